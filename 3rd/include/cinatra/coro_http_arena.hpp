@@ -0,0 +1,248 @@
+#pragma once
+#include <cstddef>
+#include <new>
+
+namespace cinatra {
+namespace detail {
+// Fixed size slabs shared by all connections running on one io thread. A
+// connection keeps its first slab for its whole life and only borrows more
+// for unusually large requests, so once the pool is warm keep-alive traffic
+// never reaches malloc.
+class slab_pool {
+ public:
+  static constexpr size_t slab_size = 4096;
+  // at most 1MB of idle slabs per thread, the rest goes back to malloc
+  static constexpr size_t max_idle = 256;
+
+  static slab_pool &local() {
+    thread_local slab_pool pool;
+    return pool;
+  }
+
+  slab_pool() = default;
+  slab_pool(const slab_pool &) = delete;
+  slab_pool &operator=(const slab_pool &) = delete;
+
+  ~slab_pool() {
+    while (idle_) {
+      auto next = idle_->next;
+      ::operator delete(idle_);
+      idle_ = next;
+    }
+  }
+
+  void *get() {
+    if (idle_ == nullptr) {
+      return ::operator new(slab_size);
+    }
+    auto slab = idle_;
+    idle_ = slab->next;
+    --idle_count_;
+    return slab;
+  }
+
+  void put(void *slab) {
+    if (idle_count_ == max_idle) {
+      ::operator delete(slab);
+      return;
+    }
+    auto node = static_cast<free_slab *>(slab);
+    node->next = idle_;
+    idle_ = node;
+    ++idle_count_;
+  }
+
+ private:
+  struct free_slab {
+    free_slab *next;
+  };
+  free_slab *idle_ = nullptr;
+  size_t idle_count_ = 0;
+};
+}  // namespace detail
+
+// Memory of one asio operation in flight, e.g. the header read or the reply
+// write of a connection. Two slots: a write that completes at once still holds
+// its operation while asio posts the handler. Falls back to the heap when the
+// request is too large or both slots are taken.
+class handler_block {
+ public:
+  static constexpr size_t slots = 2;
+
+  void *allocate(size_t size) {
+    if (size <= slot_size_) {
+      for (size_t i = 0; i < slots; ++i) {
+        if (!in_use_[i]) {
+          in_use_[i] = true;
+          return storage_ + i * slot_size_;
+        }
+      }
+    }
+    return ::operator new(size);
+  }
+
+  void deallocate(void *pointer) noexcept {
+    auto p = static_cast<char *>(pointer);
+    if (p >= storage_ && p < storage_ + slots * slot_size_) {
+      in_use_[(p - storage_) / slot_size_] = false;
+    }
+    else {
+      ::operator delete(pointer);
+    }
+  }
+
+ private:
+  friend class request_arena;
+  char *storage_ = nullptr;
+  size_t slot_size_ = 0;
+  bool in_use_[slots] = {};
+};
+
+// Associated allocator of a completion handler: asio places the operation
+// object in the handler's block instead of allocating it.
+template <typename T>
+class handler_allocator {
+ public:
+  using value_type = T;
+
+  explicit handler_allocator(handler_block *block) noexcept : block_(block) {}
+
+  template <typename U>
+  handler_allocator(const handler_allocator<U> &other) noexcept
+      : block_(other.block_) {}
+
+  T *allocate(size_t n) {
+    return static_cast<T *>(block_->allocate(sizeof(T) * n));
+  }
+
+  void deallocate(T *pointer, size_t) noexcept { block_->deallocate(pointer); }
+
+  template <typename U>
+  bool operator==(const handler_allocator<U> &other) const noexcept {
+    return block_ == other.block_;
+  }
+
+  template <typename U>
+  bool operator!=(const handler_allocator<U> &other) const noexcept {
+    return block_ != other.block_;
+  }
+
+ private:
+  template <typename U>
+  friend class handler_allocator;
+  handler_block *block_;
+};
+
+// Per connection memory for request scoped data: route params, the url
+// decoded path and the asio operations of the read / reply loop. Memory is
+// handed out by bumping a cursor through slabs of the thread's slab_pool and
+// is never freed one by one; reset() after each request puts the cursor back
+// to the start of the first slab, which is O(1) unless the request needed
+// more than one slab.
+class request_arena {
+ public:
+  static constexpr size_t handler_blocks = 2;
+  static constexpr size_t handler_slot_size = 512;
+
+  request_arena() = default;
+  request_arena(const request_arena &) = delete;
+  request_arena &operator=(const request_arena &) = delete;
+
+  ~request_arena() {
+    reset();
+    if (first_) {
+      detail::slab_pool::local().put(first_);
+    }
+  }
+
+  // Memory for the asio operation with the given index. The blocks sit in
+  // front of the first slab and survive reset().
+  handler_block *handler_memory(size_t index) {
+    if (first_ == nullptr) {
+      acquire_first();
+    }
+    return &blocks_[index];
+  }
+
+  // align must not exceed alignof(std::max_align_t)
+  void *allocate(size_t size, size_t align = alignof(std::max_align_t)) {
+    if (first_ == nullptr) {
+      acquire_first();
+    }
+
+    size_t pos = (used_ + align - 1) & ~(align - 1);
+    if (pos + size <= slab_payload) [[likely]] {
+      used_ = pos + size;
+      return current_->data() + pos;
+    }
+
+    if (size > slab_payload) {
+      // larger than a slab: a block of its own, freed by reset()
+      auto big = static_cast<slab *>(::operator new(sizeof(slab) + size));
+      big->next = large_;
+      large_ = big;
+      return big->data();
+    }
+
+    auto next = static_cast<slab *>(detail::slab_pool::local().get());
+    next->next = nullptr;
+    current_->next = next;
+    current_ = next;
+    used_ = size;
+    return next->data();
+  }
+
+  template <typename T>
+  T *allocate_array(size_t n) {
+    return static_cast<T *>(allocate(sizeof(T) * n, alignof(T)));
+  }
+
+  void reset() {
+    if (first_ == nullptr) {
+      return;
+    }
+    while (first_->next) {
+      auto next = first_->next->next;
+      detail::slab_pool::local().put(first_->next);
+      first_->next = next;
+    }
+    while (large_) {
+      auto next = large_->next;
+      ::operator delete(large_);
+      large_ = next;
+    }
+    current_ = first_;
+    used_ = reserved_size;
+  }
+
+ private:
+  struct alignas(std::max_align_t) slab {
+    slab *next;
+    char *data() { return reinterpret_cast<char *>(this + 1); }
+  };
+
+  static constexpr size_t slab_payload =
+      detail::slab_pool::slab_size - sizeof(slab);
+  static constexpr size_t reserved_size =
+      handler_blocks * handler_block::slots * handler_slot_size;
+  static_assert(reserved_size < slab_payload);
+
+  void acquire_first() {
+    first_ = static_cast<slab *>(detail::slab_pool::local().get());
+    first_->next = nullptr;
+    current_ = first_;
+    used_ = reserved_size;
+    for (size_t i = 0; i < handler_blocks; ++i) {
+      blocks_[i].storage_ =
+          first_->data() + i * handler_block::slots * handler_slot_size;
+      blocks_[i].slot_size_ = handler_slot_size;
+    }
+  }
+
+  slab *first_ = nullptr;
+  slab *current_ = nullptr;
+  slab *large_ = nullptr;
+  size_t used_ = 0;
+  handler_block blocks_[handler_blocks];
+};
+}  // namespace cinatra
@@ -3,6 +3,7 @@
 #include <async_simple/coro/SyncAwait.h>
 
 #include <asio/buffer.hpp>
+#include <span>
 #include <system_error>
 #include <thread>
 
@@ -12,6 +13,7 @@
 #include "cinatra/cinatra_log_wrapper.hpp"
 #include "cinatra/response_cv.hpp"
 #include "cookie.hpp"
+#include "coro_http_arena.hpp"
 #include "coro_http_request.hpp"
 #include "coro_http_router.hpp"
 #include "define.h"
@@ -51,6 +53,204 @@ class coro_http_connection
 
   ~coro_http_connection() { close(); }
 
+ private:
+  // Completion handler of io_awaiter: stores the result and resumes the
+  // awaiting coroutine. asio takes the memory of the operation from the
+  // handler's block, one of the blocks of the connection's arena.
+  struct io_state {
+    std::coroutine_handle<> handle;
+    std::pair<std::error_code, size_t> result;
+    handler_block *block;
+  };
+
+  class io_handler {
+   public:
+    using allocator_type = handler_allocator<void>;
+
+    explicit io_handler(io_state *state) : state_(state) {}
+
+    allocator_type get_allocator() const noexcept {
+      return allocator_type(state_->block);
+    }
+
+    void operator()(const std::error_code &ec, size_t size) const {
+      state_->result = {ec, size};
+      state_->handle.resume();
+    }
+
+   private:
+    io_state *state_;
+  };
+
+  // co_await-able asio operation of the request loop. Unlike the coro_io
+  // wrappers it needs no coroutine frame of its own, so together with the
+  // handler block, reading a request and replying to it does not allocate.
+  template <typename Op>
+  class io_awaiter {
+   public:
+    io_awaiter(Op op, handler_block *block) : op_(op) { state_.block = block; }
+
+    // completes at once with ec and size, without starting op
+    io_awaiter(Op op, std::error_code ec, size_t size = 0)
+        : op_(op), ready_(true) {
+      state_.result = {ec, size};
+    }
+
+    bool await_ready() const noexcept { return ready_; }
+
+    void await_suspend(std::coroutine_handle<> handle) {
+      state_.handle = handle;
+      op_(io_handler{&state_});
+    }
+
+    std::pair<std::error_code, size_t> await_resume() noexcept {
+      return state_.result;
+    }
+
+    io_awaiter coAwait(async_simple::Executor *) noexcept { return *this; }
+
+   private:
+    Op op_;
+    io_state state_{};
+    bool ready_ = false;
+  };
+
+  struct read_head_op {
+    coro_http_connection *self;
+    void operator()(io_handler handler) const {
+#ifdef CINATRA_ENABLE_SSL
+      if (self->use_ssl_) {
+        asio::async_read_until(*self->ssl_stream_, self->head_buf_, TWO_CRCF,
+                               std::move(handler));
+        return;
+      }
+#endif
+      asio::async_read_until(self->socket_, self->head_buf_, TWO_CRCF,
+                             std::move(handler));
+    }
+  };
+
+  // a part of a streamed request body, see read_body_some()
+  struct read_body_op {
+    coro_http_connection *self;
+    asio::mutable_buffer buffer;
+    void operator()(io_handler handler) const {
+#ifdef CINATRA_ENABLE_SSL
+      if (self->use_ssl_) {
+        self->ssl_stream_->async_read_some(buffer, std::move(handler));
+        return;
+      }
+#endif
+      self->socket_.async_read_some(buffer, std::move(handler));
+    }
+  };
+
+  // the rest of a request body that did not come with its header
+  struct read_body_rest_op {
+    coro_http_connection *self;
+    asio::mutable_buffer buffer;
+    void operator()(io_handler handler) const {
+#ifdef CINATRA_ENABLE_SSL
+      if (self->use_ssl_) {
+        asio::async_read(*self->ssl_stream_, buffer, std::move(handler));
+        return;
+      }
+#endif
+      asio::async_read(self->socket_, buffer, std::move(handler));
+    }
+  };
+
+  // writes the connection's buffers_ if multi_buf, else resp_str_
+  struct write_reply_op {
+    coro_http_connection *self;
+    bool multi_buf;
+    template <typename Stream>
+    void write(Stream &stream, io_handler handler) const {
+      if (multi_buf) {
+        // a span, the operation would copy a vector
+        asio::async_write(
+            stream, std::span<const asio::const_buffer>(self->buffers_),
+            std::move(handler));
+      }
+      else {
+        asio::async_write(stream, asio::buffer(self->resp_str_),
+                          std::move(handler));
+      }
+    }
+    void operator()(io_handler handler) const {
+#ifdef CINATRA_ENABLE_SSL
+      if (self->use_ssl_) {
+        write(*self->ssl_stream_, std::move(handler));
+        return;
+      }
+#endif
+      write(self->socket_, std::move(handler));
+    }
+  };
+
+ public:
+  // co_await reply() yields false, and the connection is closed, when the
+  // write failed.
+  class reply_awaiter {
+   public:
+    reply_awaiter(coro_http_connection *self, io_awaiter<write_reply_op> io)
+        : self_(self), io_(io) {}
+
+    bool await_ready() const noexcept { return io_.await_ready(); }
+
+    void await_suspend(std::coroutine_handle<> handle) {
+      io_.await_suspend(handle);
+    }
+
+    bool await_resume() {
+      auto [ec, size] = io_.await_resume();
+      // the responses batched in resp_str_ went out with this write
+      self_->resp_str_.clear();
+      if (ec) {
+        CINATRA_LOG_ERROR << "async_write error: " << ec.message();
+        self_->close();
+        return false;
+      }
+      return true;
+    }
+
+    reply_awaiter coAwait(async_simple::Executor *) noexcept { return *this; }
+
+   private:
+    coro_http_connection *self_;
+    io_awaiter<write_reply_op> io_;
+  };
+
+  // co_await read_body_some() yields the error and the bytes read, 0 once
+  // the whole body was read.
+  class body_read_awaiter {
+   public:
+    body_read_awaiter(coro_http_connection *self, io_awaiter<read_body_op> io)
+        : self_(self), io_(io) {}
+
+    bool await_ready() const noexcept { return io_.await_ready(); }
+
+    void await_suspend(std::coroutine_handle<> handle) {
+      io_.await_suspend(handle);
+    }
+
+    std::pair<std::error_code, size_t> await_resume() {
+      auto result = io_.await_resume();
+      if (!await_ready()) {
+        self_->body_left_ -= result.second;
+      }
+      return result;
+    }
+
+    body_read_awaiter coAwait(async_simple::Executor *) noexcept {
+      return *this;
+    }
+
+   private:
+    coro_http_connection *self_;
+    io_awaiter<read_body_op> io_;
+  };
+
 #ifdef CINATRA_ENABLE_SSL
   bool init_ssl(const std::string &cert_file, const std::string &key_file,
                 std::string passwd) {
@@ -110,14 +310,21 @@ class coro_http_connection
         has_shake = true;
       }
 #endif
-      auto [ec, size] = co_await async_read_until(head_buf_, TWO_CRCF);
-      if (ec) {
-        if (ec != asio::error::eof) {
-          CINATRA_LOG_WARNING << "read http header error: " << ec.message();
-        }
+      set_last_time();
+      std::error_code ec;
+      // a pipelined request whose header is buffered already needs no read
+      size_t size = buffered_head_size();
+      if (size == 0) {
+        std::tie(ec, size) = co_await io_awaiter<read_head_op>(
+            read_head_op{this}, arena_.handler_memory(0));
+        if (ec) {
+          if (ec != asio::error::eof) {
+            CINATRA_LOG_WARNING << "read http header error: " << ec.message();
+          }
 
-        close();
-        break;
+          close();
+          break;
+        }
       }
 
       const char *data_ptr = asio::buffer_cast<const char *>(head_buf_.data());
@@ -147,6 +354,7 @@ class coro_http_connection
 
       auto type = request_.get_content_type();
 
+      std::string_view body;
       if (type != content_type::chunked && type != content_type::multipart) {
         size_t body_len = (size_t)parser_.body_len();
         if (body_len == 0) {
@@ -173,46 +381,75 @@ class coro_http_connection
         }
         else if (body_len <= head_buf_.size()) {
           if (body_len > 0) {
-            detail::resize(body_, body_len);
+            // the body came with the header: use it in place, consume() only
+            // moves head_buf_'s read pointer and the bytes stay put until
+            // the next read. What follows it is the next pipelined request.
             auto data_ptr = asio::buffer_cast<const char *>(head_buf_.data());
-            memcpy(body_.data(), data_ptr, body_len);
-            head_buf_.consume(head_buf_.size());
+            body = {data_ptr, body_len};
+            head_buf_.consume(body_len);
           }
         }
         else {
-          size_t part_size = head_buf_.size();
-          size_t size_to_read = body_len - part_size;
-          auto data_ptr = asio::buffer_cast<const char *>(head_buf_.data());
-          detail::resize(body_, body_len);
-          memcpy(body_.data(), data_ptr, part_size);
-          head_buf_.consume(part_size);
-
-          auto [ec, size] = co_await async_read(
-              asio::buffer(body_.data() + part_size, size_to_read),
-              size_to_read);
-          if (ec) {
-            CINATRA_LOG_ERROR << "async_read error: " << ec.message();
-            close();
-            break;
+          if (!resp_str_.empty()) {
+            // do not hold the batched responses back while the body trickles in
+            auto [write_ec, _] = co_await write_batch();
+            resp_str_.clear();
+            if (write_ec) {
+              CINATRA_LOG_ERROR << "async_write error: " << write_ec.message();
+              close();
+              break;
+            }
+          }
+          if (stream_body_min_ > 0 && body_len >= stream_body_min_) {
+            // left in the socket: the handler reads it with read_body_some()
+            body_left_ = body_len;
+          }
+          else {
+            size_t part_size = head_buf_.size();
+            size_t size_to_read = body_len - part_size;
+            auto data_ptr = asio::buffer_cast<const char *>(head_buf_.data());
+            detail::resize(body_, body_len);
+            memcpy(body_.data(), data_ptr, part_size);
+            head_buf_.consume(part_size);
+
+            set_last_time();
+            auto [ec, size] = co_await io_awaiter<read_body_rest_op>(
+                read_body_rest_op{
+                    this, asio::buffer(body_.data() + part_size, size_to_read)},
+                arena_.handler_memory(0));
+            if (ec) {
+              CINATRA_LOG_ERROR << "async_read error: " << ec.message();
+              close();
+              break;
+            }
+            body = body_;
           }
         }
       }
 
-      std::string_view key = {
+      // "GET /path", a view into the request line
+      std::string_view raw_key = {
           parser_.method().data(),
           parser_.method().length() + 1 + parser_.url().length()};
 
-      std::string decode_key;
+      std::string_view key = raw_key;
       if (parser_.url().find('%') != std::string_view::npos) {
-        decode_key = code_utils::url_decode(key);
-        key = decode_key;
+        char *decoded = arena_.allocate_array<char>(raw_key.size());
+        key = {decoded, code_utils::url_decode(raw_key, decoded)};
       }
 
-      if (!body_.empty()) {
-        request_.set_body(body_);
+      if (!body.empty()) {
+        request_.set_body(body);
       }
 
-      if (auto handler = router_.get_handler(key); handler) {
+      if (auto routed = router_.route_static(key, request_, response_);
+          routed != coro_http_router::static_route::not_found) {
+        // served by the application's own route table
+        if (routed == coro_http_router::static_route::suspend) {
+          co_await router_.route_static_coro(key, request_, response_);
+        }
+      }
+      else if (auto handler = router_.get_handler(key); handler) {
         router_.route(handler, request_, response_, key);
       }
       else {
@@ -223,33 +460,38 @@ class coro_http_connection
           bool is_exist = false;
           bool is_coro_exist = false;
           bool is_matched_regex_router = false;
-          std::function<void(coro_http_request & req,
-                             coro_http_response & resp)>
-              handler;
-          std::string method_str{parser_.method()};
-          std::string url_path = method_str;
-          url_path.append(" ").append(parser_.url());
-          std::tie(is_exist, handler, request_.params_) =
-              router_.get_router_tree()->get(url_path, method_str);
+          const std::function<void(coro_http_request & req,
+                                   coro_http_response & resp)> *handler;
+          auto &tree = *router_.get_router_tree();
+          request_.params_.reset(arena_.allocate_array<route_params::value_type>(
+                                     tree.max_params()),
+                                 tree.max_params());
+          std::tie(is_exist, handler) =
+              tree.get(raw_key, parser_.method(), request_.params_);
           if (is_exist) {
             if (handler) {
-              (handler)(request_, response_);
+              (*handler)(request_, response_);
             }
             else {
               response_.set_status(status_type::not_found);
             }
           }
           else {
-            std::function<async_simple::coro::Lazy<void>(
+            const std::function<async_simple::coro::Lazy<void>(
                 coro_http_request & req, coro_http_response & resp)>
-                coro_handler;
+                *coro_handler;
 
-            std::tie(is_coro_exist, coro_handler, request_.params_) =
-                router_.get_coro_router_tree()->get_coro(url_path, method_str);
+            auto &coro_tree = *router_.get_coro_router_tree();
+            request_.params_.reset(
+                arena_.allocate_array<route_params::value_type>(
+                    coro_tree.max_params()),
+                coro_tree.max_params());
+            std::tie(is_coro_exist, coro_handler) = coro_tree.get_coro(
+                raw_key, parser_.method(), request_.params_);
 
             if (is_coro_exist) {
               if (coro_handler) {
-                co_await coro_handler(request_, response_);
+                co_await (*coro_handler)(request_, response_);
               }
               else {
                 response_.set_status(status_type::not_found);
@@ -257,7 +499,7 @@ class coro_http_connection
             }
             else {
               // coro regex router
-              auto coro_regex_handlers = router_.get_coro_regex_handlers();
+              auto &coro_regex_handlers = router_.get_coro_regex_handlers();
               if (coro_regex_handlers.size() != 0) {
                 for (auto &pair : coro_regex_handlers) {
                   std::string coro_regex_key{key};
@@ -274,7 +516,7 @@ class coro_http_connection
               }
               // regex router
               if (!is_matched_regex_router) {
-                auto regex_handlers = router_.get_regex_handlers();
+                auto &regex_handlers = router_.get_regex_handlers();
                 if (regex_handlers.size() != 0) {
                   for (auto &pair : regex_handlers) {
                     std::string regex_key{key};
@@ -306,86 +548,33 @@ class coro_http_connection
       }
 
       if (!response_.get_delay()) {
-        if (head_buf_.size()) {
-          if (type == content_type::multipart ||
-              type == content_type::chunked) {
-            if (response_.content().empty())
-              response_.set_status_and_content(
-                  status_type::not_implemented,
-                  "mutipart handler not implemented or incorrect implemented");
-            co_await reply();
-            close();
-            CINATRA_LOG_ERROR
-                << "mutipart handler not implemented or incorrect implemented"
-                << ec.message();
-            break;
-          }
-          else if (parser_.method()[0] != 'G' && parser_.method()[0] != 'H') {
-            // handle pipeling, only support GET and HEAD method now.
-            response_.set_status_and_content(status_type::method_not_allowed,
-                                             "method not allowed");
-            co_await reply();
-          }
-          else {
-            resp_str_.reserve(512);
-            response_.build_resp_str(resp_str_);
-
-            while (true) {
-              size_t left_size = head_buf_.size();
-              auto next_data_ptr =
-                  asio::buffer_cast<const char *>(head_buf_.data());
-              std::string_view left_content{next_data_ptr, left_size};
-              size_t pos = left_content.find(TWO_CRCF);
-              if (pos == std::string_view::npos) {
-                break;
-              }
-              http_parser parser;
-              int head_len = parser.parse_request(next_data_ptr, left_size, 0);
-              if (head_len <= 0) {
-                CINATRA_LOG_ERROR << "parse http header error";
-                response_.set_status_and_content(status_type::bad_request,
-                                                 "invalid http protocol");
-                co_await reply();
-                close();
-                break;
-              }
-
-              head_buf_.consume(pos + TWO_CRCF.length());
-
-              std::string_view next_key = {
-                  parser.method().data(),
-                  parser.method().length() + 1 + parser.url().length()};
-
-              coro_http_request req(parser, this);
-              coro_http_response resp(this);
-              resp.need_date_head(response_.need_date());
-              if (auto handler = router_.get_handler(next_key); handler) {
-                router_.route(handler, req, resp, key);
-              }
-              else {
-                if (auto coro_handler = router_.get_coro_handler(next_key);
-                    coro_handler) {
-                  co_await router_.route_coro(coro_handler, req, resp, key);
-                }
-                else {
-                  resp.set_status(status_type::not_found);
-                }
-              }
-
-              resp.build_resp_str(resp_str_);
-            }
+        if (head_buf_.size() && (type == content_type::multipart ||
+                                 type == content_type::chunked)) {
+          if (response_.content().empty())
+            response_.set_status_and_content(
+                status_type::not_implemented,
+                "mutipart handler not implemented or incorrect implemented");
+          co_await reply();
+          close();
+          CINATRA_LOG_ERROR
+              << "mutipart handler not implemented or incorrect implemented"
+              << ec.message();
+          break;
+        }
 
-            auto [write_ec, _] = co_await async_write(asio::buffer(resp_str_));
-            if (write_ec) {
-              CINATRA_LOG_ERROR << "async_write error: " << write_ec.message();
-              close();
-              co_return;
-            }
-          }
-          head_buf_.consume(head_buf_.size());
+        if (body_left_ > 0) {
+          // the handler left a streamed body unread: no telling where the
+          // next request starts
+          keep_alive_ = false;
+          response_.set_keepalive(false);
+        }
+        handle_session_for_response();
+        if (keep_alive_ && can_batch_response()) {
+          // HTTP/1.1 pipelining: the next request is buffered already, answer
+          // it first and send both responses with one write
+          response_.build_resp_str(resp_str_);
         }
         else {
-          handle_session_for_response();
           co_await reply();
         }
       }
@@ -399,7 +588,8 @@ class coro_http_connection
       request_.clear();
       buffers_.clear();
       body_.clear();
-      resp_str_.clear();
+      body_left_ = 0;
+      arena_.reset();
       multi_buf_ = true;
       if (need_shrink_every_time_) {
         body_.shrink_to_fit();
@@ -411,29 +601,30 @@ class coro_http_connection
     }
   }
 
-  async_simple::coro::Lazy<bool> reply(bool need_to_bufffer = true) {
-    std::error_code ec;
-    size_t size;
+  // Also writes the responses of pipelined requests batched before this one.
+  reply_awaiter reply(bool need_to_bufffer = true) {
     if (multi_buf_) {
+      if (!resp_str_.empty()) {
+        buffers_.insert(buffers_.begin(), asio::buffer(resp_str_));
+      }
       if (need_to_bufffer) {
         response_.to_buffers(buffers_, chunk_size_str_);
       }
-      std::tie(ec, size) = co_await async_write(buffers_);
     }
     else {
       if (need_to_bufffer) {
         response_.build_resp_str(resp_str_);
       }
-      std::tie(ec, size) = co_await async_write(asio::buffer(resp_str_));
     }
 
-    if (ec) {
-      CINATRA_LOG_ERROR << "async_write error: " << ec.message();
-      close();
-      co_return false;
+    write_reply_op op{this, multi_buf_};
+#ifdef INJECT_FOR_HTTP_SEVER_TEST
+    if (write_failed_forever_) {
+      return {this, {op, std::make_error_code(std::errc::io_error)}};
     }
-
-    co_return true;
+#endif
+    set_last_time();
+    return {this, {op, arena_.handler_memory(1)}};
   }
 
   std::string local_address() {
@@ -467,6 +658,33 @@ class coro_http_connection
     max_http_body_len_ = max_size;
   }
 
+  // see coro_http_server::set_stream_body_min
+  void set_stream_body_min(size_t min_size) { stream_body_min_ = min_size; }
+
+  // Bytes of a streamed request body still to be read, 0 if the body was
+  // read before the handler was called.
+  uint64_t body_left() const { return body_left_; }
+
+  // Reads at most size bytes of a streamed request body into buffer: what
+  // is buffered already, else one read from the socket. Nothing is read
+  // ahead, so a handler consuming slowly holds the client back through TCP
+  // flow control, and the memory used is the handler's buffer. 0 bytes
+  // once the body was read completely.
+  body_read_awaiter read_body_some(char *buffer, size_t size) {
+    size = static_cast<size_t>(std::min<uint64_t>(size, body_left_));
+    if (size == 0 || head_buf_.size() > 0) {
+      size = std::min(size, head_buf_.size());
+      memcpy(buffer, asio::buffer_cast<const char *>(head_buf_.data()), size);
+      head_buf_.consume(size);
+      body_left_ -= size;
+      return {this, {read_body_op{this, {}}, std::error_code{}, size}};
+    }
+    set_last_time();
+    return {this,
+            {read_body_op{this, asio::buffer(buffer, size)},
+             arena_.handler_memory(0)}};
+  }
+
 #ifdef INJECT_FOR_HTTP_SEVER_TEST
   void set_write_failed_forever(bool r) { write_failed_forever_ = r; }
 
@@ -654,11 +872,13 @@ class coro_http_connection
         auto payload_length = ws_.payload_length();
 
         if (max_part_size_ != 0 && payload_length > max_part_size_) {
-          std::string close_reason = "message_too_big";
-          std::string close_msg = ws_.format_close_payload(
-              close_code::too_big, close_reason.data(), close_reason.size());
-          co_await write_websocket(close_msg, opcode::close);
-          close();
+          if (ws_auto_reply_) {
+            std::string close_reason = "message_too_big";
+            std::string close_msg = ws_.format_close_payload(
+                close_code::too_big, close_reason.data(), close_reason.size());
+            co_await write_websocket(close_msg, opcode::close);
+            close();
+          }
           result.ec = std::error_code(asio::error::message_size,
                                       asio::error::get_system_category());
           break;
@@ -711,6 +931,9 @@ class coro_http_connection
             result.eof = true;
             result.data = {close_frame.message, close_frame.length};
 
+            if (!ws_auto_reply_) {
+              break;
+            }
             std::string close_msg = ws_.format_close_payload(
                 close_code::normal, close_frame.message, close_frame.length);
 
@@ -719,6 +942,9 @@ class coro_http_connection
           } break;
           case cinatra::ws_frame_type::WS_PING_FRAME: {
             result.data = {payload.data(), payload.size()};
+            if (!ws_auto_reply_) {
+              break;
+            }
             auto ec = co_await write_websocket(result.data, opcode::pong);
             if (ec) {
               close();
@@ -727,6 +953,9 @@ class coro_http_connection
           } break;
           case cinatra::ws_frame_type::WS_PONG_FRAME: {
             result.data = {payload.data(), payload.size()};
+            if (!ws_auto_reply_) {
+              break;
+            }
             auto ec = co_await write_websocket(result.data, opcode::ping);
             result.ec = ec;
           } break;
@@ -774,6 +1003,27 @@ class coro_http_connection
 
   auto &tcp_socket() { return socket_; }
 
+  bool is_ssl() const {
+#ifdef CINATRA_ENABLE_SSL
+    return use_ssl_;
+#else
+    return false;
+#endif
+  }
+
+#ifdef __linux__
+  // plain tcp only: the kernel copies [offset, offset + size) of fd to the
+  // socket, the bytes never go through user space.
+  async_simple::coro::Lazy<std::pair<std::error_code, size_t>> async_sendfile(
+      int fd, off_t offset, size_t size) {
+    if (!resp_str_.empty()) [[unlikely]] {
+      return flush_then_sendfile(fd, offset, size);
+    }
+    set_last_time();
+    return coro_io::async_sendfile(socket_, fd, offset, size);
+  }
+#endif
+
   void set_quit_callback(std::function<void(const uint64_t &conn_id)> callback,
                          uint64_t conn_id) {
     quit_cb_ = std::move(callback);
@@ -782,6 +1032,12 @@ class coro_http_connection
 
   void set_ws_max_size(uint64_t max_size) { max_part_size_ = max_size; }
 
+  // false: read_websocket() returns ping, pong and close frames (and
+  // message_size for a frame over the max size) without writing the answer
+  // nor closing, for a caller that has a writer of its own: a write from
+  // read_websocket() could land between the partial writes of its batch.
+  void set_ws_auto_reply(bool r) { ws_auto_reply_ = r; }
+
   void set_shrink_to_fit(bool r) {
     need_shrink_every_time_ = r;
     response_.set_shrink_to_fit(r);
@@ -828,6 +1084,10 @@ class coro_http_connection
       return async_write_failed();
     }
 #endif
+    if (!resp_str_.empty()) [[unlikely]] {
+      // a handler writing on its own after pipelined requests
+      return flush_then_write<AsioBuffer>(std::forward<AsioBuffer>(buffer));
+    }
     set_last_time();
 #ifdef CINATRA_ENABLE_SSL
     if (use_ssl_) {
@@ -900,6 +1160,57 @@ class coro_http_connection
   }
 
  private:
+  // responses of pipelined requests are batched up to this many bytes
+  static constexpr size_t max_batched_responses = 64 * 1024;
+
+  // Length of the next request's header if all of it is buffered already,
+  // i.e. the client pipelines; 0 otherwise.
+  size_t buffered_head_size() const {
+    std::string_view buffered(
+        asio::buffer_cast<const char *>(head_buf_.data()), head_buf_.size());
+    size_t pos = buffered.find(TWO_CRCF);
+    return pos == std::string_view::npos ? 0 : pos + TWO_CRCF.size();
+  }
+
+  // Whether to hold the response back and send it with the next one: the
+  // next request is buffered and the batch stays small. A copy of the
+  // response goes into the batch, so large bodies are written at once.
+  bool can_batch_response() {
+    return resp_str_.size() + response_.body_view().size() <
+               max_batched_responses &&
+           buffered_head_size() != 0;
+  }
+
+  // Writes the batched responses on their own, before something that does
+  // not go through reply(). The caller clears resp_str_ afterwards.
+  io_awaiter<write_reply_op> write_batch() {
+    set_last_time();
+    return {write_reply_op{this, false}, arena_.handler_memory(1)};
+  }
+
+  template <typename AsioBuffer>
+  async_simple::coro::Lazy<std::pair<std::error_code, size_t>>
+  flush_then_write(AsioBuffer buffer) {
+    auto [ec, size] = co_await write_batch();
+    resp_str_.clear();
+    if (ec) {
+      co_return std::make_pair(ec, size_t{0});
+    }
+    co_return co_await async_write(buffer);
+  }
+
+#ifdef __linux__
+  async_simple::coro::Lazy<std::pair<std::error_code, size_t>>
+  flush_then_sendfile(int fd, off_t offset, size_t size) {
+    auto [ec, _] = co_await write_batch();
+    resp_str_.clear();
+    if (ec) {
+      co_return std::make_pair(ec, size_t{0});
+    }
+    co_return co_await async_sendfile(fd, offset, size);
+  }
+#endif
+
   bool check_keep_alive() {
     if (parser_.has_close()) {
       return false;
@@ -958,6 +1269,9 @@ class coro_http_connection
  private:
   friend class multipart_reader_t<coro_http_connection>;
   coro_io::ExecutorWrapper<> *executor_;
+  // declared before socket_: operations still queued on the socket live in
+  // the arena's handler blocks
+  request_arena arena_;
   asio::ip::tcp::socket socket_;
   coro_http_router &router_;
   asio::streambuf head_buf_;
@@ -975,7 +1289,10 @@ class coro_http_connection
   std::atomic<std::chrono::system_clock::time_point> last_rwtime_ =
       std::chrono::system_clock::now();
   uint64_t max_part_size_ = 8 * 1024 * 1024;
+  bool ws_auto_reply_ = true;
   std::string resp_str_;
+  size_t stream_body_min_ = 0;  // 0: disabled
+  uint64_t body_left_ = 0;
 
 #ifdef CINATRA_ENABLE_GZIP
   bool is_client_ws_compressed_ = false;
@@ -6,6 +6,8 @@
 #include <optional>
 #include <regex>
 #include <string>
+#include <string_view>
+#include <utility>
 
 #include "async_simple/coro/Lazy.h"
 #include "define.h"
@@ -93,6 +95,53 @@ inline std::vector<std::pair<int, int>> parse_ranges(std::string_view range_str,
   return vec;
 }
 
+// Path parameters of a radix route ("/users/:id"). Names are views into the
+// route tree and values views into the request line; the slots come from the
+// connection's request_arena, so matching a route does not allocate. Valid
+// until the response has been sent.
+class route_params {
+ public:
+  using value_type = std::pair<std::string_view, std::string_view>;
+
+  void reset(value_type *slots, size_t capacity) {
+    data_ = slots;
+    size_ = 0;
+    capacity_ = capacity;
+  }
+
+  void emplace(std::string_view name, std::string_view value) {
+    if (size_ < capacity_) {
+      data_[size_++] = {name, value};
+    }
+  }
+
+  // the value of name, empty if the route has no such parameter
+  std::string_view operator[](std::string_view name) const {
+    auto it = find(name);
+    return it == end() ? std::string_view{} : it->second;
+  }
+
+  const value_type *find(std::string_view name) const {
+    for (auto it = begin(); it != end(); ++it) {
+      if (it->first == name) {
+        return it;
+      }
+    }
+    return end();
+  }
+
+  const value_type *begin() const { return data_; }
+  const value_type *end() const { return data_ + size_; }
+  size_t size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+  void clear() { size_ = 0; }
+
+ private:
+  value_type *data_ = nullptr;
+  size_t size_ = 0;
+  size_t capacity_ = 0;
+};
+
 class coro_http_connection;
 class coro_http_request {
  public:
@@ -129,7 +178,7 @@ class coro_http_request {
 
   std::string_view full_url() { return parser_.full_url(); }
 
-  void set_body(std::string &body) {
+  void set_body(std::string_view body) {
     body_ = body;
     auto type = get_content_type();
     if (type == content_type::urlencoded) {
@@ -289,6 +338,7 @@ class coro_http_request {
   bool has_session() { return !cached_session_id_.empty(); }
   void clear() {
     body_ = {};
+    params_.clear();
     if (!aspect_data_.empty()) {
       aspect_data_.clear();
     }
@@ -297,7 +347,7 @@ class coro_http_request {
     }
   }
 
-  std::unordered_map<std::string, std::string> params_;
+  route_params params_;
   std::smatch matches_;
 
  private:
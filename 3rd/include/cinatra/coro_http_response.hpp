@@ -1,6 +1,7 @@
 #pragma once
 #include <charconv>
 #include <functional>
+#include <memory>
 #include <optional>
 #include <string>
 #include <string_view>
@@ -186,8 +187,98 @@ class coro_http_response {
 
   std::string_view get_boundary() { return boundary_; }
 
+  // Sends head and body as they are, e.g. a response cached earlier. head is
+  // what build_prepared_head() made; Date and Connection are added when the
+  // response goes out. owner keeps head and body alive until then.
+  void set_prepared(status_type status, std::string_view head,
+                    std::string_view body, std::shared_ptr<const void> owner) {
+    status_ = status;
+    prepared_head_ = head;
+    content_view_ = body;
+    prepared_owner_ = std::move(owner);
+    has_set_content_ = true;
+  }
+
+  // The status line and headers of the response filled in by a handler,
+  // without Date, Connection and the closing blank line: the head
+  // set_prepared() takes. False if the response can not be replayed
+  // (chunked, cookies, multipart).
+  bool build_prepared_head(std::string &head) {
+    if (fmt_type_ == format_type::chunked || !cookies_.empty() ||
+        !boundary_.empty()) {
+      return false;
+    }
+    head.append(to_http_status_string(status_));
+    bool has_len = false;
+    bool has_host = false;
+    bool need_date = need_date_;
+    check_header(resp_headers_, has_len, has_host);
+    if (!resp_header_span_.empty()) {
+      check_header(resp_header_span_, has_len, has_host);
+    }
+    need_date_ = need_date;
+
+    if (!has_host) {
+      head.append(CINATRA_HOST_SV);
+    }
+    if (content_.empty() && !has_set_content_) {
+      content_.append(default_status_content(status_));
+    }
+    if (!has_len) {
+      auto [ptr, ec] = std::to_chars(buf_, buf_ + 32, body_view().size());
+      head.append(CONTENT_LENGTH_SV);
+      head.append(std::string_view(buf_, std::distance(buf_, ptr)));
+      head.append(CRCF);
+    }
+    head.append(content_type_);
+    for (auto &[k, v] : resp_headers_) {
+      if (k != "Date" && k != "Connection") {
+        head.append(k).append(COLON_SV).append(v).append(CRCF);
+      }
+    }
+    for (auto &[k, v] : resp_header_span_) {
+      if (k != "Date" && k != "Connection") {
+        head.append(k).append(COLON_SV).append(v).append(CRCF);
+      }
+    }
+    return true;
+  }
+
+  // A header the handler set, Content-Type included; empty if there is none.
+  std::string_view header_value(std::string_view key) const {
+    if (!content_type_.empty() && iequal0(key, "Content-Type")) {
+      std::string_view type = content_type_.substr(content_type_.find(':') + 1);
+      return type.substr(type.find_first_not_of(' '),
+                         type.size() - type.find_first_not_of(' ') - 2);
+    }
+    for (auto &[k, v] : resp_headers_) {
+      if (iequal0(k, key)) {
+        return v;
+      }
+    }
+    for (auto &[k, v] : resp_header_span_) {
+      if (iequal0(k, key)) {
+        return v;
+      }
+    }
+    return {};
+  }
+
+  // the body as it will be sent
+  std::string_view body_view() const {
+    return content_.empty() ? content_view_ : std::string_view(content_);
+  }
+
   void to_buffers(std::vector<asio::const_buffer> &buffers,
                   std::string &size_str) {
+    if (!prepared_head_.empty()) {
+      buffers.push_back(asio::buffer(prepared_head_));
+      build_prepared_tail(buffers);
+      if (!content_view_.empty()) {
+        buffers.push_back(asio::buffer(content_view_));
+      }
+      return;
+    }
     buffers.push_back(asio::buffer(to_http_status_string(status_)));
     build_resp_head(buffers);
     if (!content_.empty()) {
@@ -199,6 +290,20 @@ class coro_http_response {
   }
 
   void build_resp_str(std::string &resp_str) {
+    if (!prepared_head_.empty()) {
+      resp_str.append(prepared_head_);
+      if (need_date_) {
+        resp_str.append(DATE_SV);
+        resp_str.append(get_gmt_time_str());
+        resp_str.append(CRCF);
+      }
+      if (keepalive_.has_value()) {
+        resp_str.append(keepalive_.value() ? CONN_KEEP_SV : CONN_CLOSE_SV);
+      }
+      resp_str.append(CRCF);
+      resp_str.append(content_view_);
+      return;
+    }
     resp_str.append(to_http_status_string(status_));
     bool has_len = false;
     bool has_host = false;
@@ -351,6 +456,20 @@ class coro_http_response {
     buffers.emplace_back(asio::buffer(CRCF));
   }
 
+  // Date, Connection and the blank line after a prepared head
+  void build_prepared_tail(std::vector<asio::const_buffer> &buffers) {
+    if (need_date_) {
+      buffers.emplace_back(asio::buffer(DATE_SV));
+      buffers.emplace_back(asio::buffer(get_gmt_time_str()));
+      buffers.emplace_back(asio::buffer(CRCF));
+    }
+    if (keepalive_.has_value()) {
+      buffers.emplace_back(
+          asio::buffer(keepalive_.value() ? CONN_KEEP_SV : CONN_CLOSE_SV));
+    }
+    buffers.emplace_back(asio::buffer(CRCF));
+  }
+
   void append_header(auto &buffers, auto &resp_headers) {
     for (auto &[k, v] : resp_headers) {
       buffers.emplace_back(asio::buffer(k));
@@ -367,6 +486,9 @@ class coro_http_response {
     if (need_shrink_every_time_) {
       content_.shrink_to_fit();
     }
+    content_view_ = {};
+    prepared_head_ = {};
+    prepared_owner_.reset();
 
     resp_headers_.clear();
     keepalive_ = {};
@@ -428,5 +550,7 @@ class coro_http_response {
   std::unordered_map<std::string, cookie> cookies_;
   std::string_view content_type_;
   std::string_view content_view_;
+  std::string_view prepared_head_;
+  std::shared_ptr<const void> prepared_owner_;
 };
 }  // namespace cinatra
@@ -214,6 +214,68 @@ class coro_http_router {
     }
   }
 
+  // What the static router did with a request.
+  enum class static_route {
+    not_found,  // not its route, try the others
+    served,     // resp is filled in
+    suspend,    // it has to wait, e.g. for a response another request is
+                // computing: co_await the static coroutine router on it
+  };
+
+  // Tried before any other route with the "METHOD /path" key. Lets an
+  // application bring its own route table, e.g. one compiled at build time.
+  // The coroutine router is only called for requests the static router
+  // suspended, so the common path costs no coroutine frame.
+  using static_router_t = std::function<static_route(
+      std::string_view key, coro_http_request& req, coro_http_response& resp)>;
+  using static_coro_router_t =
+      std::function<async_simple::coro::Lazy<void>(
+          std::string_view key, coro_http_request& req,
+          coro_http_response& resp)>;
+  void set_static_router(static_router_t router,
+                         static_coro_router_t coro_router = nullptr) {
+    static_router_ = std::move(router);
+    static_coro_router_ = std::move(coro_router);
+  }
+
+  static_route route_static(std::string_view key, coro_http_request& req,
+                            coro_http_response& resp) {
+    if (!static_router_) {
+      return static_route::not_found;
+    }
+    try {
+      auto result = static_router_(key, req, resp);
+      if (result == static_route::suspend && !static_coro_router_) {
+        resp.set_status(status_type::internal_server_error);
+        return static_route::served;
+      }
+      return result;
+    } catch (const std::exception& e) {
+      CINATRA_LOG_WARNING << "exception in business function, reason: "
+                          << e.what();
+      resp.set_status(status_type::service_unavailable);
+    } catch (...) {
+      CINATRA_LOG_WARNING << "unknown exception in business function";
+      resp.set_status(status_type::service_unavailable);
+    }
+    return static_route::served;
+  }
+
+  async_simple::coro::Lazy<void> route_static_coro(std::string_view key,
+                                                   coro_http_request& req,
+                                                   coro_http_response& resp) {
+    try {
+      co_await static_coro_router_(key, req, resp);
+    } catch (const std::exception& e) {
+      CINATRA_LOG_WARNING << "exception in business function, reason: "
+                          << e.what();
+      resp.set_status(status_type::service_unavailable);
+    } catch (...) {
+      CINATRA_LOG_WARNING << "unknown exception in business function";
+      resp.set_status(status_type::service_unavailable);
+    }
+  }
+
   const auto& get_handlers() const { return map_handles_; }
 
   const auto& get_coro_handlers() const { return coro_handles_; }
@@ -229,6 +291,9 @@ class coro_http_router {
   const auto& get_regex_handlers() { return regex_handles_; }
 
  private:
+  static_router_t static_router_;
+  static_coro_router_t static_coro_router_;
+
   std::set<std::string> keys_;
   std::unordered_map<
       std::string_view,
@@ -23,12 +23,14 @@ class coro_http_server {
                    std::string address = "0.0.0.0")
       : out_ctx_(&ctx), port_(port), acceptor_(ctx), check_timer_(ctx) {
     init_address(std::move(address));
+    init_shards(1);
   }
 
   coro_http_server(asio::io_context &ctx,
                    std::string address /* = "0.0.0.0:9001" */)
       : out_ctx_(&ctx), acceptor_(ctx), check_timer_(ctx) {
     init_address(std::move(address));
+    init_shards(1);
   }
 
   coro_http_server(size_t thread_num, unsigned short port,
@@ -39,6 +41,7 @@ class coro_http_server {
         acceptor_(pool_->get_executor()->get_asio_executor()),
         check_timer_(pool_->get_executor()->get_asio_executor()) {
     init_address(std::move(address));
+    init_shards(pool_->pool_size());
   }
 
   coro_http_server(size_t thread_num,
@@ -49,6 +52,7 @@ class coro_http_server {
         acceptor_(pool_->get_executor()->get_asio_executor()),
         check_timer_(pool_->get_executor()->get_asio_executor()) {
     init_address(std::move(address));
+    init_shards(pool_->pool_size());
   }
 
   ~coro_http_server() {
@@ -58,10 +62,22 @@ class coro_http_server {
 
   void set_no_delay(bool r) { no_delay_ = r; }
 
+  // SO_REUSEPORT: several servers, one per io_context, may listen on the same
+  // port and let the kernel spread the incoming connections between them.
+  // call it before async_start or sync_start.
+  void set_reuse_port(bool r) { reuse_port_ = r; }
+
   void set_max_http_body_size(int64_t max_size) {
     max_http_body_len_ = max_size;
   }
 
+  // Request bodies of at least min_size bytes (0: none) are not read before
+  // the handler is called: it streams them with
+  // coro_http_connection::read_body_some(), and req.get_body() is empty.
+  // Unless the whole body came with the header. A connection whose handler
+  // left the body unread is closed after the response.
+  void set_stream_body_min(size_t min_size) { stream_body_min_ = min_size; }
+
 #ifdef CINATRA_ENABLE_SSL
   void init_ssl(const std::string &cert_file, const std::string &key_file,
                 const std::string &passwd = "") {
@@ -122,13 +138,15 @@ class coro_http_server {
 
     close_acceptor();
 
-    // close current connections.
-    {
-      std::scoped_lock lock(conn_mtx_);
-      for (auto &conn : connections_) {
+    // close current connections, shard by shard.
+    for (auto &shard : shards_) {
+      std::scoped_lock lock(shard->mtx);
+      shard->stopped = true;
+      for (auto &conn : shard->conns) {
         conn.second->close(false);
       }
-      connections_.clear();
+      shard->conns.clear();
+      shard->count.store(0, std::memory_order_relaxed);
     }
 
     if (out_ctx_ == nullptr) {
@@ -583,21 +601,41 @@ class coro_http_server {
 
   void set_shrink_to_fit(bool r) { need_shrink_every_time_ = r; }
 
+  // see coro_http_router::set_static_router
+  void set_static_router(
+      coro_http_router::static_router_t router,
+      coro_http_router::static_coro_router_t coro_router = nullptr) {
+    router_.set_static_router(std::move(router), std::move(coro_router));
+  }
+
   void set_default_handler(std::function<async_simple::coro::Lazy<void>(
                                coro_http_request &, coro_http_response &)>
                                handler) {
     default_handler_ = std::move(handler);
   }
 
+  // sum of the per io_context counters, takes no lock.
   size_t connection_count() {
-    std::scoped_lock lock(conn_mtx_);
-    return connections_.size();
+    size_t count = 0;
+    for (auto &shard : shards_) {
+      count += shard->count.load(std::memory_order_relaxed);
+    }
+    return count;
   }
 
   std::string_view address() { return address_; }
   std::error_code get_errc() { return errc_; }
 
  private:
+  // live connections, one shard per io_context so that accepting and closing
+  // on different threads never meet on the same lock.
+  struct alignas(64) connection_shard {
+    std::mutex mtx;
+    std::unordered_map<uint64_t, std::shared_ptr<coro_http_connection>> conns;
+    std::atomic<size_t> count = 0;
+    bool stopped = false;
+  };
+
   std::error_code listen() {
     CINATRA_LOG_INFO << "begin to listen " << port_;
     using asio::ip::tcp;
@@ -626,6 +664,20 @@ class coro_http_server {
     }
 #ifdef __GNUC__
     acceptor_.set_option(tcp::acceptor::reuse_address(true), ec);
+#endif
+#ifdef SO_REUSEPORT
+    if (reuse_port_) {
+      acceptor_.set_option(
+          asio::detail::socket_option::boolean<SOL_SOCKET, SO_REUSEPORT>(true),
+          ec);
+      if (ec) {
+        CINATRA_LOG_ERROR << "set reuse port: " << port_
+                          << " error: " << ec.message();
+        std::error_code ignore_ec;
+        acceptor_.close(ignore_ec);
+        return ec;
+      }
+    }
 #endif
     acceptor_.bind(endpoint, ec);
     if (ec) {
@@ -660,12 +712,18 @@ class coro_http_server {
   async_simple::coro::Lazy<std::error_code> accept() {
     for (;;) {
       coro_io::ExecutorWrapper<> *executor;
+      size_t shard_index = 0;
       if (out_ctx_ == nullptr) {
-        executor = pool_->get_executor();
+        shard_index = next_shard_++ % pool_->pool_size();
+        executor = pool_->get_executor(shard_index);
       }
       else {
-        out_executor_ = std::make_unique<coro_io::ExecutorWrapper<>>(
-            out_ctx_->get_executor());
+        // one wrapper for the server's lifetime: every connection keeps a
+        // pointer to the executor it runs on
+        if (out_executor_ == nullptr) {
+          out_executor_ = std::make_unique<coro_io::ExecutorWrapper<>>(
+              out_ctx_->get_executor());
+        }
         executor = out_executor_.get();
       }
 
@@ -689,6 +747,7 @@ class coro_http_server {
         conn->tcp_socket().set_option(asio::ip::tcp::no_delay(true));
       }
       conn->set_max_http_body_size(max_http_body_len_);
+      conn->set_stream_body_min(stream_body_min_);
       if (need_shrink_every_time_) {
         conn->set_shrink_to_fit(true);
       }
@@ -714,28 +773,44 @@ class coro_http_server {
       }
 #endif
 
+      // registered and unregistered on the connection's own io thread: the
+      // shard lock is only contended by stop() and the timeout check.
+      connection_shard *shard = shards_[shard_index].get();
       conn->set_quit_callback(
-          [this](const uint64_t &id) {
-            std::scoped_lock lock(conn_mtx_);
-            if (!connections_.empty())
-              connections_.erase(id);
+          [shard](const uint64_t &id) {
+            std::scoped_lock lock(shard->mtx);
+            if (shard->conns.erase(id) > 0) {
+              shard->count.fetch_sub(1, std::memory_order_relaxed);
+            }
           },
           conn_id);
 
-      {
-        std::scoped_lock lock(conn_mtx_);
-        connections_.emplace(conn_id, conn);
-      }
-
-      start_one(conn).via(conn->get_executor()).detach();
+      start_one(conn, shard, conn_id).via(conn->get_executor()).detach();
     }
   }
 
   async_simple::coro::Lazy<void> start_one(
-      std::shared_ptr<coro_http_connection> conn) noexcept {
+      std::shared_ptr<coro_http_connection> conn, connection_shard *shard,
+      uint64_t conn_id) noexcept {
+    {
+      std::scoped_lock lock(shard->mtx);
+      if (shard->stopped) {
+        conn->close(false);
+        co_return;
+      }
+      shard->conns.emplace(conn_id, conn);
+      shard->count.fetch_add(1, std::memory_order_relaxed);
+    }
     co_await conn->start();
   }
 
+  void init_shards(size_t n) {
+    shards_.clear();
+    for (size_t i = 0; i < n; ++i) {
+      shards_.push_back(std::make_unique<connection_shard>());
+    }
+  }
+
   void close_acceptor() {
     asio::dispatch(acceptor_.get_executor(), [this]() {
       asio::error_code ec;
@@ -761,16 +836,15 @@ class coro_http_server {
   void check_timeout() {
     auto cur_time = std::chrono::system_clock::now();
 
-    std::unordered_map<uint64_t, std::shared_ptr<coro_http_connection>> conns;
-
-    {
-      std::scoped_lock lock(conn_mtx_);
-      for (auto it = connections_.begin();
-           it != connections_.end();)  // no "++"!
+    for (auto &shard : shards_) {
+      std::scoped_lock lock(shard->mtx);
+      for (auto it = shard->conns.begin();
+           it != shard->conns.end();)  // no "++"!
       {
         if (cur_time - it->second->get_last_rwtime() > timeout_duration_) {
           it->second->close(false);
-          connections_.erase(it++);
+          it = shard->conns.erase(it);
+          shard->count.fetch_sub(1, std::memory_order_relaxed);
         }
         else {
           ++it;
@@ -983,11 +1057,11 @@ class coro_http_server {
   std::thread thd_;
   std::promise<void> acceptor_close_waiter_;
   bool no_delay_ = true;
+  bool reuse_port_ = false;
 
   uint64_t conn_id_ = 0;
-  std::unordered_map<uint64_t, std::shared_ptr<coro_http_connection>>
-      connections_;
-  std::mutex conn_mtx_;
+  size_t next_shard_ = 0;  // only touched by the accept loop
+  std::vector<std::unique_ptr<connection_shard>> shards_;  // see connection_shard
   std::chrono::steady_clock::duration check_duration_ =
       std::chrono::seconds(15);
   std::chrono::steady_clock::duration timeout_duration_{};
@@ -1014,6 +1088,7 @@ class coro_http_server {
                                                coro_http_response &)>
       default_handler_ = nullptr;
   int64_t max_http_body_len_ = MAX_HTTP_BODY_SIZE;
+  size_t stream_body_min_ = 0;  // 0: disabled
 #ifdef INJECT_FOR_HTTP_SEVER_TEST
   bool write_failed_forever_ = false;
   bool read_failed_forever_ = false;
@@ -17,15 +17,14 @@ constexpr char type_asterisk = '*';
 constexpr char type_colon = ':';
 constexpr char type_slash = '/';
 
-typedef std::tuple<
-    bool, std::function<void(coro_http_request &req, coro_http_response &resp)>,
-    std::unordered_map<std::string, std::string>>
+// matched, and the handler registered for the method (nullptr if none); the
+// handler points into the tree
+typedef std::tuple<bool, const std::function<void(coro_http_request &req,
+                                                  coro_http_response &resp)> *>
     parse_result;
 
-typedef std::tuple<bool,
-                   std::function<async_simple::coro::Lazy<void>(
-                       coro_http_request &req, coro_http_response &resp)>,
-                   std::unordered_map<std::string, std::string>>
+typedef std::tuple<bool, const std::function<async_simple::coro::Lazy<void>(
+                             coro_http_request &req, coro_http_response &resp)> *>
     coro_result;
 
 struct handler_t {
@@ -46,26 +45,26 @@ struct radix_tree_node {
   coro_handler_t coro_handler;
   std::string indices;
   std::vector<std::shared_ptr<radix_tree_node>> children;
-  int max_params;
+  int max_params = 0;
 
   radix_tree_node() = default;
   radix_tree_node(const std::string &path) { this->path = path; }
   ~radix_tree_node() {}
 
-  std::function<void(coro_http_request &req, coro_http_response &resp)>
-  get_handler(const std::string &method) {
-    if (handler.method == method) {
-      return handler.handler;
+  const std::function<void(coro_http_request &req, coro_http_response &resp)>
+      *get_handler(std::string_view method) const {
+    if (handler.method == method && handler.handler) {
+      return &handler.handler;
     }
 
     return nullptr;
   }
 
-  std::function<async_simple::coro::Lazy<void>(coro_http_request &req,
-                                               coro_http_response &resp)>
-  get_coro_handler(const std::string &method) {
-    if (coro_handler.method == method) {
-      return coro_handler.coro_handler;
+  const std::function<async_simple::coro::Lazy<void>(coro_http_request &req,
+                                                     coro_http_response &resp)>
+      *get_coro_handler(std::string_view method) const {
+    if (coro_handler.method == method && coro_handler.coro_handler) {
+      return &coro_handler.coro_handler;
     }
     return nullptr;
   }
@@ -324,9 +323,11 @@ class radix_tree {
     return code;
   }
 
-  parse_result get(const std::string &path, const std::string &method) {
-    std::unordered_map<std::string, std::string> params;
-    auto root = this->root;
+  // params receives views into path and into the tree; reset() it with room
+  // for max_params() slots first
+  parse_result get(std::string_view path, std::string_view method,
+                   route_params &params) {
+    radix_tree_node *root = this->root.get();
 
     int i = 0, n = path.size(), p;
 
@@ -335,31 +336,33 @@ class radix_tree {
         return parse_result();
 
       if (root->indices[0] == type_colon) {
-        root = root->children[0];
+        root = root->children[0].get();
 
         p = find_pos(path, type_slash, i);
-        params[root->path] = path.substr(i, p - i);
+        params.emplace(root->path, path.substr(i, p - i));
         i = p;
       }
       else if (root->indices[0] == type_asterisk) {
-        root = root->children[0];
-        params[root->path] = path.substr(i);
+        root = root->children[0].get();
+        params.emplace(root->path, path.substr(i));
         break;
       }
       else {
-        root = root->get_child(path[i]);
+        root = root->get_child(path[i]).get();
         if (!root || path.substr(i, root->path.size()) != root->path)
           return parse_result();
         i += root->path.size();
       }
     }
 
-    return parse_result{true, root->get_handler(method), params};
+    return parse_result{true, root->get_handler(method)};
   }
 
-  coro_result get_coro(const std::string &path, const std::string &method) {
-    std::unordered_map<std::string, std::string> params;
-    auto root = this->root;
+  // params receives views into path and into the tree; reset() it with room
+  // for max_params() slots first
+  coro_result get_coro(std::string_view path, std::string_view method,
+                       route_params &params) {
+    radix_tree_node *root = this->root.get();
 
     int i = 0, n = path.size(), p;
 
@@ -368,30 +371,33 @@ class radix_tree {
         return coro_result();
 
       if (root->indices[0] == type_colon) {
-        root = root->children[0];
+        root = root->children[0].get();
 
         p = find_pos(path, type_slash, i);
-        params[root->path] = path.substr(i, p - i);
+        params.emplace(root->path, path.substr(i, p - i));
         i = p;
       }
       else if (root->indices[0] == type_asterisk) {
-        root = root->children[0];
-        params[root->path] = path.substr(i);
+        root = root->children[0].get();
+        params.emplace(root->path, path.substr(i));
         break;
       }
       else {
-        root = root->get_child(path[i]);
+        root = root->get_child(path[i]).get();
         if (!root || path.substr(i, root->path.size()) != root->path)
           return coro_result();
         i += root->path.size();
       }
     }
 
-    return coro_result{true, root->get_coro_handler(method), params};
+    return coro_result{true, root->get_coro_handler(method)};
   }
 
+  // the most parameters any route of the tree has
+  int max_params() const { return root->max_params; }
+
  private:
-  int find_pos(const std::string &str, char target, int start) {
+  int find_pos(std::string_view str, char target, int start) {
     auto i = str.find(target, start);
     return i == -1 ? str.size() : i;
   }
@@ -5,7 +5,8 @@
 #include <span>
 #include <string>
 #include <string_view>
-#include <unordered_map>
+#include <utility>
+#include <vector>
 
 #include "cinatra/utils.hpp"
 #include "cinatra_log_wrapper.hpp"
@@ -130,12 +131,12 @@ class http_parser {
   std::string_view full_url() { return full_url_; }
 
   std::string_view get_query_value(std::string_view key) {
-    if (auto it = queries_.find(key); it != queries_.end()) {
-      return it->second;
-    }
-    else {
-      return "";
+    for (auto &[k, v] : queries_) {
+      if (k == key) {
+        return v;
+      }
     }
+    return "";
   }
 
   bool is_chunked() const {
@@ -215,28 +216,40 @@ class http_parser {
     return {headers_.data(), num_headers_};
   }
 
+  // the pairs are views into str, the table keeps its capacity across
+  // requests so parsing a query does not allocate once warm
   void parse_query(std::string_view str) {
-    std::string_view key;
-    std::string_view val;
-
-    auto vec = split_sv(str, "&");
-    for (auto s : vec) {
+    while (!str.empty()) {
+      size_t end = str.find('&');
+      std::string_view s = str.substr(0, end);
+      str = end == std::string_view::npos ? std::string_view{}
+                                          : str.substr(end + 1);
       if (s.empty()) {
         continue;
       }
+      std::string_view key;
+      std::string_view val;
       size_t pos = s.find('=');
-      if (s.find('=') != std::string_view::npos) {
+      if (pos != std::string_view::npos) {
         key = s.substr(0, pos);
         if (key.empty()) {
           continue;
         }
-        val = s.substr(pos + 1, s.length() - pos);
+        val = s.substr(pos + 1);
       }
       else {
         key = s;
-        val = "";
       }
-      queries_.emplace(key, val);
+      bool exist = false;
+      for (auto &kv : queries_) {
+        if (kv.first == key) {
+          exist = true;
+          break;
+        }
+      }
+      if (!exist) {
+        queries_.emplace_back(key, val);
+      }
     }
   }
 
@@ -261,6 +274,6 @@ class http_parser {
   std::string_view method_;
   std::string_view url_;
   std::string_view full_url_;
-  std::unordered_map<std::string_view, std::string_view> queries_;
+  std::vector<std::pair<std::string_view, std::string_view>> queries_;
 };
 }  // namespace cinatra
\ No newline at end of file
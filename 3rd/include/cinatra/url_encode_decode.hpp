@@ -29,9 +29,10 @@ inline static std::string url_encode(const std::string &value) noexcept {
   return result;
 }
 
-inline static std::string url_decode(std::string_view str) noexcept {
-  std::string result;
-  result.reserve(str.size());
+// Decodes str into out, which must have room for str.size() chars; returns
+// the decoded length.
+inline static size_t url_decode(std::string_view str, char *out) noexcept {
+  char *p = out;
 
   for (size_t i = 0; i < str.size(); ++i) {
     char ch = str[i];
@@ -39,32 +40,39 @@ inline static std::string url_decode(std::string_view str) noexcept {
       constexpr char hex[] = "0123456789ABCDEF";
 
       if (++i == str.size()) {
-        result.push_back('?');
+        *p++ = '?';
         break;
       }
 
       int hi = (int)(std::find(hex, hex + 16, toupper(str[i])) - hex);
 
       if (++i == str.size()) {
-        result.push_back('?');
+        *p++ = '?';
         break;
       }
 
       int lo = (int)(std::find(hex, hex + 16, toupper(str[i])) - hex);
 
       if ((hi >= 16) || (lo >= 16)) {
-        result.push_back('?');
+        *p++ = '?';
         break;
       }
 
-      result.push_back((char)((hi << 4) + lo));
+      *p++ = (char)((hi << 4) + lo);
     }
     else if (ch == '+')
-      result.push_back(' ');
+      *p++ = ' ';
     else
-      result.push_back(ch);
+      *p++ = ch;
   }
 
+  return p - out;
+}
+
+inline static std::string url_decode(std::string_view str) noexcept {
+  std::string result;
+  result.resize(str.size());
+  result.resize(url_decode(str, result.data()));
   return result;
 }
 
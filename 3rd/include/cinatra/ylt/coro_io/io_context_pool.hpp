@@ -204,6 +204,11 @@ class io_context_pool {
     return ret;
   }
 
+  // the executor of io_context i, i < pool_size()
+  coro_io::ExecutorWrapper<> *get_executor(size_t i) {
+    return executors[i].get();
+  }
+
   template <typename T>
   friend io_context_pool &g_io_context_pool();
 
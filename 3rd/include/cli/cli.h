@@ -44,7 +44,9 @@
 #include "historystorage.h"
 #include "volatilehistorystorage.h"
 #include <iostream>
+#include <mutex>
 #include <utility>
+#include "lynx/snapshot.hpp"
 
 namespace cli
 {
@@ -72,45 +74,182 @@ namespace cli
 
     // ********************************************************************
 
-    // this class provides a global output stream
-    class OutStream : public std::basic_ostream<char>, public std::streambuf
+    // A line of the global output stream, shared by all the sessions it goes to.
+    class Broadcast
     {
     public:
-        OutStream() : std::basic_ostream<char>(this)
+        explicit Broadcast(std::string _text) : text(std::make_shared<const std::string>(std::move(_text))) {}
+        // a line already shared elsewhere, say by the log
+        explicit Broadcast(std::shared_ptr<const std::string> _text) : text(std::move(_text)) {}
+
+        const std::shared_ptr<const std::string>& Text() const { return text; }
+
+        // the text with "\r\n" line ends: made by the first telnet session it goes to, for all of them
+        const std::shared_ptr<const std::string>& Crlf() const
         {
+            if (!crlf)
+            {
+                if (text->find('\n') == std::string::npos)
+                    crlf = text;
+                else
+                {
+                    std::string s;
+                    s.reserve(text->size() + 8);
+                    for (char c: *text)
+                    {
+                        if (c == '\n') s += '\r';
+                        s += c;
+                    }
+                    crlf = std::make_shared<const std::string>(std::move(s));
+                }
+            }
+            return crlf;
         }
 
-        // std::streambuf overrides
-        std::streamsize xsputn(const char* s, std::streamsize n) override
+    private:
+        std::shared_ptr<const std::string> text;
+        mutable std::shared_ptr<const std::string> crlf;
+    };
+
+    // The output of a session queueing the writes to the global output stream by reference, as they are.
+    class BroadcastSink
+    {
+    public:
+        virtual ~BroadcastSink() = default;
+        virtual void Send(const Broadcast& b) = 0;
+    };
+
+    // The sessions the global output stream writes to. The list is copy on write, in a
+    // lynx::SnapshotCell: Register and UnRegister publish a new one under a mutex, Publish reads the
+    // current one without locking.
+    class BroadcastHub
+    {
+    public:
+        BroadcastHub() = default;
+
+        BroadcastHub(const BroadcastHub&) = delete;
+        BroadcastHub& operator = (const BroadcastHub&) = delete;
+
+        // the streams whose buffer is a BroadcastSink get each line as one shared Broadcast, the
+        // others have it written in place
+        void Register(std::ostream& o)
         {
-            for (auto os: ostreams)
-                os->rdbuf()->sputn(s, n);
-            return n;
+            std::lock_guard<std::mutex> lock(mutex);
+            List l = subscribers.current();
+            l.push_back(std::make_shared<Subscriber>(o));
+            subscribers.publish(std::move(l));
         }
-        int overflow(int c) override
+        // once it returns, nothing is written to o anymore
+        void UnRegister(std::ostream& o)
         {
-            for (auto os: ostreams)
-                *os << static_cast<char>(c);
-            return c;
-        }            
+            std::shared_ptr<Subscriber> removed;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                List l = subscribers.current();
+                auto it = std::find_if(l.begin(), l.end(), [&o](const auto& s){ return s->out == &o; });
+                if (it == l.end())
+                    return;
+                removed = *it;
+                l.erase(it);
+                subscribers.publish(std::move(l));
+            }
+            // a publisher may still hold an older list: waits for the write in progress, if any,
+            // and makes the next ones skip it
+            std::lock_guard<std::mutex> lock(removed->mutex);
+            removed->out = nullptr;
+            removed->sink = nullptr;
+        }
 
-        void Register(std::ostream& o)
+        void Publish(const char* s, std::size_t n)
         {
-            ostreams.push_back(&o);
+            const auto list = subscribers.read();
+            if (list->empty())
+                return;
+            const Broadcast b(std::string(s, n));
+            for (const auto& sub: *list)
+            {
+                // a plain stream is not meant for concurrent writers either
+                std::lock_guard<std::mutex> lock(sub->mutex);
+                if (sub->sink)
+                    sub->sink->Send(b);
+                else if (sub->out)
+                    sub->out->rdbuf()->sputn(s, static_cast<std::streamsize>(n));
+            }
         }
-        void UnRegister(std::ostream& o)
+
+    private:
+        struct Subscriber
+        {
+            explicit Subscriber(std::ostream& o) : out(&o), sink(dynamic_cast<BroadcastSink*>(o.rdbuf())) {}
+
+            std::mutex mutex;
+            std::ostream* out; // nullptr once unregistered
+            BroadcastSink* sink;
+        };
+        using List = std::vector<std::shared_ptr<Subscriber>>;
+
+        lynx::SnapshotCell<List> subscribers; // published under mutex
+        std::mutex mutex;
+    };
+
+    // The global output stream of a thread: it buffers what is written and publishes it to the
+    // sessions on flush (std::endl), or when the buffer fills: up to the last line end then, a line
+    // longer than the buffer goes in pieces.
+    class OutStream : public std::basic_ostream<char>, public std::streambuf
+    {
+    public:
+        explicit OutStream(std::shared_ptr<BroadcastHub> _hub) : std::basic_ostream<char>(this), hub(std::move(_hub))
+        {
+            setp(buffer, buffer + sizeof(buffer));
+        }
+        ~OutStream() override
+        {
+            sync();
+        }
+
+        void Register(std::ostream& o) { hub->Register(o); }
+        void UnRegister(std::ostream& o) { hub->UnRegister(o); }
+
+    protected:
+
+        // std::streambuf overrides
+        int overflow(int c) override
+        {
+            using traits = std::streambuf::traits_type;
+            char* lineEnd = pptr();
+            while (lineEnd != pbase() && lineEnd[-1] != '\n')
+                --lineEnd;
+            if (lineEnd == pbase())
+                lineEnd = pptr();
+            hub->Publish(pbase(), static_cast<std::size_t>(lineEnd - pbase()));
+            // the start of the last line moves to the front
+            char* rest = std::copy(lineEnd, pptr(), buffer);
+            setp(buffer, buffer + sizeof(buffer));
+            pbump(static_cast<int>(rest - buffer));
+            if (!traits::eq_int_type(c, traits::eof()))
+                sputc(traits::to_char_type(c));
+            return traits::not_eof(c);
+        }
+        int sync() override
         {
-            ostreams.erase(std::remove(ostreams.begin(), ostreams.end(), &o), ostreams.end());
+            if (pptr() != pbase())
+            {
+                hub->Publish(pbase(), static_cast<std::size_t>(pptr() - pbase()));
+                setp(buffer, buffer + sizeof(buffer));
+            }
+            return 0;
         }
 
     private:
 
-        std::vector<std::ostream*> ostreams;
+        std::shared_ptr<BroadcastHub> hub;
+        char buffer[4096];
     };
     
     // forward declarations
     class Menu;
     class CliSession;
+    class PendingCommand;
 
     class Cli
     {
@@ -152,6 +291,15 @@ namespace cli
          */
         void ExitAction(const std::function< void(std::ostream&)>& action) { exitAction = action; }
 
+        /**
+         * @brief Add a global close action that is called every time a session (local or remote) is destroyed,
+         * whether it got the "exit" command or its connection dropped. Only the sessions created afterwards get it.
+         * 
+         * @param action the function to be called when a session is destroyed, taking the @c std::ostream& of the
+         * session: it is the last chance to forget any reference to it, nothing should be written on it anymore.
+         */
+        void CloseAction(const std::function< void(std::ostream&)>& action) { closeAction = action; }
+
         /**
          * @brief Add an handler that will be called when a @c std::exception (or derived) is thrown inside a command handler.
          * If an exception handler is not set, the exception will be logget on the session output stream.
@@ -183,15 +331,17 @@ namespace cli
          */
         static OutStream& cout()
         {
-            return *CoutPtr();
+            // one per thread: the threads buffer their lines apart, and publish them whole
+            thread_local OutStream s(Hub());
+            return s;
         }
 
     private:
         friend class CliSession;
 
-        static std::shared_ptr<OutStream> CoutPtr()
+        static std::shared_ptr<BroadcastHub> Hub()
         {
-            static std::shared_ptr<OutStream> s = std::make_shared<OutStream>();
+            static std::shared_ptr<BroadcastHub> s = std::make_shared<BroadcastHub>();
             return s;
         }
 
@@ -240,6 +390,7 @@ namespace cli
         std::unique_ptr<Menu> rootMenu; // just to keep it alive
         std::function<void(std::ostream&)> enterAction;
         std::function<void(std::ostream&)> exitAction;
+        std::function<void(std::ostream&)> closeAction;
         std::function<void(std::ostream&, const std::string& cmd, const std::exception& )> exceptionHandler;
         std::function<void(std::ostream&, const std::string& cmd)> wrongCmdHandler;
     };
@@ -307,7 +458,8 @@ namespace cli
     class CliSession
     {
     public:
-        CliSession(Cli& _cli, std::ostream& _out, std::size_t historySize = 100);
+        CliSession(Cli& _cli, std::ostream& _out, std::size_t historySize = 100) :
+            CliSession(_cli, _out, historySize, true) {}
         virtual ~CliSession() noexcept;
 
         // disable value semantics
@@ -337,6 +489,7 @@ namespace cli
 
         void Exit()
         {
+            Interrupt();
             exitAction(out);
             cli.ExitAction(out);
 
@@ -377,17 +530,90 @@ namespace cli
 
         std::vector<std::string> GetCompletions(std::string currentLine) const;
 
+        /**
+         * @brief Holds the prompt back while the command being executed completes asynchronously, until
+         * @c PendingCommand::Complete is called. Meanwhile the input is ignored but for Ctrl-C, and the
+         * session closing, that call @c onInterrupt. Only for the sessions taking their input through the
+         * scheduler (see @c CanSuspend).
+         *
+         * @param onInterrupt called on the scheduler's thread, possibly more than once.
+         * @return the handle of the command, to be used on the scheduler's thread only.
+         */
+        std::shared_ptr<PendingCommand> Suspend(std::function<void()> onInterrupt);
+
+        // false for the sessions that execute their commands one after the other (file sessions)
+        bool CanSuspend() const { return canSuspend; }
+        void EnableSuspend() { canSuspend = true; }
+        bool Suspended() const { return pending != nullptr; }
+        // Ctrl-C: interrupts the pending command, if any
+        void Interrupt();
+
+    protected:
+        // broadcast false: out is a part of the derived object, which registers it to the global output
+        // stream once whole with StartBroadcasts()
+        CliSession(Cli& _cli, std::ostream& _out, std::size_t historySize, bool broadcast);
+
+        void StartBroadcasts()
+        {
+            if (!broadcasting)
+                hub->Register(out);
+            broadcasting = true;
+        }
+        // Stops the global output stream writing to the session. Done by the destructor, but a derived
+        // object owning out does it while still whole: on disconnection, and in its own destructor.
+        void StopBroadcasts()
+        {
+            if (broadcasting)
+                hub->UnRegister(out);
+            broadcasting = false;
+        }
+
     private:
+        friend class PendingCommand;
 
         Cli& cli;
-        std::shared_ptr<cli::OutStream> coutPtr;
+        std::shared_ptr<BroadcastHub> hub;
         Menu* current;
         std::unique_ptr<Menu> globalScopeMenu;
         std::ostream& out;
         std::function< void(std::ostream&)> enterAction = []( std::ostream& ) noexcept {};
         std::function< void(std::ostream&)> exitAction = []( std::ostream& ) noexcept {};
+        std::function< void(std::ostream&)> closeAction; // copied from cli, that may be gone before the session
         detail::History history;
         bool exit{ false }; // to prevent the prompt after exit command
+        bool canSuspend{ false };
+        std::shared_ptr<PendingCommand> pending; // the command holding the prompt back
+        bool broadcasting{ false }; // registered to the hub
+    };
+
+    // ********************************************************************
+
+    // A command of a session completing asynchronously, see CliSession::Suspend.
+    class PendingCommand
+    {
+    public:
+        PendingCommand(CliSession* _session, std::function<void()> _onInterrupt) :
+            session(_session), onInterrupt(std::move(_onInterrupt))
+        {}
+
+        // the output of the session, nullptr once it is closed
+        std::ostream* OutStream() const { return session ? &session->OutStream() : nullptr; }
+
+        // shows the prompt again
+        void Complete()
+        {
+            if (session == nullptr) return;
+            CliSession* s = session;
+            session = nullptr;
+            s->pending.reset(); // may destroy this
+            s->Prompt();
+        }
+
+    private:
+        friend class CliSession;
+
+        CliSession* session;
+        std::function<void()> onInterrupt;
     };
 
     // ********************************************************************
@@ -876,17 +1102,19 @@ namespace cli
 
     // CliSession implementation
 
-    inline CliSession::CliSession(Cli& _cli, std::ostream& _out, std::size_t historySize) :
+    inline CliSession::CliSession(Cli& _cli, std::ostream& _out, std::size_t historySize, bool broadcast) :
             cli(_cli),
-            coutPtr(Cli::CoutPtr()),
+            hub(Cli::Hub()),
             current(cli.RootMenu()),
             globalScopeMenu(std::make_unique< Menu >()),
             out(_out),
+            closeAction(cli.closeAction),
             history(historySize)
         {
             history.LoadCommands(cli.GetCommands());
 
-            coutPtr->Register(out);
+            if (broadcast)
+                StartBroadcasts();
             globalScopeMenu->Insert(
                 "help",
                 [this](std::ostream&){ Help(); },
@@ -973,9 +1201,31 @@ namespace cli
         return v1;
     }
 
+    inline std::shared_ptr<PendingCommand> CliSession::Suspend(std::function<void()> onInterrupt)
+    {
+        pending = std::make_shared<PendingCommand>(this, std::move(onInterrupt));
+        return pending;
+    }
+
+    inline void CliSession::Interrupt()
+    {
+        if (pending && pending->onInterrupt)
+            pending->onInterrupt();
+    }
+
     inline CliSession::~CliSession() noexcept
     {
-        coutPtr->UnRegister(out);
+        if (pending)
+        {
+            // the command is not waited for: it completes on its own
+            auto p = std::move(pending);
+            p->session = nullptr;
+            if (p->onInterrupt)
+                p->onInterrupt();
+        }
+        StopBroadcasts();
+        if (closeAction)
+            closeAction(out);
     }
 
     // Menu implementation
@@ -68,6 +68,7 @@ public:
         kb(_kb)
     {
         kb.Register( [this](auto key){ this->Keypressed(key); } );
+        session.EnableSuspend();
     }
 
 private:
@@ -79,6 +80,18 @@ private:
      */
     void Keypressed(std::pair<KeyType, char> k)
     {
+        if (session.Suspended())
+        {
+            // a command is running: no typing ahead
+            if (k.first == KeyType::interrupt)
+            {
+                session.OutStream() << "^C\n" << std::flush;
+                session.Interrupt();
+            }
+            else if (k.first == KeyType::eof)
+                session.Exit();
+            return;
+        }
         const std::pair<Symbol,std::string> s = terminal.Keypressed(k);
         NewCommand(s);
     }
@@ -105,10 +118,16 @@ private:
             {
                 kb.DeactivateInput();
                 session.Feed(s.second);
-                session.Prompt();
+                if (!session.Suspended())
+                    session.Prompt();
                 kb.ActivateInput();
                 break;
             }
+            case Symbol::interrupt:
+            {
+                session.Prompt();
+                break;
+            }
             case Symbol::down:
             {
                 terminal.SetLine(session.NextCmd());
@@ -54,15 +54,18 @@ public:
 
 protected:
 
-    std::string Encode(const std::string& _data) const override
+    void Encode(const char* s, std::size_t n, std::string& out) const override
     {
-        std::string result;
-        for (char c: _data)
+        for (const char* end = s + n; s != end; ++s)
         {
-            if (c == '\n') result += '\r';
-            result += c;
+            if (*s == '\n') out += '\r';
+            out += *s;
         }
-        return result;
+    }
+
+    std::shared_ptr<const std::string> EncodeShared(const Broadcast& b) const override
+    {
+        return b.Crlf();
     }
 
     void OnConnect() override
@@ -218,10 +221,10 @@ protected:
         NEW_ENV_OPTION = '\x027'
     };
 
-    void OnDataReceived(const std::string& _data) override
+    void OnDataReceived(const char* _data, std::size_t length) override
     {
-        for (char c: _data)
-            Consume(c);
+        for (std::size_t i = 0; i < length; ++i)
+            Consume(_data[i]);
     }
 
 private:
@@ -306,9 +309,12 @@ private:
                 else
                     std::cerr << "ERROR: received SE when not in sub state\n";
                 break;
+            case InterruptProcess: // Ctrl-C of a client in line mode
+                OnInterruptProcess();
+                state = State::data;
+                break;
             case DataMark: // ?
             case Break: // ?
-            case InterruptProcess:
             case AbortOutput:
             case AreYouThere:
             case EraseCharacter:
@@ -408,6 +414,7 @@ private:
         this -> OutStream() << answer << std::flush;
     }
 protected:
+    virtual void OnInterruptProcess() {}
     virtual void Output(char c)
     {
         #ifdef CLI_TELNET_TRACE
@@ -454,20 +461,44 @@ public:
     CliTelnetSession(Scheduler& _scheduler, asiolib::ip::tcp::socket _socket, Cli& _cli, const std::function< void(std::ostream&)>& _exitAction, std::size_t historySize ) :
         InputDevice(_scheduler),
         TelnetSession(std::move(_socket)),
-        CliSession(_cli, TelnetSession::OutStream(), historySize),
+        CliSession(_cli, TelnetSession::OutStream(), historySize, false),
         poll(*this, *this)
     {
         ExitAction([this, _exitAction](std::ostream& _out){ _exitAction(_out), Disconnect(); } );
     }
+    // the session is not whole anymore once in ~CliSession
+    ~CliTelnetSession() override { StopBroadcasts(); }
+
+    // a command in progress
+    bool Busy() const override { return Suspended(); }
+
 protected:
 
     void OnConnect() override
     {
+        StartBroadcasts();
         TelnetSession::OnConnect();
         Enter();
         Prompt();
     }
 
+    void OnDisconnect() override
+    {
+        TelnetSession::OnDisconnect();
+        StopBroadcasts();
+    }
+
+    void OnError() override
+    {
+        TelnetSession::OnError();
+        StopBroadcasts();
+    }
+
+    void OnInterruptProcess() override
+    {
+        Dispatch(std::make_pair(KeyType::interrupt, ' '));
+    }
+
     void Output(char c) override // NB: C++ does not specify wether char is signed or unsigned
     {
         switch(step)
@@ -477,19 +508,21 @@ protected:
                 {
                     case static_cast<char>(EOF):
                     case 4:  // EOT
-                        Notify(std::make_pair(KeyType::eof,' ')); break;
+                        Dispatch(std::make_pair(KeyType::eof,' ')); break;
+                    case 3:  // ctrl+C
+                        Dispatch(std::make_pair(KeyType::interrupt, ' ')); break;
                     case 8: // Backspace
                     case 127:  // Backspace or Delete
-                        Notify(std::make_pair(KeyType::backspace, ' ')); break;
+                        Dispatch(std::make_pair(KeyType::backspace, ' ')); break;
                     //case 10: Notify(std::make_pair(KeyType::ret,' ')); break;
                     case 12: // ctrl+L
-                        Notify(std::make_pair(KeyType::clear, ' ')); break;
+                        Dispatch(std::make_pair(KeyType::clear, ' ')); break;
                     case 27: step = Step::_2; break;  // symbol
                     case 13: step = Step::wait_0; break;  // wait for 0 (ENTER key)
                     default: // ascii
                     {
                         const char ch = static_cast<char>(c);
-                        Notify(std::make_pair(KeyType::ascii,ch));
+                        Dispatch(std::make_pair(KeyType::ascii,ch));
                     }
                 }
                 break;
@@ -503,7 +536,7 @@ protected:
                 else
                 {
                     step = Step::_1;
-                    Notify(std::make_pair(KeyType::ignored,' '));
+                    Dispatch(std::make_pair(KeyType::ignored,' '));
                     break; // unknown
                 }
                 break;
@@ -511,27 +544,27 @@ protected:
             case Step::_3: // got 27 and 91
                 switch( c )
                 {
-                    case 65: step = Step::_1; Notify(std::make_pair(KeyType::up,' ')); break;
-                    case 66: step = Step::_1; Notify(std::make_pair(KeyType::down,' ')); break;
-                    case 68: step = Step::_1; Notify(std::make_pair(KeyType::left,' ')); break;
-                    case 67: step = Step::_1; Notify(std::make_pair(KeyType::right,' ')); break;
-                    case 70: step = Step::_1; Notify(std::make_pair(KeyType::end,' ')); break;
-                    case 72: step = Step::_1; Notify(std::make_pair(KeyType::home,' ')); break;
+                    case 65: step = Step::_1; Dispatch(std::make_pair(KeyType::up,' ')); break;
+                    case 66: step = Step::_1; Dispatch(std::make_pair(KeyType::down,' ')); break;
+                    case 68: step = Step::_1; Dispatch(std::make_pair(KeyType::left,' ')); break;
+                    case 67: step = Step::_1; Dispatch(std::make_pair(KeyType::right,' ')); break;
+                    case 70: step = Step::_1; Dispatch(std::make_pair(KeyType::end,' ')); break;
+                    case 72: step = Step::_1; Dispatch(std::make_pair(KeyType::home,' ')); break;
                     default: step = Step::_4; break;  // not arrow keys
                 }
                 break;
 
             case Step::_4:
-                if ( c == 126 ) Notify(std::make_pair(KeyType::canc,' '));
-                else Notify(std::make_pair(KeyType::ignored,' '));
+                if ( c == 126 ) Dispatch(std::make_pair(KeyType::canc,' '));
+                else Dispatch(std::make_pair(KeyType::ignored,' '));
 
                 step = Step::_1;
 
                 break;
 
             case Step::wait_0:
-                if ( c == 0 /* linux */ || c == 10 /* win */ ) Notify(std::make_pair(KeyType::ret,' '));
-                else Notify(std::make_pair(KeyType::ignored,' '));
+                if ( c == 0 /* linux */ || c == 10 /* win */ ) Dispatch(std::make_pair(KeyType::ret,' '));
+                else Dispatch(std::make_pair(KeyType::ignored,' '));
 
                 step = Step::_1;
 
@@ -573,9 +606,23 @@ public:
     {
         exitAction = action;
     }
+    // see Session::OutputHighWaterMark, applies to the sessions accepted afterwards
+    void OutputHighWaterMark(std::size_t bytes)
+    {
+        outputHighWaterMark = bytes;
+    }
+    // see Session::OutputLimit, applies to the sessions accepted afterwards
+    void OutputLimit(std::size_t bytes)
+    {
+        outputLimit = bytes;
+    }
+
     std::shared_ptr<Session> CreateSession(asiolib::ip::tcp::socket _socket) override
     {
-        return std::make_shared<CliTelnetSession>(scheduler, std::move(_socket), cli, exitAction, historySize);
+        auto session = std::make_shared<CliTelnetSession>(scheduler, std::move(_socket), cli, exitAction, historySize);
+        session->OutputHighWaterMark(outputHighWaterMark);
+        session->OutputLimit(outputLimit);
+        return session;
     }
 private:
     Scheduler& scheduler;
@@ -583,6 +630,8 @@ private:
     std::function< void(std::ostream&)> enterAction;
     std::function< void(std::ostream&)> exitAction;
     std::size_t historySize;
+    std::size_t outputHighWaterMark = 1024 * 1024;
+    std::size_t outputLimit = 16 * 1024 * 1024;
 };
 
 
@@ -39,7 +39,7 @@ namespace cli
 namespace detail
 {
 
-enum class KeyType { ascii, up, down, left, right, backspace, canc, home, end, ret, eof, ignored, clear, };
+enum class KeyType { ascii, up, down, left, right, backspace, canc, home, end, ret, eof, ignored, clear, interrupt, };
 
 class InputDevice
 {
@@ -61,6 +61,12 @@ protected:
         scheduler.Post([this,k](){ if (handler) handler(k); });
     }
 
+    // from the scheduler's thread: no post
+    void Dispatch(std::pair<KeyType,char> k)
+    {
+        if (handler) handler(k);
+    }
+
 private:
 
     Scheduler& scheduler;
@@ -178,6 +178,8 @@ public:
             case 4:  // EOT
                 return std::make_pair(KeyType::eof,' ');
                 break;
+            case 3: // ctrl+C, when it does not raise SIGINT
+                return std::make_pair(KeyType::interrupt,' ');
             case 127:
             case 8:
                 return std::make_pair(KeyType::backspace,' '); break;
@@ -82,6 +82,9 @@ public:
 
 };
 
+// executor a Session posts its output writes to
+using SessionExecutor = NewBoostAsioLib::Executor;
+
 } // namespace detail
 } // namespace cli
 
@@ -82,6 +82,9 @@ public:
 
 };
 
+// executor a Session posts its output writes to
+using SessionExecutor = NewStandaloneAsioLib::Executor;
+
 } // namespace detail
 } // namespace cli
 
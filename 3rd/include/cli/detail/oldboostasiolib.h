@@ -75,6 +75,9 @@ public:
 
 };
 
+// executor a Session posts its output writes to
+using SessionExecutor = OldBoostAsioLib::Executor;
+
 } // namespace detail
 } // namespace cli
 
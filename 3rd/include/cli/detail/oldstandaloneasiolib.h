@@ -78,6 +78,9 @@ public:
 
 };
 
+// executor a Session posts its output writes to
+using SessionExecutor = OldStandaloneAsioLib::Executor;
+
 } // namespace detail
 } // namespace cli
 
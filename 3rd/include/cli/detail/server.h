@@ -30,34 +30,106 @@
 #ifndef CLI_DETAIL_SERVER_H_
 #define CLI_DETAIL_SERVER_H_
 
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <limits>
 #include <memory>
-#include <queue>
+#include <mutex>
+#include <span>
+#include <string>
+#include <utility>
+#include <vector>
+#include "../cli.h" // Broadcast
 
 namespace cli
 {
 namespace detail
 {
 
-class Session : public std::enable_shared_from_this<Session>, public std::streambuf
+class Session : public std::enable_shared_from_this<Session>, public std::streambuf, public BroadcastSink
 {
 public:
-    ~Session() override = default;
+    ~Session() override
+    {
+        if (live)
+            --*live;
+    }
     virtual void Start()
     {
+        {
+            std::lock_guard<std::mutex> lock(outMutex);
+            started = true;
+        }
         OnConnect();
         Read();
+        std::lock_guard<std::mutex> lock(outMutex);
+        ScheduleFlush();
+    }
+
+    // Broadcast lines (Cli::cout(), monitor mode) that would leave more than
+    // this many bytes queued and not yet written are dropped whole (and
+    // counted) instead of growing without bound, so a stalled client never
+    // slows down the threads writing to the session.
+    void OutputHighWaterMark(std::size_t bytes)
+    {
+        std::lock_guard<std::mutex> lock(outMutex);
+        highWaterMark = bytes;
+    }
+
+    // The session's own output, its command replies and prompts, is never
+    // dropped: the session is closed instead once its client leaves more
+    // than this many bytes unwritten.
+    void OutputLimit(std::size_t bytes)
+    {
+        std::lock_guard<std::mutex> lock(outMutex);
+        outputLimit = bytes;
+    }
+
+    // Number of broadcast lines dropped because the client did not keep up.
+    std::size_t DroppedOutput() const
+    {
+        std::lock_guard<std::mutex> lock(outMutex);
+        return dropped;
+    }
+
+    // Queues the chunk itself, shared with the other sessions it goes to. Can
+    // be called from any thread.
+    void Send(const Broadcast& b) override
+    {
+        Enqueue(EncodeShared(b));
+    }
+
+    // when the client sent something last, on the socket's thread
+    std::chrono::steady_clock::time_point LastInput() const { return lastInput; }
+    // a command in progress: the session is not idle
+    virtual bool Busy() const { return false; }
+
+    // Writes msg and closes the connection once the output is written.
+    void Shutdown(const std::string& msg)
+    {
+        outStream << msg << std::flush;
+        Disconnect();
     }
 
 protected:
 
-    explicit Session(asiolib::ip::tcp::socket _socket) : socket(std::move(_socket)), outStream( this ) {}
+    explicit Session(asiolib::ip::tcp::socket _socket) :
+        socket(std::move(_socket)), executor(socket), outStream( this ) {}
 
+    // Closes the connection once the queued output has been written.
     virtual void Disconnect()
     {
-        socket.shutdown(asiolib::ip::tcp::socket::shutdown_both);
-        socket.close();
+        {
+            std::lock_guard<std::mutex> lock(outMutex);
+            closeRequested = true;
+            if (writing)
+                return;
+        }
+        Close();
     }
 
+    // the input is parsed from data, reused by every read
     virtual void Read()
     {
       auto self( shared_from_this() );
@@ -70,20 +142,38 @@ protected:
                   OnError();
               else
               {
-                  OnDataReceived( std::string( data, length ));
+                  lastInput = std::chrono::steady_clock::now();
+                  OnDataReceived( data, length );
                   Read();
               }
           });
     }
 
-    virtual void Send(const std::string& msg)
+    // Queues n bytes, encoded, they are written asynchronously together with
+    // whatever else gets queued until the socket is ready. Can be called from
+    // any thread.
+    void Send(const char* s, std::size_t n)
     {
-        asiolibec::error_code ec;
-        asiolib::write(socket, asiolib::buffer(msg), ec);
-        if ((ec == asiolib::error::eof) || (ec == asiolib::error::connection_reset))
-            OnDisconnect();
-        else if (ec)
-            OnError();
+        std::lock_guard<std::mutex> lock(outMutex);
+        if (closeRequested)
+            return;
+        const std::size_t before = pending.size();
+        Encode(s, n, pending);
+        queued += pending.size() - before;
+        unwritten += pending.size() - before;
+        if (unwritten > outputLimit)
+        {
+            // the client does not read its own replies: nothing more is written
+            pending.clear();
+            shared.clear();
+            queued = 0;
+            closeRequested = true;
+            auto self( weak_from_this().lock() );
+            if (self)
+                executor.Post([this, self]() { Close(); });
+            return;
+        }
+        ScheduleFlush();
     }
 
     virtual std::ostream& OutStream() { return outStream; }
@@ -91,28 +181,148 @@ protected:
     virtual void OnConnect() = 0;
     virtual void OnDisconnect() = 0;
     virtual void OnError() = 0;
-    virtual void OnDataReceived(const std::string& _data) = 0;
+    virtual void OnDataReceived(const char* _data, std::size_t length) = 0;
 
-    virtual std::string Encode(const std::string& _data) const { return _data; }
+    // appends s as written on the wire to out
+    virtual void Encode(const char* s, std::size_t n, std::string& out) const { out.append(s, n); }
+    // the form of a broadcast for the wire
+    virtual std::shared_ptr<const std::string> EncodeShared(const Broadcast& b) const { return b.Text(); }
 
 private:
+    template <typename ASIOLIB>
+    friend class Server;
 
     // std::streambuf
     std::streamsize xsputn( const char* s, std::streamsize n ) override
     {
-        Send(Encode(std::string(s, s+n)));
+        Send(s, static_cast<std::size_t>(n));
         return n;
     }
     int overflow( int c ) override
     {
-        Send(Encode(std::string(1, static_cast< char >(c))));
+        const char ch = static_cast< char >(c);
+        Send(&ch, 1);
         return c;
     }
 
+    void Enqueue(std::shared_ptr<const std::string> chunk)
+    {
+        std::lock_guard<std::mutex> lock(outMutex);
+        if (closeRequested)
+            return;
+        if (unwritten + chunk->size() > highWaterMark)
+        {
+            ++dropped;
+            return;
+        }
+        queued += chunk->size();
+        unwritten += chunk->size();
+        // after what was sent to this session alone so far
+        shared.emplace_back(pending.size(), std::move(chunk));
+        ScheduleFlush();
+    }
+
+    // called with outMutex held
+    void ScheduleFlush()
+    {
+        if (!started || writing || queued == 0)
+            return;
+        // none when written to from a destructor
+        auto self( weak_from_this().lock() );
+        if (!self)
+            return;
+        writing = true;
+        executor.Post([this, self]() { Flush(); });
+    }
+
+    // on the socket executor: writes everything queued so far in one go,
+    // the shared chunks in place
+    void Flush()
+    {
+        {
+            std::lock_guard<std::mutex> lock(outMutex);
+            inFlight.swap(pending);
+            inFlightShared.swap(shared);
+            pending.clear();
+            shared.clear();
+            queued = 0;
+        }
+        buffers.clear();
+        std::size_t offset = 0;
+        for (const auto& [at, chunk]: inFlightShared)
+        {
+            if (at > offset)
+                buffers.push_back(asiolib::buffer(inFlight.data() + offset, at - offset));
+            buffers.push_back(asiolib::buffer(*chunk));
+            offset = at;
+        }
+        if (inFlight.size() > offset)
+            buffers.push_back(asiolib::buffer(inFlight.data() + offset, inFlight.size() - offset));
+        auto self( shared_from_this() );
+        // a view: the op copies its buffer sequence
+        asiolib::async_write(socket, std::span<const asiolib::const_buffer>(buffers),
+            [ this, self ]( asiolibec::error_code ec, std::size_t /*length*/ )
+            {
+                bool more = false;
+                bool close = false;
+                inFlight.clear();
+                inFlightShared.clear();
+                {
+                    std::lock_guard<std::mutex> lock(outMutex);
+                    unwritten = queued;
+                    if (ec)
+                    {
+                        pending.clear();
+                        shared.clear();
+                        queued = 0;
+                        unwritten = 0;
+                        closeRequested = true;
+                    }
+                    more = !ec && queued != 0;
+                    writing = more;
+                    close = !more && closeRequested;
+                }
+                if ((ec == asiolib::error::eof) || (ec == asiolib::error::connection_reset))
+                    OnDisconnect();
+                else if (ec)
+                    OnError();
+                if (more)
+                    Flush();
+                else if (close)
+                    Close();
+            });
+    }
+
+    void Close()
+    {
+        asiolibec::error_code ec;
+        socket.shutdown(asiolib::ip::tcp::socket::shutdown_both, ec);
+        socket.close(ec);
+    }
+
     asiolib::ip::tcp::socket socket;
+    SessionExecutor executor;
     enum { max_length = 1024 };
     char data[ max_length ];
     std::ostream outStream;
+    std::chrono::steady_clock::time_point lastInput{ std::chrono::steady_clock::now() };
+    std::shared_ptr<std::atomic<std::size_t>> live; // of the server, counts this one
+
+    mutable std::mutex outMutex;
+    std::string pending;   // queued since the last write started, for this session alone
+    std::vector<std::pair<std::size_t, std::shared_ptr<const std::string>>> shared; // broadcasts, at their offset in pending
+    std::size_t queued = 0; // bytes of both
+    std::size_t unwritten = 0; // queued plus the bytes of the write in progress
+    // being written, on the socket executor
+    std::string inFlight;
+    std::vector<std::pair<std::size_t, std::shared_ptr<const std::string>>> inFlightShared;
+    std::vector<asiolib::const_buffer> buffers;
+    std::size_t highWaterMark = 1024 * 1024;
+    std::size_t outputLimit = 16 * 1024 * 1024;
+    std::size_t dropped = 0;
+    bool started = false;
+    bool writing = false;  // a flush is posted or a write in progress
+    bool closeRequested = false;
 };
 
 
@@ -120,6 +330,9 @@ template <typename ASIOLIB>
 class Server
 {
 public:
+    // runs f once, on the io_context, after delay: a timer wheel's schedule, say
+    using TimerScheduler = std::function<void(std::chrono::steady_clock::duration delay, std::function<void()> f)>;
+
     // disable value semantics
     Server( const Server& ) = delete;
     Server& operator = ( const Server& ) = delete;
@@ -137,16 +350,83 @@ public:
     virtual ~Server() = default;
     // returns shared_ptr instead of unique_ptr because Session needs to use enable_shared_from_this
     virtual std::shared_ptr<Session> CreateSession(asiolib::ip::tcp::socket socket) = 0;
+
+    // The connections accepted while this many sessions are open are refused.
+    void MaxSessions(std::size_t n) { maxSessions = n; }
+    // Closes the sessions without input for timeout, but for those running a
+    // command. Their idle timers are scheduled by schedule, from the next
+    // connection on.
+    void IdleTimeout(std::chrono::steady_clock::duration timeout, TimerScheduler schedule)
+    {
+        idle = std::make_shared<Idle>();
+        idle->timeout = timeout;
+        idle->schedule = std::move(schedule);
+        idle->reaped = reaped;
+    }
+
+    std::size_t Sessions() const { return *live; }
+    std::size_t Refused() const { return refused; }
+    std::size_t Reaped() const { return *reaped; }
+
 private:
+    struct Idle
+    {
+        std::chrono::steady_clock::duration timeout;
+        TimerScheduler schedule;
+        std::shared_ptr<std::atomic<std::size_t>> reaped;
+    };
+
+    // a session's idle timer, pushed back to the timeout after its last input
+    static void Watch(const std::shared_ptr<Idle>& idle, std::weak_ptr<Session> session,
+                      std::chrono::steady_clock::duration delay)
+    {
+        idle->schedule(delay, [idle, session]()
+            {
+                auto s = session.lock();
+                if (!s)
+                    return;
+                const auto since = std::chrono::steady_clock::now() - s->LastInput();
+                if (s->Busy() || since < idle->timeout)
+                    Watch(idle, session, s->Busy() ? idle->timeout : idle->timeout - since);
+                else
+                {
+                    ++*idle->reaped;
+                    s->Shutdown("session idle for too long, closing\n");
+                }
+            });
+    }
+
     void Accept()
     {
         acceptor.async_accept([this](asiolibec::error_code ec, asiolib::ip::tcp::socket socket)
             {
-                if (!ec) CreateSession(std::move(socket))->Start();
+                if (!ec && *live >= maxSessions)
+                {
+                    ++refused;
+                    static const std::string full{ "too many sessions, try later\r\n" };
+                    asiolibec::error_code ignored;
+                    socket.non_blocking(true, ignored);
+                    socket.write_some(asiolib::buffer(full), ignored);
+                    socket.close(ignored);
+                }
+                else if (!ec)
+                {
+                    auto session = CreateSession(std::move(socket));
+                    session->live = live;
+                    ++*live;
+                    if (idle)
+                        Watch(idle, session, idle->timeout);
+                    session->Start();
+                }
                 Accept();
             });
     }
     asiolib::ip::tcp::acceptor acceptor;
+    std::shared_ptr<std::atomic<std::size_t>> live = std::make_shared<std::atomic<std::size_t>>(0);
+    std::size_t maxSessions = std::numeric_limits<std::size_t>::max();
+    std::atomic<std::size_t> refused{0};
+    std::shared_ptr<std::atomic<std::size_t>> reaped = std::make_shared<std::atomic<std::size_t>>(0);
+    std::shared_ptr<Idle> idle;
 };
 
 
@@ -47,7 +47,8 @@ enum class Symbol
     down,
     tab,
     eof,
-    clear
+    clear,
+    interrupt
 };
 
 template <typename SCREEN>
@@ -200,6 +201,13 @@ class Terminal
             case KeyType::clear:
                 return std::make_pair(Symbol::clear, std::string());
                 break;
+            case KeyType::interrupt:
+                // Ctrl-C at the prompt: the line is dropped
+                out << "^C\n";
+                currentLine.clear();
+                position = 0;
+                return std::make_pair(Symbol::interrupt, std::string());
+                break;
             case KeyType::ignored:
                 // TODO
                 break;
@@ -0,0 +1,248 @@
+#pragma once
+
+#include <spdlog/common.h>
+
+#ifdef SPDLOG_JSON_LOGGER
+
+#ifndef SPDLOG_HEADER_ONLY
+#    include <spdlog/details/json_writer.h>
+#endif
+
+#include <spdlog/details/fmt_helper.h>
+
+#include <string>
+
+namespace spdlog {
+
+namespace details {
+
+SPDLOG_INLINE void json_writer::buffer_adapter::write_character(char c)
+{
+    target->push_back(c);
+}
+
+SPDLOG_INLINE void json_writer::buffer_adapter::write_characters(const char *s, std::size_t length)
+{
+    target->append(s, s + length);
+}
+
+SPDLOG_INLINE json_writer::json_writer()
+    : adapter_(std::make_shared<buffer_adapter>())
+    , serializer_(details::make_unique<nlohmann::detail::serializer<nlohmann::json>>(adapter_, ' '))
+{
+    fields_.reserve(16);
+}
+
+SPDLOG_INLINE void json_writer::clear()
+{
+    fields_.clear();
+    values_.clear();
+}
+
+SPDLOG_INLINE void json_writer::add_string(string_view_t key, string_view_t value)
+{
+    begin_field_(key);
+    write_string(value, values_);
+    end_field_();
+}
+
+SPDLOG_INLINE void json_writer::add_int(string_view_t key, long long value)
+{
+    begin_field_(key);
+    fmt_helper::append_int(value, values_);
+    end_field_();
+}
+
+SPDLOG_INLINE void json_writer::add_uint(string_view_t key, unsigned long long value)
+{
+    begin_field_(key);
+    fmt_helper::append_int(value, values_);
+    end_field_();
+}
+
+SPDLOG_INLINE void json_writer::add_json(string_view_t key, const nlohmann::json &value)
+{
+    begin_field_(key);
+    write_json(value, values_);
+    end_field_();
+}
+
+SPDLOG_INLINE void json_writer::add_field(const spdlog::field &f)
+{
+    begin_field_(f.key);
+    write_field(f, values_);
+    end_field_();
+}
+
+SPDLOG_INLINE void json_writer::write_to(memory_buf_t &dest)
+{
+    // insertion sort: stable, allocation free and cheap for a handful of fields
+    for (size_t i = 1; i < fields_.size(); ++i)
+    {
+        field f = fields_[i];
+        size_t j = i;
+        for (; j > 0 && f.key.compare(fields_[j - 1].key) < 0; --j)
+        {
+            fields_[j] = fields_[j - 1];
+        }
+        fields_[j] = f;
+    }
+
+    dest.push_back('{');
+    bool first = true;
+    for (size_t i = 0; i < fields_.size(); ++i)
+    {
+        const field &f = fields_[i];
+        if (i + 1 < fields_.size() && fields_[i + 1].key == f.key)
+        {
+            continue;
+        }
+        if (!first)
+        {
+            dest.push_back(',');
+        }
+        first = false;
+        write_string(f.key, dest);
+        dest.push_back(':');
+        dest.append(values_.data() + f.begin, values_.data() + f.end);
+    }
+    dest.push_back('}');
+}
+
+SPDLOG_INLINE void json_writer::begin_field_(string_view_t key)
+{
+    fields_.push_back(field{key, values_.size(), values_.size()});
+}
+
+SPDLOG_INLINE void json_writer::end_field_()
+{
+    fields_.back().end = values_.size();
+}
+
+// Length of the well-formed UTF-8 sequence starting at p, 0 if it is not one.
+SPDLOG_INLINE size_t json_writer::utf8_length_(const unsigned char *p, const unsigned char *end)
+{
+    const auto in = [](unsigned char c, unsigned char lo, unsigned char hi) { return c >= lo && c <= hi; };
+    const size_t avail = static_cast<size_t>(end - p);
+    const unsigned char c = p[0];
+    if (in(c, 0xC2, 0xDF))
+    {
+        return avail >= 2 && in(p[1], 0x80, 0xBF) ? 2 : 0;
+    }
+    if (in(c, 0xE0, 0xEF))
+    {
+        const unsigned char lo = c == 0xE0 ? 0xA0 : 0x80;
+        const unsigned char hi = c == 0xED ? 0x9F : 0xBF;
+        return avail >= 3 && in(p[1], lo, hi) && in(p[2], 0x80, 0xBF) ? 3 : 0;
+    }
+    if (in(c, 0xF0, 0xF4))
+    {
+        const unsigned char lo = c == 0xF0 ? 0x90 : 0x80;
+        const unsigned char hi = c == 0xF4 ? 0x8F : 0xBF;
+        return avail >= 4 && in(p[1], lo, hi) && in(p[2], 0x80, 0xBF) && in(p[3], 0x80, 0xBF) ? 4 : 0;
+    }
+    return 0;
+}
+
+// Same escaping rules as nlohmann's serializer with ensure_ascii == false.
+SPDLOG_INLINE void json_writer::write_string(string_view_t str, memory_buf_t &dest)
+{
+    static const char hex[] = "0123456789abcdef";
+    const size_t start = dest.size();
+    const auto *p = reinterpret_cast<const unsigned char *>(str.data());
+    const auto *end = p + str.size();
+    const auto *run = p;
+
+    dest.push_back('"');
+    while (p != end)
+    {
+        const unsigned char c = *p;
+        if (c >= 0x20 && c != '"' && c != '\\' && c < 0x80)
+        {
+            ++p;
+            continue;
+        }
+        if (c >= 0x80)
+        {
+            const size_t len = utf8_length_(p, end);
+            if (len == 0)
+            {
+                // let nlohmann report the invalid byte exactly as it always did
+                dest.resize(start);
+                write_json(nlohmann::json(std::string(str.data(), str.size())), dest);
+                return;
+            }
+            p += len;
+            continue;
+        }
+
+        dest.append(reinterpret_cast<const char *>(run), reinterpret_cast<const char *>(p));
+        dest.push_back('\\');
+        switch (c)
+        {
+        case '\b':
+            dest.push_back('b');
+            break;
+        case '\t':
+            dest.push_back('t');
+            break;
+        case '\n':
+            dest.push_back('n');
+            break;
+        case '\f':
+            dest.push_back('f');
+            break;
+        case '\r':
+            dest.push_back('r');
+            break;
+        case '"':
+        case '\\':
+            dest.push_back(static_cast<char>(c));
+            break;
+        default:
+        {
+            const char u[] = {'u', '0', '0', hex[c >> 4], hex[c & 0x0F]};
+            dest.append(u, u + sizeof(u));
+            break;
+        }
+        }
+        run = ++p;
+    }
+    dest.append(reinterpret_cast<const char *>(run), reinterpret_cast<const char *>(p));
+    dest.push_back('"');
+}
+
+SPDLOG_INLINE void json_writer::write_json(const nlohmann::json &value, memory_buf_t &dest)
+{
+    adapter_->target = &dest;
+    serializer_->dump(value, false, false, 0);
+}
+
+SPDLOG_INLINE void json_writer::write_field(const spdlog::field &f, memory_buf_t &dest)
+{
+    switch (f.kind)
+    {
+    case spdlog::field::type::int64:
+        fmt_helper::append_int(f.i, dest);
+        break;
+    case spdlog::field::type::uint64:
+        fmt_helper::append_int(f.u, dest);
+        break;
+    case spdlog::field::type::float64:
+        // nlohmann's number format (and null for nan/inf), as params get it
+        write_json(nlohmann::json(f.d), dest);
+        break;
+    case spdlog::field::type::boolean:
+        fmt_helper::append_string_view(f.b ? string_view_t("true", 4) : string_view_t("false", 5), dest);
+        break;
+    case spdlog::field::type::string:
+        write_string(f.str, dest);
+        break;
+    }
+}
+
+} // namespace details
+
+} // namespace spdlog
+
+#endif
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <spdlog/common.h>
+
+#ifdef SPDLOG_JSON_LOGGER
+
+#include <spdlog/field.h>
+#include <spdlog/json.h>
+
+#include <memory>
+#include <vector>
+
+namespace spdlog {
+
+namespace details {
+
+// Streams a flat JSON object straight into a memory_buf_t, without building a
+// nlohmann::json DOM. Values are rendered as they are added and write_to()
+// emits the fields ordered by key, the last value of a duplicated key winning,
+// which is byte-for-byte what dumping a nlohmann::json object filled through
+// operator[] produces.
+//
+// The writer keeps its buffers between records, so once warmed up formatting
+// a record does not allocate. Keys are kept as views: they must stay valid
+// until write_to() returns.
+class SPDLOG_API json_writer
+{
+private:
+    struct field
+    {
+        string_view_t key;
+        size_t begin;
+        size_t end;
+    };
+
+    class buffer_adapter : public nlohmann::detail::output_adapter_protocol<char>
+    {
+    public:
+        memory_buf_t *target = nullptr;
+
+        virtual void write_character(char c) override;
+
+        virtual void write_characters(const char *s, std::size_t length) override;
+    };
+
+    std::vector<field> fields_;
+
+    memory_buf_t values_;
+
+    std::shared_ptr<buffer_adapter> adapter_;
+
+    std::unique_ptr<nlohmann::detail::serializer<nlohmann::json>> serializer_;
+
+    void begin_field_(string_view_t key);
+
+    void end_field_();
+
+    static size_t utf8_length_(const unsigned char *p, const unsigned char *end);
+
+public:
+    json_writer();
+    json_writer(const json_writer &other) = delete;
+    json_writer &operator=(const json_writer &other) = delete;
+
+    void clear();
+
+    void add_string(string_view_t key, string_view_t value);
+
+    void add_int(string_view_t key, long long value);
+
+    void add_uint(string_view_t key, unsigned long long value);
+
+    void add_json(string_view_t key, const nlohmann::json &value);
+
+    void add_field(const spdlog::field &f);
+
+    void write_to(memory_buf_t &dest);
+
+    // Quoted and escaped string, straight into dest.
+    void write_string(string_view_t str, memory_buf_t &dest);
+
+    // Any json value, as nlohmann would dump it, straight into dest.
+    void write_json(const nlohmann::json &value, memory_buf_t &dest);
+
+    // The value of a structured field, straight into dest.
+    void write_field(const spdlog::field &f, memory_buf_t &dest);
+};
+
+} // namespace details
+
+} // namespace spdlog
+
+#ifdef SPDLOG_HEADER_ONLY
+    #include "json_writer-inl.h"
+#endif
+
+#endif
@@ -5,6 +5,7 @@
 
 #include <spdlog/common.h>
 #ifdef SPDLOG_JSON_LOGGER
+#    include <spdlog/field.h>
 #    include <spdlog/json.h>
 #endif
 #include <string>
@@ -37,6 +38,10 @@ struct SPDLOG_API log_msg {
 
 #ifdef SPDLOG_JSON_LOGGER
     const nlohmann::json *params = nullptr;
+
+    // structured fields viewed on the caller's stack, see spdlog/field.h
+    const field *fields = nullptr;
+    size_t fields_count = 0;
 #endif
 };
 }  // namespace details
@@ -19,6 +19,7 @@ SPDLOG_INLINE log_msg_buffer::log_msg_buffer(const log_msg &orig_msg)
     {
         params_buffer = *params;
     }
+    materialize_fields();
 #endif
     update_string_views();
 }
@@ -27,6 +28,9 @@ SPDLOG_INLINE log_msg_buffer::log_msg_buffer(const log_msg_buffer &other)
     : log_msg{other} {
     buffer.append(logger_name.begin(), logger_name.end());
     buffer.append(payload.begin(), payload.end());
+#ifdef SPDLOG_JSON_LOGGER
+    params_buffer = other.params_buffer;
+#endif
     update_string_views();
 }
 
@@ -65,6 +69,38 @@ SPDLOG_INLINE log_msg_buffer &log_msg_buffer::operator=(log_msg_buffer &&other)
     return *this;
 }
 
+#ifdef SPDLOG_JSON_LOGGER
+// The fields only view the caller's stack, keep them as params instead.
+SPDLOG_INLINE void log_msg_buffer::materialize_fields() {
+    for (size_t i = 0; i < fields_count; ++i) {
+        const field &f = fields[i];
+        nlohmann::json &value = params_buffer[std::string(f.key.data(), f.key.size())];
+        switch (f.kind) {
+            case field::type::int64:
+                value = f.i;
+                break;
+            case field::type::uint64:
+                value = f.u;
+                break;
+            case field::type::float64:
+                value = f.d;
+                break;
+            case field::type::boolean:
+                value = f.b;
+                break;
+            case field::type::string:
+                value = std::string(f.str.data(), f.str.size());
+                break;
+        }
+    }
+    if (fields_count > 0) {
+        params = &params_buffer;
+    }
+    fields = nullptr;
+    fields_count = 0;
+}
+#endif
+
 SPDLOG_INLINE void log_msg_buffer::update_string_views() {
     logger_name = string_view_t{buffer.data(), logger_name.size()};
     payload = string_view_t{buffer.data() + logger_name.size(), payload.size()};
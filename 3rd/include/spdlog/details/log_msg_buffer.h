@@ -14,6 +14,9 @@ namespace details {
 class SPDLOG_API log_msg_buffer : public log_msg {
     memory_buf_t buffer;
     void update_string_views();
+#ifdef SPDLOG_JSON_LOGGER
+    void materialize_fields();
+#endif
 
 public:
     log_msg_buffer() = default;
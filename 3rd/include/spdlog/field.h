@@ -0,0 +1,93 @@
+#pragma once
+
+#include <spdlog/common.h>
+
+#ifdef SPDLOG_JSON_LOGGER
+
+#include <initializer_list>
+#include <string>
+#include <type_traits>
+
+namespace spdlog {
+
+// A typed key/value pair for structured logging.
+//
+// Fields only view their key and string value, they are meant to live on the
+// caller's stack for the duration of one log call:
+//     spdlog::info("connection closed", {{"conn_id", 42}, {"peer", peer}, {"clean", true}});
+// Nothing is copied or allocated on the way to the sinks; the fields are
+// rendered by the JSON formatters, and turned into nlohmann::json only when
+// the record has to outlive the call (backtrace, async logger).
+class field
+{
+public:
+    enum class type
+    {
+        int64,
+        uint64,
+        float64,
+        boolean,
+        string
+    };
+
+    string_view_t key;
+    type kind;
+    union
+    {
+        long long i;
+        unsigned long long u;
+        double d;
+        bool b;
+    };
+    string_view_t str;
+
+    field(string_view_t k, bool v)
+        : key(k)
+        , kind(type::boolean)
+        , b(v)
+    {}
+
+    template<class T, typename std::enable_if<std::is_integral<T>::value && std::is_signed<T>::value, int>::type = 0>
+    field(string_view_t k, T v)
+        : key(k)
+        , kind(type::int64)
+        , i(v)
+    {}
+
+    template<class T, typename std::enable_if<std::is_integral<T>::value && std::is_unsigned<T>::value &&
+                                                  !std::is_same<T, bool>::value,
+                          int>::type = 0>
+    field(string_view_t k, T v)
+        : key(k)
+        , kind(type::uint64)
+        , u(v)
+    {}
+
+    template<class T, typename std::enable_if<std::is_floating_point<T>::value, int>::type = 0>
+    field(string_view_t k, T v)
+        : key(k)
+        , kind(type::float64)
+        , d(v)
+    {}
+
+    field(string_view_t k, string_view_t v)
+        : key(k)
+        , kind(type::string)
+        , u(0)
+        , str(v)
+    {}
+
+    field(string_view_t k, const char *v)
+        : field(k, string_view_t(v))
+    {}
+
+    field(string_view_t k, const std::string &v)
+        : field(k, string_view_t(v))
+    {}
+};
+
+using fields_t = std::initializer_list<field>;
+
+} // namespace spdlog
+
+#endif
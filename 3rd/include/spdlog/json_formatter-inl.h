@@ -8,6 +8,8 @@
 #    include <spdlog/json_formatter.h>
 #endif
 
+#include <spdlog/details/fmt_helper.h>
+
 namespace spdlog {
 
 SPDLOG_INLINE populators::populator_set json_formatter::make_default_populators_()
@@ -31,19 +33,24 @@ SPDLOG_INLINE json_formatter::json_formatter(populators::populator_set &&populat
 
 SPDLOG_INLINE void json_formatter::format(const details::log_msg &msg, memory_buf_t &dest)
 {
-    nlohmann::json entry = nlohmann::json::object();
+    writer_.clear();
     for (const auto &populator : populators_)
     {
-        populator->populate(msg, entry);
+        populator->populate(msg, writer_);
     }
-    if (msg.params)
+    if (msg.params && msg.params->is_object())
     {
-        for (const auto &kv : msg.params->items())
+        for (auto it = msg.params->begin(); it != msg.params->end(); ++it)
         {
-            entry[kv.key()] = kv.value();
+            writer_.add_json(it.key(), it.value());
         }
     }
-    dest.append(entry.dump() + kEOL);
+    for (size_t i = 0; i < msg.fields_count; ++i)
+    {
+        writer_.add_field(msg.fields[i]);
+    }
+    writer_.write_to(dest);
+    details::fmt_helper::append_string_view(kEOL, dest);
 }
 
 SPDLOG_INLINE std::unique_ptr<formatter> json_formatter::clone() const
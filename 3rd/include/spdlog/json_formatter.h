@@ -4,12 +4,16 @@
 
 #ifdef SPDLOG_JSON_LOGGER
 
+#include <spdlog/details/json_writer.h>
 #include <spdlog/details/os.h>
 #include <spdlog/formatter.h>
 #include <spdlog/populators.h>
 
 #include <memory>
 #include <string>
+#include <tuple>
+#include <type_traits>
+#include <utility>
 
 namespace spdlog {
 
@@ -20,6 +24,8 @@ private:
 
     populators::populator_set populators_;
 
+    details::json_writer writer_;
+
     static populators::populator_set make_default_populators_();
 
 public:
@@ -32,6 +38,171 @@ public:
     virtual std::unique_ptr<formatter> clone() const override;
 };
 
+namespace details {
+
+template<class T, class... Ts>
+struct is_one_of : std::false_type
+{};
+
+template<class T, class U, class... Ts>
+struct is_one_of<T, U, Ts...> : std::integral_constant<bool, std::is_same<T, U>::value || is_one_of<T, Ts...>::value>
+{};
+
+template<class... Ts>
+struct are_distinct : std::true_type
+{};
+
+template<class T, class... Ts>
+struct are_distinct<T, Ts...> : std::integral_constant<bool, !is_one_of<T, Ts...>::value && are_distinct<Ts...>::value>
+{};
+
+} // namespace details
+
+// JSON formatter over a compile-time populator list, see
+// populators::make_populator_set<...>(). The fields are written in the listed
+// order, followed by the structured params sorted by key and the structured
+// fields in call order. A param or field named after one of the listed
+// populators replaces that populator's value in place.
+template<class... Populators>
+class static_json_formatter final : public formatter
+{
+private:
+    static_assert(details::are_distinct<Populators...>::value, "populators must be listed once");
+
+    const std::string kEOL;
+
+    std::tuple<Populators...> populators_;
+
+    details::json_writer writer_;
+
+    bool first_ = true;
+
+    static bool is_populated_key_(string_view_t key)
+    {
+        bool found = false;
+        int dummy[] = {0, (found = found || key == string_view_t(Populators::key), 0)...};
+        (void)dummy;
+        return found;
+    }
+
+    void write_key_(string_view_t key, memory_buf_t &dest)
+    {
+        if (!first_)
+        {
+            dest.push_back(',');
+        }
+        first_ = false;
+        dest.push_back('"');
+        dest.append(key.data(), key.data() + key.size());
+        dest.push_back('"');
+        dest.push_back(':');
+    }
+
+    static const field *find_field_(const details::log_msg &msg, string_view_t key)
+    {
+        for (size_t i = 0; i < msg.fields_count; ++i)
+        {
+            if (msg.fields[i].key == key)
+            {
+                return &msg.fields[i];
+            }
+        }
+        return nullptr;
+    }
+
+    template<class P>
+    void populate_(P &populator, const details::log_msg &msg, const nlohmann::json *params, memory_buf_t &dest)
+    {
+        if (msg.fields_count > 0)
+        {
+            const field *f = find_field_(msg, P::key);
+            if (f)
+            {
+                write_key_(P::key, dest);
+                writer_.write_field(*f, dest);
+                return;
+            }
+        }
+        if (params)
+        {
+            auto it = params->find(P::key);
+            if (it != params->end())
+            {
+                write_key_(P::key, dest);
+                writer_.write_json(*it, dest);
+                return;
+            }
+        }
+        if (populator.skip(msg))
+        {
+            return;
+        }
+        write_key_(P::key, dest);
+        populator.populate(msg, writer_, dest);
+    }
+
+    template<size_t... I>
+    void populate_all_(const details::log_msg &msg, const nlohmann::json *params, memory_buf_t &dest, std::index_sequence<I...>)
+    {
+        int dummy[] = {0, (populate_(std::get<I>(populators_), msg, params, dest), 0)...};
+        (void)dummy;
+    }
+
+public:
+    explicit static_json_formatter(std::string eol = spdlog::details::os::default_eol)
+        : kEOL(std::move(eol))
+    {}
+
+    virtual void format(const details::log_msg &msg, memory_buf_t &dest) override
+    {
+        const nlohmann::json *params = msg.params && msg.params->is_object() && !msg.params->empty() ? msg.params : nullptr;
+        first_ = true;
+        dest.push_back('{');
+        populate_all_(msg, params, dest, std::make_index_sequence<sizeof...(Populators)>{});
+        if (params)
+        {
+            for (auto it = params->begin(); it != params->end(); ++it)
+            {
+                if (is_populated_key_(it.key()))
+                {
+                    continue;
+                }
+                if (!first_)
+                {
+                    dest.push_back(',');
+                }
+                first_ = false;
+                writer_.write_string(it.key(), dest);
+                dest.push_back(':');
+                writer_.write_json(it.value(), dest);
+            }
+        }
+        for (size_t i = 0; i < msg.fields_count; ++i)
+        {
+            const field &f = msg.fields[i];
+            if (is_populated_key_(f.key))
+            {
+                continue;
+            }
+            if (!first_)
+            {
+                dest.push_back(',');
+            }
+            first_ = false;
+            writer_.write_string(f.key, dest);
+            dest.push_back(':');
+            writer_.write_field(f, dest);
+        }
+        dest.push_back('}');
+        dest.append(kEOL.data(), kEOL.data() + kEOL.size());
+    }
+
+    virtual std::unique_ptr<formatter> clone() const override
+    {
+        return details::make_unique<static_json_formatter>(kEOL);
+    }
+};
+
 } // namespace spdlog
 
 #ifdef SPDLOG_HEADER_ONLY
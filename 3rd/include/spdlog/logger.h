@@ -135,6 +135,39 @@ public:
         return log(source_loc{}, lvl, msg); 
     }
 
+#ifdef SPDLOG_JSON_LOGGER
+    // structured fields, handed to the sinks as views without any copy:
+    //     logger->info("connection closed", {{"conn_id", 42}, {"clean", true}});
+    void log(source_loc loc, level::level_enum lvl, string_view_t msg, fields_t fields) {
+        bool log_enabled = should_log(lvl);
+        bool traceback_enabled = tracer_.enabled();
+        if (!log_enabled && !traceback_enabled) {
+            return;
+        }
+
+        details::log_msg log_msg(loc, name_, lvl, msg);
+        log_msg.fields = fields.begin();
+        log_msg.fields_count = fields.size();
+        executor_callback(log_msg, log_enabled, traceback_enabled);
+    }
+
+    void log(level::level_enum lvl, string_view_t msg, fields_t fields) {
+        log(source_loc{}, lvl, msg, fields);
+    }
+
+    void trace(string_view_t msg, fields_t fields) { log(level::trace, msg, fields); }
+
+    void debug(string_view_t msg, fields_t fields) { log(level::debug, msg, fields); }
+
+    void info(string_view_t msg, fields_t fields) { log(level::info, msg, fields); }
+
+    void warn(string_view_t msg, fields_t fields) { log(level::warn, msg, fields); }
+
+    void error(string_view_t msg, fields_t fields) { log(level::err, msg, fields); }
+
+    void critical(string_view_t msg, fields_t fields) { log(level::critical, msg, fields); }
+#endif
+
     template <typename... Args>
     SPDLOG_EXECUTOR_T trace(format_string_t<Args...> fmt, Args &&...args) {
         return log(level::trace, fmt, std::forward<Args>(args)...);
@@ -300,6 +333,12 @@ public:
     {
         set_formatter(details::make_unique<json_formatter>(populators::make_populator_set(std::forward<Args>(args)...)));
     }
+
+    template<class... Populators>
+    void set_populators(populators::populator_list<Populators...>)
+    {
+        set_formatter(details::make_unique<static_json_formatter<Populators...>>());
+    }
 #endif
 
     // backtrace support.
@@ -8,6 +8,12 @@
 #    include <spdlog/populators.h>
 #endif
 
+#include <spdlog/details/fmt_helper.h>
+
+#ifndef _WIN32
+#    include <pthread.h>
+#endif
+
 namespace spdlog {
 
 namespace populators {
@@ -22,11 +28,11 @@ SPDLOG_INLINE pattern_populator::pattern_populator(const pattern_populator &othe
     , pf_(other.pf_->clone())
 {}
 
-SPDLOG_INLINE void pattern_populator::populate(const details::log_msg &msg, nlohmann::json &dest)
+SPDLOG_INLINE void pattern_populator::populate(const details::log_msg &msg, details::json_writer &dest)
 {
-    memory_buf_t tmp;
-    pf_->format(msg, tmp);
-    dest[kKey] = std::string(tmp.data(), tmp.size());
+    buf_.clear();
+    pf_->format(msg, buf_);
+    dest.add_string(kKey, string_view_t(buf_.data(), buf_.size()));
 }
 
 SPDLOG_INLINE std::unique_ptr<populator> pattern_populator::clone() const
@@ -46,12 +52,12 @@ SPDLOG_INLINE logger_name_populator::logger_name_populator()
     : pattern_populator("logger_name", "%n")
 {}
 
-SPDLOG_INLINE void logger_name_populator::populate(const details::log_msg &msg, nlohmann::json &dest)
+SPDLOG_INLINE void logger_name_populator::populate(const details::log_msg &msg, details::json_writer &dest)
 {
-    memory_buf_t tmp;
-    pf_->format(msg, tmp);
-    if (tmp.size() > 0) {
-        dest[kKey] = std::string(tmp.data(), tmp.size());
+    buf_.clear();
+    pf_->format(msg, buf_);
+    if (buf_.size() > 0) {
+        dest.add_string(kKey, string_view_t(buf_.data(), buf_.size()));
     }
 }
 
@@ -64,9 +70,9 @@ SPDLOG_INLINE message_populator::message_populator()
     : pattern_populator("message", "%v")
 {}
 
-SPDLOG_INLINE void pid_populator::populate(const details::log_msg &, nlohmann::json &dest)
+SPDLOG_INLINE void pid_populator::populate(const details::log_msg &, details::json_writer &dest)
 {
-    dest["pid"] = details::os::pid();
+    dest.add_int("pid", details::os::pid());
 }
 
 SPDLOG_INLINE std::unique_ptr<populator> pid_populator::clone() const
@@ -78,9 +84,9 @@ SPDLOG_INLINE src_loc_populator::src_loc_populator()
     : pattern_populator("src_loc", "%@")
 {}
 
-SPDLOG_INLINE void thread_id_populator::populate(const details::log_msg &msg, nlohmann::json &dest)
+SPDLOG_INLINE void thread_id_populator::populate(const details::log_msg &msg, details::json_writer &dest)
 {
-    dest["thread_id"] = msg.thread_id;
+    dest.add_uint("thread_id", msg.thread_id);
 }
 
 SPDLOG_INLINE std::unique_ptr<populator> thread_id_populator::clone() const
@@ -88,10 +94,10 @@ SPDLOG_INLINE std::unique_ptr<populator> thread_id_populator::clone() const
     return details::make_unique<thread_id_populator>();
 }
 
-SPDLOG_INLINE void timestamp_populator::populate(const details::log_msg &msg, nlohmann::json &dest)
+SPDLOG_INLINE void timestamp_populator::populate(const details::log_msg &msg, details::json_writer &dest)
 {
     const auto dur = msg.time.time_since_epoch();
-    dest["timestamp"] = std::chrono::duration_cast<std::chrono::seconds>(dur).count();
+    dest.add_int("timestamp", std::chrono::duration_cast<std::chrono::seconds>(dur).count());
 }
 
 SPDLOG_INLINE std::unique_ptr<populator> timestamp_populator::clone() const
@@ -99,6 +105,108 @@ SPDLOG_INLINE std::unique_ptr<populator> timestamp_populator::clone() const
     return details::make_unique<timestamp_populator>();
 }
 
+SPDLOG_INLINE void date_time::populate(const details::log_msg &msg, details::json_writer &, memory_buf_t &dest)
+{
+    using details::fmt_helper::pad2;
+    const auto secs = std::chrono::duration_cast<std::chrono::seconds>(msg.time.time_since_epoch());
+    if (secs != cached_secs_)
+    {
+        // same text as the "%Y-%m-%d %H:%M:%S.%e%z" pattern
+        const std::tm tm_time = details::os::localtime(log_clock::to_time_t(msg.time));
+        cached_date_.clear();
+        details::fmt_helper::append_int(tm_time.tm_year + 1900, cached_date_);
+        cached_date_.push_back('-');
+        pad2(tm_time.tm_mon + 1, cached_date_);
+        cached_date_.push_back('-');
+        pad2(tm_time.tm_mday, cached_date_);
+        cached_date_.push_back(' ');
+        pad2(tm_time.tm_hour, cached_date_);
+        cached_date_.push_back(':');
+        pad2(tm_time.tm_min, cached_date_);
+        cached_date_.push_back(':');
+        pad2(tm_time.tm_sec, cached_date_);
+        cached_date_.push_back('.');
+
+        int total_minutes = details::os::utc_minutes_offset(tm_time);
+        cached_zone_.clear();
+        cached_zone_.push_back(total_minutes < 0 ? '-' : '+');
+        total_minutes = total_minutes < 0 ? -total_minutes : total_minutes;
+        pad2(total_minutes / 60, cached_zone_);
+        cached_zone_.push_back(':');
+        pad2(total_minutes % 60, cached_zone_);
+        cached_secs_ = secs;
+    }
+
+    const auto millis = details::fmt_helper::time_fraction<std::chrono::milliseconds>(msg.time);
+    dest.push_back('"');
+    dest.append(cached_date_.data(), cached_date_.data() + cached_date_.size());
+    details::fmt_helper::pad3(static_cast<uint32_t>(millis.count()), dest);
+    dest.append(cached_zone_.data(), cached_zone_.data() + cached_zone_.size());
+    dest.push_back('"');
+}
+
+SPDLOG_INLINE void level::populate(const details::log_msg &msg, details::json_writer &writer, memory_buf_t &dest)
+{
+    writer.write_string(spdlog::level::to_string_view(msg.level), dest);
+}
+
+SPDLOG_INLINE void logger_name::populate(const details::log_msg &msg, details::json_writer &writer, memory_buf_t &dest)
+{
+    writer.write_string(msg.logger_name, dest);
+}
+
+SPDLOG_INLINE void message::populate(const details::log_msg &msg, details::json_writer &writer, memory_buf_t &dest)
+{
+    writer.write_string(msg.payload, dest);
+}
+
+SPDLOG_INLINE std::atomic<int> &pid::cache_()
+{
+    static std::atomic<int> cached{[] {
+#ifndef _WIN32
+        pthread_atfork(nullptr, nullptr, [] { cache_().store(details::os::pid(), std::memory_order_relaxed); });
+#endif
+        return details::os::pid();
+    }()};
+    return cached;
+}
+
+SPDLOG_INLINE int pid::current()
+{
+    return cache_().load(std::memory_order_relaxed);
+}
+
+SPDLOG_INLINE void pid::populate(const details::log_msg &, details::json_writer &, memory_buf_t &dest)
+{
+    details::fmt_helper::append_int(current(), dest);
+}
+
+SPDLOG_INLINE void src_loc::populate(const details::log_msg &msg, details::json_writer &writer, memory_buf_t &dest)
+{
+    if (msg.source.empty())
+    {
+        writer.write_string(string_view_t(), dest);
+        return;
+    }
+    // "filename:line", reopening the escaped file name for the line number
+    writer.write_string(msg.source.filename, dest);
+    dest.resize(dest.size() - 1);
+    dest.push_back(':');
+    details::fmt_helper::append_int(msg.source.line, dest);
+    dest.push_back('"');
+}
+
+SPDLOG_INLINE void thread_id::populate(const details::log_msg &msg, details::json_writer &, memory_buf_t &dest)
+{
+    details::fmt_helper::append_int(msg.thread_id, dest);
+}
+
+SPDLOG_INLINE void timestamp::populate(const details::log_msg &msg, details::json_writer &, memory_buf_t &dest)
+{
+    const auto dur = msg.time.time_since_epoch();
+    details::fmt_helper::append_int(std::chrono::duration_cast<std::chrono::seconds>(dur).count(), dest);
+}
+
 } // namespace populators
 
 } // namespace spdlog
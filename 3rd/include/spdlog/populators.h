@@ -4,11 +4,13 @@
 
 #ifdef SPDLOG_JSON_LOGGER
 
+#include <spdlog/details/json_writer.h>
 #include <spdlog/details/log_msg.h>
 #include <spdlog/details/os.h>
-#include <spdlog/json.h>
 #include <spdlog/pattern_formatter.h>
 
+#include <atomic>
+#include <chrono>
 #include <unordered_set>
 
 namespace spdlog {
@@ -20,7 +22,7 @@ class SPDLOG_API populator
 public:
     virtual ~populator() {}
 
-    virtual void populate(const details::log_msg &msg, nlohmann::json &dest) = 0;
+    virtual void populate(const details::log_msg &msg, details::json_writer &dest) = 0;
 
     virtual std::unique_ptr<populator> clone() const = 0;
 };
@@ -32,12 +34,14 @@ protected:
 
     std::unique_ptr<spdlog::formatter> pf_;
 
+    memory_buf_t buf_;
+
 public:
     pattern_populator(const std::string &key, const std::string &pattern);
 
     pattern_populator(const pattern_populator &other);
 
-    virtual void populate(const details::log_msg &msg, nlohmann::json &dest) override;
+    virtual void populate(const details::log_msg &msg, details::json_writer &dest) override;
 
     virtual std::unique_ptr<populator> clone() const override;
 };
@@ -59,7 +63,7 @@ class SPDLOG_API logger_name_populator : public pattern_populator
 public:
     logger_name_populator();
 
-    virtual void populate(const details::log_msg &msg, nlohmann::json &dest) override;
+    virtual void populate(const details::log_msg &msg, details::json_writer &dest) override;
 
     virtual std::unique_ptr<populator> clone() const override;
 };
@@ -73,7 +77,7 @@ public:
 class SPDLOG_API pid_populator : public populator
 {
 public:
-    virtual void populate(const details::log_msg &, nlohmann::json &dest) override;
+    virtual void populate(const details::log_msg &, details::json_writer &dest) override;
 
     virtual std::unique_ptr<populator> clone() const override;
 };
@@ -87,7 +91,7 @@ public:
 class SPDLOG_API thread_id_populator : public populator
 {
 public:
-    virtual void populate(const details::log_msg &msg, nlohmann::json &dest) override;
+    virtual void populate(const details::log_msg &msg, details::json_writer &dest) override;
 
     virtual std::unique_ptr<populator> clone() const override;
 };
@@ -95,7 +99,7 @@ public:
 class SPDLOG_API timestamp_populator : public populator
 {
 public:
-    virtual void populate(const details::log_msg &msg, nlohmann::json &dest) override;
+    virtual void populate(const details::log_msg &msg, details::json_writer &dest) override;
 
     virtual std::unique_ptr<populator> clone() const override;
 };
@@ -117,6 +121,109 @@ inline populator_set make_populator_set()
     return ret;
 }
 
+// Compile-time populators.
+//
+// Plain types writing one field each, without a virtual call or an
+// intermediate pattern_formatter. They are listed with
+//     sink->set_populators(populators::make_populator_set<populators::date_time, populators::level>());
+// and the resulting formatter writes them straight into the destination
+// buffer, in the listed order. A populator provides a literal `key`, written
+// verbatim, `skip()` to leave the field out of a record and `populate()` to
+// write the JSON value.
+
+struct field_populator
+{
+    bool skip(const details::log_msg &) const
+    {
+        return false;
+    }
+};
+
+// Date and time are formatted once per second, only the milliseconds change.
+class SPDLOG_API date_time : public field_populator
+{
+private:
+    std::chrono::seconds cached_secs_{-1};
+    memory_buf_t cached_date_;
+    memory_buf_t cached_zone_;
+
+public:
+    static constexpr const char *key = "date_time";
+
+    void populate(const details::log_msg &msg, details::json_writer &writer, memory_buf_t &dest);
+};
+
+struct SPDLOG_API level : field_populator
+{
+    static constexpr const char *key = "level";
+
+    void populate(const details::log_msg &msg, details::json_writer &writer, memory_buf_t &dest);
+};
+
+struct SPDLOG_API logger_name : field_populator
+{
+    static constexpr const char *key = "logger_name";
+
+    bool skip(const details::log_msg &msg) const
+    {
+        return msg.logger_name.size() == 0;
+    }
+
+    void populate(const details::log_msg &msg, details::json_writer &writer, memory_buf_t &dest);
+};
+
+struct SPDLOG_API message : field_populator
+{
+    static constexpr const char *key = "message";
+
+    void populate(const details::log_msg &msg, details::json_writer &writer, memory_buf_t &dest);
+};
+
+// The process id is looked up once per process, and again in a forked child.
+class SPDLOG_API pid : public field_populator
+{
+private:
+    static std::atomic<int> &cache_();
+
+public:
+    static constexpr const char *key = "pid";
+
+    static int current();
+
+    void populate(const details::log_msg &msg, details::json_writer &writer, memory_buf_t &dest);
+};
+
+struct SPDLOG_API src_loc : field_populator
+{
+    static constexpr const char *key = "src_loc";
+
+    void populate(const details::log_msg &msg, details::json_writer &writer, memory_buf_t &dest);
+};
+
+struct SPDLOG_API thread_id : field_populator
+{
+    static constexpr const char *key = "thread_id";
+
+    void populate(const details::log_msg &msg, details::json_writer &writer, memory_buf_t &dest);
+};
+
+struct SPDLOG_API timestamp : field_populator
+{
+    static constexpr const char *key = "timestamp";
+
+    void populate(const details::log_msg &msg, details::json_writer &writer, memory_buf_t &dest);
+};
+
+template<class... Populators>
+struct populator_list
+{};
+
+template<class... Populators>
+populator_list<Populators...> make_populator_set()
+{
+    return {};
+}
+
 } // namespace populators
 
 } // namespace spdlog
@@ -24,6 +24,12 @@ public:
     {
         set_formatter(details::make_unique<json_formatter>(populators::make_populator_set(std::forward<Args>(args)...)));
     }
+
+    template<class... Populators>
+    void set_populators(populators::populator_list<Populators...>)
+    {
+        set_formatter(details::make_unique<static_json_formatter<Populators...>>());
+    }
 #endif
 
     void set_level(level::level_enum log_level);
@@ -65,6 +65,12 @@ SPDLOG_API void set_populators(Args &&... args)
 {
     set_formatter(details::make_unique<json_formatter>(populators::make_populator_set(std::forward<Args>(args)...)));
 }
+
+template<class... Populators>
+SPDLOG_API void set_populators(populators::populator_list<Populators...>)
+{
+    set_formatter(details::make_unique<static_json_formatter<Populators...>>());
+}
 #endif
 
 // enable global backtrace support
@@ -246,6 +252,28 @@ inline SPDLOG_EXECUTOR_T critical(wformat_string_t<Args...> fmt, Args &&...args)
 }
 #endif
 
+#ifdef SPDLOG_JSON_LOGGER
+inline void log(source_loc source, level::level_enum lvl, string_view_t msg, fields_t fields) {
+    default_logger_raw()->log(source, lvl, msg, fields);
+}
+
+inline void log(level::level_enum lvl, string_view_t msg, fields_t fields) {
+    default_logger_raw()->log(lvl, msg, fields);
+}
+
+inline void trace(string_view_t msg, fields_t fields) { default_logger_raw()->trace(msg, fields); }
+
+inline void debug(string_view_t msg, fields_t fields) { default_logger_raw()->debug(msg, fields); }
+
+inline void info(string_view_t msg, fields_t fields) { default_logger_raw()->info(msg, fields); }
+
+inline void warn(string_view_t msg, fields_t fields) { default_logger_raw()->warn(msg, fields); }
+
+inline void error(string_view_t msg, fields_t fields) { default_logger_raw()->error(msg, fields); }
+
+inline void critical(string_view_t msg, fields_t fields) { default_logger_raw()->critical(msg, fields); }
+#endif
+
 template <typename T>
 inline SPDLOG_EXECUTOR_T trace(const T &msg) {
     return default_logger_raw()->trace(msg);
@@ -299,6 +327,19 @@ inline SPDLOG_EXECUTOR_T critical(const T &msg) {
         (logger)->log(spdlog::source_loc{}, level, __VA_ARGS__)
 #endif
 
+#ifdef SPDLOG_JSON_LOGGER
+// Structured fields, evaluated only when the record is going to be logged:
+//     SPDLOG_FIELDS(spdlog::level::debug, "read", {"conn_id", id}, {"bytes", n});
+    #define SPDLOG_LOGGER_FIELDS(logger, level, msg, ...)                                                \
+        do {                                                                                              \
+            auto *spdlog_fields_logger_ = &*(logger);                                                     \
+            if (spdlog_fields_logger_->should_log(level) || spdlog_fields_logger_->should_backtrace()) { \
+                SPDLOG_LOGGER_CALL(spdlog_fields_logger_, level, msg, {__VA_ARGS__});                     \
+            }                                                                                             \
+        } while (0)
+    #define SPDLOG_FIELDS(level, msg, ...) SPDLOG_LOGGER_FIELDS(spdlog::default_logger_raw(), level, msg, __VA_ARGS__)
+#endif
+
 #if SPDLOG_ACTIVE_LEVEL <= SPDLOG_LEVEL_TRACE
     #define SPDLOG_LOGGER_TRACE(logger, ...) \
         SPDLOG_LOGGER_CALL(logger, spdlog::level::trace, __VA_ARGS__)
@@ -0,0 +1,39 @@
+#ifndef CONFIG_H
+#define CONFIG_H
+
+#define MYPROJECT_VERSION_MAJOR 0
+#define MYPROJECT_VERSION_MINOR 1
+#define MYPROJECT_VERSION_PATCH 0
+
+
+// // Define to 1 if you have a definition for fdatasync() in <unistd.h>.
+// #if !defined(HAVE_FDATASYNC)
+// #define HAVE_FDATASYNC 0
+// #endif  // !defined(HAVE_FDATASYNC)
+
+// // Define to 1 if you have a definition for F_FULLFSYNC in <fcntl.h>.
+// #if !defined(HAVE_FULLFSYNC)
+// #define HAVE_FULLFSYNC 0
+// #endif  // !defined(HAVE_FULLFSYNC)
+
+// // Define to 1 if you have a definition for O_CLOEXEC in <fcntl.h>.
+// #if !defined(HAVE_O_CLOEXEC)
+// #define HAVE_O_CLOEXEC 0
+// #endif  // !defined(HAVE_O_CLOEXEC)
+
+// // Define to 1 if you have Google CRC32C.
+// #if !defined(HAVE_LIBEVENT)
+// #define HAVE_LIBEVENT 0
+// #endif  // !defined(HAVE_LIBEVENT)
+
+// // Define to 1 if you have Google Snappy.
+// #if !defined(HAVE_SNAPPY)
+// #define HAVE_SNAPPY 0
+// #endif  // !defined(HAVE_SNAPPY)
+
+// // Define to 1 if you have Zstd.
+// #if !defined(HAVE_Zstd)
+// #define HAVE_ZSTD 0
+// #endif  // !defined(HAVE_ZSTD)
+
+#endif
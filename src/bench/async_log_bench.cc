@@ -0,0 +1,120 @@
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "lynx/async_log.hpp"
+#include "main.h"
+#include "spdlog/sinks/daily_file_sink.h"
+#include "spdlog/spdlog.h"
+
+namespace {
+size_t count_lines(const std::string& filename) {
+    std::ifstream in(filename);
+    size_t lines = 0;
+    for (std::string line; std::getline(in, line);) {
+        ++lines;
+    }
+    return lines;
+}
+
+std::string today_filename(const std::string& base) {
+    return spdlog::sinks::daily_filename_calculator::calc_filename(
+        base, spdlog::details::os::localtime(spdlog::log_clock::to_time_t(spdlog::log_clock::now())));
+}
+
+// Per call cost seen by the logging threads, and what reached the file.
+int run(const char* name, const std::string& base, spdlog::sink_ptr sink, size_t threads, size_t iterations,
+        lynx::AsyncFileSink* async, const std::string& message = "request served") {
+    namespace pop = spdlog::populators;
+    sink->set_populators(pop::make_populator_set<pop::date_time, pop::timestamp, pop::level, pop::pid,
+                                                 pop::thread_id, pop::src_loc, pop::message>());
+    auto logger = std::make_shared<spdlog::logger>(name, sink);
+    if (!async) {
+        logger->flush_on(spdlog::level::info);
+    }
+
+    size_t before = bench::allocations();
+    std::vector<double> ns(threads);
+    std::vector<std::thread> producers;
+    for (size_t t = 0; t < threads; ++t) {
+        producers.emplace_back([&, t] {
+            ns[t] = bench::ns_per_op(iterations, [&](size_t i) {
+                logger->info(message, {{"conn_id", i}, {"worker", t}, {"status", 200}});
+            });
+        });
+    }
+    for (auto& p : producers) {
+        p.join();
+    }
+    double allocs = double(bench::allocations() - before) / (threads * iterations);
+    double avg = 0;
+    for (double v : ns) {
+        avg += v / threads;
+    }
+
+    lynx::AsyncLogStats s;
+    if (async) {
+        async->stop_writer();  // drain
+        s = async->stats();
+    }
+    logger.reset();
+    sink.reset();
+
+    size_t total = threads * iterations;
+    size_t lines = count_lines(today_filename(base));
+    std::printf("%-32s %12.1f ns/op %10.2f allocs/op %10zu lines   dropped %llu+%llu blocked %llu\n", name, avg,
+                allocs, lines, static_cast<unsigned long long>(s.dropped_newest),
+                static_cast<unsigned long long>(s.dropped_oldest), static_cast<unsigned long long>(s.blocked));
+    std::remove(today_filename(base).c_str());
+
+    // nothing may get lost or duplicated silently
+    if (lines + s.dropped_newest + s.dropped_oldest + s.write_errors != total) {
+        std::printf("MISMATCH: %zu records logged, %zu lines written\n", total, lines);
+        return 1;
+    }
+    return 0;
+}
+}  // namespace
+
+int async_log_bench(size_t iterations) {
+    const size_t threads = 4;
+    const std::string dir = "/tmp/lynx_bench_async_log/";
+    int ret = 0;
+
+    std::remove(today_filename(dir + "sync.log").c_str());
+    ret |= run("async_log/sync_daily_file", dir + "sync.log",
+               std::make_shared<spdlog::sinks::daily_file_sink_mt>(dir + "sync.log", 0, 0), threads, iterations,
+               nullptr);
+
+    // a ring large enough for the whole run: the cost of the enqueue alone
+    {
+        std::string base = dir + "burst.log";
+        std::remove(today_filename(base).c_str());
+        auto sink = std::make_shared<lynx::AsyncFileSink>(base, threads * iterations, lynx::OverflowPolicy::block, 64);
+        ret |= run("async_log/enqueue_only", base, sink, threads, iterations, sink.get());
+    }
+
+    // a small ring the writer cannot keep up with: the overflow policies
+    const lynx::OverflowPolicy policies[] = {lynx::OverflowPolicy::block, lynx::OverflowPolicy::drop_newest,
+                                             lynx::OverflowPolicy::drop_oldest};
+    for (auto policy : policies) {
+        std::string base = dir + lynx::to_string(policy) + ".log";
+        std::remove(today_filename(base).c_str());
+        auto sink = std::make_shared<lynx::AsyncFileSink>(base, 1024, policy, 64);
+        std::string name = std::string("async_log/") + lynx::to_string(policy);
+        ret |= run(name.c_str(), base, sink, threads, iterations, sink.get());
+    }
+
+    // payloads past the inline capacity of the record buffers: the slots keep
+    // the memory they grew to, only their first use allocates
+    {
+        std::string base = dir + "long.log";
+        std::remove(today_filename(base).c_str());
+        auto sink = std::make_shared<lynx::AsyncFileSink>(base, 1024, lynx::OverflowPolicy::block, 64);
+        ret |= run("async_log/block_1k_payload", base, sink, threads, iterations, sink.get(), std::string(1024, 'x'));
+    }
+    return ret;
+}
@@ -0,0 +1,230 @@
+#include <charconv>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <thread>
+
+#include "cinatra.hpp"
+#include "lynx/compression.hpp"
+#include "lynx/response_cache.hpp"
+#include "main.h"
+
+namespace {
+using asio::ip::tcp;
+
+// Reads one response off a keep-alive connection into buf, body included.
+// Returns the length of the whole response, 0 on error.
+size_t read_response(tcp::socket& s, char* buf, size_t cap, size_t& have) {
+    for (;;) {
+        std::string_view data(buf, have);
+        size_t end = data.find("\r\n\r\n");
+        if (end != std::string_view::npos) {
+            size_t body = 0;
+            size_t pos = data.find("Content-Length: ");
+            if (pos != std::string_view::npos && pos < end) {
+                std::from_chars(buf + pos + 16, buf + end, body);
+            }
+            size_t total = end + 4 + body;
+            if (have >= total) {
+                return total;
+            }
+        }
+        asio::error_code ec;
+        size_t n = s.read_some(asio::buffer(buf + have, cap - have), ec);
+        if (ec || n == 0) {
+            return 0;
+        }
+        have += n;
+    }
+}
+
+// One keep-alive connection sending request over and over: time and heap
+// allocations per request, client and server included (the client does not
+// allocate). With depth > 1 the client pipelines: it sends depth requests in
+// one write, then reads the depth responses. The first requests warm the
+// connection up; after that the server parses into views of its receive
+// buffer and the connection's arena and must not allocate either, unless the
+// route's handler does (allocating).
+int round_trips(const char* name, size_t iterations, unsigned short port, std::string_view request,
+                std::string_view expect, size_t depth = 1, bool allocating = false) {
+    asio::io_context ctx;
+    tcp::socket s(ctx);
+    s.connect(tcp::endpoint(asio::ip::address_v4::loopback(), port));
+    s.set_option(tcp::no_delay(true));
+    static char out[1 << 16];
+    static char buf[1 << 16];
+    for (size_t i = 0; i < depth; ++i) {
+        std::memcpy(out + i * request.size(), request.data(), request.size());
+    }
+    size_t have = 0;
+    bool bad = false;
+    auto once = [&] {
+        asio::write(s, asio::buffer(out, request.size() * depth));
+        for (size_t i = 0; i < depth; ++i) {
+            size_t len = read_response(s, buf, sizeof(buf), have);
+            if (len == 0 || std::string_view(buf, len).find(expect) == std::string_view::npos) {
+                bad = true;
+                return;
+            }
+            std::memmove(buf, buf + len, have - len);
+            have -= len;
+        }
+    };
+    for (size_t i = 0; i < 1000 && !bad; ++i) {
+        once();
+    }
+    iterations = (iterations + depth - 1) / depth;
+    size_t before = bench::allocations();
+    double ns = bench::ns_per_op(iterations, [&](size_t) { once(); }) / double(depth);
+    size_t allocations = bench::allocations() - before;
+    bench::report(name, ns, double(allocations) / double(iterations * depth));
+    if (bad) {
+        std::printf("MISMATCH: %s did not answer %.*s\n", name, static_cast<int>(expect.size()), expect.data());
+        return 1;
+    }
+    if (!allocating && allocations != 0) {
+        std::printf("MISMATCH: %s allocated %zu times on a warm keep-alive connection\n", name, allocations);
+        return 1;
+    }
+    return 0;
+}
+}  // namespace
+
+int http_bench(size_t iterations) {
+    asio::io_context ctx;
+    cinatra::coro_http_server server(ctx, 0, "127.0.0.1");
+    server.set_http_handler<cinatra::GET>(
+        "/plaintext", [](cinatra::coro_http_request&, cinatra::coro_http_response& res) {
+            res.set_status_and_content(cinatra::status_type::ok, "Hello, World!");
+        });
+    server.set_http_handler<cinatra::GET>(
+        "/users/:id", [](cinatra::coro_http_request& req, cinatra::coro_http_response& res) {
+            res.set_status_and_content_view(cinatra::status_type::ok, req.params_["id"]);
+        });
+    server.set_http_handler<cinatra::GET>(
+        "/search", [](cinatra::coro_http_request& req, cinatra::coro_http_response& res) {
+            res.set_status_and_content_view(cinatra::status_type::ok, req.get_query_value("q"));
+        });
+    server.set_http_handler<cinatra::POST>(
+        "/echo", [](cinatra::coro_http_request& req, cinatra::coro_http_response& res) {
+            res.set_status_and_content_view(cinatra::status_type::ok, req.get_body());
+        });
+    // /cached goes through lynx's response cache: after the first request
+    // every hit is replayed without running the handler
+    lynx::RouteCache cache;
+    lynx::CacheRouteOptions cache_options;
+    cache_options.ttl_ms = 3600 * 1000;
+    cache_options.vary = {"Accept"};
+    cache.configure(cache_options);
+    // /json is 16KB of json sent gzip: the cached variant (/json/cached, as
+    // lynx serves cached responses and static files) or compressed on every
+    // request
+    lynx::CompressionOptions compression;
+    compression.offload_min = 1 << 20;
+    lynx::Compressor compressor(compression);
+    lynx::RouteCache json_cache;
+    json_cache.configure(cache_options);
+    std::string json = "[";
+    while (json.size() < (16 << 10)) {
+        json += "{\"id\":" + std::to_string(json.size()) + ",\"name\":\"lynx\",\"tags\":[\"a\",\"b\"]},";
+    }
+    json += "{}]";
+    server.set_static_router(
+        [&](std::string_view key, cinatra::coro_http_request& req, cinatra::coro_http_response& res) {
+            using cinatra::coro_http_router;
+            auto encoding = compressor.negotiate(req.get_accept_encoding());
+            if (key == "GET /json") {
+                res.add_header("Content-Type", "application/json");
+                if (auto variant = compressor.compress({}, json, encoding)) {
+                    res.add_header("Content-Encoding", std::string(lynx::to_string(encoding)));
+                    res.set_status_and_content(cinatra::status_type::ok, variant->body);
+                } else {
+                    res.set_status_and_content_view(cinatra::status_type::ok, std::string_view(json));
+                }
+                return coro_http_router::static_route::served;
+            }
+            if (key == "GET /json/cached") {
+                lynx::RouteCache::Entry entry;
+                std::string_view cache_key;
+                if (json_cache.find(req, entry, cache_key) != lynx::RouteCache::Lookup::hit) {
+                    res.add_header("Content-Type", "application/json");
+                    res.set_status_and_content_view(cinatra::status_type::ok, std::string_view(json));
+                    entry = json_cache.make_entry(res);
+                    json_cache.fill(std::string(cache_key), entry);
+                }
+                auto status = static_cast<cinatra::status_type>(entry->status);
+                if (auto variant = compressor.cached(entry, entry->head, entry->body, entry->hash, encoding)) {
+                    res.set_prepared(status, variant->head, variant->body, variant);
+                } else {
+                    res.set_prepared(status, entry->head, entry->body, entry);
+                }
+                return coro_http_router::static_route::served;
+            }
+            if (key != "GET /cached") {
+                return coro_http_router::static_route::not_found;
+            }
+            lynx::RouteCache::Entry entry;
+            std::string_view cache_key;
+            if (cache.find(req, entry, cache_key) == lynx::RouteCache::Lookup::hit) {
+                res.set_prepared(static_cast<cinatra::status_type>(entry->status), entry->head, entry->body, entry);
+            } else {
+                res.set_status_and_content(cinatra::status_type::ok, std::string(512, 'x'));
+                cache.fill(std::string(cache_key), cache.make_entry(res));
+            }
+            return coro_http_router::static_route::served;
+        });
+    auto started = server.async_start();
+    std::thread io([&] { ctx.run(); });
+    if (started.hasResult() && started.value()) {
+        std::printf("MISMATCH: listen failed: %s\n", started.value().message().c_str());
+        ctx.stop();
+        io.join();
+        return 1;
+    }
+
+    int ret = 0;
+    unsigned short port = server.port();
+    ret |= round_trips("http/get_plaintext", iterations, port,
+                       "GET /plaintext HTTP/1.1\r\nHost: bench\r\nUser-Agent: lynx-bench\r\nAccept: */*\r\n\r\n",
+                       "Hello, World!");
+    ret |= round_trips("http/get_radix_param", iterations, port,
+                       "GET /users/4711 HTTP/1.1\r\nHost: bench\r\nAccept: */*\r\n\r\n", "4711");
+    ret |= round_trips("http/get_radix_encoded", iterations, port,
+                       "GET /users/lynx%20bench HTTP/1.1\r\nHost: bench\r\nAccept: */*\r\n\r\n", "lynx%20bench");
+    ret |= round_trips("http/get_query", iterations, port,
+                       "GET /search?q=lynx&page=2 HTTP/1.1\r\nHost: bench\r\nAccept: */*\r\n\r\n", "lynx");
+    ret |= round_trips("http/post_small_body", iterations, port,
+                       "POST /echo HTTP/1.1\r\nHost: bench\r\nContent-Type: text/plain\r\nContent-Length: "
+                       "32\r\n\r\n0123456789abcdef0123456789abcdef",
+                       "0123456789abcdef0123456789abcdef");
+    ret |= round_trips("http/pipelined16_plaintext", iterations, port,
+                       "GET /plaintext HTTP/1.1\r\nHost: bench\r\nUser-Agent: lynx-bench\r\nAccept: */*\r\n\r\n",
+                       "Hello, World!", 16);
+    ret |= round_trips("http/pipelined16_radix_param", iterations, port,
+                       "GET /users/4711 HTTP/1.1\r\nHost: bench\r\nAccept: */*\r\n\r\n", "4711", 16);
+    ret |= round_trips("http/pipelined16_post_small_body", iterations, port,
+                       "POST /echo HTTP/1.1\r\nHost: bench\r\nContent-Type: text/plain\r\nContent-Length: "
+                       "32\r\n\r\n0123456789abcdef0123456789abcdef",
+                       "0123456789abcdef0123456789abcdef", 16);
+    ret |= round_trips("http/get_cached_512b", iterations, port,
+                       "GET /cached HTTP/1.1\r\nHost: bench\r\nAccept: */*\r\n\r\n", "xxxxxxxx");
+    ret |= round_trips("http/get_json_16k_gzip_per_request", iterations, port,
+                       "GET /json HTTP/1.1\r\nHost: bench\r\nAccept-Encoding: gzip\r\n\r\n",
+                       "Content-Encoding: gzip", 1, true);
+    ret |= round_trips("http/get_json_16k_gzip_cached", iterations, port,
+                       "GET /json/cached HTTP/1.1\r\nHost: bench\r\nAccept-Encoding: gzip\r\n\r\n",
+                       "Content-Encoding: gzip");
+    ret |= round_trips("http/get_json_16k_identity", iterations, port,
+                       "GET /json/cached HTTP/1.1\r\nHost: bench\r\nAccept-Encoding: identity\r\n\r\n",
+                       "Content-Length: 16");
+    if (cache.stats().misses != 1) {
+        std::printf("MISMATCH: /cached ran its handler %llu times\n",
+                    static_cast<unsigned long long>(cache.stats().misses));
+        ret = 1;
+    }
+
+    server.stop();
+    ctx.stop();
+    io.join();
+    return ret;
+}
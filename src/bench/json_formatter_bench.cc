@@ -0,0 +1,130 @@
+#include <string>
+#include <vector>
+
+#include "main.h"
+#include "spdlog/json_formatter.h"
+#include "spdlog/pattern_formatter.h"
+#include "spdlog/spdlog.h"
+
+namespace {
+// The formatter as it was before the streaming writer: a nlohmann::json DOM
+// per record, filled by the lynx populator set and dumped into a temporary.
+class dom_json_formatter {
+  public:
+    dom_json_formatter() {
+        add("date_time", "%Y-%m-%d %H:%M:%S.%e%z");
+        add("level", "%l");
+        add("src_loc", "%@");
+        add("message", "%v");
+    }
+
+    void format(const spdlog::details::log_msg& msg, spdlog::memory_buf_t& dest) {
+        nlohmann::json entry = nlohmann::json::object();
+        for (auto& p : patterns_) {
+            spdlog::memory_buf_t tmp;
+            p.second->format(msg, tmp);
+            entry[p.first] = std::string(tmp.data(), tmp.size());
+        }
+        entry["pid"] = spdlog::details::os::pid();
+        entry["thread_id"] = msg.thread_id;
+        entry["timestamp"] = std::chrono::duration_cast<std::chrono::seconds>(msg.time.time_since_epoch()).count();
+        if (msg.params) {
+            for (const auto& kv : msg.params->items()) {
+                entry[kv.key()] = kv.value();
+            }
+        }
+        std::string eol = spdlog::details::os::default_eol;
+        dest.append(entry.dump() + eol);
+    }
+
+  private:
+    void add(const std::string& key, const std::string& pattern) {
+        patterns_.emplace_back(key, std::make_unique<spdlog::pattern_formatter>(pattern, spdlog::pattern_time_type::local, ""));
+    }
+
+    std::vector<std::pair<std::string, std::unique_ptr<spdlog::formatter>>> patterns_;
+};
+
+std::unique_ptr<spdlog::json_formatter> make_streaming_formatter() {
+    return spdlog::details::make_unique<spdlog::json_formatter>(spdlog::populators::make_populator_set(
+        spdlog::details::make_unique<spdlog::populators::date_time_populator>(),
+        spdlog::details::make_unique<spdlog::populators::level_populator>(),
+        spdlog::details::make_unique<spdlog::populators::thread_id_populator>(),
+        spdlog::details::make_unique<spdlog::populators::src_loc_populator>(),
+        spdlog::details::make_unique<spdlog::populators::pid_populator>(),
+        spdlog::details::make_unique<spdlog::populators::timestamp_populator>(),
+        spdlog::details::make_unique<spdlog::populators::message_populator>()));
+}
+
+namespace pop = spdlog::populators;
+using static_formatter = spdlog::static_json_formatter<pop::date_time, pop::timestamp, pop::level, pop::pid,
+                                                       pop::thread_id, pop::src_loc, pop::message>;
+}  // namespace
+
+int json_formatter_bench(size_t iterations) {
+    dom_json_formatter dom;
+    auto streaming = make_streaming_formatter();
+    static_formatter pipeline;
+
+    const nlohmann::json params = {{"conn_id", 42}, {"peer", "10.0.0.1:5000"}, {"ratio", 0.25}, {"ok", true}};
+    const nlohmann::json tricky = {{"message", "override"}, {"nested", {{"a", {1, 2.5, nullptr}}}}, {"q\"k", "\t\x01"}};
+    const char* payloads[] = {
+        "Global logger initialized successfully",
+        "quote \" backslash \\ tab \t newline \n bell \x07 del \x7f",
+        "utf-8: \xe4\xbd\xa0\xe5\xa5\xbd \xf0\x9f\x98\x80",
+        "",
+    };
+
+    // byte identical output first
+    int ret = 0;
+    for (const char* payload : payloads) {
+        for (const nlohmann::json* p : {static_cast<const nlohmann::json*>(nullptr), &params, &tricky}) {
+            spdlog::details::log_msg msg(spdlog::source_loc{"lynx/main.cpp", 42, "main"}, "default_sink", spdlog::level::info, payload);
+            msg.params = p;
+            spdlog::memory_buf_t a, b, c;
+            dom.format(msg, a);
+            streaming->format(msg, b);
+            pipeline.format(msg, c);
+            if (std::string(a.data(), a.size()) != std::string(b.data(), b.size())) {
+                std::printf("MISMATCH\n  dom:       %.*s  streaming: %.*s", static_cast<int>(a.size()), a.data(),
+                            static_cast<int>(b.size()), b.data());
+                ret = 1;
+            }
+            // the pipeline keeps its own field order, compare the parsed records
+            if (nlohmann::json::parse(a.data(), a.data() + a.size()) != nlohmann::json::parse(c.data(), c.data() + c.size())) {
+                std::printf("MISMATCH\n  dom:       %.*s  pipeline:  %.*s", static_cast<int>(a.size()), a.data(),
+                            static_cast<int>(c.size()), c.data());
+                ret = 1;
+            }
+        }
+    }
+
+    spdlog::details::log_msg msg(spdlog::source_loc{"lynx/main.cpp", 42, "main"}, "default_sink", spdlog::level::info,
+                                 "Steady Timer expired!");
+    msg.params = &params;
+    spdlog::memory_buf_t dest;
+
+    size_t before = bench::allocations();
+    double ns = bench::ns_per_op(iterations, [&](size_t) {
+        dest.clear();
+        dom.format(msg, dest);
+    });
+    bench::report("json_formatter/nlohmann_dom", ns, double(bench::allocations() - before) / iterations);
+
+    streaming->format(msg, dest);  // warm up the writer buffers
+    before = bench::allocations();
+    ns = bench::ns_per_op(iterations, [&](size_t) {
+        dest.clear();
+        streaming->format(msg, dest);
+    });
+    bench::report("json_formatter/streaming", ns, double(bench::allocations() - before) / iterations);
+
+    pipeline.format(msg, dest);
+    before = bench::allocations();
+    ns = bench::ns_per_op(iterations, [&](size_t) {
+        dest.clear();
+        pipeline.format(msg, dest);
+    });
+    bench::report("json_formatter/static_pipeline", ns, double(bench::allocations() - before) / iterations);
+    return ret;
+}
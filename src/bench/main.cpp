@@ -0,0 +1,58 @@
+#include "main.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+#include "CLI11.hpp"
+
+namespace {
+std::atomic<size_t> g_allocations{0};
+}
+
+// Count every allocation of the process, so benchmarks can check for a
+// steady state without heap traffic.
+void* operator new(std::size_t size) {
+    g_allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(size ? size : 1)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+
+size_t bench::allocations() { return g_allocations.load(std::memory_order_relaxed); }
+
+int main(int argc, char** argv) {
+    CLI::App app("Lynx micro benchmarks");
+    size_t iterations = 200000;
+    app.add_option("-n,--iterations", iterations, "Iterations per measurement");
+    app.require_subcommand(1);
+
+    int ret = 0;
+    app.add_subcommand("json_formatter", "JSON log formatting: nlohmann DOM, streaming writer and static pipeline")
+        ->callback([&] { ret = json_formatter_bench(iterations); });
+    app.add_subcommand("structured_log", "Structured logging: nlohmann params against zero-copy fields")
+        ->callback([&] { ret = structured_log_bench(iterations); });
+    app.add_subcommand("async_log", "lynx file logging: synchronous daily sink against the async ring per overflow policy")
+        ->callback([&] { ret = async_log_bench(iterations); });
+    app.add_subcommand("udp", "lynx UDP engine on loopback: packets per second per batch size, echo round trip")
+        ->callback([&] { ret = udp_bench(iterations); });
+    app.add_subcommand("route", "REST dispatch: cinatra regex and radix tree against the compile time route table")
+        ->callback([&] { ret = route_bench(iterations); });
+    app.add_subcommand("http", "cinatra keep-alive round trips on loopback: time and heap allocations per request")
+        ->callback([&] { ret = http_bench(iterations); });
+    app.add_subcommand("pubsub", "lynx pub/sub fan-out: a copy per subscriber against one shared frame")
+        ->callback([&] { ret = pubsub_bench(iterations); });
+    app.add_subcommand("tcp", "lynx TCP framing: read_until with substr/erase against the ring buffer, msg/s")
+        ->callback([&] { ret = tcp_bench(iterations); });
+    app.add_subcommand("timer", "Idle timers, 5 per iteration: asio steady_timer heap against the lynx timer wheel")
+        ->callback([&] { ret = timer_bench(iterations); });
+    app.add_subcommand("repl", "Telnet management plane: hello_everysession to 100 sessions, data plane round trips")
+        ->callback([&] { ret = repl_bench(iterations); });
+
+    CLI11_PARSE(app, argc, argv);
+    return ret;
+}
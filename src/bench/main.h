@@ -0,0 +1,37 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+
+// Micro benchmarks, one function per subsystem. Each returns 0 on success and
+// non zero when a correctness check inside the benchmark failed.
+int json_formatter_bench(size_t iterations);
+int structured_log_bench(size_t iterations);
+int async_log_bench(size_t iterations);
+int udp_bench(size_t iterations);
+int route_bench(size_t iterations);
+int http_bench(size_t iterations);
+int pubsub_bench(size_t iterations);
+int tcp_bench(size_t iterations);
+int timer_bench(size_t iterations);
+int repl_bench(size_t iterations);
+
+namespace bench {
+// Number of global operator new calls made by this process so far.
+size_t allocations();
+
+template <typename F>
+double ns_per_op(size_t iterations, F&& f) {
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < iterations; ++i) {
+        f(i);
+    }
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    return std::chrono::duration<double, std::nano>(elapsed).count() / static_cast<double>(iterations);
+}
+
+inline void report(const char* name, double ns, double allocs) {
+    std::printf("%-32s %12.1f ns/op %10.2f allocs/op\n", name, ns, allocs);
+}
+}  // namespace bench
@@ -0,0 +1,179 @@
+#include <algorithm>
+#include <cstdio>
+#include <deque>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "lynx/pubsub.hpp"
+#include "main.h"
+
+namespace {
+constexpr size_t kMessage = 256;
+constexpr size_t kDrainEvery = 16;  // messages a writer finds queued at once
+
+// asio_demo2's chat_room: every participant copies the message into its own
+// write queue.
+int copy_per_subscriber(size_t subscribers, size_t messages) {
+    std::vector<std::deque<std::string>> queues(subscribers);
+    std::string message(kMessage, 'x');
+    size_t before = bench::allocations();
+    double ns = bench::ns_per_op(messages, [&](size_t i) {
+        for (auto& queue : queues) {
+            queue.push_back(message);
+        }
+        if ((i + 1) % kDrainEvery == 0) {
+            for (auto& queue : queues) {
+                queue.clear();
+            }
+        }
+    });
+    char name[64];
+    std::snprintf(name, sizeof(name), "copy_per_subscriber_%zuk", subscribers / 1000);
+    bench::report(name, ns, static_cast<double>(bench::allocations() - before) / messages);
+    return 0;
+}
+
+// lynx::PubSubHub: one frame per message, a pointer pushed per subscriber.
+// The writers are stood in for by take(), every kDrainEvery messages.
+int shared_frame(size_t subscribers, size_t messages) {
+    lynx::PubSubHub hub(lynx::PubSubOptions{});
+    std::vector<std::shared_ptr<lynx::Subscriber>> all;
+    all.reserve(subscribers);
+    for (size_t i = 0; i < subscribers; ++i) {
+        all.push_back(hub.make_subscriber());
+        hub.subscribe(all.back(), "ticks");
+    }
+    std::string message(kMessage, 'x');
+    std::vector<lynx::Frame> batch;
+    size_t queued = 0;
+    auto publish = [&](size_t i) {
+        queued += hub.publish("ticks", message);
+        if ((i + 1) % kDrainEvery == 0) {
+            for (auto& subscriber : all) {
+                subscriber->take(batch);
+                batch.clear();
+            }
+        }
+    };
+    // the queues grow to kDrainEvery frames once
+    for (size_t i = 0; i < kDrainEvery; ++i) {
+        publish(i);
+    }
+    queued = 0;
+    size_t before = bench::allocations();
+    double ns = bench::ns_per_op(messages, publish);
+    char name[64];
+    std::snprintf(name, sizeof(name), "shared_frame_%zuk", subscribers / 1000);
+    bench::report(name, ns, static_cast<double>(bench::allocations() - before) / messages);
+    if (queued != subscribers * messages || hub.stats().dropped != 0) {
+        std::fprintf(stderr, "%s: %zu frames queued, expected %zu\n", name, queued, subscribers * messages);
+        return 1;
+    }
+    return 0;
+}
+// A client resuming from sequence id 0 on a channel whose history is full:
+// the frames it gets are those the history holds, no payload is copied.
+int replay_history(size_t history, size_t iterations) {
+    lynx::PubSubOptions options;
+    options.history = history;
+    options.history_bytes = history * (kMessage + 64);
+    lynx::PubSubHub hub(options);
+    std::string message(kMessage, 'x');
+    for (size_t i = 0; i < history; ++i) {
+        hub.publish("ticks", message);
+    }
+    auto subscriber = hub.make_subscriber();
+    std::vector<lynx::Frame> batch;
+    size_t replayed = 0;
+    size_t before = bench::allocations();
+    double ns = bench::ns_per_op(iterations, [&](size_t) {
+        hub.subscribe(subscriber, "ticks", 0);
+        subscriber->take(batch);
+        replayed += batch.size() - 1;  // the first one is the ok
+        batch.clear();
+        hub.unsubscribe(subscriber, "ticks");
+    });
+    char name[64];
+    std::snprintf(name, sizeof(name), "replay_history_%zu", history);
+    bench::report(name, ns, static_cast<double>(bench::allocations() - before) / iterations);
+    if (replayed != history * iterations) {
+        std::fprintf(stderr, "%s: %zu frames replayed, expected %zu\n", name, replayed, history * iterations);
+        return 1;
+    }
+    return 0;
+}
+
+// Publishes to channel names never seen, the hub full of channels with
+// history only: each evicts the least recently published one. A subscriber
+// then still gets its channel, and publishing keeps a channel alive.
+int channel_cap(size_t max_channels, size_t iterations) {
+    lynx::PubSubOptions options;
+    options.max_channels = max_channels;
+    options.history = 4;
+    lynx::PubSubHub hub(options);
+    for (size_t i = 0; i < max_channels; ++i) {
+        hub.publish("c" + std::to_string(i), "x");
+    }
+    auto subscriber = hub.make_subscriber();
+    bool subscribed = hub.subscribe(subscriber, "fresh");  // evicts c0
+    hub.publish("c1", "x");                                // c2 is the oldest now
+    std::vector<std::string> names;
+    for (size_t i = 0; i < iterations; ++i) {
+        names.push_back("n" + std::to_string(i));
+    }
+    size_t before = bench::allocations();
+    double ns = bench::ns_per_op(iterations, [&](size_t i) {
+        hub.publish(names[i], "x");
+        hub.publish("c1", "x");
+    });
+    char name[64];
+    std::snprintf(name, sizeof(name), "channel_cap_%zu", max_channels);
+    bench::report(name, ns, static_cast<double>(bench::allocations() - before) / iterations);
+    std::vector<lynx::Frame> batch;
+    subscriber->take(batch);
+    size_t fresh = batch.size();
+    batch.clear();
+    hub.publish("fresh", "x");
+    subscriber->take(batch);
+    auto stats = hub.stats();
+    auto resumed = hub.make_subscriber();
+    hub.subscribe(resumed, "c1", 0);
+    std::vector<lynx::Frame> history;
+    resumed->take(history);
+    if (!subscribed || fresh != 1 || batch.size() != 1 || stats.channels != max_channels ||
+        stats.evicted != iterations + 1 || history.size() != 1 + options.history) {
+        std::fprintf(stderr, "%s: subscribed %d, %zu channels, %lu evicted, %zu frames of c1 kept\n", name,
+                     subscribed, stats.channels, static_cast<unsigned long>(stats.evicted), history.size() - 1);
+        return 1;
+    }
+    // channels with subscribers are never evicted
+    lynx::PubSubHub busy(options);
+    auto client = busy.make_subscriber();
+    for (size_t i = 0; i < max_channels; ++i) {
+        busy.subscribe(client, "c" + std::to_string(i));
+    }
+    if (busy.subscribe(client, "fresh") || busy.publish("fresh", "x") != 0 || busy.stats().channels != max_channels) {
+        std::fprintf(stderr, "%s: a channel with subscribers was evicted\n", name);
+        return 1;
+    }
+    return 0;
+}
+}  // namespace
+
+// Fan-out of one 256 byte message to every subscriber of a channel, per
+// message, replay of a channel's history, per resuming client, and
+// publishing to a new channel when max_channels are in use.
+int pubsub_bench(size_t iterations) {
+    int ret = 0;
+    for (size_t subscribers : {1000, 50000}) {
+        // a fan-out to 50k costs as much as 50k small operations
+        size_t messages = std::max<size_t>(iterations * 10 / subscribers, kDrainEvery);
+        messages -= messages % kDrainEvery;
+        ret |= copy_per_subscriber(subscribers, messages);
+        ret |= shared_frame(subscribers, messages);
+    }
+    ret |= replay_history(256, std::max<size_t>(iterations / 100, 1));
+    ret |= channel_cap(4096, iterations);
+    return ret;
+}
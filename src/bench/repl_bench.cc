@@ -0,0 +1,263 @@
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "asio.hpp"
+#include "cli/cli.h"
+#include "cli/standaloneasioremotecli.h"
+#include "cli/standaloneasioscheduler.h"
+#include "main.h"
+
+namespace {
+using tcp = asio::ip::tcp;
+using clock_type = std::chrono::steady_clock;
+constexpr size_t kSessions = 100;
+const std::string kHello = "Hello, everybody";  // hello_everysession, "\r\n" on the wire
+
+unsigned short free_port() {
+    asio::io_context ctx;
+    tcp::acceptor acceptor(ctx, tcp::endpoint(asio::ip::address_v4::loopback(), 0));
+    return acceptor.local_endpoint().port();
+}
+
+// An operator's telnet client: reads whatever comes, counts the bytes.
+struct Client {
+    explicit Client(asio::io_context& ctx) : socket(ctx) {}
+
+    void read() {
+        socket.async_read_some(asio::buffer(buffer), [this](const asio::error_code& ec, size_t n) {
+            if (!ec) {
+                received += n;
+                read();
+            }
+        });
+    }
+
+    tcp::socket socket;
+    std::array<char, 4096> buffer;
+    size_t received{0};
+};
+
+// kSessions operators connected to the telnet server of a REPL on ctx
+struct Operators {
+    explicit Operators(asio::io_context& ctx)
+        : port(free_port()), cli(std::make_unique<cli::Menu>("cli")), scheduler(ctx), server(cli, scheduler, port) {
+        for (size_t i = 0; i < kSessions; ++i) {
+            clients.push_back(std::make_unique<Client>(ctx));
+            clients.back()->socket.connect(tcp::endpoint(asio::ip::address_v4::loopback(), port));
+            clients.back()->read();
+        }
+        // the negotiation and the prompts
+        ctx.run_for(std::chrono::milliseconds(300));
+        for (auto& c : clients) {
+            c->received = 0;
+        }
+    }
+
+    size_t received() const {
+        size_t total = 0;
+        for (const auto& c : clients) {
+            total += c->received;
+        }
+        return total;
+    }
+
+    unsigned short port;
+    cli::Cli cli;
+    cli::StandaloneAsioScheduler scheduler;
+    cli::StandaloneAsioCliTelnetServer server;
+    std::vector<std::unique_ptr<Client>> clients;
+};
+
+// hello_everysession with kSessions sessions: the command's cost on the REPL
+// thread, the writes to every session included.
+int broadcast(size_t n) {
+    asio::io_context ctx;
+    Operators operators(ctx);
+    const size_t expected = n * kSessions * (kHello.size() + 2);
+
+    size_t before = bench::allocations();
+    auto start = clock_type::now();
+    for (size_t i = 0; i < n; ++i) {
+        cli::Cli::cout() << kHello << std::endl;
+        ctx.poll();
+    }
+    while (operators.received() < expected && ctx.run_one_for(std::chrono::seconds(1)) > 0) {
+    }
+    double ns = std::chrono::duration<double, std::nano>(clock_type::now() - start).count() / double(n);
+    bench::report("hello_everysession_100", ns, static_cast<double>(bench::allocations() - before) / double(n));
+    if (operators.received() != expected) {
+        std::fprintf(stderr, "hello_everysession_100: %zu bytes received, expected %zu\n", operators.received(),
+                     expected);
+        return 1;
+    }
+    return 0;
+}
+
+// A session's output that takes broadcasts by reference: counts them.
+struct CountingSink : std::streambuf, cli::BroadcastSink {
+    void Send(const cli::Broadcast& b) override { bytes += b.Text()->size(); }
+
+    std::atomic<size_t> bytes{0};
+};
+
+// Lines of "tick <n>" written to Cli::cout() by `writers` threads, to 8
+// subscribers, while another thread registers and unregisters a 9th.
+int cout_lines(size_t n, size_t writers) {
+    constexpr size_t kSubscribers = 8;
+    std::array<CountingSink, kSubscribers> sinks;
+    std::vector<std::unique_ptr<std::ostream>> outs;
+    for (auto& sink : sinks) {
+        outs.push_back(std::make_unique<std::ostream>(&sink));
+        cli::Cli::cout().Register(*outs.back());
+    }
+    std::atomic<bool> done{false};
+    std::thread churn([&] {
+        CountingSink sink;
+        std::ostream out(&sink);
+        while (!done) {
+            cli::Cli::cout().Register(out);
+            cli::Cli::cout().UnRegister(out);
+            std::this_thread::yield();
+        }
+    });
+
+    const size_t per_writer = n / writers;
+    size_t expected = 0;
+    for (size_t i = 0; i < per_writer; ++i) {
+        expected += std::to_string(i).size() + 6;
+    }
+    expected *= writers;
+
+    size_t before = bench::allocations();
+    auto start = clock_type::now();
+    std::vector<std::thread> threads;
+    for (size_t w = 0; w < writers; ++w) {
+        threads.emplace_back([per_writer] {
+            for (size_t i = 0; i < per_writer; ++i) {
+                cli::Cli::cout() << "tick " << i << '\n';
+            }
+            cli::Cli::cout() << std::flush;
+        });
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+    const size_t lines = per_writer * writers;
+    double ns = std::chrono::duration<double, std::nano>(clock_type::now() - start).count() / double(lines);
+    double allocs = static_cast<double>(bench::allocations() - before) / double(lines);
+    done = true;
+    churn.join();
+    for (auto& out : outs) {
+        cli::Cli::cout().UnRegister(*out);
+    }
+
+    const std::string name = "cout_line_8_subscribers/" + std::to_string(writers) + "_threads";
+    bench::report(name.c_str(), ns, allocs);
+    for (const auto& sink : sinks) {
+        if (sink.bytes != expected) {
+            std::fprintf(stderr, "%s: %zu bytes received, expected %zu\n", name.c_str(), sink.bytes.load(), expected);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Round trips of 64 bytes to an echo server on a data plane thread, while
+// the REPL thread is idle or broadcasts to kSessions sessions 1000 times a second.
+std::vector<double> echo_round_trips(size_t n) {
+    asio::io_context data;
+    tcp::acceptor acceptor(data, tcp::endpoint(asio::ip::address_v4::loopback(), 0));
+    tcp::socket peer(data);
+    std::array<char, 64> echo;
+    std::function<void()> serve = [&] {
+        asio::async_read(peer, asio::buffer(echo), [&](const asio::error_code& ec, size_t) {
+            if (!ec) {
+                asio::async_write(peer, asio::buffer(echo), [&](const asio::error_code& ec, size_t) {
+                    if (!ec) {
+                        serve();
+                    }
+                });
+            }
+        });
+    };
+    acceptor.async_accept(peer, [&](const asio::error_code& ec) {
+        if (!ec) {
+            peer.set_option(tcp::no_delay(true));
+            serve();
+        }
+    });
+    std::thread data_plane([&] { data.run(); });
+
+    asio::io_context ctx;
+    tcp::socket client(ctx);
+    client.connect(acceptor.local_endpoint());
+    client.set_option(tcp::no_delay(true));
+    std::array<char, 64> ping{};
+    std::vector<double> rtt(n);
+    for (size_t i = 0; i < n; ++i) {
+        auto start = clock_type::now();
+        asio::write(client, asio::buffer(ping));
+        asio::read(client, asio::buffer(ping));
+        rtt[i] = std::chrono::duration<double, std::micro>(clock_type::now() - start).count();
+    }
+    client.close();
+    data_plane.join();
+    std::sort(rtt.begin(), rtt.end());
+    return rtt;
+}
+
+void report_rtt(const char* name, const std::vector<double>& rtt) {
+    std::printf("%-32s %9.1f us p50 %9.1f us p99\n", name, rtt[rtt.size() / 2], rtt[rtt.size() * 99 / 100]);
+}
+
+int data_plane(size_t n) {
+    report_rtt("data_plane_rtt/repl_idle", echo_round_trips(n));
+
+    asio::io_context ctx;
+    Operators operators(ctx);
+    std::atomic<bool> done{false};
+    size_t broadcasts = 0;
+    std::thread repl([&] {
+        asio::steady_timer tick(ctx);
+        std::function<void()> next = [&] {
+            tick.expires_after(std::chrono::milliseconds(1));
+            tick.async_wait([&](const asio::error_code& ec) {
+                if (ec || done) {
+                    return;
+                }
+                cli::Cli::cout() << kHello << std::endl;
+                ++broadcasts;
+                next();
+            });
+        };
+        next();
+        while (!done) {
+            ctx.run_for(std::chrono::milliseconds(10));
+        }
+    });
+    report_rtt("data_plane_rtt/hello_100_at_1khz", echo_round_trips(n));
+    done = true;
+    repl.join();
+    std::printf("%-32s %12zu broadcasts\n", "", broadcasts);
+    return 0;
+}
+}  // namespace
+
+// The telnet management plane: hello_everysession to 100 operator sessions,
+// and what it does to the round trips of a data plane thread meanwhile.
+int repl_bench(size_t iterations) {
+    int ret = 0;
+    ret |= cout_lines(std::max<size_t>(iterations, 1000), 1);
+    ret |= cout_lines(std::max<size_t>(iterations, 1000), 4);
+    ret |= broadcast(std::max<size_t>(iterations / 100, 100));
+    ret |= data_plane(std::max<size_t>(iterations / 10, 1000));
+    return ret;
+}
@@ -0,0 +1,108 @@
+#include <functional>
+#include <regex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+#include "cinatra/coro_http_arena.hpp"
+#include "cinatra/coro_radix_tree.hpp"
+#include "lynx/route_table.hpp"
+#include "main.h"
+
+namespace {
+using Handler = int (*)(const lynx::RouteParams&);
+
+int health(const lynx::RouteParams&) { return 1; }
+int numbers(const lynx::RouteParams& p) { return static_cast<int>(p[0].size() + p[1].size()); }
+int string_test(const lynx::RouteParams& p) { return static_cast<int>(p.get("name").size()); }
+
+constexpr std::pair<frozen::string, Handler> kExact[] = {
+    {"GET /health", health},
+    {"GET /version", health},
+    {"GET /metrics", health},
+};
+constexpr lynx::RouteTable<Handler, std::size(kExact), 2> kRoutes(
+    kExact, {{
+                {"GET", "/numbers/{a:int}/test/{b:int}", numbers},
+                {"GET", "/string/{id}/test/{name}", string_test},
+            }});
+
+using cinatra_handler = std::function<void(cinatra::coro_http_request&, cinatra::coro_http_response&)>;
+
+// each case cycles through a few keys so the lookup cannot be hoisted out of the loop
+template <typename F>
+int run(const char* name, size_t iterations, F&& f) {
+    size_t before = bench::allocations();
+    int sink = 0;
+    double ns = bench::ns_per_op(iterations, [&](size_t i) { sink += f(i % 4); });
+    bench::report(name, ns, double(bench::allocations() - before) / double(iterations));
+    return sink;
+}
+}  // namespace
+
+int route_bench(size_t iterations) {
+    int ret = 0;
+    const std::string_view exact_keys[] = {"GET /metrics", "GET /health", "GET /version", "GET /metrics"};
+    const std::string_view numbers_keys[] = {"GET /numbers/123/test/456", "GET /numbers/7/test/8",
+                                             "GET /numbers/65536/test/1", "GET /numbers/42/test/4242"};
+    const std::string_view string_keys[] = {"GET /string/42/test/alice", "GET /string/x/test/bob",
+                                            "GET /string/abc/test/carol", "GET /string/9/test/d"};
+
+    // exact path: cinatra's unordered_map of string_view against the frozen perfect hash
+    std::unordered_map<std::string_view, cinatra_handler> map_handles;
+    for (const auto& [key, _] : kExact) {
+        map_handles.emplace(std::string_view(key.data(), key.size()), [](auto&, auto&) {});
+    }
+    run("route/exact_unordered_map", iterations,
+        [&](size_t k) { return map_handles.find(exact_keys[k]) != map_handles.end() ? 1 : 0; });
+    run("route/exact_frozen", iterations, [&](size_t k) {
+        lynx::RouteParams params;
+        return kRoutes.find(exact_keys[k], params) != nullptr ? 1 : 0;
+    });
+
+    // digits: cinatra copies the key and runs std::regex_match on it
+    std::regex numbers_re(R"(GET /numbers/(\d+)/test/(\d+))");
+    int regex_hits = run("route/numbers_regex", iterations, [&](size_t k) {
+        std::string regex_key{numbers_keys[k]};
+        std::smatch matches;
+        return std::regex_match(regex_key, matches, numbers_re) ? static_cast<int>(matches[1].length()) : 0;
+    });
+    int static_hits = run("route/numbers_static", iterations, [&](size_t k) {
+        lynx::RouteParams params;
+        Handler h = kRoutes.find(numbers_keys[k], params);
+        return h != nullptr && params.size() == 2 ? static_cast<int>(params[0].size()) : 0;
+    });
+    if (regex_hits != static_hits) {
+        std::printf("MISMATCH: numbers route, regex %d static %d\n", regex_hits, static_hits);
+        ret = 1;
+    }
+
+    // named segments: cinatra walks its radix tree, params land in the connection's arena
+    cinatra::radix_tree tree;
+    tree.insert("GET /string/:id/test/:name", [](auto&, auto&) {}, "GET");
+    cinatra::request_arena arena;
+    int radix_hits = run("route/string_radix_tree", iterations, [&](size_t k) {
+        cinatra::route_params params;
+        params.reset(arena.allocate_array<cinatra::route_params::value_type>(tree.max_params()), tree.max_params());
+        auto [found, handler] = tree.get(string_keys[k], "GET", params);
+        arena.reset();
+        return found ? static_cast<int>(params["name"].size()) : 0;
+    });
+    static_hits = run("route/string_static", iterations, [&](size_t k) {
+        lynx::RouteParams params;
+        Handler h = kRoutes.find(string_keys[k], params);
+        return h != nullptr ? h(params) : 0;
+    });
+    if (radix_hits != static_hits) {
+        std::printf("MISMATCH: string route, radix %d static %d\n", radix_hits, static_hits);
+        ret = 1;
+    }
+
+    lynx::RouteParams params;
+    if (kRoutes.find("GET /numbers/12x/test/4", params) != nullptr || kRoutes.find("GET /nope", params) != nullptr ||
+        kRoutes.find("POST /health", params) != nullptr) {
+        std::printf("MISMATCH: a route matched what it should not\n");
+        ret = 1;
+    }
+    return ret;
+}
@@ -0,0 +1,76 @@
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include "main.h"
+#include "spdlog/details/null_mutex.h"
+#include "spdlog/sinks/base_sink.h"
+#include "spdlog/spdlog.h"
+
+namespace {
+// Formats every record like the lynx file sink does and keeps the last one.
+class last_record_sink : public spdlog::sinks::base_sink<spdlog::details::null_mutex> {
+  public:
+    std::string last() const { return std::string(buf_.data(), buf_.size()); }
+
+  protected:
+    void sink_it_(const spdlog::details::log_msg& msg) override {
+        buf_.clear();
+        formatter_->format(msg, buf_);
+    }
+    void flush_() override {}
+
+  private:
+    spdlog::memory_buf_t buf_;
+};
+
+namespace pop = spdlog::populators;
+}  // namespace
+
+int structured_log_bench(size_t iterations) {
+    auto sink = std::make_shared<last_record_sink>();
+    sink->set_populators(pop::make_populator_set<pop::date_time, pop::timestamp, pop::level, pop::pid, pop::thread_id,
+                                                 pop::src_loc, pop::message>());
+    spdlog::logger logger("bench", sink);
+    logger.set_level(spdlog::level::info);
+
+    const std::string peer = "10.0.0.1:5000";
+    int conn_id = 42;
+
+    // both paths have to render the same record
+    int ret = 0;
+    logger.info("connection closed")({{"conn_id", conn_id}, {"peer", peer}, {"ratio", 0.25}, {"clean", true}});
+    std::string a = sink->last();
+    logger.info("connection closed", {{"conn_id", conn_id}, {"peer", peer}, {"ratio", 0.25}, {"clean", true}});
+    std::string b = sink->last();
+    if (nlohmann::json::parse(a).dump() != nlohmann::json::parse(b).dump()) {
+        std::printf("MISMATCH\n  params: %s  fields: %s", a.c_str(), b.c_str());
+        ret = 1;
+    }
+
+    size_t before = bench::allocations();
+    double ns = bench::ns_per_op(iterations, [&](size_t i) {
+        logger.info("connection closed")({{"conn_id", i}, {"peer", peer}, {"ratio", 0.25}, {"clean", true}});
+    });
+    bench::report("structured_log/json_params", ns, double(bench::allocations() - before) / iterations);
+
+    before = bench::allocations();
+    ns = bench::ns_per_op(iterations, [&](size_t i) {
+        logger.info("connection closed", {{"conn_id", i}, {"peer", peer}, {"ratio", 0.25}, {"clean", true}});
+    });
+    bench::report("structured_log/fields", ns, double(bench::allocations() - before) / iterations);
+
+    before = bench::allocations();
+    ns = bench::ns_per_op(iterations, [&](size_t i) {
+        logger.debug("connection closed")({{"conn_id", i}, {"peer", peer}, {"ratio", 0.25}, {"clean", true}});
+    });
+    bench::report("structured_log/json_params_filtered", ns, double(bench::allocations() - before) / iterations);
+
+    before = bench::allocations();
+    ns = bench::ns_per_op(iterations, [&](size_t i) {
+        SPDLOG_LOGGER_FIELDS(&logger, spdlog::level::debug, "connection closed", {"conn_id", i}, {"peer", peer},
+                             {"ratio", 0.25}, {"clean", true});
+    });
+    bench::report("structured_log/fields_filtered", ns, double(bench::allocations() - before) / iterations);
+    return ret;
+}
@@ -0,0 +1,200 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+
+#include "lynx/tcp.hpp"
+#include "main.h"
+
+namespace {
+using tcp = asio::ip::tcp;
+constexpr size_t kMessage = 64;  // bytes on the wire, delimiter or length included
+constexpr size_t kRead = 64 << 10;
+
+// messages frames, each kMessage bytes once framed
+std::string make_stream(lynx::Framing framing, size_t messages) {
+    const size_t payload = framing == lynx::Framing::line ? kMessage - 1 : kMessage - 4;
+    std::string stream;
+    stream.reserve(messages * kMessage);
+    for (size_t i = 0; i < messages; ++i) {
+        lynx::append_frame(stream, framing, std::string(payload, static_cast<char>('a' + i % 26)));
+    }
+    return stream;
+}
+
+int check(const char* name, size_t frames, size_t bytes, size_t messages, lynx::Framing framing) {
+    const size_t payload = framing == lynx::Framing::line ? kMessage - 1 : kMessage - 4;
+    if (frames != messages || bytes != messages * payload) {
+        std::fprintf(stderr, "%s: %zu frames of %zu bytes, expected %zu of %zu\n", name, frames, bytes, messages,
+                     messages * payload);
+        return 1;
+    }
+    return 0;
+}
+
+void report_rate(const char* name, size_t messages, double seconds, double allocs) {
+    std::printf("%-32s %12.0f msg/s %8.1f ns/msg %10.2f allocs/msg\n", name, double(messages) / seconds,
+                seconds * 1e9 / double(messages), allocs);
+}
+
+// asio_demo2's chat_session: async_read_until(dynamic_buffer(read_msg, 1024),
+// "\n"), then read_msg.substr() and read_msg.erase() per message. The reads
+// are stood in for by a memcpy of what the socket would return.
+int read_until_substr_erase(const std::string& stream, size_t messages) {
+    std::string read_msg;
+    size_t offset = 0;
+    size_t frames = 0;
+    size_t bytes = 0;
+    size_t before = bench::allocations();
+    auto start = std::chrono::steady_clock::now();
+    while (frames < messages) {
+        size_t n = read_msg.find('\n');
+        if (n == std::string::npos) {
+            size_t chunk = std::min(stream.size() - offset, 1024 - read_msg.size());
+            read_msg.append(stream, offset, chunk);
+            offset += chunk;
+            continue;
+        }
+        std::string msg = read_msg.substr(0, n);
+        read_msg.erase(0, n + 1);
+        ++frames;
+        bytes += msg.size();
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    const char* name = "tcp/read_until_substr_erase";
+    report_rate(name, messages, seconds, double(bench::allocations() - before) / double(messages));
+    return check(name, frames, bytes, messages, lynx::Framing::line);
+}
+
+// lynx::FrameDecoder fed kRead bytes per read: every frame a view of the ring.
+int frame_decoder(const char* name, lynx::Framing framing, const std::string& stream, size_t messages) {
+    lynx::TcpOptions options;
+    options.framing = framing;
+    lynx::FrameDecoder decoder(options);
+    size_t offset = 0;
+    size_t frames = 0;
+    size_t bytes = 0;
+    bool ok = true;
+    size_t before = bench::allocations();
+    auto start = std::chrono::steady_clock::now();
+    while (offset < stream.size() && ok) {
+        std::span<char> buffer = decoder.buffer();
+        size_t n = std::min({buffer.size(), kRead, stream.size() - offset});
+        std::memcpy(buffer.data(), stream.data() + offset, n);
+        offset += n;
+        ok = decoder.commit(n, [&](std::string_view frame) {
+            ++frames;
+            bytes += frame.size();
+        });
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    report_rate(name, messages, seconds, double(bench::allocations() - before) / double(messages));
+    return check(name, frames, bytes, messages, framing);
+}
+
+// The client writes the stream kRead bytes at a time over one loopback
+// connection, the server counts the frames on its single io thread. serve
+// starts it on the context, returns its endpoint and what it must keep alive.
+template <typename Serve>
+int loopback(const char* name, lynx::Framing framing, const std::string& stream, size_t messages, Serve serve) {
+    asio::io_context srv_ctx;
+    std::atomic<size_t> frames{0};
+    size_t bytes = 0;
+    auto on_frame = [&](std::string_view frame) {
+        bytes += frame.size();
+        frames.fetch_add(1, std::memory_order_release);
+    };
+    auto [local, server] = serve(srv_ctx, on_frame);
+    std::thread srv_thread([&] { srv_ctx.run(); });
+
+    asio::io_context ctx;
+    tcp::socket client(ctx);
+    client.connect(local);
+    size_t before = bench::allocations();
+    auto start = std::chrono::steady_clock::now();
+    for (size_t offset = 0; offset < stream.size(); offset += kRead) {
+        asio::write(client, asio::buffer(stream.data() + offset, std::min(kRead, stream.size() - offset)));
+    }
+    while (frames.load(std::memory_order_acquire) < messages) {
+        std::this_thread::yield();
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    double allocs = double(bench::allocations() - before) / double(messages);
+    srv_ctx.stop();
+    srv_thread.join();
+    server.reset();
+    report_rate(name, messages, seconds, allocs);
+    return check(name, frames.load(), bytes, messages, framing);
+}
+
+// the chat_session reading loop, one connection
+class ChatSession : public std::enable_shared_from_this<ChatSession> {
+  public:
+    ChatSession(tcp::socket socket, std::function<void(std::string_view)> on_message)
+        : socket_(std::move(socket)), on_message_(std::move(on_message)) {}
+
+    void read() {
+        asio::async_read_until(socket_, asio::dynamic_buffer(read_msg_, 1024), "\n",
+                               [self = shared_from_this()](const asio::error_code& ec, size_t n) {
+                                   if (ec) {
+                                       return;
+                                   }
+                                   std::string msg = self->read_msg_.substr(0, n - 1);
+                                   self->read_msg_.erase(0, n);
+                                   self->on_message_(msg);
+                                   self->read();
+                               });
+    }
+
+  private:
+    tcp::socket socket_;
+    std::string read_msg_;
+    std::function<void(std::string_view)> on_message_;
+};
+}  // namespace
+
+// Framing of 64 byte messages: per message cost of the decoding alone, then
+// messages per second through one loopback connection into one io thread,
+// i.e. per core.
+int tcp_bench(size_t iterations) {
+    int ret = 0;
+    const size_t messages = std::max<size_t>(iterations * 10, 1000);
+    const std::string lines = make_stream(lynx::Framing::line, messages);
+    const std::string prefixed = make_stream(lynx::Framing::length, messages);
+
+    ret |= read_until_substr_erase(lines, messages);
+    ret |= frame_decoder("tcp/frame_decoder_line", lynx::Framing::line, lines, messages);
+    ret |= frame_decoder("tcp/frame_decoder_length", lynx::Framing::length, prefixed, messages);
+
+    const auto any_port = tcp::endpoint(asio::ip::address_v4::loopback(), 0);
+    ret |= loopback("tcp/loopback_read_until", lynx::Framing::line, lines, messages,
+                    [&](asio::io_context& ctx, auto& on_frame) {
+                        auto acceptor = std::make_shared<tcp::acceptor>(ctx, any_port);
+                        acceptor->async_accept([&on_frame](const asio::error_code& ec, tcp::socket socket) {
+                            if (!ec) {
+                                std::make_shared<ChatSession>(std::move(socket), on_frame)->read();
+                            }
+                        });
+                        return std::pair{acceptor->local_endpoint(), std::shared_ptr<void>(acceptor)};
+                    });
+
+    for (auto framing : {lynx::Framing::line, lynx::Framing::length}) {
+        const bool line = framing == lynx::Framing::line;
+        lynx::TcpOptions options;
+        options.framing = framing;
+        ret |= loopback(line ? "tcp/loopback_frame_server_line" : "tcp/loopback_frame_server_length", framing,
+                        line ? lines : prefixed, messages, [&](asio::io_context& ctx, auto& on_frame) {
+                            auto server = std::make_shared<lynx::TcpFrameServer>(ctx, options);
+                            server->listen(any_port);
+                            server->start(
+                                [&on_frame](lynx::TcpConnection&, std::string_view frame) { on_frame(frame); });
+                            return std::pair{server->local_endpoint(), std::shared_ptr<void>(server)};
+                        });
+    }
+    return ret;
+}
@@ -0,0 +1,158 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "lynx/timer_wheel.hpp"
+#include "main.h"
+
+namespace {
+using namespace std::chrono_literals;
+using clock_type = std::chrono::steady_clock;
+
+// n delays from min to min + span, in no order
+std::vector<clock_type::duration> make_delays(size_t n, clock_type::duration min, clock_type::duration span) {
+    std::vector<clock_type::duration> delays(n);
+    uint64_t x = 88172645463325252ull;
+    for (auto& d : delays) {
+        x ^= x << 13;
+        x ^= x >> 7;
+        x ^= x << 17;
+        d = min + clock_type::duration(static_cast<clock_type::rep>(x % static_cast<uint64_t>(span.count())));
+    }
+    return delays;
+}
+
+void report(const std::string& name, size_t n, double ns, size_t allocs_before) {
+    bench::report(name.c_str(), ns, static_cast<double>(bench::allocations() - allocs_before) / double(n));
+}
+
+int check(const std::string& name, size_t got, size_t expected) {
+    if (got != expected) {
+        std::fprintf(stderr, "%s: %zu callbacks, expected %zu\n", name.c_str(), got, expected);
+        return 1;
+    }
+    return 0;
+}
+
+// One asio::steady_timer per connection: every wait an entry of the
+// reactor's timer heap. asio allocates the waits with aligned_alloc, they do
+// not show in the allocation count.
+int steady_timers(size_t n) {
+    const std::string prefix = "steady_timer_" + std::to_string(n / 1000) + "k/";
+    const auto delays = make_delays(n, 1s, 59s);
+    const auto again = make_delays(n, 1s, 59s);
+    asio::io_context ctx;
+    std::vector<asio::steady_timer> timers;
+    timers.reserve(n);
+    for (size_t i = 0; i < n; ++i) {
+        timers.emplace_back(ctx);
+    }
+    size_t fired = 0;
+    size_t aborted = 0;
+    auto handler = [&](const asio::error_code& ec) { ++(ec ? aborted : fired); };
+    int ret = 0;
+
+    size_t before = bench::allocations();
+    double ns = bench::ns_per_op(n, [&](size_t i) {
+        timers[i].expires_after(delays[i]);
+        timers[i].async_wait(handler);
+    });
+    report(prefix + "schedule", n, ns, before);
+
+    // an idle timer pushed back: expires_after() cancels the pending wait,
+    // whose handler runs aborted
+    before = bench::allocations();
+    ns = bench::ns_per_op(n, [&](size_t i) {
+        timers[i].expires_after(again[i]);
+        timers[i].async_wait(handler);
+    });
+    // the aborted handlers are part of the cost
+    auto start = clock_type::now();
+    ctx.poll();
+    ns += std::chrono::duration<double, std::nano>(clock_type::now() - start).count() / double(n);
+    report(prefix + "reschedule", n, ns, before);
+    ret |= check(prefix + "reschedule", aborted, n);
+
+    aborted = 0;
+    before = bench::allocations();
+    start = clock_type::now();
+    for (auto& t : timers) {
+        t.cancel();
+    }
+    ctx.poll();
+    ns = std::chrono::duration<double, std::nano>(clock_type::now() - start).count() / double(n);
+    report(prefix + "cancel", n, ns, before);
+    ret |= check(prefix + "cancel", aborted, n);
+
+    // all due at once
+    const auto now = clock_type::now();
+    const auto past = make_delays(n, 0s, 1s);
+    for (size_t i = 0; i < n; ++i) {
+        timers[i].expires_at(now - past[i]);
+        timers[i].async_wait(handler);
+    }
+    ctx.restart();
+    before = bench::allocations();
+    start = clock_type::now();
+    ctx.run();
+    ns = std::chrono::duration<double, std::nano>(clock_type::now() - start).count() / double(n);
+    report(prefix + "expire", n, ns, before);
+    ret |= check(prefix + "expire", fired, n);
+    return ret;
+}
+
+// lynx::TimerWheel: one asio timer for all of them, driven by hand here.
+int timer_wheel(size_t n) {
+    const std::string prefix = "timer_wheel_" + std::to_string(n / 1000) + "k/";
+    const auto delays = make_delays(n, 1s, 59s);
+    const auto again = make_delays(n, 1s, 59s);
+    asio::io_context ctx;
+    lynx::TimerWheel wheel(ctx);
+    std::vector<lynx::TimerWheel::Id> ids(n);
+    size_t fired = 0;
+    auto callback = [&fired] { ++fired; };
+    int ret = 0;
+
+    size_t before = bench::allocations();
+    double ns = bench::ns_per_op(n, [&](size_t i) { ids[i] = wheel.schedule(delays[i], callback); });
+    report(prefix + "schedule", n, ns, before);
+
+    before = bench::allocations();
+    size_t moved = 0;
+    ns = bench::ns_per_op(n, [&](size_t i) { moved += wheel.reschedule(ids[i], again[i]); });
+    report(prefix + "reschedule", n, ns, before);
+    ret |= check(prefix + "reschedule", moved, n);
+
+    before = bench::allocations();
+    size_t cancelled = 0;
+    ns = bench::ns_per_op(n, [&](size_t i) { cancelled += wheel.cancel(ids[i]); });
+    report(prefix + "cancel", n, ns, before);
+    ret |= check(prefix + "cancel", cancelled, n);
+
+    // within the next second, run as if it went by: the nodes are reused
+    const auto soon = make_delays(n, 0s, 1s);
+    for (size_t i = 0; i < n; ++i) {
+        wheel.schedule(soon[i], callback);
+    }
+    before = bench::allocations();
+    auto start = clock_type::now();
+    size_t expired = wheel.advance(clock_type::now() + 2s);
+    ns = std::chrono::duration<double, std::nano>(clock_type::now() - start).count() / double(n);
+    report(prefix + "expire", n, ns, before);
+    ret |= check(prefix + "expire", fired, n);
+    ret |= check(prefix + "advance", expired, n);
+    return ret;
+}
+}  // namespace
+
+// Idle timers of n connections armed at once (1M by default): cost per
+// timer to schedule, push back, cancel and expire them.
+int timer_bench(size_t iterations) {
+    const size_t n = std::max<size_t>(iterations * 5, 1000);
+    int ret = 0;
+    ret |= steady_timers(n);
+    ret |= timer_wheel(n);
+    return ret;
+}
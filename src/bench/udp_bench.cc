@@ -0,0 +1,170 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#include "lynx/udp.hpp"
+#include "main.h"
+
+namespace {
+using clock_type = std::chrono::steady_clock;
+using udp = asio::ip::udp;
+
+struct Packet {
+    uint64_t seq;
+    int64_t sent_ns;
+    char pad[48];  // 64 bytes on the wire
+};
+
+int64_t now_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(clock_type::now().time_since_epoch()).count();
+}
+
+// One sender thread floods a receiver running on its own io_context thread:
+// datagrams per second seen by the receiver, and how many it had to read per
+// system call. Loopback drops what the receive buffer cannot hold.
+int flood(const char* name, size_t packets, const lynx::UdpOptions& options) {
+    asio::io_context rx_ctx;
+    lynx::UdpEngine rx(rx_ctx, options);
+    rx.bind(udp::endpoint(asio::ip::address_v4::loopback(), 0));
+
+    std::atomic<uint64_t> received{0};
+    std::atomic<int64_t> first_ns{0};
+    std::atomic<int64_t> last_ns{0};
+    bool bad = false;
+    rx.start([&](std::span<const char> payload, const udp::endpoint&) {
+        if (payload.size() != sizeof(Packet)) {
+            bad = true;
+        }
+        int64_t t = now_ns();
+        if (received.fetch_add(1, std::memory_order_relaxed) == 0) {
+            first_ns.store(t, std::memory_order_relaxed);
+        }
+        last_ns.store(t, std::memory_order_relaxed);
+    });
+    std::thread rx_thread([&] { rx_ctx.run(); });
+
+    asio::io_context tx_ctx;
+    lynx::UdpEngine tx(tx_ctx, options);
+    tx.connect(rx.local_endpoint());
+    size_t before = bench::allocations();
+    Packet p{};
+    for (size_t i = 0; i < packets; ++i) {
+        p.seq = i;
+        p.sent_ns = now_ns();
+        tx.send(std::span<const char>(reinterpret_cast<const char*>(&p), sizeof(p)));
+        if (tx.queued() == options.batch_size) {
+            tx.flush();
+        }
+        // socket full: wait until it is writable again
+        while (tx.queued() == options.batch_size) {
+            tx_ctx.run_one();
+        }
+    }
+    while (tx.flush(), tx.queued() > 0) {
+        tx_ctx.run_one();
+    }
+
+    // the receiver is done once nothing came in for a while
+    uint64_t seen = 0;
+    do {
+        seen = received.load();
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    } while (seen != received.load());
+    double allocs = double(bench::allocations() - before) / double(packets);
+    asio::post(rx_ctx, [&] { rx.stop(); });
+    rx_thread.join();
+
+    uint64_t got = received.load();
+    double seconds = double(last_ns.load() - first_ns.load()) / 1e9;
+    double pps = seconds > 0 ? double(got) / seconds : 0;
+    const lynx::UdpStats& s = rx.stats();
+    std::printf("%-32s %12.0f pkt/s %7.2f%% lost %8.2f pkt/recvmmsg %8.2f pkt/sendmmsg %6.2f allocs/pkt%s%s\n",
+                name, pps, 100.0 * double(packets - got) / double(packets),
+                s.recv_calls ? double(s.received) / double(s.recv_calls) : 0.0,
+                tx.stats().send_calls ? double(tx.stats().sent) / double(tx.stats().send_calls) : 0.0, allocs,
+                rx.gro() ? " gro" : "", tx.gso() ? " gso" : "");
+    if (bad || got == 0 || got > packets || s.truncated > 0) {
+        std::printf("MISMATCH: %zu sent, %llu received, %llu truncated\n", packets,
+                    static_cast<unsigned long long>(got), static_cast<unsigned long long>(s.truncated));
+        return 1;
+    }
+    return 0;
+}
+
+// Ping-pong against an echo server: round trip percentiles, one datagram in flight.
+int echo(const char* name, size_t round_trips, const lynx::UdpOptions& options) {
+    asio::io_context srv_ctx;
+    lynx::UdpEngine srv(srv_ctx, options);
+    srv.bind(udp::endpoint(asio::ip::address_v4::loopback(), 0));
+    srv.start([&](std::span<const char> payload, const udp::endpoint& from) { srv.send(payload, from); });
+    std::thread srv_thread([&] { srv_ctx.run(); });
+
+    asio::io_context ctx;
+    lynx::UdpEngine client(ctx, options);
+    client.connect(srv.local_endpoint());
+    std::vector<double> rtt;
+    rtt.reserve(round_trips);
+    uint64_t expected = 0;
+    bool bad = false;
+    client.start([&](std::span<const char> payload, const udp::endpoint&) {
+        Packet p;
+        if (payload.size() != sizeof(p)) {
+            bad = true;
+            return;
+        }
+        std::memcpy(&p, payload.data(), sizeof(p));
+        if (p.seq != expected) {
+            bad = true;
+            return;
+        }
+        rtt.push_back(double(now_ns() - p.sent_ns));
+    });
+
+    Packet p{};
+    for (size_t i = 0; i < round_trips && !bad; ++i) {
+        expected = p.seq = i;
+        p.sent_ns = now_ns();
+        client.send(std::span<const char>(reinterpret_cast<const char*>(&p), sizeof(p)));
+        client.flush();
+        while (rtt.size() == i && !bad) {
+            ctx.run_one();
+        }
+    }
+    client.stop();
+    asio::post(srv_ctx, [&] { srv.stop(); });
+    srv_thread.join();
+
+    if (bad || rtt.size() != round_trips) {
+        std::printf("MISMATCH: %zu round trips, %zu answered in order\n", round_trips, rtt.size());
+        return 1;
+    }
+    std::sort(rtt.begin(), rtt.end());
+    auto pct = [&](double q) { return rtt[std::min(rtt.size() - 1, size_t(q * double(rtt.size())))] / 1000.0; };
+    std::printf("%-32s p50 %8.1f us  p99 %8.1f us  p99.9 %8.1f us  max %8.1f us\n", name, pct(0.5), pct(0.99),
+                pct(0.999), rtt.back() / 1000.0);
+    return 0;
+}
+}  // namespace
+
+int udp_bench(size_t iterations) {
+    int ret = 0;
+    lynx::UdpOptions single;
+    single.batch_size = 1;
+    lynx::UdpOptions batched;
+    batched.batch_size = 32;
+    lynx::UdpOptions offload = batched;
+    offload.gro = true;
+    offload.gso = true;
+
+    ret |= flood("udp/flood_batch_1", iterations, single);
+    ret |= flood("udp/flood_batch_32", iterations, batched);
+    ret |= flood("udp/flood_batch_32_gro_gso", iterations, offload);
+
+    size_t round_trips = std::max<size_t>(1000, iterations / 20);
+    ret |= echo("udp/echo_rtt", round_trips, batched);
+    return ret;
+}
@@ -0,0 +1,397 @@
+#include "async_log.hpp"
+
+#include <fcntl.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <ctime>
+#include <stdexcept>
+
+#include "spdlog/details/os.h"
+#include "spdlog/pattern_formatter.h"
+#include "spdlog/sinks/daily_file_sink.h"
+
+namespace lynx {
+OverflowPolicy overflow_policy_from_string(const std::string& name) {
+    if (name == "block") {
+        return OverflowPolicy::block;
+    }
+    if (name == "drop_newest") {
+        return OverflowPolicy::drop_newest;
+    }
+    if (name == "drop_oldest") {
+        return OverflowPolicy::drop_oldest;
+    }
+    throw std::invalid_argument("unknown log overflow policy: " + name +
+                                " (expected block, drop_newest or drop_oldest)");
+}
+
+const char* to_string(OverflowPolicy policy) {
+    switch (policy) {
+        case OverflowPolicy::block:
+            return "block";
+        case OverflowPolicy::drop_newest:
+            return "drop_newest";
+        case OverflowPolicy::drop_oldest:
+            return "drop_oldest";
+    }
+    return "unknown";
+}
+
+AsyncFileSink::AsyncFileSink(std::string base_filename, size_t queue_size, OverflowPolicy policy, size_t batch_size)
+    : ring_(queue_size),
+      policy_(policy),
+      batch_size_(std::max<size_t>(1, std::min<size_t>(batch_size, IOV_MAX))),
+      base_filename_(std::move(base_filename)),
+      batch_(batch_size_),
+      bufs_(batch_size_),
+      formatter_(spdlog::details::make_unique<spdlog::pattern_formatter>()) {
+    open_file_();
+    start_writer();
+}
+
+AsyncFileSink::~AsyncFileSink() {
+    stop_writer();
+    if (fd_ >= 0) {
+        ::close(fd_);
+    }
+}
+
+void AsyncFileSink::log(const spdlog::details::log_msg& msg) {
+    push_(msg);
+    wake_writer_();
+}
+
+void AsyncFileSink::flush() {
+    const size_t target = ring_.head();
+    // pairs with notify_progress_(): either we see the new position, or the writer sees us waiting
+    flush_waiters_.fetch_add(1, std::memory_order_seq_cst);
+    for (;;) {
+        uint32_t seen = progress_.load(std::memory_order_seq_cst);
+        if (flushed_.load(std::memory_order_seq_cst) >= target || !running_.load(std::memory_order_seq_cst)) {
+            break;
+        }
+        wake_writer_();
+        progress_.wait(seen, std::memory_order_seq_cst);
+    }
+    flush_waiters_.fetch_sub(1, std::memory_order_relaxed);
+}
+
+void AsyncFileSink::set_pattern(const std::string& pattern) {
+    set_formatter(spdlog::details::make_unique<spdlog::pattern_formatter>(pattern));
+}
+
+void AsyncFileSink::set_formatter(std::unique_ptr<spdlog::formatter> sink_formatter) {
+    std::lock_guard<std::mutex> lock(formatter_mutex_);
+    formatter_ = std::move(sink_formatter);
+}
+
+AsyncLogStats AsyncFileSink::stats() const {
+    AsyncLogStats s;
+    s.capacity = ring_.capacity();
+    s.policy = policy_;
+    s.written = written_.load(std::memory_order_relaxed);
+    s.batches = batches_.load(std::memory_order_relaxed);
+    s.dropped_newest = dropped_newest_.load(std::memory_order_relaxed);
+    s.dropped_oldest = dropped_oldest_.load(std::memory_order_relaxed);
+    s.blocked = blocked_.load(std::memory_order_relaxed);
+    s.write_errors = write_errors_.load(std::memory_order_relaxed);
+    return s;
+}
+
+void AsyncFileSink::stop_writer() {
+    if (!writer_.joinable()) {
+        return;
+    }
+    stop_.store(true, std::memory_order_release);
+    wake_.fetch_add(1, std::memory_order_release);
+    wake_.notify_one();
+    writer_.join();
+    // blocked producers drop their record from now on, flush() returns
+    running_.store(false, std::memory_order_seq_cst);
+    freed_.fetch_add(1, std::memory_order_seq_cst);
+    freed_.notify_all();
+    progress_.fetch_add(1, std::memory_order_seq_cst);
+    progress_.notify_all();
+}
+
+void AsyncFileSink::start_writer() {
+    if (writer_.joinable()) {
+        return;
+    }
+    stop_.store(false, std::memory_order_relaxed);
+    running_.store(true, std::memory_order_seq_cst);
+    writer_ = std::thread([this] { run_(); });
+}
+
+void AsyncFileSink::Record::assign(const spdlog::details::log_msg& m) {
+    // appended into the slot's buffer: a log_msg_buffer would allocate its own
+    // for every payload over the inline capacity
+    msg = m;
+    text.clear();
+    text.append(m.logger_name.data(), m.logger_name.data() + m.logger_name.size());
+    text.append(m.payload.data(), m.payload.data() + m.payload.size());
+    view_text_();
+    if (m.params) {
+        params = *m.params;
+        msg.params = &params;
+    }
+
+    // copy the strings first, the buffer may move while growing
+    strings.clear();
+    for (size_t i = 0; i < m.fields_count; ++i) {
+        const spdlog::field& f = m.fields[i];
+        strings.append(f.key.data(), f.key.data() + f.key.size());
+        if (f.kind == spdlog::field::type::string) {
+            strings.append(f.str.data(), f.str.data() + f.str.size());
+        }
+    }
+    fields.assign(m.fields, m.fields + m.fields_count);
+    const char* p = strings.data();
+    for (auto& f : fields) {
+        f.key = spdlog::string_view_t(p, f.key.size());
+        p += f.key.size();
+        if (f.kind == spdlog::field::type::string) {
+            f.str = spdlog::string_view_t(p, f.str.size());
+            p += f.str.size();
+        }
+    }
+    msg.fields = fields.data();
+    msg.fields_count = fields.size();
+}
+
+void AsyncFileSink::Record::take(Record& other) {
+    // copied rather than moved, so both records keep their capacity
+    msg = other.msg;
+    text.clear();
+    text.append(other.text.data(), other.text.data() + other.text.size());
+    view_text_();
+    if (other.msg.params) {
+        params = std::move(other.params);
+        msg.params = &params;
+    }
+
+    strings.clear();
+    strings.append(other.strings.data(), other.strings.data() + other.strings.size());
+    fields.assign(other.fields.begin(), other.fields.end());
+
+    const char* from = other.strings.data();
+    const char* to = strings.data();
+    for (auto& f : fields) {
+        f.key = spdlog::string_view_t(to + (f.key.data() - from), f.key.size());
+        if (f.kind == spdlog::field::type::string) {
+            f.str = spdlog::string_view_t(to + (f.str.data() - from), f.str.size());
+        }
+    }
+    msg.fields = fields.data();
+    msg.fields_count = fields.size();
+}
+
+void AsyncFileSink::Record::view_text_() {
+    msg.logger_name = spdlog::string_view_t(text.data(), msg.logger_name.size());
+    msg.payload = spdlog::string_view_t(text.data() + msg.logger_name.size(), msg.payload.size());
+}
+
+void AsyncFileSink::push_(const spdlog::details::log_msg& msg) {
+    // the record views the caller's stack: copy it, params and fields included
+    auto fill = [&msg](Record& r) {
+        try {
+            r.assign(msg);
+            r.valid = true;
+        } catch (...) {
+            r.valid = false;
+        }
+    };
+    if (ring_.try_push(fill)) {
+        return;
+    }
+
+    switch (policy_) {
+        case OverflowPolicy::drop_newest:
+            dropped_newest_.fetch_add(1, std::memory_order_relaxed);
+            return;
+        case OverflowPolicy::drop_oldest:
+            do {
+                if (ring_.try_pop([](Record& r) { r.valid = false; })) {
+                    dropped_oldest_.fetch_add(1, std::memory_order_relaxed);
+                }
+            } while (!ring_.try_push(fill));
+            return;
+        case OverflowPolicy::block:
+            blocked_.fetch_add(1, std::memory_order_relaxed);
+            for (;;) {
+                uint32_t seen = freed_.load(std::memory_order_seq_cst);
+                if (ring_.try_push(fill)) {
+                    return;
+                }
+                // nobody frees a slot until the writer starts again, stop_writer() bumps freed_ after this
+                if (!running_.load(std::memory_order_seq_cst)) {
+                    dropped_newest_.fetch_add(1, std::memory_order_relaxed);
+                    return;
+                }
+                // pairs with the writer bumping freed_ then reading waiters_
+                waiters_.fetch_add(1, std::memory_order_seq_cst);
+                freed_.wait(seen, std::memory_order_seq_cst);
+                waiters_.fetch_sub(1, std::memory_order_relaxed);
+            }
+    }
+}
+
+void AsyncFileSink::wake_writer_() {
+    // pairs with the fence in run_(): either the writer sees the new record
+    // before going to sleep, or we see it sleeping and wake it up
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (sleeping_.load(std::memory_order_relaxed)) {
+        wake_.fetch_add(1, std::memory_order_release);
+        wake_.notify_one();
+    }
+}
+
+void AsyncFileSink::run_() {
+    for (;;) {
+        if (write_batch_() > 0) {
+            continue;
+        }
+        if (stop_.load(std::memory_order_acquire)) {
+            break;
+        }
+        uint32_t seen = wake_.load(std::memory_order_acquire);
+        sleeping_.store(true, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (write_batch_() == 0 && !stop_.load(std::memory_order_acquire)) {
+            wake_.wait(seen, std::memory_order_acquire);
+        }
+        sleeping_.store(false, std::memory_order_relaxed);
+    }
+}
+
+size_t AsyncFileSink::write_batch_() {
+    if (spdlog::log_clock::now() >= rotation_tp_) {
+        try {
+            open_file_();
+        } catch (const spdlog::spdlog_ex&) {
+            // keep writing to the current file, retried on the next batch
+        }
+    }
+
+    // move the records out first, so slots go back to the producers before formatting
+    size_t popped = 0;
+    size_t count = 0;
+    while (count < batch_size_ && ring_.try_pop([&](Record& r) {
+        if (r.valid) {
+            batch_[count++].take(r);
+            r.valid = false;
+        }
+    })) {
+        ++popped;
+    }
+    // what is below it is in this batch, written before, or evicted by drop_oldest
+    const size_t upto = ring_.tail();
+    if (popped == 0) {
+        flushed_to_(upto);
+        return 0;
+    }
+
+    // room was made, release the producers blocked on a full ring
+    freed_.fetch_add(1, std::memory_order_seq_cst);
+    if (waiters_.load(std::memory_order_seq_cst) > 0) {
+        freed_.notify_all();
+    }
+
+    size_t formatted = 0;
+    {
+        std::lock_guard<std::mutex> lock(formatter_mutex_);
+        for (size_t i = 0; i < count; ++i) {
+            bufs_[formatted].clear();
+            try {
+                formatter_->format(batch_[i].msg, bufs_[formatted]);
+                ++formatted;
+            } catch (...) {
+                write_errors_.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+    }
+    count = formatted;
+
+    writev_(count);
+    flushed_to_(upto);
+    return popped;
+}
+
+void AsyncFileSink::flushed_to_(size_t pos) {
+    if (pos == flushed_.load(std::memory_order_relaxed)) {
+        return;
+    }
+    flushed_.store(pos, std::memory_order_seq_cst);
+    notify_progress_();
+}
+
+void AsyncFileSink::notify_progress_() {
+    progress_.fetch_add(1, std::memory_order_seq_cst);
+    if (flush_waiters_.load(std::memory_order_seq_cst) > 0) {
+        progress_.notify_all();
+    }
+}
+
+void AsyncFileSink::writev_(size_t count) {
+    if (count == 0) {
+        return;
+    }
+    iovec iov[IOV_MAX];
+    for (size_t i = 0; i < count; ++i) {
+        iov[i].iov_base = bufs_[i].data();
+        iov[i].iov_len = bufs_[i].size();
+    }
+
+    size_t first = 0;
+    while (first < count) {
+        ssize_t rc = ::writev(fd_, iov + first, static_cast<int>(count - first));
+        if (rc < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            write_errors_.fetch_add(count - first, std::memory_order_relaxed);
+            count = first;
+            break;
+        }
+        // short write: skip what went out and resume inside the current record
+        auto left = static_cast<size_t>(rc);
+        while (first < count && left >= iov[first].iov_len) {
+            left -= iov[first].iov_len;
+            ++first;
+        }
+        if (first < count) {
+            iov[first].iov_base = static_cast<char*>(iov[first].iov_base) + left;
+            iov[first].iov_len -= left;
+        }
+    }
+    written_.fetch_add(count, std::memory_order_relaxed);
+    batches_.fetch_add(1, std::memory_order_relaxed);
+}
+
+void AsyncFileSink::open_file_() {
+    using spdlog::details::os::localtime;
+    auto now = spdlog::log_clock::now();
+    tm now_tm = localtime(spdlog::log_clock::to_time_t(now));
+    auto filename = spdlog::sinks::daily_filename_calculator::calc_filename(base_filename_, now_tm);
+
+    spdlog::details::os::create_dir(spdlog::details::os::dir_name(filename));
+    int fd = ::open(filename.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        spdlog::throw_spdlog_ex("Failed opening file " + filename + " for writing", errno);
+    }
+    if (fd_ >= 0) {
+        ::close(fd_);
+    }
+    fd_ = fd;
+
+    // next midnight, like daily_file_sink(base, 0, 0)
+    now_tm.tm_hour = 0;
+    now_tm.tm_min = 0;
+    now_tm.tm_sec = 0;
+    rotation_tp_ = spdlog::log_clock::from_time_t(std::mktime(&now_tm)) + std::chrono::hours(24);
+}
+}  // namespace lynx
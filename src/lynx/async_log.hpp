@@ -0,0 +1,211 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "options.hpp"
+#include "spdlog/details/log_msg.h"
+#include "spdlog/sinks/sink.h"
+
+namespace lynx {
+// Bounded lock-free ring of pre-allocated slots (Dmitry Vyukov's bounded MPMC
+// queue). Each slot carries a sequence number telling whether it is free for
+// the producer of round `pos` or filled for the consumer of round `pos`, so
+// producers only contend on one CAS of the head and never take a lock.
+// The log writer is the only regular consumer; producers pop too, but only to
+// evict the oldest record when the ring is full.
+template <typename T>
+class LogRing {
+  public:
+    // capacity is rounded up to a power of two
+    explicit LogRing(size_t capacity) {
+        size_t n = 2;
+        while (n < capacity) {
+            n <<= 1;
+        }
+        mask_ = n - 1;
+        slots_ = std::make_unique<Slot[]>(n);
+        for (size_t i = 0; i < n; ++i) {
+            slots_[i].seq.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    LogRing(const LogRing&) = delete;
+    LogRing& operator=(const LogRing&) = delete;
+
+    size_t capacity() const { return mask_ + 1; }
+    // positions claimed by producers so far
+    size_t head() const { return head_.load(std::memory_order_acquire); }
+    // positions popped so far: the slots below it are taken or being taken
+    size_t tail() const { return tail_.load(std::memory_order_acquire); }
+
+    // Claims a free slot and calls fill(T&) on it. False when the ring is full.
+    template <typename F>
+    bool try_push(F&& fill) {
+        size_t pos = head_.load(std::memory_order_relaxed);
+        for (;;) {
+            Slot& slot = slots_[pos & mask_];
+            size_t seq = slot.seq.load(std::memory_order_acquire);
+            auto diff = static_cast<std::ptrdiff_t>(seq) - static_cast<std::ptrdiff_t>(pos);
+            if (diff == 0) {
+                if (head_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    fill(slot.value);
+                    slot.seq.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = head_.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    // Takes the oldest filled slot and calls take(T&) on it. False when empty.
+    template <typename F>
+    bool try_pop(F&& take) {
+        size_t pos = tail_.load(std::memory_order_relaxed);
+        for (;;) {
+            Slot& slot = slots_[pos & mask_];
+            size_t seq = slot.seq.load(std::memory_order_acquire);
+            auto diff = static_cast<std::ptrdiff_t>(seq) - static_cast<std::ptrdiff_t>(pos + 1);
+            if (diff == 0) {
+                if (tail_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    take(slot.value);
+                    slot.seq.store(pos + mask_ + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = tail_.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+  private:
+    struct alignas(64) Slot {
+        std::atomic<size_t> seq;
+        T value;
+    };
+
+    std::unique_ptr<Slot[]> slots_;
+    size_t mask_;
+    alignas(64) std::atomic<size_t> head_{0};
+    alignas(64) std::atomic<size_t> tail_{0};
+};
+
+struct AsyncLogStats {
+    size_t capacity{0};
+    OverflowPolicy policy{OverflowPolicy::block};
+    uint64_t written{0};         // records handed to the kernel
+    uint64_t batches{0};         // writev calls
+    uint64_t dropped_newest{0};  // records discarded by drop_newest, or by block with the writer stopped
+    uint64_t dropped_oldest{0};  // records evicted by drop_oldest
+    uint64_t blocked{0};         // records whose producer had to wait (block)
+    uint64_t write_errors{0};    // records lost to a failed writev
+};
+
+// Daily file sink whose log() only copies the record into a LogRing slot.
+// A dedicated writer thread formats the queued records in batches and hands
+// each batch to the kernel with a single writev(), so the threads that log
+// never format JSON, take a lock or touch the disk.
+//
+// Files are named like spdlog's daily_file_sink (base_YYYY-MM-DD.ext) and
+// rotated at midnight, checked once per batch.
+class AsyncFileSink final : public spdlog::sinks::sink {
+  public:
+    AsyncFileSink(std::string base_filename, size_t queue_size, OverflowPolicy policy, size_t batch_size);
+    // writes what is still queued, unless the writer was stopped for a fork
+    ~AsyncFileSink() override;
+
+    AsyncFileSink(const AsyncFileSink&) = delete;
+    AsyncFileSink& operator=(const AsyncFileSink&) = delete;
+
+    void log(const spdlog::details::log_msg& msg) override;
+    // Waits until the records queued before the call are handed to the kernel
+    // (or dropped); returns at once while the writer is stopped.
+    void flush() override;
+    void set_pattern(const std::string& pattern) override;
+    void set_formatter(std::unique_ptr<spdlog::formatter> sink_formatter) override;
+
+    AsyncLogStats stats() const;
+
+    // Threads do not survive fork(): stop the writer (draining the ring) before
+    // forking and start it again in the processes that go on logging. Records
+    // logged in between stay queued, up to a full ring.
+    void stop_writer();
+    void start_writer();
+
+  private:
+    // The logger name, payload and structured fields are appended into the
+    // record's own buffers, which keep their capacity from one use of the slot
+    // to the next: once warmed up to the largest record seen, queuing a record
+    // is allocation free (params, being a nlohmann::json, still allocate).
+    struct Record {
+        spdlog::details::log_msg msg;  // views text, params, fields and strings
+        spdlog::memory_buf_t text;     // logger name then payload
+        nlohmann::json params;
+        std::vector<spdlog::field> fields;
+        spdlog::memory_buf_t strings;
+        bool valid{false};
+
+        void assign(const spdlog::details::log_msg& m);
+        // copies other, whose slot can then be reused right away
+        void take(Record& other);
+
+      private:
+        void view_text_();
+    };
+
+    void push_(const spdlog::details::log_msg& msg);
+    void wake_writer_();
+    void run_();
+    size_t write_batch_();
+    void flushed_to_(size_t pos);
+    void notify_progress_();
+    void writev_(size_t count);
+    void open_file_();
+
+    LogRing<Record> ring_;
+    const OverflowPolicy policy_;
+    const size_t batch_size_;
+
+    // writer side
+    std::string base_filename_;
+    int fd_{-1};
+    spdlog::log_clock::time_point rotation_tp_;
+    std::vector<Record> batch_;
+    std::vector<spdlog::memory_buf_t> bufs_;
+    std::mutex formatter_mutex_;
+    std::unique_ptr<spdlog::formatter> formatter_;
+    std::thread writer_;
+    std::atomic<bool> stop_{false};
+    std::atomic<bool> running_{false};
+
+    // writer wake up and producers waiting for room (block policy)
+    std::atomic<bool> sleeping_{false};
+    std::atomic<uint32_t> wake_{0};
+    std::atomic<uint32_t> freed_{0};
+    std::atomic<uint32_t> waiters_{0};
+
+    // flush(): the ring positions below flushed_ are written or dropped,
+    // progress_ moves on when it grows or when the writer stops
+    std::atomic<size_t> flushed_{0};
+    std::atomic<uint32_t> progress_{0};
+    std::atomic<uint32_t> flush_waiters_{0};
+
+    std::atomic<uint64_t> written_{0};
+    std::atomic<uint64_t> batches_{0};
+    std::atomic<uint64_t> dropped_newest_{0};
+    std::atomic<uint64_t> dropped_oldest_{0};
+    std::atomic<uint64_t> blocked_{0};
+    std::atomic<uint64_t> write_errors_{0};
+};
+}  // namespace lynx
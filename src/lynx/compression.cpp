@@ -0,0 +1,319 @@
+#include "compression.hpp"
+
+#include <brotli/encode.h>
+
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <cstring>
+#include <functional>
+#include <utility>
+
+#include "cinatra.hpp"
+#include "cinatra/gzip.hpp"
+#include "cinatra/sha1.hpp"
+
+namespace lynx {
+namespace {
+std::string_view trim(std::string_view s) {
+    while (!s.empty() && (s.front() == ' ' || s.front() == '\t')) {
+        s.remove_prefix(1);
+    }
+    while (!s.empty() && (s.back() == ' ' || s.back() == '\t')) {
+        s.remove_suffix(1);
+    }
+    return s;
+}
+
+// Calls f(name, value, line) for the header lines of a prepared head, the
+// status line skipped; line includes its CRLF. f returns false to stop.
+template <typename F>
+void for_each_header(std::string_view head, F&& f) {
+    size_t pos = head.find("\r\n");
+    while (pos != std::string_view::npos && pos + 2 < head.size()) {
+        size_t begin = pos + 2;
+        size_t end = head.find("\r\n", begin);
+        if (end == std::string_view::npos) {
+            return;
+        }
+        std::string_view line = head.substr(begin, end + 2 - begin);
+        size_t colon = line.find(':');
+        if (colon != std::string_view::npos &&
+            !f(trim(line.substr(0, colon)), trim(line.substr(colon + 1, line.size() - colon - 3)), line)) {
+            return;
+        }
+        pos = end;
+    }
+}
+
+bool icontains(std::string_view s, std::string_view word) {
+    return std::search(s.begin(), s.end(), word.begin(), word.end(), [](char a, char b) {
+               return std::tolower(static_cast<unsigned char>(a)) == std::tolower(static_cast<unsigned char>(b));
+           }) != s.end();
+}
+
+// the head a compressed body is sent under: ranges and strong validators
+// describe the original bytes, not these
+std::string compressed_head(std::string_view head, size_t size, Encoding encoding) {
+    std::string out;
+    out.reserve(head.size() + 64);
+    out.append(head.substr(0, head.find("\r\n") + 2));
+    bool vary = false;
+    for_each_header(head, [&](std::string_view name, std::string_view value, std::string_view line) {
+        if (cinatra::iequal0(name, "Content-Length")) {
+            out.append("Content-Length: ").append(std::to_string(size)).append("\r\n");
+        } else if (cinatra::iequal0(name, "ETag") && !value.starts_with("W/")) {
+            out.append("ETag: W/").append(value).append("\r\n");
+        } else if (cinatra::iequal0(name, "Vary")) {
+            vary = true;
+            out.append(line.substr(0, line.size() - 2));
+            if (!icontains(value, "Accept-Encoding")) {
+                out.append(", Accept-Encoding");
+            }
+            out.append("\r\n");
+        } else if (!cinatra::iequal0(name, "Accept-Ranges")) {
+            out.append(line);
+        }
+        return true;
+    });
+    out.append("Content-Encoding: ").append(to_string(encoding)).append("\r\n");
+    if (!vary) {
+        out.append("Vary: Accept-Encoding\r\n");
+    }
+    return out;
+}
+
+uint64_t variant_key(uint64_t hash, Encoding encoding) {
+    return hash ^ (static_cast<uint64_t>(encoding) * 0x9e3779b97f4a7c15ull);
+}
+}  // namespace
+
+std::string_view to_string(Encoding encoding) {
+    switch (encoding) {
+        case Encoding::gzip:
+            return "gzip";
+        case Encoding::br:
+            return "br";
+        default:
+            return "identity";
+    }
+}
+
+Compressor::Compressor(CompressionOptions options)
+    : options_(std::move(options)), workers_(std::max<size_t>(options_.threads, 1)) {}
+
+Compressor::~Compressor() { workers_.join(); }
+
+Encoding Compressor::negotiate(std::string_view accept_encoding) const {
+    if (!options_.enabled || accept_encoding.empty()) {
+        return Encoding::identity;
+    }
+    // -1: not listed
+    double br = -1, gzip = -1, any = -1;
+    while (!accept_encoding.empty()) {
+        size_t comma = std::min(accept_encoding.find(','), accept_encoding.size());
+        std::string_view item = accept_encoding.substr(0, comma);
+        accept_encoding.remove_prefix(std::min(comma + 1, accept_encoding.size()));
+
+        size_t semi = std::min(item.find(';'), item.size());
+        std::string_view coding = trim(item.substr(0, semi));
+        double q = 1;
+        if (size_t at = item.find("q=", semi); at != std::string_view::npos) {
+            std::string_view value = trim(item.substr(at + 2));
+            std::from_chars(value.data(), value.data() + value.size(), q);
+        }
+        if (cinatra::iequal0(coding, "br")) {
+            br = q;
+        } else if (cinatra::iequal0(coding, "gzip") || cinatra::iequal0(coding, "x-gzip")) {
+            gzip = q;
+        } else if (coding == "*") {
+            any = q;
+        }
+    }
+    if (br < 0) {
+        br = any;
+    }
+    if (gzip < 0) {
+        gzip = any;
+    }
+    if (br <= 0 && gzip <= 0) {
+        return Encoding::identity;
+    }
+    return br >= gzip ? Encoding::br : Encoding::gzip;
+}
+
+bool Compressor::compressible(std::string_view mime) {
+    mime = trim(mime.substr(0, mime.find(';')));
+    return mime.starts_with("text/") || icontains(mime, "json") || icontains(mime, "javascript") ||
+           icontains(mime, "xml") || mime == "application/wasm" || mime == "image/x-icon" || mime == "image/bmp" ||
+           mime.starts_with("font/ttf") || mime.starts_with("font/otf") || mime == "application/x-font-ttf";
+}
+
+bool Compressor::eligible(std::string_view mime, size_t size) const {
+    return options_.enabled && size >= options_.min_size && compressible(mime);
+}
+
+bool Compressor::eligible_head(std::string_view head, size_t size) const {
+    if (!options_.enabled || size < options_.min_size) {
+        return false;
+    }
+    std::string_view mime;
+    bool encoded = false;
+    for_each_header(head, [&](std::string_view name, std::string_view value, std::string_view) {
+        if (cinatra::iequal0(name, "Content-Type")) {
+            mime = value;
+        } else if (cinatra::iequal0(name, "Content-Encoding")) {
+            encoded = true;
+        }
+        return !encoded;
+    });
+    return !encoded && compressible(mime);
+}
+
+uint64_t ContentHash::key() const {
+    uint64_t key;
+    std::memcpy(&key, digest.data(), sizeof(key));
+    return key;
+}
+
+ContentHash Compressor::content_hash(std::string_view head, std::string_view body) {
+    ContentHash hash;
+    hash.head_size = head.size();
+    hash.body_size = body.size();
+    cinatra::sha1_context ctx;
+    cinatra::init(ctx);
+    // the head's size first: where the head ends is part of the content
+    uint64_t head_size = head.size();
+    cinatra::update(ctx, &head_size, sizeof(head_size));
+    cinatra::update(ctx, head.data(), head.size());
+    cinatra::update(ctx, body.data(), body.size());
+    cinatra::finish(ctx, hash.digest.data());
+    return hash;
+}
+
+Compressor::Variant Compressor::cached(std::shared_ptr<const void> owner, std::string_view head,
+                                       std::string_view body, const ContentHash& hash, Encoding encoding) {
+    uint64_t key = variant_key(hash.key(), encoding);
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        // another content under the same key is a miss, its variant gets replaced
+        if (auto it = index_.find(key); it != index_.end() && it->second->content == hash &&
+                                        it->second->encoding == encoding && hash.head_size == head.size() &&
+                                        hash.body_size == body.size()) {
+            lru_.splice(lru_.begin(), lru_, it->second);
+            ++stats_.hits;
+            const auto& variant = it->second->variant;
+            return variant->encoding == Encoding::identity ? nullptr : variant;
+        }
+        ++stats_.misses;
+        if (body.size() >= options_.offload_min) {
+            // sent as it is this time, the next requests find the variant
+            if (pending_.insert(key).second) {
+                asio::post(workers_, [this, owner = std::move(owner), head, body, hash, encoding, key] {
+                    Variant variant = compress_(head, body, encoding);
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    ++stats_.offloaded;
+                    pending_.erase(key);
+                    store_(key, hash, encoding, std::move(variant));
+                });
+            }
+            return nullptr;
+        }
+    }
+    Variant variant = compress_(head, body, encoding);
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        store_(key, hash, encoding, variant);
+    }
+    return variant->encoding == Encoding::identity ? nullptr : variant;
+}
+
+Compressor::Variant Compressor::compress(std::string_view head, std::string_view body, Encoding encoding) {
+    Variant variant = compress_(head, body, encoding);
+    return variant->encoding == Encoding::identity ? nullptr : variant;
+}
+
+void Compressor::Offload::await_suspend(std::coroutine_handle<> handle) {
+    asio::post(compressor_.workers_, [this, handle] {
+        variant_ = compressor_.compress(head_, body_, encoding_);
+        {
+            std::lock_guard<std::mutex> lock(compressor_.mutex_);
+            ++compressor_.stats_.offloaded;
+        }
+        // this awaiter lives in the coroutine's frame: nothing of it is touched once resumed
+        if (auto executor = executor_; executor != nullptr) {
+            executor->schedule([handle] { handle.resume(); });
+        } else {
+            handle.resume();
+        }
+    });
+}
+
+Compressor::Stats Compressor::stats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+}
+
+Compressor::Variant Compressor::compress_(std::string_view head, std::string_view body, Encoding encoding) {
+    auto variant = std::make_shared<CompressedVariant>();
+    bool ok = false;
+    if (encoding == Encoding::gzip) {
+        ok = cinatra::gzip_codec::compress(body, variant->body, options_.gzip_level);
+    } else if (encoding == Encoding::br) {
+        // one shot into a buffer of the worst case size: cinatra's br_codec
+        // has no quality setting and goes through a stringstream
+        size_t size = BrotliEncoderMaxCompressedSize(body.size());
+        variant->body.resize(size);
+        ok = size > 0 && BrotliEncoderCompress(options_.br_quality, BROTLI_DEFAULT_WINDOW, BROTLI_MODE_GENERIC,
+                                               body.size(), reinterpret_cast<const uint8_t*>(body.data()), &size,
+                                               reinterpret_cast<uint8_t*>(variant->body.data())) == BROTLI_TRUE;
+        variant->body.resize(ok ? size : 0);
+    }
+    // a few percent is not worth a Content-Encoding
+    bool shrunk = ok && variant->body.size() + body.size() / 32 < body.size();
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        ++stats_.compressed;
+        stats_.bytes_in += body.size();
+        stats_.bytes_out += shrunk ? variant->body.size() : body.size();
+        if (!shrunk) {
+            ++stats_.incompressible;
+        }
+    }
+    if (!shrunk) {
+        variant->body.clear();
+        variant->body.shrink_to_fit();
+        return variant;
+    }
+    variant->encoding = encoding;
+    if (!head.empty()) {
+        variant->head = compressed_head(head, variant->body.size(), encoding);
+    }
+    return variant;
+}
+
+void Compressor::store_(uint64_t key, const ContentHash& content, Encoding encoding, Variant variant) {
+    size_t cost = sizeof(CompressedVariant) + variant->head.size() + variant->body.size();
+    if (auto it = index_.find(key); it != index_.end()) {
+        erase_(it->second);
+    }
+    if (cost > options_.cache_size) {
+        return;
+    }
+    while (stats_.bytes + cost > options_.cache_size) {
+        erase_(std::prev(lru_.end()));
+        ++stats_.evictions;
+    }
+    lru_.push_front({key, content, encoding, std::move(variant), cost});
+    index_.emplace(key, lru_.begin());
+    stats_.bytes += cost;
+    stats_.entries = index_.size();
+}
+
+void Compressor::erase_(Lru::iterator it) {
+    stats_.bytes -= it->cost;
+    index_.erase(it->key);
+    lru_.erase(it);
+    stats_.entries = index_.size();
+}
+}  // namespace lynx
@@ -0,0 +1,157 @@
+#pragma once
+
+#include <array>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "asio.hpp"
+#include "async_simple/Executor.h"
+#include "options.hpp"
+
+namespace lynx {
+enum class Encoding { identity, gzip, br };
+
+std::string_view to_string(Encoding encoding);
+
+// What the variants of a head and body are cached under: the SHA-1 of both,
+// so a hit is never another response's body. Its first bytes index the cache.
+struct ContentHash {
+    std::array<uint8_t, 20> digest{};
+    size_t head_size{0};
+    size_t body_size{0};
+
+    uint64_t key() const;
+    bool operator==(const ContentHash&) const = default;
+};
+
+// A body compressed once, with the head to send it under when it was
+// compressed from a prepared head: Content-Length rewritten, Content-Encoding
+// and Vary added, the ETag weakened. identity means the body did not shrink,
+// the original is sent. Immutable, shared by the cache and the responses
+// still writing it.
+struct CompressedVariant {
+    Encoding encoding{Encoding::identity};
+    std::string head;
+    std::string body;
+};
+
+// gzip and br for the REST servers: picks the encoding from Accept-Encoding,
+// skips bodies that are small or of a type that does not compress (images,
+// archives...), and keeps the variants of the static files and of the cached
+// responses in an LRU keyed by content hash, so a body is compressed once
+// whatever the url it is served under. Bodies of offload_min bytes and up are
+// compressed on a pool of workers: a cacheable one is sent uncompressed until
+// its variant is ready, a dynamic one is awaited by its coroutine. Shared by
+// the io threads.
+class Compressor {
+  public:
+    using Variant = std::shared_ptr<const CompressedVariant>;
+
+    struct Stats {
+        uint64_t compressed{0};      // bodies compressed, on the io threads or the workers
+        uint64_t offloaded{0};       // of which on the workers
+        uint64_t incompressible{0};  // did not shrink
+        uint64_t hits{0};
+        uint64_t misses{0};
+        uint64_t evictions{0};
+        uint64_t bytes_in{0};  // of the bodies compressed
+        uint64_t bytes_out{0};
+        size_t entries{0};
+        size_t bytes{0};
+    };
+
+    explicit Compressor(CompressionOptions options);
+    // waits for the jobs running on the workers
+    ~Compressor();
+
+    Compressor(const Compressor&) = delete;
+    Compressor& operator=(const Compressor&) = delete;
+
+    const CompressionOptions& options() const { return options_; }
+
+    // the encoding the client prefers among those it accepts (q-values
+    // honoured, br on a tie), identity if none or compression is off
+    Encoding negotiate(std::string_view accept_encoding) const;
+    // text, json, javascript, xml, svg...: a mime type worth compressing
+    static bool compressible(std::string_view mime);
+    // a body worth compressing: large enough, of a compressible type
+    bool eligible(std::string_view mime, size_t size) const;
+    // same for a prepared head (see cinatra::coro_http_response::build_prepared_head()),
+    // which must not carry a Content-Encoding already
+    bool eligible_head(std::string_view head, size_t size) const;
+    // key of the variants: the head takes part, their head is derived from it.
+    // Computed once per cached content, when it is loaded or stored.
+    static ContentHash content_hash(std::string_view head, std::string_view body);
+
+    // The variant of a cacheable body (a static file, a cached response):
+    // a cached one, else compressed right away if it is small, else queued
+    // on the workers while the caller sends the body as it is. nullptr:
+    // send the original. owner keeps head and body alive for the workers.
+    Variant cached(std::shared_ptr<const void> owner, std::string_view head, std::string_view body,
+                   const ContentHash& hash, Encoding encoding);
+
+    // Compresses on the calling thread, without caching. head may be empty:
+    // the variant then has none. nullptr if the body did not shrink.
+    Variant compress(std::string_view head, std::string_view body, Encoding encoding);
+
+    // Compresses on a worker, the awaiting coroutine resumes on its own
+    // executor with what compress() returns. head and body must live until then.
+    class Offload {
+      public:
+        Offload(Compressor& compressor, std::string_view head, std::string_view body, Encoding encoding)
+            : compressor_(compressor), head_(head), body_(body), encoding_(encoding) {}
+
+        auto coAwait(async_simple::Executor* executor) {
+            executor_ = executor;
+            return std::move(*this);
+        }
+        bool await_ready() const noexcept { return false; }
+        void await_suspend(std::coroutine_handle<> handle);
+        Variant await_resume() { return std::move(variant_); }
+
+      private:
+        Compressor& compressor_;
+        std::string_view head_;
+        std::string_view body_;
+        Encoding encoding_;
+        async_simple::Executor* executor_{nullptr};
+        Variant variant_;
+    };
+    Offload offload(std::string_view head, std::string_view body, Encoding encoding) {
+        return Offload(*this, head, body, encoding);
+    }
+
+    Stats stats() const;
+
+  private:
+    struct Slot {
+        uint64_t key;
+        ContentHash content;  // checked on a hit, the key is only part of it
+        Encoding encoding;    // asked for, the variant's is identity if the body did not shrink
+        Variant variant;
+        size_t cost;
+    };
+    using Lru = std::list<Slot>;
+
+    // identity variant when the body did not shrink
+    Variant compress_(std::string_view head, std::string_view body, Encoding encoding);
+    void store_(uint64_t key, const ContentHash& content, Encoding encoding, Variant variant);
+    void erase_(Lru::iterator it);
+
+    const CompressionOptions options_;
+    asio::thread_pool workers_;
+    mutable std::mutex mutex_;
+    Lru lru_;  // most recently used first
+    std::unordered_map<uint64_t, Lru::iterator> index_;
+    std::unordered_set<uint64_t> pending_;  // keys being compressed on the workers
+    Stats stats_;
+};
+}  // namespace lynx
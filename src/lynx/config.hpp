@@ -1,12 +1,24 @@
 #pragma once
 
+#include <algorithm>
 #include <cstdio>
+#include <filesystem>
 #include <fstream>
+#include <functional>
 #include <iostream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
 #include <string>
+#include <utility>
+#include <vector>
 
 #include "CLI11.hpp"
 #include "config.h"
+#include "options.hpp"
+#include "snapshot.hpp"
+#include "spdlog/common.h"
 #include "toml.hpp"
 
 namespace lynx {
@@ -19,6 +31,16 @@ struct ConfigData {
     struct Sub {
         bool sub{false};
     } sub;
+    // file only data
+    LogOptions log;
+    ServerOptions server;
+    StaticOptions static_files;
+    CacheOptions cache;
+    UploadOptions upload;
+    CompressionOptions compression;
+    PubSubOptions pubsub;
+    SchedulerOptions scheduler;
+    ReplOptions repl;
 };
 }  // namespace lynx
 TOML11_DEFINE_CONVERSION_NON_INTRUSIVE(lynx::ConfigData::Sub, sub)
@@ -49,8 +71,73 @@ class Config {
         return instance;
     }
 
+    // as parsed at startup, what the subsystems are built from; not updated by
+    // reload(): the reloadable settings are read through snapshot() or handed
+    // to the subscribers
     const ConfigData& data() const { return data_; }
     ConfigData& data() { return data_; }
+
+    // The configuration in force, from any thread and without locking. A
+    // snapshot never changes: reload() publishes a new one (RCU style), the
+    // old one lives on as long as a reader holds it.
+    std::shared_ptr<const ConfigData> snapshot() const { return *current_.read(); }
+
+    // Called by reload() with the new snapshot when key changed: a full key
+    // ("log.level") or a section ("log" for any log.* key). Runs on the thread
+    // that reloads, must not call subscribe() or unsubscribe().
+    using Subscriber = std::function<void(const ConfigData& now)>;
+    size_t subscribe(std::string key, Subscriber fn) {
+        std::lock_guard<std::mutex> lock(subscribers_mutex_);
+        subscribers_.push_back({++last_subscription_, std::move(key), std::move(fn)});
+        return last_subscription_;
+    }
+    void unsubscribe(size_t id) {
+        std::lock_guard<std::mutex> lock(subscribers_mutex_);
+        std::erase_if(subscribers_, [id](const Subscription& s) { return s.id == id; });
+    }
+
+    // Re-reads the file only settings of the config file, validates them and
+    // publishes them, then notifies the subscribers of the keys that changed.
+    // Settings given on the command line are kept. Throws, leaving the
+    // configuration in force untouched, if the file is invalid. Blocks on the
+    // file: call it off the io threads.
+    std::vector<std::string> reload() {
+        std::lock_guard<std::mutex> reload_lock(reload_mutex_);
+        auto current = current_.current();
+        auto next = std::make_shared<ConfigData>(*current);
+        parse_toml(toml::parse(config_file_), *next);
+        resolve_paths(*next);
+        validate(*next);
+
+        std::vector<std::string> changed;
+        auto before = flatten(*current);
+        auto after = flatten(*next);
+        for (size_t i = 0; i < after.size(); ++i) {
+            if (before[i].second != after[i].second) {
+                changed.push_back(after[i].first);
+            }
+        }
+        if (changed.empty()) {
+            return changed;
+        }
+        current_.publish(next);
+
+        std::vector<Subscription> subscribers;
+        {
+            std::lock_guard<std::mutex> lock(subscribers_mutex_);
+            subscribers = subscribers_;
+        }
+        for (const auto& sub : subscribers) {
+            bool hit = std::any_of(changed.begin(), changed.end(), [&sub](const std::string& key) {
+                return key == sub.key || (key.size() > sub.key.size() && key.compare(0, sub.key.size(), sub.key) == 0 &&
+                                          key[sub.key.size()] == '.');
+            });
+            if (hit) {
+                sub.fn(*next);
+            }
+        }
+        return changed;
+    }
     CLI::App& cli() { return cli_; }
     toml::value& toml_root() { return toml_root_; }
     const std::string& config_file() const { return config_file_; }
@@ -88,9 +175,18 @@ class Config {
         try {
             // parse command line and config file related to cli
             cli_.parse(argc, argv);
-            config_file_ = cli_.get_config_ptr()->as<std::string>();
+            // absolute: reload() may run after the daemon changed directory
+            config_file_ = std::filesystem::absolute(cli_.get_config_ptr()->as<std::string>()).string();
+            start_dir_ = std::filesystem::current_path();
             std::cout << "Loaded configuration from: " << cli_.get_config_ptr()->as<std::string>() << std::endl;
             toml_root_ = toml::parse(config_file_);
+            parse_toml(toml_root_, data_);
+            resolve_paths(data_);
+            validate(data_);
+            {
+                std::lock_guard<std::mutex> lock(reload_mutex_);
+                current_.publish(std::make_shared<const ConfigData>(data_));
+            }
 
             override_toml();
         } catch (const CLI::ParseError& e) {
@@ -108,18 +204,47 @@ class Config {
 
     std::string toml_to_string() { return toml::format(toml_root_); }
 
-    std::string data_to_string() {
+    // the configuration in force, reloaded settings included
+    std::string data_to_string() const {
+        const auto current = snapshot();
+        const ConfigData& d = *current;
         std::stringstream ss;
-        ss << "data_.dae    : " << data_.dae << std::endl;
-        ss << "data_.port   : " << data_.port << std::endl;
-        ss << "data_.env    : " << data_.env << std::endl;
-        ss << "data_.pi     : " << data_.pi << std::endl;
-        ss << "data_.sub.sub: " << data_.sub.sub << std::endl;
+        ss << "data_.dae    : " << d.dae << std::endl;
+        ss << "data_.port   : " << d.port << std::endl;
+        ss << "data_.env    : " << d.env << std::endl;
+        ss << "data_.pi     : " << d.pi << std::endl;
+        ss << "data_.sub.sub: " << d.sub.sub << std::endl;
+        ss << "data_.log    : " << d.log.mode << ", level " << d.log.level << ", overflow " << d.log.overflow << ", queue "
+           << d.log.queue_size << ", batch " << d.log.batch_size << std::endl;
+        ss << "data_.server : " << d.server.address << ":" << d.server.port << ", threads "
+           << d.server.threads << ", cpu_affinity " << d.server.cpu_affinity << std::endl;
+        ss << "data_.static : " << (d.static_files.root.empty() ? "-" : d.static_files.root) << " on "
+           << d.static_files.prefix << ", cache " << d.static_files.cache_size << ", mmap "
+           << d.static_files.mmap_min << ", sendfile " << d.static_files.sendfile_min << ", watch "
+           << d.static_files.watch << std::endl;
+        ss << "data_.cache  :";
+        for (const auto& route : d.cache.routes) {
+            ss << " [" << route.route << ", ttl " << route.ttl_ms << "ms, max " << route.max_size << "]";
+        }
+        ss << std::endl;
+        ss << "data_.upload : stream " << d.upload.stream_min << ", window " << d.upload.window << ", max "
+           << d.upload.max_size << ", spill " << d.upload.spill_dir << std::endl;
+        ss << "data_.compression: " << (d.compression.enabled ? "on" : "off") << ", min "
+           << d.compression.min_size << ", offload " << d.compression.offload_min << ", threads "
+           << d.compression.threads << ", cache " << d.compression.cache_size << ", gzip "
+           << d.compression.gzip_level << ", br " << d.compression.br_quality << std::endl;
+        ss << "data_.pubsub : " << (d.pubsub.path.empty() ? "-" : d.pubsub.path) << ", queue "
+           << d.pubsub.queue_limit << ", slow " << d.pubsub.slow << ", history " << d.pubsub.history
+           << " / " << d.pubsub.history_bytes << ", channels " << d.pubsub.max_channels << std::endl;
+        ss << "data_.scheduler: tick " << d.scheduler.resolution_ms << " ms, threads " << d.scheduler.threads
+           << std::endl;
+        ss << "data_.repl   : telnet " << d.repl.port << ", sessions " << d.repl.max_sessions << ", idle "
+           << d.repl.idle_timeout_s << " s, threads " << d.repl.threads << std::endl;
         return ss.str();
     }
 
   private:
-    explicit Config() : cli_("Lynx Network Daemon") {
+    explicit Config() : current_(std::make_shared<const ConfigData>()), cli_("Lynx Network Daemon") {
         cli_.add_flag("-d,--dae", data_.dae, "Running program in daemon mode")
             ->group("Important");
 
@@ -144,6 +269,204 @@ class Config {
         sub->add_flag("-s,--sub", data_.sub.sub, "dae in sub");
     }
 
+    // settings that only live in the file, no cli option for them
+    static void parse_toml(const toml::value& root, ConfigData& data) {
+        if (root.contains("log")) {
+            const auto& log = root.at("log");
+            data.log.mode = toml::find_or<std::string>(log, "mode", data.log.mode);
+            data.log.level = toml::find_or<std::string>(log, "level", data.log.level);
+            data.log.overflow = toml::find_or<std::string>(log, "overflow", data.log.overflow);
+            data.log.queue_size = toml::find_or<size_t>(log, "queue_size", data.log.queue_size);
+            data.log.batch_size = toml::find_or<size_t>(log, "batch_size", data.log.batch_size);
+        }
+        if (root.contains("server")) {
+            const auto& server = root.at("server");
+            data.server.port = toml::find_or<unsigned short>(server, "port", data.server.port);
+            data.server.address = toml::find_or<std::string>(server, "address", data.server.address);
+            data.server.threads = toml::find_or<size_t>(server, "threads", data.server.threads);
+            data.server.cpu_affinity = toml::find_or<bool>(server, "cpu_affinity", data.server.cpu_affinity);
+        }
+        if (root.contains("static")) {
+            const auto& files = root.at("static");
+            data.static_files.root = toml::find_or<std::string>(files, "root", data.static_files.root);
+            data.static_files.prefix = toml::find_or<std::string>(files, "prefix", data.static_files.prefix);
+            data.static_files.cache_size = toml::find_or<size_t>(files, "cache_size", data.static_files.cache_size);
+            data.static_files.mmap_min = toml::find_or<size_t>(files, "mmap_min", data.static_files.mmap_min);
+            data.static_files.sendfile_min = toml::find_or<size_t>(files, "sendfile_min", data.static_files.sendfile_min);
+            data.static_files.watch = toml::find_or<bool>(files, "watch", data.static_files.watch);
+        }
+        if (root.contains("upload")) {
+            const auto& upload = root.at("upload");
+            data.upload.stream_min = toml::find_or<size_t>(upload, "stream_min", data.upload.stream_min);
+            data.upload.window = toml::find_or<size_t>(upload, "window", data.upload.window);
+            data.upload.max_size = toml::find_or<size_t>(upload, "max_size", data.upload.max_size);
+            data.upload.spill_dir = toml::find_or<std::string>(upload, "spill_dir", data.upload.spill_dir);
+        }
+        if (root.contains("compression")) {
+            const auto& compression = root.at("compression");
+            auto& c = data.compression;
+            c.enabled = toml::find_or<bool>(compression, "enabled", c.enabled);
+            c.min_size = toml::find_or<size_t>(compression, "min_size", c.min_size);
+            c.offload_min = toml::find_or<size_t>(compression, "offload_min", c.offload_min);
+            c.threads = toml::find_or<size_t>(compression, "threads", c.threads);
+            c.cache_size = toml::find_or<size_t>(compression, "cache_size", c.cache_size);
+            c.gzip_level = toml::find_or<int>(compression, "gzip_level", c.gzip_level);
+            c.br_quality = toml::find_or<int>(compression, "br_quality", c.br_quality);
+        }
+        if (root.contains("pubsub")) {
+            const auto& pubsub = root.at("pubsub");
+            data.pubsub.path = toml::find_or<std::string>(pubsub, "path", data.pubsub.path);
+            data.pubsub.queue_limit = toml::find_or<size_t>(pubsub, "queue_limit", data.pubsub.queue_limit);
+            data.pubsub.slow = toml::find_or<std::string>(pubsub, "slow", data.pubsub.slow);
+            data.pubsub.history = toml::find_or<size_t>(pubsub, "history", data.pubsub.history);
+            data.pubsub.history_bytes = toml::find_or<size_t>(pubsub, "history_bytes", data.pubsub.history_bytes);
+            data.pubsub.max_channels = toml::find_or<size_t>(pubsub, "max_channels", data.pubsub.max_channels);
+        }
+        if (root.contains("scheduler")) {
+            const auto& scheduler = root.at("scheduler");
+            data.scheduler.resolution_ms =
+                toml::find_or<size_t>(scheduler, "resolution_ms", data.scheduler.resolution_ms);
+            data.scheduler.threads = toml::find_or<size_t>(scheduler, "threads", data.scheduler.threads);
+        }
+        if (root.contains("repl")) {
+            const auto& repl = root.at("repl");
+            data.repl.port = toml::find_or<uint16_t>(repl, "port", data.repl.port);
+            data.repl.max_sessions = toml::find_or<size_t>(repl, "max_sessions", data.repl.max_sessions);
+            data.repl.idle_timeout_s = toml::find_or<size_t>(repl, "idle_timeout_s", data.repl.idle_timeout_s);
+            data.repl.threads = toml::find_or<size_t>(repl, "threads", data.repl.threads);
+        }
+        // [[cache.routes]] replaces the routes as a whole: a reload may drop some
+        data.cache.routes.clear();
+        if (root.contains("cache") && root.at("cache").contains("routes")) {
+            for (const auto& table : toml::find<toml::array>(root.at("cache"), "routes")) {
+                CacheRouteOptions route;
+                route.route = toml::find<std::string>(table, "route");
+                route.ttl_ms = toml::find_or<size_t>(table, "ttl_ms", route.ttl_ms);
+                route.max_size = toml::find_or<size_t>(table, "max_size", route.max_size);
+                route.vary = toml::find_or<std::vector<std::string>>(table, "vary", route.vary);
+                data.cache.routes.push_back(std::move(route));
+            }
+        }
+    }
+
+    // relative paths of the file are relative to the directory lynx started in, not to the daemon's
+    void resolve_paths(ConfigData& data) const {
+        if (!data.static_files.root.empty()) {
+            data.static_files.root = (start_dir_ / data.static_files.root).lexically_normal().string();
+        }
+        data.upload.spill_dir = (start_dir_ / data.upload.spill_dir).lexically_normal().string();
+    }
+
+    // throws std::invalid_argument
+    static void validate(const ConfigData& data) {
+        if (data.log.mode != "sync" && data.log.mode != "async") {
+            throw std::invalid_argument("unknown log mode: " + data.log.mode + " (expected sync or async)");
+        }
+        if (spdlog::level::from_str(data.log.level) == spdlog::level::off && data.log.level != "off") {
+            throw std::invalid_argument("unknown log level: " + data.log.level);
+        }
+        overflow_policy_from_string(data.log.overflow);
+        if (data.log.queue_size == 0 || data.log.batch_size == 0) {
+            throw std::invalid_argument("log queue_size and batch_size must be positive");
+        }
+        std::error_code ec;
+        if (!data.static_files.root.empty() && !std::filesystem::is_directory(data.static_files.root, ec)) {
+            throw std::invalid_argument("static root is not a directory: " + data.static_files.root);
+        }
+        if (data.static_files.mmap_min > data.static_files.sendfile_min) {
+            throw std::invalid_argument("static mmap_min must not exceed sendfile_min");
+        }
+        if (data.upload.stream_min == 0 || data.upload.window == 0) {
+            throw std::invalid_argument("upload stream_min and window must be positive");
+        }
+        if (!std::filesystem::is_directory(data.upload.spill_dir, ec)) {
+            throw std::invalid_argument("upload spill_dir is not a directory: " + data.upload.spill_dir);
+        }
+        if (data.compression.threads == 0) {
+            throw std::invalid_argument("compression threads must be positive");
+        }
+        if (data.compression.gzip_level < 1 || data.compression.gzip_level > 9 || data.compression.br_quality < 0 ||
+            data.compression.br_quality > 11) {
+            throw std::invalid_argument("compression gzip_level must be 1 to 9 and br_quality 0 to 11");
+        }
+        if (!data.pubsub.path.empty() && data.pubsub.path.front() != '/') {
+            throw std::invalid_argument("pubsub path must start with /: " + data.pubsub.path);
+        }
+        if (data.pubsub.queue_limit == 0 || data.pubsub.max_channels == 0) {
+            throw std::invalid_argument("pubsub queue_limit and max_channels must be positive");
+        }
+        slow_consumer_from_string(data.pubsub.slow);
+        if (data.scheduler.resolution_ms == 0 || data.scheduler.threads == 0) {
+            throw std::invalid_argument("scheduler resolution_ms and threads must be positive");
+        }
+        if (data.repl.max_sessions == 0 || data.repl.threads == 0) {
+            throw std::invalid_argument("repl max_sessions and threads must be positive");
+        }
+        for (const auto& route : data.cache.routes) {
+            if (route.ttl_ms == 0 || route.max_size == 0) {
+                throw std::invalid_argument("cache ttl_ms and max_size must be positive: " + route.route);
+            }
+        }
+    }
+
+    // every reloadable setting by key, in a fixed order
+    static std::vector<std::pair<std::string, std::string>> flatten(const ConfigData& data) {
+        auto str = [](const auto& v) {
+            std::ostringstream ss;
+            ss << v;
+            return ss.str();
+        };
+        std::string cache_routes;
+        for (const auto& route : data.cache.routes) {
+            cache_routes += route.route + " ttl_ms=" + str(route.ttl_ms) + " max_size=" + str(route.max_size) + " vary=";
+            for (const auto& header : route.vary) {
+                cache_routes += header + ",";
+            }
+            cache_routes += ";";
+        }
+        return {
+            {"log.mode", data.log.mode},
+            {"log.level", data.log.level},
+            {"log.overflow", data.log.overflow},
+            {"log.queue_size", str(data.log.queue_size)},
+            {"log.batch_size", str(data.log.batch_size)},
+            {"server.port", str(data.server.port)},
+            {"server.address", data.server.address},
+            {"server.threads", str(data.server.threads)},
+            {"server.cpu_affinity", str(data.server.cpu_affinity)},
+            {"static.root", data.static_files.root},
+            {"static.prefix", data.static_files.prefix},
+            {"static.cache_size", str(data.static_files.cache_size)},
+            {"static.mmap_min", str(data.static_files.mmap_min)},
+            {"static.sendfile_min", str(data.static_files.sendfile_min)},
+            {"static.watch", str(data.static_files.watch)},
+            {"cache.routes", cache_routes},
+            {"upload.stream_min", str(data.upload.stream_min)},
+            {"upload.window", str(data.upload.window)},
+            {"upload.max_size", str(data.upload.max_size)},
+            {"upload.spill_dir", data.upload.spill_dir},
+            {"compression.enabled", str(data.compression.enabled)},
+            {"compression.min_size", str(data.compression.min_size)},
+            {"compression.offload_min", str(data.compression.offload_min)},
+            {"compression.threads", str(data.compression.threads)},
+            {"compression.cache_size", str(data.compression.cache_size)},
+            {"compression.gzip_level", str(data.compression.gzip_level)},
+            {"compression.br_quality", str(data.compression.br_quality)},
+            {"pubsub.path", data.pubsub.path},
+            {"pubsub.queue_limit", str(data.pubsub.queue_limit)},
+            {"pubsub.slow", data.pubsub.slow},
+            {"pubsub.history", str(data.pubsub.history)},
+            {"pubsub.history_bytes", str(data.pubsub.history_bytes)},
+            {"pubsub.max_channels", str(data.pubsub.max_channels)},
+            {"scheduler.resolution_ms", str(data.scheduler.resolution_ms)},
+            {"scheduler.threads", str(data.scheduler.threads)},
+            {"repl.port", str(data.repl.port)},
+            {"repl.max_sessions", str(data.repl.max_sessions)},
+            {"repl.idle_timeout_s", str(data.repl.idle_timeout_s)},
+            {"repl.threads", str(data.repl.threads)},
+        };
+    }
+
     void override_toml() {
         // toml_root_["pi"].as_floating_fmt().prec = 16;
         toml_root_["pi"] = data_.pi;
@@ -171,11 +494,23 @@ class Config {
         return true;
     }
 
+    struct Subscription {
+        size_t id;
+        std::string key;
+        Subscriber fn;
+    };
+
     // 配置数据存储
     ConfigData data_;
+    SnapshotCell<std::shared_ptr<const ConfigData>> current_;  // published under reload_mutex_
+    std::mutex reload_mutex_;
+    std::mutex subscribers_mutex_;
+    std::vector<Subscription> subscribers_;
+    size_t last_subscription_{0};
     CLI::App cli_;
     toml::value toml_root_;
     std::string config_file_;
+    std::filesystem::path start_dir_;
 };
 
 }  // namespace lynx
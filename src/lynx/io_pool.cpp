@@ -0,0 +1,78 @@
+#include "io_pool.hpp"
+
+#include <pthread.h>
+#include <sched.h>
+
+#include <algorithm>
+#include <iostream>
+
+namespace lynx {
+namespace {
+// the cores lynx may run on (taskset, cgroups), in order
+std::vector<int> allowed_cpus() {
+    std::vector<int> cpus;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+        for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+            if (CPU_ISSET(cpu, &set)) {
+                cpus.push_back(cpu);
+            }
+        }
+    }
+    return cpus;
+}
+}  // namespace
+
+IoContextPool::IoContextPool(size_t threads, bool cpu_affinity) : cpu_affinity_(cpu_affinity) {
+    if (threads == 0) {
+        threads = allowed_cpus().size();
+    }
+    if (threads == 0) {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    contexts_.reserve(threads);
+    guards_.reserve(threads);
+    for (size_t i = 0; i < threads; ++i) {
+        // a context is only ever run by its own thread
+        contexts_.push_back(std::make_unique<asio::io_context>(1));
+        guards_.push_back(asio::make_work_guard(*contexts_.back()));
+    }
+}
+
+IoContextPool::~IoContextPool() { stop(); }
+
+void IoContextPool::start() {
+    if (!threads_.empty()) {
+        return;
+    }
+    std::vector<int> cpus = cpu_affinity_ ? allowed_cpus() : std::vector<int>{};
+    for (size_t i = 0; i < contexts_.size(); ++i) {
+        threads_.emplace_back([ctx = contexts_[i].get()] { ctx->run(); });
+        if (cpus.empty()) {
+            continue;
+        }
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cpus[i % cpus.size()], &set);
+        int rc = pthread_setaffinity_np(threads_.back().native_handle(), sizeof(set), &set);
+        if (rc != 0) {
+            std::cerr << "Failed to pin io thread " << i << " to cpu " << cpus[i % cpus.size()] << ": " << rc
+                      << std::endl;
+        }
+    }
+}
+
+void IoContextPool::stop() {
+    guards_.clear();
+    for (auto& ctx : contexts_) {
+        ctx->stop();
+    }
+    for (auto& t : threads_) {
+        if (t.joinable()) {
+            t.join();
+        }
+    }
+    threads_.clear();
+}
+}  // namespace lynx
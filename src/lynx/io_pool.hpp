@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "asio.hpp"
+#include "options.hpp"
+
+namespace lynx {
+// Data plane of lynx: one io_context per thread, thread per core. Nothing is
+// shared between the contexts, a connection lives and dies on the context
+// that accepted it, so the threads never contend on a reactor or a strand.
+// Control plane work (signals, REPL, config) stays on the main io_context.
+class IoContextPool {
+  public:
+    IoContextPool(size_t threads, bool cpu_affinity);
+    // stop()
+    ~IoContextPool();
+
+    IoContextPool(const IoContextPool&) = delete;
+    IoContextPool& operator=(const IoContextPool&) = delete;
+
+    size_t size() const { return contexts_.size(); }
+    asio::io_context& context(size_t i) { return *contexts_[i]; }
+
+    // Threads do not survive fork(): start them once the process is daemonized.
+    void start();
+    // Stops the contexts, dropping what is still queued, and joins the threads.
+    // The servers running on them must be stopped first.
+    void stop();
+
+  private:
+    std::vector<std::unique_ptr<asio::io_context>> contexts_;
+    std::vector<asio::executor_work_guard<asio::io_context::executor_type>> guards_;
+    std::vector<std::thread> threads_;
+    const bool cpu_affinity_;
+};
+}  // namespace lynx
@@ -1,47 +1,78 @@
 #include "log.hpp"
 
+#include <stdexcept>
+
 #include "spdlog/pattern_formatter.h"
 // #include "spdlog/sinks/basic_file_sink.h"
 #include "spdlog/sinks/daily_file_sink.h"
-#include "spdlog/sinks/ostream_sink.h"
 // #include "spdlog/sinks/rotating_file_sink.h"
 #include "spdlog/sinks/stdout_color_sinks.h"
 #include "spdlog/spdlog.h"
 
 namespace lynx {
 std::mutex LoggerConfig::sink_mutex_;
+std::shared_ptr<AsyncFileSink> LoggerConfig::async_sink_;
+std::shared_ptr<MonitorSink> LoggerConfig::monitor_sink_;
 
-void LoggerConfig::init() {
+void LoggerConfig::init(const LogOptions& options) {
     std::lock_guard<std::mutex> lock(sink_mutex_);
 
     try {
         // default sink
-        auto file_sink_ = std::make_shared<spdlog::sinks::daily_file_sink_mt>(
-            "logs/daily.log", 00, 00, false);
-        file_sink_->set_formatter(spdlog::details::make_unique<spdlog::json_formatter>());
-        file_sink_->set_populators(
-            spdlog::details::make_unique<spdlog::populators::date_time_populator>(),
-            spdlog::details::make_unique<spdlog::populators::level_populator>(),
-            spdlog::details::make_unique<spdlog::populators::thread_id_populator>(),
-            spdlog::details::make_unique<spdlog::populators::src_loc_populator>(),
-            spdlog::details::make_unique<spdlog::populators::pid_populator>(),
-            spdlog::details::make_unique<spdlog::populators::thread_id_populator>(),
-            spdlog::details::make_unique<spdlog::populators::timestamp_populator>(),
-            spdlog::details::make_unique<spdlog::populators::message_populator>());
-        file_sink_->set_level(spdlog::level::debug);
+        spdlog::sink_ptr file_sink_;
+        bool async = options.mode == "async";
+        if (async) {
+            // the io_context threads only queue the record, a writer thread formats and writes it
+            async_sink_ = std::make_shared<AsyncFileSink>("logs/daily.log", options.queue_size,
+                                                          overflow_policy_from_string(options.overflow),
+                                                          options.batch_size);
+            file_sink_ = async_sink_;
+        } else if (options.mode == "sync") {
+            file_sink_ = std::make_shared<spdlog::sinks::daily_file_sink_mt>(
+                "logs/daily.log", 00, 00, false);
+        } else {
+            throw std::invalid_argument("unknown log mode: " + options.mode + " (expected sync or async)");
+        }
+        namespace pop = spdlog::populators;
+        file_sink_->set_populators(pop::make_populator_set<pop::date_time, pop::timestamp, pop::level, pop::pid,
+                                                           pop::thread_id, pop::src_loc, pop::message>());
+        // the logger level decides, it can be changed on the fly
+        file_sink_->set_level(spdlog::level::trace);
+
+        // one sink for every monitoring REPL session, formats a record once for all of them
+        if (!monitor_sink_) {
+            monitor_sink_ = std::make_shared<MonitorSink>();
+        }
+        monitor_sink_->set_level(spdlog::level::trace);
 
-        auto logger_ = std::make_shared<spdlog::logger>("default_sink", file_sink_);
-        logger_->set_level(spdlog::level::debug);
-        logger_->flush_on(spdlog::level::info);
+        auto logger_ = std::make_shared<spdlog::logger>("default_sink", spdlog::sinks_init_list{file_sink_, monitor_sink_});
+        logger_->set_level(spdlog::level::from_str(options.level));
+        if (!async) {
+            logger_->flush_on(spdlog::level::info);
+        }
 
         spdlog::set_default_logger(logger_);
-        spdlog::info("Global logger initialized successfully");
+        spdlog::info("Global logger initialized successfully", {{"mode", options.mode}});
     } catch (const spdlog::spdlog_ex& ex) {
         std::cerr << "Log initialization failed: " << ex.what() << std::endl;
         throw;
     }
 }
 
+void LoggerConfig::before_fork() {
+    std::lock_guard<std::mutex> lock(sink_mutex_);
+    if (async_sink_) {
+        async_sink_->stop_writer();
+    }
+}
+
+void LoggerConfig::after_fork() {
+    std::lock_guard<std::mutex> lock(sink_mutex_);
+    if (async_sink_) {
+        async_sink_->start_writer();
+    }
+}
+
 void LoggerConfig::add_console_sink() {
     std::lock_guard<std::mutex> lock(sink_mutex_);
     try {
@@ -54,28 +85,6 @@ void LoggerConfig::add_console_sink() {
     }
 }
 
-void LoggerConfig::add_stream_sink(std::ostream& os) {
-    std::lock_guard<std::mutex> lock(sink_mutex_);
-    try {
-        auto os_sink_ = std::make_shared<spdlog::sinks::ostream_sink_mt>(os);
-        os_sink_->set_pattern("[%D %H:%M:%S.%e] [%^%L%$] [%t] %@ %v");
-        spdlog::default_logger()->sinks().push_back(os_sink_);
-    } catch (const spdlog::spdlog_ex& ex) {
-        spdlog::error("Failed to add ostream sink: {}", ex.what());
-    }
-}
-
-void LoggerConfig::remove_all_stream_sink() {
-    // spdlog::default_logger()->sinks().pop_back();
-    auto sinks = spdlog::default_logger()->sinks();
-    sinks.erase(
-        std::remove_if(sinks.begin(), sinks.end(), [](const std::shared_ptr<spdlog::sinks::sink>& sink) {
-            return std::dynamic_pointer_cast<spdlog::sinks::ostream_sink_mt>(sink) != nullptr;
-        }),
-        sinks.end());
-    spdlog::default_logger()->sinks() = sinks;
-}
-
 // void LoggerConfig::AddFileSink(const std::string& filename, bool truncate) {
 //     std::lock_guard<std::mutex> lock(sink_mutex_);
 
@@ -1,21 +1,32 @@
 #pragma once
 
+#include <cstddef>
 #include <iostream>
 #include <memory>
 #include <mutex>
+#include <string>
+
+#include "async_log.hpp"
+#include "monitor.hpp"
+#include "options.hpp"
 
 namespace lynx {
 class LoggerConfig {
   public:
-    static void init();
+    static void init(const LogOptions& options = {});
+    // null in sync mode
+    static std::shared_ptr<AsyncFileSink> async_sink() { return async_sink_; }
+    // the async writer thread does not survive fork()
+    static void before_fork();
+    static void after_fork();
     // static void init_from_file(const std::string& config_file);
     // static void Shutdown();
 
     // static void SetGlobalLevel(spdlog::level::level_enum level);
 
     static void add_console_sink();
-    static void add_stream_sink(std::ostream &os);
-    static void remove_all_stream_sink();
+    // REPL monitor mode: sessions attach their stream to this sink
+    static std::shared_ptr<MonitorSink> monitor() { return monitor_sink_; }
     // static void AddFileSink(const std::string& filename, bool truncate = true);
     // static void AddRotatingFileSink(const std::string& filename, size_t max_size, size_t max_files);
     // static bool RemoveSinkByPattern(const std::string& pattern);
@@ -25,5 +36,7 @@ class LoggerConfig {
     // static void SetupFromConfig(const std::string& config_file);
 
     static std::mutex sink_mutex_;
+    static std::shared_ptr<AsyncFileSink> async_sink_;
+    static std::shared_ptr<MonitorSink> monitor_sink_;
 };
 }  // namespace lynx
\ No newline at end of file
@@ -1,10 +1,14 @@
 
+#include <array>
+
 #include "asio.hpp"
 #include "config.hpp"
 #include "daemon.hpp"
+#include "io_pool.hpp"
 #include "log.hpp"
 #include "repl.hpp"
 #include "rest_server.hpp"
+#include "scheduler.hpp"
 #include "spdlog/spdlog.h"
 #include "toml.hpp"
 
@@ -16,15 +20,31 @@ namespace backward {
 backward::SignalHandling sh;
 }
 
+// Re-reads lynx.toml on the worker, the io thread goes on meanwhile.
+void reload_config(asio::thread_pool& worker) {
+    asio::post(worker, [] {
+        try {
+            auto changed = lynx::Config::instance().reload();
+            std::string keys;
+            for (const auto& key : changed) {
+                keys += keys.empty() ? key : " " + key;
+            }
+            spdlog::info("Configuration reloaded", {{"changed", keys}});
+        } catch (const std::exception& e) {
+            spdlog::error("Configuration reload failed, keeping the current one", {{"error", e.what()}});
+        }
+    });
+}
+
 void handle_signal(const std::error_code& ec, int signal_number,
-                   asio::signal_set& signals) {
+                   asio::signal_set& signals, asio::thread_pool& worker) {
     if (!ec) {
         std::cout << "Received signal: " << signal_number << std::endl;
         // 根据信号值区分不同信号并处理
         switch (signal_number) {
             case SIGHUP:
                 std::cout << "Received SIGHUP (hangup)" << std::endl;
-                // 可以在这里处理配置文件重新加载等逻辑
+                reload_config(worker);
                 break;
             case SIGUSR1:
                 break;
@@ -33,29 +53,12 @@ void handle_signal(const std::error_code& ec, int signal_number,
         }
 
         // Re-arm the signal handler to catch SIGHUP again
-        signals.async_wait([&signals](const asio::error_code& ec, int signal_number) {
-            handle_signal(ec, signal_number, signals);
+        signals.async_wait([&signals, &worker](const asio::error_code& ec, int signal_number) {
+            handle_signal(ec, signal_number, signals, worker);
         });
     }
 }
 
-void print(const std::error_code& ec, asio::steady_timer* t, int* count) {
-    if (!ec) {
-        if (*count) {
-            // std::cout << *count << std::endl;
-            spdlog::info("count: {}", *count);
-            --(*count);
-
-            t->expires_at(t->expiry() + asio::chrono::seconds(1));
-            t->async_wait(std::bind(print, asio::placeholders::error, t, count));
-        }
-    } else if (ec == asio::error::operation_aborted) {
-        std::cout << "Timer was cancelled\n";
-    } else {
-        std::cout << "Timer error: " << ec.message() << "\n";
-    }
-}
-
 int main(int argc, char** argv) {
     try {
         // parse command line args
@@ -100,11 +103,11 @@ int main(int argc, char** argv) {
         std::cout << "save : " << cfg.config_file() + ".sav" << std::endl;
 
         // init log
-        lynx::LoggerConfig::init();
+        lynx::LoggerConfig::init(cfg.data().log);
         if (!cfg.data().dae) {
             lynx::LoggerConfig::add_console_sink();
         }
-        spdlog::info("Welcome to spdlog!")({{"key1", 10}, {"k2", "val2"}});
+        spdlog::info("Welcome to spdlog!", {{"key1", 10}, {"k2", "val2"}});
         spdlog::error("Some error message with arg: {}", 1);
         spdlog::warn("Easy padding in numbers like {:08d}", 12);
         spdlog::critical("Support for int: {0:d};  hex: {0:x};  oct: {0:o}; bin: {0:b}", 42);
@@ -112,44 +115,20 @@ int main(int argc, char** argv) {
         spdlog::info("Positional args are {1} {0}..", "too", "supported");
         spdlog::info("{:<30}", "left aligned");
 
-        // main application that creates an asio io_context and uses it
+        // main application that creates an asio io_context and uses it:
+        // control plane only (signals, REPL, timers), requests are served by the io pool
         asio::io_context io_ctx;
 
-        // Timers
-        int count = 5;
-        // asio::steady_timer t(io_ctx, asio::chrono::seconds(1));
-        asio::steady_timer t(io_ctx);
-        t.expires_at(std::chrono::steady_clock::now());
-        t.async_wait(std::bind(print, asio::placeholders::error, &t, &count));
-
-        asio::steady_timer timer(io_ctx, std::chrono::milliseconds(1500));
-        timer.async_wait([&timer, &t, &count](const std::error_code&) {
-            // std::cout << "Steady Timer expired!\n";
-            spdlog::info("Steady Timer expired!")({{"left", count}});
-
-            t.cancel();
-            count = 100;
-            t.expires_after(std::chrono::seconds(2));
-            t.async_wait(std::bind(print, asio::placeholders::error, &t, &count));
-        });
-
-        // Http REST API 服务器
-        lynx::RestServer rest(io_ctx, 8080, "0.0.0.0");
-        rest.setup_routes();
-        rest.server().async_start();
-
-        // REPL setup
-        lynx::Repl repl(io_ctx);
+        // REPL setup: its async command workers start with the first of them, so once daemonized
+        lynx::Repl repl(io_ctx, cfg.data().repl.threads);
         if (!cfg.data().dae) {
             repl.start_local_terminal_session();
             repl.local_session->ExitAction(
                 [&](auto& out) {
                     out << "Closing App by Cli...\n";
-                    rest.server().stop();
                     repl.stop();
                 });
         }
-        repl.start_telnet_session(8888);
         std::ifstream infile("etc/repl.in");
         if (infile.is_open()) {
             std::ofstream outfile("etc/repl.out");
@@ -163,27 +142,114 @@ int main(int argc, char** argv) {
         exit_signals.async_wait([&](std::error_code ec, int signo) {
             // std::thread([&] { rest.server().stop(); }).detach();
             std::cout << "Closing App due to signal" << signo << "...\n";
-            rest.server().stop();
             repl.stop();
         });
 
-        // Register other signal handler.
-        asio::signal_set user_signals(io_ctx, SIGHUP, SIGUSR1, SIGUSR2);
-        user_signals.async_wait([&user_signals](const std::error_code& ec, int signal_number) {
-            handle_signal(ec, signal_number, user_signals);
-        });
-
         // Prepare daemon
         lynx::Daemon dae(io_ctx);
         if (cfg.data().dae) {
+            lynx::LoggerConfig::before_fork();
             dae.daemonize();
+            lynx::LoggerConfig::after_fork();
             std::cout << "daemon start: " << getpid() << std::endl;
         }
 
+        // Timers: one wheel ticking on io_ctx, periodic tasks keep their cadence and run on
+        // its workers when offloaded; the workers start once daemonized
+        const auto& scheduler_opts = cfg.data().scheduler;
+        lynx::TimerWheel timers(io_ctx, {.resolution = std::chrono::milliseconds(scheduler_opts.resolution_ms)});
+        lynx::PeriodicScheduler periodic(timers, scheduler_opts);
+        repl.show_tasks(periodic);
+        // telnet REPL: capped, its idle sessions closed on the wheel
+        repl.start_telnet_session(cfg.data().repl, timers);
+        int count = 5;
+        periodic.add("count", {.interval = std::chrono::seconds(1)}, [&count] {
+            if (count > 0) {
+                spdlog::info("count: {}", count--);
+            }
+        });
+        timers.schedule(std::chrono::milliseconds(1500), [&count] {
+            spdlog::info("Steady Timer expired!", {{"left", count}});
+            count = 100;
+        });
+
+        // Http REST API 服务器: one io_context and one SO_REUSEPORT listener per core,
+        // threads do not survive fork() so they start once daemonized
+        const auto& server_opts = cfg.data().server;
+        lynx::IoContextPool io_pool(server_opts.threads, server_opts.cpu_affinity);
+        io_pool.start();
+        // 压缩: gzip / br negotiated per request, large bodies compressed on its own workers
+        lynx::Compressor compressor(cfg.data().compression);
+        lynx::RestServer rest(io_pool, server_opts.port, server_opts.address);
+        rest.setup_routes();
+        rest.compress_with(compressor);
+        // 响应缓存: routes listed under [[cache.routes]], reloaded on SIGHUP
+        rest.configure_cache(cfg.data().cache);
+        // 流式上传: large bodies are read by the handler a window at a time
+        rest.configure_uploads(cfg.data().upload);
+        // 静态文件: LRU cache in memory, large files by sendfile(), invalidated by inotify on io_ctx
+        std::unique_ptr<lynx::StaticFiles> static_files;
+        if (!cfg.data().static_files.root.empty()) {
+            static_files = std::make_unique<lynx::StaticFiles>(io_ctx, cfg.data().static_files);
+            static_files->compress_with(compressor);
+            rest.serve_static(*static_files);
+            spdlog::info("Serving static files", {{"root", static_files->options().root},
+                                                  {"prefix", static_files->options().prefix},
+                                                  {"watching", static_files->watching()}});
+        }
+        // 发布订阅: websocket clients subscribe to channels, each message is framed once for all of them
+        std::unique_ptr<lynx::PubSubHub> pubsub;
+        if (!cfg.data().pubsub.path.empty()) {
+            pubsub = std::make_unique<lynx::PubSubHub>(cfg.data().pubsub);
+            rest.serve_pubsub(*pubsub);
+            spdlog::info("Serving pub/sub", {{"path", pubsub->options().path},
+                                             {"queue_limit", pubsub->options().queue_limit},
+                                             {"slow", pubsub->options().slow}});
+        }
+        rest.async_start();
+        spdlog::info("REST server started", {{"port", server_opts.port}, {"threads", rest.size()}});
+
+        // Register other signal handler: SIGHUP reloads lynx.toml on a worker thread
+        asio::thread_pool config_worker(1);
+        asio::signal_set user_signals(io_ctx, SIGHUP, SIGUSR1, SIGUSR2);
+        user_signals.async_wait([&user_signals, &config_worker](const std::error_code& ec, int signal_number) {
+            handle_signal(ec, signal_number, user_signals, config_worker);
+        });
+        cfg.subscribe("log.level", [](const lynx::ConfigData& now) {
+            spdlog::default_logger()->set_level(spdlog::level::from_str(now.log.level));
+        });
+        // built once from the startup settings: a reload only warns
+        static constexpr std::array<const char*, 7> kRestartOnly = {"server", "static", "compression", "upload",
+                                                                    "repl",   "pubsub", "scheduler"};
+        for (const char* section : kRestartOnly) {
+            cfg.subscribe(section, [section](const lynx::ConfigData&) {
+                spdlog::warn("[{}] settings take effect after a restart", section);
+            });
+        }
+        cfg.subscribe("cache", [&rest](const lynx::ConfigData& now) {
+            try {
+                rest.configure_cache(now.cache);
+            } catch (const std::exception& e) {
+                spdlog::warn("[cache] not applied, keeping the previous one", {{"error", e.what()}});
+            }
+        });
+        cfg.subscribe("log", [](const lynx::ConfigData& now) {
+            auto old = lynx::Config::instance().data().log;
+            if (old.mode != now.log.mode || old.overflow != now.log.overflow || old.queue_size != now.log.queue_size ||
+                old.batch_size != now.log.batch_size) {
+                spdlog::warn("[log] mode and queue settings take effect after a restart");
+            }
+        });
+
         // start the asio io_context
         // auto work = asio::make_work_guard(io_ctx);
         io_ctx.run();
 
+        // the control plane is done: close the acceptors, then stop the io threads
+        rest.stop();
+        io_pool.stop();
+        config_worker.join();
+
     } catch (const std::exception& e) {
         std::cerr << "Exception caught in main: " << e.what() << '\n';
     } catch (...) {
@@ -0,0 +1,241 @@
+#include "monitor.hpp"
+
+#include <algorithm>
+#include <optional>
+#include <stdexcept>
+
+#include "cli/cli.h"
+#include "spdlog/details/json_writer.h"
+#include "spdlog/pattern_formatter.h"
+
+namespace lynx {
+namespace {
+constexpr const char* kDefaultPattern = "[%D %H:%M:%S.%e] [%L] [%t] %@ %v";
+
+// a structured value as the filter spells it: strings unquoted, the rest as json
+std::string field_value(const spdlog::field& f) {
+    switch (f.kind) {
+        case spdlog::field::type::int64:
+            return std::to_string(f.i);
+        case spdlog::field::type::uint64:
+            return std::to_string(f.u);
+        case spdlog::field::type::float64:
+            return nlohmann::json(f.d).dump();
+        case spdlog::field::type::boolean:
+            return f.b ? "true" : "false";
+        case spdlog::field::type::string:
+            return std::string(f.str.data(), f.str.size());
+    }
+    return {};
+}
+
+bool has_value(const spdlog::details::log_msg& msg, const std::string& key, const std::string& value) {
+    // fields win over params of the same key, the last field over the previous ones
+    for (size_t i = msg.fields_count; i > 0; --i) {
+        const spdlog::field& f = msg.fields[i - 1];
+        if (f.key == key) {
+            if (f.kind == spdlog::field::type::string) {
+                return f.str == value;
+            }
+            return field_value(f) == value;
+        }
+    }
+    if (msg.params == nullptr || !msg.params->is_object()) {
+        return false;
+    }
+    auto it = msg.params->find(key);
+    if (it == msg.params->end()) {
+        return false;
+    }
+    if (it->is_string()) {
+        return it->get_ref<const std::string&>() == value;
+    }
+    return it->dump() == value;
+}
+}  // namespace
+
+MonitorFilter MonitorFilter::parse(const std::vector<std::string>& args) {
+    MonitorFilter filter;
+    for (const auto& arg : args) {
+        if (arg.rfind("level=", 0) == 0) {
+            std::string name = arg.substr(6);
+            filter.level = spdlog::level::from_str(name);
+            if (filter.level == spdlog::level::off && name != "off") {
+                throw std::invalid_argument("unknown log level: " + name);
+            }
+        } else if (arg.rfind("key=", 0) == 0) {
+            auto colon = arg.find(':', 4);
+            if (colon == std::string::npos || colon == 4) {
+                throw std::invalid_argument("expected key=<key>:<value>, got " + arg);
+            }
+            filter.keys.emplace_back(arg.substr(4, colon - 4), arg.substr(colon + 1));
+        } else {
+            throw std::invalid_argument("unknown monitor filter: " + arg + " (expected level=<level> or key=<key>:<value>)");
+        }
+    }
+    return filter;
+}
+
+bool MonitorFilter::matches(const spdlog::details::log_msg& msg) const {
+    if (msg.level < level) {
+        return false;
+    }
+    return std::all_of(keys.begin(), keys.end(),
+                       [&msg](const auto& kv) { return has_value(msg, kv.first, kv.second); });
+}
+
+std::string MonitorFilter::to_string() const {
+    auto name = spdlog::level::to_string_view(level);
+    std::string s = "level=" + std::string(name.data(), name.size());
+    for (const auto& [key, value] : keys) {
+        s += " key=" + key + ":" + value;
+    }
+    return s;
+}
+
+MonitorSink::Subscriber::Subscriber(std::ostream& out, MonitorFilter filter)
+    : out_(&out), sink_(dynamic_cast<cli::BroadcastSink*>(out.rdbuf())), filter_(std::move(filter)) {}
+
+void MonitorSink::Subscriber::write(const cli::Broadcast& line) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (sink_ != nullptr) {
+        sink_->Send(line);
+    } else if (out_ != nullptr) {
+        const auto& text = line.Text();
+        out_->write(text->data(), static_cast<std::streamsize>(text->size()));
+        out_->flush();
+    }
+}
+
+void MonitorSink::Subscriber::close() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    out_ = nullptr;
+    sink_ = nullptr;
+}
+
+MonitorSink::MonitorSink() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    publish_({}, std::make_shared<spdlog::pattern_formatter>(kDefaultPattern, spdlog::pattern_time_type::local, ""));
+}
+
+void MonitorSink::attach(std::ostream& out, MonitorFilter filter) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    const View& current = view_.current();
+    std::vector<std::shared_ptr<Subscriber>> subscribers;
+    subscribers.reserve(current.subscribers.size() + 1);
+    for (const auto& s : current.subscribers) {
+        if (s->watches(out)) {
+            s->close();
+        } else {
+            subscribers.push_back(s);
+        }
+    }
+    subscribers.push_back(std::make_shared<Subscriber>(out, std::move(filter)));
+    publish_(std::move(subscribers), current.formatter);
+}
+
+bool MonitorSink::detach(std::ostream& out) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    const View& current = view_.current();
+    std::vector<std::shared_ptr<Subscriber>> subscribers;
+    bool found = false;
+    for (const auto& s : current.subscribers) {
+        if (s->watches(out)) {
+            // a logging thread may still hold the old view: stop the writes now
+            s->close();
+            found = true;
+        } else {
+            subscribers.push_back(s);
+        }
+    }
+    if (found) {
+        publish_(std::move(subscribers), current.formatter);
+    }
+    return found;
+}
+
+void MonitorSink::log(const spdlog::details::log_msg& msg) {
+    if (count_.load(std::memory_order_relaxed) == 0) {
+        return;
+    }
+    const auto view = view_.read();
+    if (msg.level < view->min_level) {
+        return;
+    }
+    std::optional<cli::Broadcast> line;
+    for (const auto& s : view->subscribers) {
+        if (!s->filter().matches(msg)) {
+            continue;
+        }
+        if (!line) {
+            line.emplace(format_(*view, msg));
+        }
+        s->write(*line);
+    }
+}
+
+void MonitorSink::set_pattern(const std::string& pattern) {
+    set_formatter(std::make_unique<spdlog::pattern_formatter>(pattern, spdlog::pattern_time_type::local, ""));
+}
+
+void MonitorSink::set_formatter(std::unique_ptr<spdlog::formatter> sink_formatter) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    const View& current = view_.current();
+    publish_(current.subscribers, std::shared_ptr<const spdlog::formatter>(std::move(sink_formatter)));
+}
+
+std::shared_ptr<const std::string> MonitorSink::format_(const View& view, const spdlog::details::log_msg& msg) {
+    // formatters cache state while formatting: each logging thread works on
+    // its own clone of the view's, cloned again when the view changes
+    struct Cache {
+        const MonitorSink* sink{nullptr};
+        uint64_t generation{0};
+        std::unique_ptr<spdlog::formatter> formatter;
+        spdlog::memory_buf_t buf;
+        spdlog::details::json_writer json;
+    };
+    thread_local Cache cache;
+    if (cache.sink != this || cache.generation != view.generation || !cache.formatter) {
+        cache.formatter = view.formatter->clone();
+        cache.sink = this;
+        cache.generation = view.generation;
+    }
+
+    cache.buf.clear();
+    cache.formatter->format(msg, cache.buf);
+    while (cache.buf.size() > 0 && (cache.buf[cache.buf.size() - 1] == '\n' || cache.buf[cache.buf.size() - 1] == '\r')) {
+        cache.buf.resize(cache.buf.size() - 1);
+    }
+
+    // structured data goes after the message, as one compact json object
+    bool has_params = msg.params != nullptr && msg.params->is_object() && !msg.params->empty();
+    if (has_params || msg.fields_count > 0) {
+        cache.json.clear();
+        if (has_params) {
+            for (const auto& [key, value] : msg.params->items()) {
+                cache.json.add_json(key, value);
+            }
+        }
+        for (size_t i = 0; i < msg.fields_count; ++i) {
+            cache.json.add_field(msg.fields[i]);
+        }
+        cache.buf.push_back(' ');
+        cache.json.write_to(cache.buf);
+    }
+    cache.buf.push_back('\n');
+    return std::make_shared<const std::string>(cache.buf.data(), cache.buf.size());
+}
+
+void MonitorSink::publish_(std::vector<std::shared_ptr<Subscriber>> subscribers,
+                           std::shared_ptr<const spdlog::formatter> f) {
+    View next;
+    next.generation = view_.current().generation + 1;
+    for (const auto& s : subscribers) {
+        next.min_level = std::min(next.min_level, s->filter().level);
+    }
+    next.subscribers = std::move(subscribers);
+    next.formatter = std::move(f);
+    count_.store(next.subscribers.size(), std::memory_order_relaxed);
+    view_.publish(std::move(next));
+}
+}  // namespace lynx
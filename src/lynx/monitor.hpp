@@ -0,0 +1,95 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "snapshot.hpp"
+#include "spdlog/sinks/sink.h"
+
+namespace cli {
+class Broadcast;
+class BroadcastSink;
+}  // namespace cli
+
+namespace lynx {
+// What a REPL session wants to see of the log, e.g. `level=warn key=conn_id:42`.
+struct MonitorFilter {
+    spdlog::level::level_enum level{spdlog::level::trace};
+    // structured params or fields, all of them must be present and equal
+    std::vector<std::pair<std::string, std::string>> keys;
+
+    // "level=<level>" and "key=<key>:<value>" arguments, throws std::invalid_argument
+    static MonitorFilter parse(const std::vector<std::string>& args);
+
+    bool matches(const spdlog::details::log_msg& msg) const;
+    std::string to_string() const;
+};
+
+// The one sink behind REPL monitor mode. Each record is formatted at most
+// once, however many sessions watch the log, and the formatted line is shared
+// by reference count with every subscriber whose filter accepts it.
+//
+// Subscribers are kept in a SnapshotCell replaced on attach/detach (copy on
+// write), so the logging threads never take the lock attach and detach
+// serialize on; with nobody watching, log() is a single atomic load.
+//
+// A telnet session gets each line as a cli::Broadcast, the way Cli::cout()
+// lines reach it: queued whole, or dropped whole and counted past its output
+// high-water mark, never cutting into its own replies.
+class MonitorSink final : public spdlog::sinks::sink {
+  public:
+    MonitorSink();
+
+    // Starts (or re-filters) monitoring on out. The stream must stay valid
+    // until detach(out) returns.
+    void attach(std::ostream& out, MonitorFilter filter);
+    // false if out was not monitoring
+    bool detach(std::ostream& out);
+    size_t subscribers() const { return count_.load(std::memory_order_relaxed); }
+
+    void log(const spdlog::details::log_msg& msg) override;
+    void flush() override {}
+    void set_pattern(const std::string& pattern) override;
+    void set_formatter(std::unique_ptr<spdlog::formatter> sink_formatter) override;
+
+  private:
+    class Subscriber {
+      public:
+        Subscriber(std::ostream& out, MonitorFilter filter);
+
+        const MonitorFilter& filter() const { return filter_; }
+        bool watches(const std::ostream& out) const { return out_ == &out; }
+        void write(const cli::Broadcast& line);
+        // after close() returns the stream is not touched anymore
+        void close();
+
+      private:
+        std::mutex mutex_;
+        std::ostream* out_;
+        cli::BroadcastSink* sink_;  // the buffer of out_, when it queues broadcasts
+        const MonitorFilter filter_;
+    };
+
+    // what the logging threads read, replaced as a whole
+    struct View {
+        std::vector<std::shared_ptr<Subscriber>> subscribers;
+        spdlog::level::level_enum min_level{spdlog::level::off};
+        std::shared_ptr<const spdlog::formatter> formatter;
+        uint64_t generation{0};
+    };
+
+    std::shared_ptr<const std::string> format_(const View& view, const spdlog::details::log_msg& msg);
+    // called with mutex_ held
+    void publish_(std::vector<std::shared_ptr<Subscriber>> subscribers, std::shared_ptr<const spdlog::formatter> f);
+
+    SnapshotCell<View> view_;  // published under mutex_
+    std::atomic<size_t> count_{0};
+    std::mutex mutex_;
+};
+}  // namespace lynx
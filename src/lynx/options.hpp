@@ -0,0 +1,117 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// The sections of lynx.toml as plain structs, apart from the subsystems they
+// configure: Config parses and validates them without pulling those in.
+namespace lynx {
+// [log] section of lynx.toml
+struct LogOptions {
+    std::string mode{"sync"};       // sync | async
+    std::string level{"debug"};     // default logger level, reloadable
+    std::string overflow{"block"};  // async only: block | drop_newest | drop_oldest
+    size_t queue_size{8192};        // async only: ring slots
+    size_t batch_size{64};          // async only: records per writev
+};
+
+// What a producer does when the ring is full.
+enum class OverflowPolicy {
+    block,        // wait for the writer to free a slot; drop_newest while the writer is stopped
+    drop_newest,  // discard the record being logged
+    drop_oldest,  // evict the oldest queued record to make room
+};
+
+// "block", "drop_newest" or "drop_oldest", throws std::invalid_argument otherwise.
+OverflowPolicy overflow_policy_from_string(const std::string& name);
+const char* to_string(OverflowPolicy policy);
+
+// [server] section of lynx.toml
+struct ServerOptions {
+    unsigned short port{8080};
+    std::string address{"0.0.0.0"};
+    size_t threads{0};        // io threads of the REST server, 0: one per core
+    bool cpu_affinity{true};  // pin io thread i to the i-th core lynx may run on
+};
+
+// [static] section of lynx.toml
+struct StaticOptions {
+    std::string root;              // directory served, empty: no static files
+    std::string prefix{"/static"};  // url path root is served under
+    size_t cache_size{64 << 20};   // bytes the cached files may hold, headers and bodies
+    size_t mmap_min{64 << 10};     // files this size and up are mmap()ed instead of copied
+    size_t sendfile_min{4 << 20};  // files this size and up go out with sendfile(), body never cached
+    bool watch{true};              // invalidate the cache with inotify, stat() every hit otherwise
+};
+
+// one [[cache.routes]] table of lynx.toml
+struct CacheRouteOptions {
+    std::string route;          // as declared in the route table, e.g. "GET /numbers/{a:int}/test/{b:int}"
+    size_t ttl_ms{1000};        // a response is served this long after it was computed
+    size_t max_size{1 << 20};   // bytes the route's responses may hold, heads and bodies
+    std::vector<std::string> vary;  // request headers that are part of the key, besides method and url
+};
+
+// [cache] section of lynx.toml: routes not listed are never cached
+struct CacheOptions {
+    std::vector<CacheRouteOptions> routes;
+};
+
+// [upload] section of lynx.toml
+struct UploadOptions {
+    size_t stream_min{1 << 20};         // bodies this size and up stay in the socket until a streaming route reads them
+    size_t window{256 << 10};           // bytes of a streamed body in memory at once, per upload
+    size_t max_size{size_t(4) << 30};   // larger bodies are refused before any handler runs
+    std::string spill_dir{"/tmp"};      // where BodyStream::spill() creates its files
+};
+
+// [compression] section of lynx.toml
+struct CompressionOptions {
+    bool enabled{true};            // false: responses go out as the handlers made them
+    size_t min_size{1024};         // smaller bodies are not worth the cpu
+    size_t offload_min{16 << 10};  // bodies this size and up are compressed on the workers, never on an io thread
+    size_t threads{2};             // compression workers
+    size_t cache_size{32 << 20};   // bytes of compressed variants kept, heads and bodies
+    int gzip_level{6};             // 1 (fastest) to 9
+    int br_quality{5};             // 0 (fastest) to 11
+};
+
+// What a subscriber whose queue is full gets.
+enum class SlowConsumer {
+    drop_newest,  // the frame being published is not queued for it
+    drop_oldest,  // its oldest queued frame is discarded to make room
+    disconnect,   // it is disconnected, it may resubscribe
+};
+
+// "drop_newest", "drop_oldest" or "disconnect", throws std::invalid_argument otherwise.
+SlowConsumer slow_consumer_from_string(const std::string& name);
+const char* to_string(SlowConsumer policy);
+
+// [pubsub] section of lynx.toml
+struct PubSubOptions {
+    std::string path{"/ws"};          // websocket endpoint of the REST servers, empty: off
+    size_t queue_limit{1024};         // frames waiting to be written per subscriber
+    std::string slow{"drop_oldest"};  // queue full: drop_newest | drop_oldest | disconnect
+    size_t history{256};              // last messages kept per channel for resuming clients, 0: none
+    size_t history_bytes{1 << 20};    // bytes of frames kept per channel, at most
+    size_t max_channels{4096};        // channels with subscribers or history, the least recently
+                                      // published of those with history only (roughly: second chance)
+                                      // are evicted for new ones
+};
+
+// [scheduler] section of lynx.toml
+struct SchedulerOptions {
+    size_t resolution_ms{10};  // tick of the control plane's timer wheel: the tasks due in one tick run together
+    size_t threads{2};         // workers of the offloaded tasks
+};
+
+// [repl] section of lynx.toml
+struct ReplOptions {
+    uint16_t port{8888};        // telnet
+    size_t max_sessions{16};    // telnet sessions open at once, the next connections are refused
+    size_t idle_timeout_s{600}; // a telnet session without input, and no command running, is closed; 0: never
+    size_t threads{2};          // workers of the async commands
+};
+}  // namespace lynx
@@ -0,0 +1,572 @@
+#include "pubsub.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <stdexcept>
+#include <utility>
+
+#include "async_simple/coro/Collect.h"
+#include "cinatra.hpp"
+
+namespace lynx {
+namespace {
+constexpr size_t kMaxChannelName = 256;
+
+void resume(std::coroutine_handle<> handle, async_simple::Executor* executor) {
+    if (!handle) {
+        return;
+    }
+    if (executor != nullptr) {
+        executor->schedule([handle] { handle.resume(); });
+    } else {
+        handle.resume();
+    }
+}
+
+// "sub", "a b c" -> "sub" and "a b c"
+std::pair<std::string_view, std::string_view> split_word(std::string_view s) {
+    size_t space = std::min(s.find(' '), s.size());
+    return {s.substr(0, space), s.substr(std::min(space + 1, s.size()))};
+}
+
+bool valid_channel(std::string_view channel) {
+    return !channel.empty() && channel.size() <= kMaxChannelName &&
+           channel.find_first_of(" \r\n") == std::string_view::npos;
+}
+
+Frame ws_frame(std::string_view text, cinatra::opcode op = cinatra::opcode::text) {
+    cinatra::websocket ws;
+    auto header = ws.encode_ws_header(text.size(), op, true, false, false);
+    auto frame = std::make_shared<std::string>();
+    frame->reserve(header.size() + text.size());
+    frame->append(header).append(text);
+    return frame;
+}
+
+Frame close_frame(uint16_t code, std::string_view reason) {
+    cinatra::websocket ws;
+    std::string message(reason);
+    return ws_frame(ws.format_close_payload(code, message.data(), message.size()), cinatra::opcode::close);
+}
+
+// a reply to the client that sent a command, queued behind the messages
+// already on their way to it
+void reply(Subscriber& subscriber, std::string_view text) { subscriber.push(ws_frame(text)); }
+
+// The connection does not answer ping and close frames itself (see
+// set_ws_auto_reply()): their answers are queued like any frame, so
+// write_frames() is the only coroutine writing to the socket.
+async_simple::coro::Lazy<void> read_commands(PubSubHub& hub, cinatra::coro_http_connection* conn,
+                                             std::shared_ptr<Subscriber> subscriber) {
+    for (;;) {
+        auto result = co_await conn->read_websocket();
+        if (result.ec == std::error_code(asio::error::message_size, asio::error::get_system_category())) {
+            subscriber->close(close_frame(cinatra::close_code::too_big, "message_too_big"));
+            co_return;
+        }
+        if (result.ec || result.type == cinatra::ws_frame_type::WS_ERROR_FRAME) {
+            break;
+        }
+        if (result.type == cinatra::ws_frame_type::WS_CLOSE_FRAME) {
+            // echoed instead of the frames still queued: the client is leaving
+            subscriber->close(close_frame(cinatra::close_code::normal, result.data));
+            co_return;
+        }
+        if (result.type == cinatra::ws_frame_type::WS_PING_FRAME) {
+            Frame pong = ws_frame(result.data, cinatra::opcode::pong);
+            subscriber->replay({&pong, 1});
+            continue;
+        }
+        if (result.type != cinatra::ws_frame_type::WS_TEXT_FRAME &&
+            result.type != cinatra::ws_frame_type::WS_BINARY_FRAME) {
+            // fragmented messages are not supported
+            continue;
+        }
+        auto [command, args] = split_word(result.data);
+        if (command == "pub") {
+            auto [channel, message] = split_word(args);
+            if (!valid_channel(channel)) {
+                reply(*subscriber, "error invalid channel");
+                continue;
+            }
+            hub.publish(channel, message);
+        } else if (command == "sub") {
+            auto [channel, since] = split_word(args);
+            std::optional<uint64_t> from;
+            if (!since.empty()) {
+                uint64_t seq;
+                auto [end, ec] = std::from_chars(since.data(), since.data() + since.size(), seq);
+                if (ec != std::errc() || end != since.data() + since.size()) {
+                    reply(*subscriber, "error invalid sequence id");
+                    continue;
+                }
+                from = seq;
+            }
+            if (!valid_channel(channel)) {
+                reply(*subscriber, "error invalid channel");
+            } else if (!hub.subscribe(subscriber, std::string(channel), from)) {
+                reply(*subscriber, "error too many channels");
+            }
+        } else if (command == "unsub") {
+            if (!valid_channel(args)) {
+                reply(*subscriber, "error invalid channel");
+                continue;
+            }
+            hub.unsubscribe(subscriber, std::string(args));
+            reply(*subscriber, "ok " + std::string(result.data));
+        } else {
+            reply(*subscriber, "error unknown command");
+        }
+    }
+    subscriber->close();
+}
+
+async_simple::coro::Lazy<void> write_frames(cinatra::coro_http_connection* conn,
+                                            std::shared_ptr<Subscriber> subscriber) {
+    std::vector<Frame> batch;
+    std::vector<asio::const_buffer> buffers;
+    for (;;) {
+        co_await subscriber->wait(batch);
+        if (batch.empty()) {
+            break;
+        }
+        buffers.clear();
+        for (const auto& frame : batch) {
+            buffers.push_back(asio::buffer(*frame));
+        }
+        auto [ec, _] = co_await conn->async_write(buffers);
+        batch.clear();
+        if (ec) {
+            break;
+        }
+    }
+    // closed by the reader, disconnected as a slow consumer, or the socket
+    // failed: the reader stops too
+    subscriber->close();
+    conn->close();
+}
+}  // namespace
+
+SlowConsumer slow_consumer_from_string(const std::string& name) {
+    if (name == "drop_newest") {
+        return SlowConsumer::drop_newest;
+    }
+    if (name == "drop_oldest") {
+        return SlowConsumer::drop_oldest;
+    }
+    if (name == "disconnect") {
+        return SlowConsumer::disconnect;
+    }
+    throw std::invalid_argument("unknown pubsub slow consumer policy: " + name +
+                                " (expected drop_newest, drop_oldest or disconnect)");
+}
+
+const char* to_string(SlowConsumer policy) {
+    switch (policy) {
+        case SlowConsumer::drop_newest:
+            return "drop_newest";
+        case SlowConsumer::drop_oldest:
+            return "drop_oldest";
+        case SlowConsumer::disconnect:
+            return "disconnect";
+    }
+    return "unknown";
+}
+
+Frame make_frame(std::string_view channel, uint64_t seq, std::string_view payload) {
+    char digits[20];
+    auto end = std::to_chars(digits, digits + sizeof(digits), seq).ptr;
+    std::string_view id(digits, end - digits);
+    cinatra::websocket ws;
+    size_t size = channel.size() + 1 + id.size() + 1 + payload.size();
+    auto header = ws.encode_ws_header(size, cinatra::opcode::text, true, false, false);
+    auto frame = std::make_shared<std::string>();
+    frame->reserve(header.size() + size);
+    frame->append(header).append(channel).append(1, ' ').append(id).append(1, ' ').append(payload);
+    return frame;
+}
+
+void History::push(uint64_t seq, Frame frame) {
+    if (capacity_ == 0) {
+        return;
+    }
+    size_t cost = frame->size();
+    if (cost > max_bytes_) {
+        while (size_ > 0) {
+            pop_();
+        }
+        return;
+    }
+    if (ring_.empty()) {
+        ring_.resize(capacity_);
+    }
+    while (size_ == capacity_ || bytes_ + cost > max_bytes_) {
+        pop_();
+    }
+    if (size_ == 0) {
+        first_ = seq;
+    }
+    ring_[(head_ + size_) % capacity_] = std::move(frame);
+    ++size_;
+    bytes_ += cost;
+}
+
+std::pair<std::span<const Frame>, std::span<const Frame>> History::after(uint64_t seq) const {
+    // the ids are consecutive from first_: the oldest wanted is found by arithmetic
+    size_t skip = seq < first_ ? 0 : static_cast<size_t>(std::min<uint64_t>(seq - first_ + 1, size_));
+    size_t start = (head_ + skip) % std::max<size_t>(capacity_, 1);
+    size_t count = size_ - skip;
+    size_t wrapped = count > capacity_ - start ? count - (capacity_ - start) : 0;
+    std::span<const Frame> ring(ring_);
+    return {ring.subspan(start, count - wrapped), ring.subspan(0, wrapped)};
+}
+
+void History::pop_() {
+    bytes_ -= ring_[head_]->size();
+    ring_[head_].reset();
+    head_ = (head_ + 1) % capacity_;
+    --size_;
+    ++first_;
+}
+
+Subscriber::Push Subscriber::push(Frame frame) {
+    std::coroutine_handle<> waiter;
+    async_simple::Executor* executor;
+    std::function<void()> disconnect;
+    Push pushed = Push::queued;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (closed_) {
+            return Push::closed;
+        }
+        if (queue_.size() - head_ >= limit_) {
+            switch (policy_) {
+                case SlowConsumer::drop_newest:
+                    return Push::dropped;
+                case SlowConsumer::drop_oldest:
+                    queue_[head_++].reset();
+                    // the writer may be stuck on a write for long: compact
+                    // once limit_ frames were dropped, keeping the queue
+                    // under 2 * limit_ slots for a copy per limit_ pushes
+                    if (head_ >= limit_) {
+                        queue_.erase(queue_.begin(), queue_.begin() + static_cast<ptrdiff_t>(std::exchange(head_, 0)));
+                    }
+                    pushed = Push::dropped;
+                    break;
+                case SlowConsumer::disconnect:
+                    closed_ = true;
+                    queue_.clear();
+                    head_ = 0;
+                    disconnect = std::move(on_disconnect_);
+                    pushed = Push::disconnected;
+                    break;
+            }
+        }
+        if (!closed_) {
+            queue_.push_back(std::move(frame));
+        }
+        waiter = std::exchange(waiter_, nullptr);
+        executor = executor_;
+    }
+    if (disconnect) {
+        disconnect();
+    }
+    resume(waiter, executor);
+    return pushed;
+}
+
+bool Subscriber::replay(std::span<const Frame> frames) {
+    std::coroutine_handle<> waiter;
+    async_simple::Executor* executor;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (closed_) {
+            return false;
+        }
+        queue_.insert(queue_.end(), frames.begin(), frames.end());
+        waiter = std::exchange(waiter_, nullptr);
+        executor = executor_;
+    }
+    resume(waiter, executor);
+    return true;
+}
+
+void Subscriber::on_disconnect(std::function<void()> callback) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    on_disconnect_ = std::move(callback);
+}
+
+void Subscriber::close(Frame last) {
+    std::coroutine_handle<> waiter;
+    async_simple::Executor* executor;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        closed_ = true;
+        queue_.clear();
+        head_ = 0;
+        if (last) {
+            queue_.push_back(std::move(last));
+        }
+        on_disconnect_ = nullptr;
+        waiter = std::exchange(waiter_, nullptr);
+        executor = executor_;
+    }
+    resume(waiter, executor);
+}
+
+bool Subscriber::closed() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return closed_;
+}
+
+bool Subscriber::take(std::vector<Frame>& batch) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (closed_ && queue_.size() == head_) {
+        return false;
+    }
+    queue_.erase(queue_.begin(), queue_.begin() + static_cast<ptrdiff_t>(std::exchange(head_, 0)));
+    batch.swap(queue_);
+    return true;
+}
+
+bool Subscriber::Wait::await_ready() { return false; }
+
+bool Subscriber::Wait::await_suspend(std::coroutine_handle<> handle) {
+    std::lock_guard<std::mutex> lock(subscriber_.mutex_);
+    if (subscriber_.closed_ || subscriber_.queue_.size() > subscriber_.head_) {
+        return false;
+    }
+    subscriber_.waiter_ = handle;
+    subscriber_.executor_ = executor_;
+    return true;
+}
+
+void Subscriber::Wait::await_resume() { subscriber_.take(batch_); }
+
+PubSubHub::PubSubHub(PubSubOptions options)
+    : options_(std::move(options)), policy_(slow_consumer_from_string(options_.slow)) {}
+
+std::shared_ptr<Subscriber> PubSubHub::make_subscriber() const {
+    return std::make_shared<Subscriber>(std::max<size_t>(options_.queue_limit, 1), policy_);
+}
+
+bool PubSubHub::subscribe(const std::shared_ptr<Subscriber>& subscriber, const std::string& channel,
+                          std::optional<uint64_t> since) {
+    auto& mine = subscriber->channels();
+    bool again = std::find(mine.begin(), mine.end(), channel) != mine.end();
+    std::lock_guard<std::shared_mutex> lock(mutex_);
+    auto it = channels_.find(channel);
+    auto slot = it != channels_.end() ? it->second : create_(channel);
+    if (!slot) {
+        return false;
+    }
+    std::lock_guard<std::mutex> channel_lock(slot->mutex);
+    if (!again) {
+        mine.push_back(channel);
+        slot->subscribers.push_back(subscriber);
+    }
+    set_idle_(channel, *slot, false);
+    // under the channel's lock: nothing is published between the replay and the live messages
+    Frame ack = ws_frame("ok sub " + channel + " " + std::to_string(slot->seq));
+    subscriber->replay({&ack, 1});
+    if (since) {
+        auto [older, newer] = slot->history.after(*since);
+        subscriber->replay(older);
+        subscriber->replay(newer);
+        replayed_ += older.size() + newer.size();
+    }
+    return true;
+}
+
+void PubSubHub::unsubscribe(const std::shared_ptr<Subscriber>& subscriber, const std::string& channel) {
+    auto& mine = subscriber->channels();
+    if (auto it = std::find(mine.begin(), mine.end(), channel); it != mine.end()) {
+        mine.erase(it);
+    }
+    std::lock_guard<std::shared_mutex> lock(mutex_);
+    auto it = channels_.find(channel);
+    if (it == channels_.end()) {
+        return;
+    }
+    auto& target = *it->second;
+    std::lock_guard<std::mutex> channel_lock(target.mutex);
+    std::erase(target.subscribers, subscriber);
+    if (!target.subscribers.empty()) {
+        return;
+    }
+    if (target.history.size() == 0) {
+        set_idle_(channel, target, false);
+        target.erased = true;
+        channels_.erase(it);
+    } else {
+        set_idle_(channel, target, true);
+    }
+}
+
+void PubSubHub::unsubscribe_all(const std::shared_ptr<Subscriber>& subscriber) {
+    auto channels = std::move(subscriber->channels());
+    for (const auto& channel : channels) {
+        unsubscribe(subscriber, channel);
+    }
+}
+
+size_t PubSubHub::publish(std::string_view channel, std::string_view payload) {
+    ++published_;
+    size_t queued = 0;
+    uint64_t dropped = 0, disconnected = 0;
+    for (;;) {
+        // without a history, a message nobody subscribed to leaves no trace
+        auto target = find_(channel, options_.history > 0);
+        if (!target) {
+            return 0;
+        }
+        std::lock_guard<std::mutex> lock(target->mutex);
+        if (target->erased) {
+            continue;
+        }
+        // framed under the lock: the ids follow the order the subscribers get the frames in
+        Frame frame = make_frame(channel, ++target->seq, payload);
+        target->history.push(target->seq, frame);
+        auto& subscribers = target->subscribers;
+        for (size_t i = 0; i < subscribers.size();) {
+            switch (subscribers[i]->push(frame)) {
+                case Subscriber::Push::queued:
+                    ++queued;
+                    break;
+                case Subscriber::Push::dropped:
+                    // drop_oldest queued it all the same
+                    ++dropped;
+                    queued += policy_ == SlowConsumer::drop_oldest;
+                    break;
+                case Subscriber::Push::disconnected:
+                    ++disconnected;
+                    [[fallthrough]];
+                case Subscriber::Push::closed:
+                    // out of the channel, the order of the others does not matter
+                    subscribers[i] = std::move(subscribers.back());
+                    subscribers.pop_back();
+                    continue;
+            }
+            ++i;
+        }
+        break;
+    }
+    delivered_ += queued;
+    dropped_ += dropped;
+    disconnected_ += disconnected;
+    return queued;
+}
+
+async_simple::coro::Lazy<void> PubSubHub::serve(cinatra::coro_http_request& req, cinatra::coro_http_response& res) {
+    if (!req.is_upgrade()) {
+        res.set_status_and_content(cinatra::status_type::bad_request, "websocket only");
+        co_return;
+    }
+    auto* conn = req.get_conn();
+    auto subscriber = make_subscriber();
+    subscriber->on_disconnect([conn = conn->shared_from_this()] {
+        conn->get_executor()->schedule([conn] { conn->close(); });
+    });
+    conn->set_ws_auto_reply(false);
+    co_await async_simple::coro::collectAll(read_commands(*this, conn, subscriber), write_frames(conn, subscriber));
+    unsubscribe_all(subscriber);
+}
+
+PubSubHub::Stats PubSubHub::stats() const {
+    Stats stats;
+    {
+        std::shared_lock<std::shared_mutex> lock(mutex_);
+        stats.channels = channels_.size();
+        stats.evicted = evicted_;
+        for (const auto& [name, channel] : channels_) {
+            std::lock_guard<std::mutex> channel_lock(channel->mutex);
+            stats.subscriptions += channel->subscribers.size();
+            stats.history_frames += channel->history.size();
+            stats.history_bytes += channel->history.bytes();
+        }
+    }
+    stats.published = published_;
+    stats.delivered = delivered_;
+    stats.dropped = dropped_;
+    stats.disconnected = disconnected_;
+    stats.replayed = replayed_;
+    return stats;
+}
+
+std::shared_ptr<PubSubHub::Channel> PubSubHub::find_(std::string_view channel, bool create) {
+    {
+        std::shared_lock<std::shared_mutex> lock(mutex_);
+        if (auto it = channels_.find(channel); it != channels_.end()) {
+            Channel& found = *it->second;
+            // evict_idle_() gives it a second chance; read first, a busy channel's flag stays set
+            if (found.idle && !found.published.load(std::memory_order_relaxed)) {
+                found.published.store(true, std::memory_order_relaxed);
+            }
+            return it->second;
+        }
+    }
+    if (!create) {
+        return nullptr;
+    }
+    std::lock_guard<std::shared_mutex> lock(mutex_);
+    // created meanwhile maybe
+    if (auto it = channels_.find(channel); it != channels_.end()) {
+        return it->second;
+    }
+    std::string name(channel);
+    auto created = create_(name);
+    if (created) {
+        // idle until subscribed to, what it is published keeps it
+        set_idle_(name, *created, true);
+    }
+    return created;
+}
+
+std::shared_ptr<PubSubHub::Channel> PubSubHub::create_(std::string name) {
+    if (channels_.size() >= options_.max_channels && !evict_idle_()) {
+        return nullptr;
+    }
+    auto created = std::make_shared<Channel>(options_.history, options_.history_bytes);
+    channels_.emplace(std::move(name), created);
+    return created;
+}
+
+bool PubSubHub::evict_idle_() {
+    // the oldest in idle_, but those published to meanwhile go first again once
+    auto it = channels_.end();
+    while (!idle_.empty()) {
+        it = channels_.find(idle_.back());
+        if (!it->second->published.exchange(false, std::memory_order_relaxed)) {
+            break;
+        }
+        // idle_pos stays valid
+        idle_.splice(idle_.begin(), idle_, std::prev(idle_.end()));
+    }
+    if (idle_.empty()) {
+        return false;
+    }
+    idle_.pop_back();
+    {
+        // a publisher that found it before waits on its lock, then looks it up again
+        std::lock_guard<std::mutex> channel_lock(it->second->mutex);
+        it->second->idle = false;
+        it->second->erased = true;
+    }
+    channels_.erase(it);
+    ++evicted_;
+    return true;
+}
+
+void PubSubHub::set_idle_(const std::string& name, Channel& channel, bool idle) {
+    if (channel.idle == idle) {
+        return;
+    }
+    if (idle) {
+        channel.idle_pos = idle_.insert(idle_.begin(), name);
+        channel.published.store(false, std::memory_order_relaxed);
+    } else {
+        idle_.erase(channel.idle_pos);
+    }
+    channel.idle = idle;
+}
+}  // namespace lynx
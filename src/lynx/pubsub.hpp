@@ -0,0 +1,224 @@
+#pragma once
+
+#include <atomic>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <shared_mutex>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "async_simple/Executor.h"
+#include "async_simple/coro/Lazy.h"
+#include "options.hpp"
+
+namespace cinatra {
+class coro_http_request;
+class coro_http_response;
+}  // namespace cinatra
+
+namespace lynx {
+// A websocket text frame, header and payload in one buffer, serialized once
+// per message and shared by the queues of every subscriber it goes to.
+using Frame = std::shared_ptr<const std::string>;
+
+// the frame sent to the subscribers of channel: "<channel> <seq> <payload>"
+Frame make_frame(std::string_view channel, uint64_t seq, std::string_view payload);
+
+// The last messages of a channel, for the clients resuming from a sequence
+// id: a ring of up to capacity frames and max_bytes bytes, the oldest evicted
+// first. The frames are those the subscribers got, a replay shares them.
+// Guarded by its channel's mutex.
+class History {
+  public:
+    History(size_t capacity, size_t max_bytes) : capacity_(capacity), max_bytes_(max_bytes) {}
+
+    // seq follows the one pushed last. A frame larger than max_bytes empties
+    // the ring: the clients see the gap in the sequence ids.
+    void push(uint64_t seq, Frame frame);
+    // the frames kept after seq, oldest first, in two parts as the ring wraps
+    std::pair<std::span<const Frame>, std::span<const Frame>> after(uint64_t seq) const;
+
+    uint64_t first() const { return first_; }  // seq of the oldest frame kept, if any
+    size_t size() const { return size_; }
+    size_t bytes() const { return bytes_; }
+
+  private:
+    void pop_();
+
+    const size_t capacity_;
+    const size_t max_bytes_;
+    std::vector<Frame> ring_;  // capacity_ slots, allocated by the first push
+    size_t head_{0};           // slot of the oldest frame
+    size_t size_{0};
+    size_t bytes_{0};
+    uint64_t first_{0};
+};
+
+// One websocket connection's queue of frames to write. Publishers of any
+// thread push to it, its writer coroutine drains it on the connection's io
+// thread, all the queued frames at once with a single gathered write.
+class Subscriber {
+  public:
+    Subscriber(size_t limit, SlowConsumer policy) : limit_(limit), policy_(policy) {}
+
+    Subscriber(const Subscriber&) = delete;
+    Subscriber& operator=(const Subscriber&) = delete;
+
+    enum class Push { queued, dropped, disconnected, closed };
+    // Queues frame, applying the slow consumer policy when the queue is full:
+    // disconnected if that closed the subscriber, closed if it was already.
+    Push push(Frame frame);
+    // Queues frames whatever the limit: a replayed history or a pong counts
+    // in the queue, not against the publishers. false if closed.
+    bool replay(std::span<const Frame> frames);
+    // Called once if the policy disconnects it, on the publisher's thread:
+    // its writer may be stuck writing to the client, this closes the socket.
+    void on_disconnect(std::function<void()> callback);
+    // Drops the queued frames and wakes the writer, which writes last if
+    // any (e.g. a close frame) then returns; later pushes are refused.
+    void close(Frame last = nullptr);
+    bool closed() const;
+
+    // Moves the queued frames to batch, which must be empty: the two swap
+    // storage, so a writer that clears its batch allocates nothing once
+    // warmed up. false once closed with nothing left to write.
+    bool take(std::vector<Frame>& batch);
+
+    // Waits for frames and takes them, batch stays empty once closed.
+    class Wait {
+      public:
+        Wait(Subscriber& subscriber, std::vector<Frame>& batch) : subscriber_(subscriber), batch_(batch) {}
+
+        auto coAwait(async_simple::Executor* executor) {
+            executor_ = executor;
+            return std::move(*this);
+        }
+        bool await_ready();
+        bool await_suspend(std::coroutine_handle<> handle);
+        void await_resume();
+
+      private:
+        Subscriber& subscriber_;
+        std::vector<Frame>& batch_;
+        async_simple::Executor* executor_{nullptr};
+    };
+    Wait wait(std::vector<Frame>& batch) { return Wait(*this, batch); }
+
+    // channels it is subscribed to, only touched by its connection
+    std::vector<std::string>& channels() { return channels_; }
+
+  private:
+    const size_t limit_;
+    const SlowConsumer policy_;
+    mutable std::mutex mutex_;
+    std::vector<Frame> queue_;
+    size_t head_{0};  // frames before it were dropped by drop_oldest
+    bool closed_{false};
+    std::coroutine_handle<> waiter_;
+    async_simple::Executor* executor_{nullptr};
+    std::function<void()> on_disconnect_;
+    std::vector<std::string> channels_;
+};
+
+// Topics of the websocket clients, by channel name: a message published to
+// a channel gets the channel's next sequence id and is framed once, then each
+// of its subscribers gets a pointer to the frame, so a fan-out to N clients
+// costs one serialization and N pointer pushes. A client whose queue reaches
+// queue_limit is handled by the slow consumer policy and never holds the
+// publishers back. The channel's History keeps the last frames for the
+// clients that (re)subscribe from a sequence id. Shared by the io threads:
+// publishing looks the channel up by string_view under a shared lock and
+// only serializes on the channel's own lock.
+class PubSubHub {
+  public:
+    struct Stats {
+        size_t channels{0};
+        size_t subscriptions{0};
+        uint64_t published{0};     // messages
+        uint64_t delivered{0};     // frames queued to subscribers
+        uint64_t dropped{0};       // frames a slow consumer missed
+        uint64_t disconnected{0};  // slow consumers disconnected
+        uint64_t replayed{0};      // frames queued from the histories
+        uint64_t evicted{0};       // channels with history only dropped to make room for new ones
+        size_t history_frames{0};
+        size_t history_bytes{0};
+    };
+
+    explicit PubSubHub(PubSubOptions options);
+
+    PubSubHub(const PubSubHub&) = delete;
+    PubSubHub& operator=(const PubSubHub&) = delete;
+
+    const PubSubOptions& options() const { return options_; }
+
+    std::shared_ptr<Subscriber> make_subscriber() const;
+    // Queues "ok sub <channel> <last>" to subscriber, last the sequence id of
+    // the channel's latest message, then the messages after since the history
+    // still has, then the new ones. The replay copies pointers under the
+    // channel's lock, no payload. false if max_channels are in use and all
+    // of them have subscribers.
+    bool subscribe(const std::shared_ptr<Subscriber>& subscriber, const std::string& channel,
+                   std::optional<uint64_t> since = std::nullopt);
+    void unsubscribe(const std::shared_ptr<Subscriber>& subscriber, const std::string& channel);
+    // every channel of subscriber
+    void unsubscribe_all(const std::shared_ptr<Subscriber>& subscriber);
+    // number of subscribers the message was queued to
+    size_t publish(std::string_view channel, std::string_view payload);
+
+    // The websocket endpoint (see RestServer::serve_pubsub()): the client
+    // sends "sub <channel> [<since>]", "unsub <channel>" or
+    // "pub <channel> <message>" text frames and receives "<channel> <seq> <message>" ones.
+    async_simple::coro::Lazy<void> serve(cinatra::coro_http_request& req, cinatra::coro_http_response& res);
+
+    Stats stats() const;
+
+  private:
+    struct Channel {
+        Channel(size_t history, size_t history_bytes) : history(history, history_bytes) {}
+
+        std::mutex mutex;  // held while publishing: each subscriber gets the messages in order
+        std::vector<std::shared_ptr<Subscriber>> subscribers;
+        uint64_t seq{0};  // of the latest message
+        History history;
+        bool erased{false};  // out of the hub, a publisher holding it looks it up again
+        // no subscribers, kept for its history: in idle_ at idle_pos (hub's lock, exclusive)
+        bool idle{false};
+        std::list<std::string>::iterator idle_pos;
+        // published to since it was last put first in idle_, set under the hub's shared lock
+        std::atomic<bool> published{false};
+    };
+    struct NameHash {
+        using is_transparent = void;
+        size_t operator()(std::string_view name) const { return std::hash<std::string_view>{}(name); }
+    };
+
+    // nullptr if it does not exist and create is false or max_channels are
+    // in use with no idle channel to evict
+    std::shared_ptr<Channel> find_(std::string_view channel, bool create);
+    // the rest run under mutex_, exclusive
+    std::shared_ptr<Channel> create_(std::string name);
+    bool evict_idle_();
+    void set_idle_(const std::string& name, Channel& channel, bool idle);
+
+    const PubSubOptions options_;
+    const SlowConsumer policy_;
+    mutable std::shared_mutex mutex_;  // shared to look a channel up, exclusive to change the map or idle_
+    std::unordered_map<std::string, std::shared_ptr<Channel>, NameHash, std::equal_to<>> channels_;
+    std::list<std::string> idle_;  // channels without subscribers, most recently made idle or revisited first
+    uint64_t evicted_{0};
+    std::atomic<uint64_t> published_{0};
+    std::atomic<uint64_t> delivered_{0};
+    std::atomic<uint64_t> dropped_{0};
+    std::atomic<uint64_t> disconnected_{0};
+    std::atomic<uint64_t> replayed_{0};
+};
+}  // namespace lynx
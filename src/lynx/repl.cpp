@@ -1,12 +1,21 @@
 #include "repl.hpp"
 
 #include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <exception>
 #include <iostream>
 #include <iterator>
 #include <stdexcept>
 #include <string>
+#include <system_error>
 
+#include "config.hpp"
 #include "log.hpp"
+#include "scheduler.hpp"
+#include "timer_wheel.hpp"
 
 using namespace tabulate;
 using Row_t = Table::Row_t;
@@ -14,13 +23,115 @@ using namespace cli;
 using namespace std;
 
 namespace lynx {
+namespace {
+// 0, 850us, 12.5ms, 2.0s
+string format_duration(std::chrono::nanoseconds d) {
+    if (d.count() == 0) {
+        return "0";
+    }
+    char buf[32];
+    const double us = static_cast<double>(d.count()) / 1000.0;
+    if (us < 1000.0) {
+        std::snprintf(buf, sizeof(buf), "%.0fus", us);
+    } else if (us < 1000000.0) {
+        std::snprintf(buf, sizeof(buf), "%.1fms", us / 1000.0);
+    } else {
+        std::snprintf(buf, sizeof(buf), "%.1fs", us / 1000000.0);
+    }
+    return buf;
+}
+
+void print_exception(std::ostream& out, const std::string& cmd, const std::exception& e) {
+    out << "Exception caught in cli handler: " << e.what() << " handling command: " << cmd << ".\n";
+}
+
+// Output of an async command, written on a worker: buffered, handed to publish
+// when a write ends a line, on flush and when full.
+class AsyncOutput : public std::streambuf {
+  public:
+    using Publish = std::function<void(std::string chunk)>;
+
+    explicit AsyncOutput(Publish publish) : publish_(std::move(publish)) {
+        setp(buffer_.data(), buffer_.data() + buffer_.size());
+    }
+
+  protected:
+    std::streamsize xsputn(const char* s, std::streamsize n) override {
+        const bool line = std::memchr(s, '\n', static_cast<size_t>(n)) != nullptr;
+        for (std::streamsize left = n; left > 0;) {
+            if (pptr() == epptr()) {
+                sync();
+            }
+            const auto k = std::min<std::streamsize>(left, epptr() - pptr());
+            std::memcpy(pptr(), s, static_cast<size_t>(k));
+            pbump(static_cast<int>(k));
+            s += k;
+            left -= k;
+        }
+        if (line) {
+            sync();
+        }
+        return n;
+    }
+
+    int overflow(int c) override {
+        sync();
+        if (!traits_type::eq_int_type(c, traits_type::eof())) {
+            *pptr() = traits_type::to_char_type(c);
+            pbump(1);
+        }
+        return traits_type::not_eof(c);
+    }
+
+    int sync() override {
+        if (pptr() != pbase()) {
+            publish_(std::string(pbase(), pptr()));
+            setp(buffer_.data(), buffer_.data() + buffer_.size());
+        }
+        return 0;
+    }
+
+  private:
+    Publish publish_;
+    std::array<char, 4096> buffer_;
+};
+
+struct AsyncRun {
+    AsyncRun(AsyncTask t, AsyncOutput::Publish publish) : task(std::move(t)), buffer(std::move(publish)) {}
+
+    AsyncTask task;
+    AsyncOutput buffer;
+    std::ostream out{&buffer};
+};
+
+// how an async command ended, on its output
+void print_outcome(std::ostream& out, const std::string& cmd, const std::exception_ptr& error) {
+    if (!error) {
+        return;
+    }
+    try {
+        std::rethrow_exception(error);
+    } catch (const std::system_error& e) {
+        if (e.code() == asio::error::operation_aborted) {
+            out << "cancelled: " << cmd << "\n";
+        } else {
+            print_exception(out, cmd, e);
+        }
+    } catch (const std::exception& e) {
+        print_exception(out, cmd, e);
+    } catch (...) {
+        out << "Cli. Unknown exception caught handling command line \"" << cmd << "\"\n";
+    }
+}
+}  // namespace
 
 istream& operator>>(istream& in, Bar& p) {
     in >> p.value;
     return in;
 }
 
-Repl::Repl(IoContext& iocontext) : scheduler(iocontext) {
+Repl::Repl(IoContext& iocontext, size_t threads)
+    : scheduler(iocontext), worker_threads(std::max<size_t>(threads, 1)) {
     auto rootMenu = make_unique<Menu>("cli");
 
     rootMenu->Insert(
@@ -38,15 +149,42 @@ Repl::Repl(IoContext& iocontext) : scheduler(iocontext) {
     rootMenu->Insert(
         "monitor",
         [](std::ostream& out) {
-            LoggerConfig::add_stream_sink(out);
+            LoggerConfig::monitor()->attach(out, MonitorFilter{});
         },
         "enter monitor mode");
+    rootMenu->Insert(
+        "monitor", {"filters: level=<level> key=<key>:<value>"},
+        [](std::ostream& out, const std::vector<std::string>& filters) {
+            MonitorFilter filter = MonitorFilter::parse(filters);
+            out << "monitoring " << filter.to_string() << "\n";
+            LoggerConfig::monitor()->attach(out, std::move(filter));
+        },
+        "enter monitor mode, showing only the records matching every filter");
     rootMenu->Insert(
         "nomonitor",
         [](std::ostream& out) {
-            LoggerConfig::remove_all_stream_sink();
+            LoggerConfig::monitor()->detach(out);
         },
         "exit monitor mode");
+    rootMenu->Insert(
+        "logstats",
+        [](std::ostream& out) {
+            auto sink = LoggerConfig::async_sink();
+            if (!sink) {
+                out << "log mode: sync\n";
+                return;
+            }
+            AsyncLogStats s = sink->stats();
+            out << "log mode: async, queue " << s.capacity << ", overflow " << to_string(s.policy) << "\n"
+                << "written: " << s.written << " in " << s.batches << " writev\n"
+                << "dropped_newest: " << s.dropped_newest << ", dropped_oldest: " << s.dropped_oldest
+                << ", blocked: " << s.blocked << ", write_errors: " << s.write_errors << "\n";
+        },
+        "Show the async log writer counters");
+    rootMenu->Insert(
+        "config",
+        [](std::ostream& out) { out << Config::instance().data_to_string(); },
+        "Show the configuration in force, as last reloaded");
     rootMenu->Insert(
         "hello_everysession",
         [](std::ostream&) { Cli::cout() << "Hello, everybody" << std::endl; },
@@ -194,18 +332,117 @@ Repl::Repl(IoContext& iocontext) : scheduler(iocontext) {
 
     rootMenu->Insert(std::move(subMenu));
 
+    menu = rootMenu.get();
     cli = make_unique<Cli>(std::move(rootMenu));
     // global exit action
     cli->ExitAction([](auto& out) { out << "Goodbye and thanks for all the fish.\n"; });
+    // a closed session must not stay subscribed to the log
+    cli->CloseAction([](std::ostream& out) { LoggerConfig::monitor()->detach(out); });
     // std exception custom handler
-    cli->StdExceptionHandler(
-        [](std::ostream& out, const std::string& cmd, const std::exception& e) {
-            out << "Exception caught in cli handler: "
-                << e.what()
-                << " handling command: "
-                << cmd
-                << ".\n";
+    cli->StdExceptionHandler(print_exception);
+
+    insert_async(
+        "scan", [](std::ostream& out, unsigned long rows) -> asio::awaitable<void> {
+            unsigned long sum = 0;
+            for (unsigned long i = 0; i < rows; ++i) {
+                sum += i * i % 7;
+                if (i % 10000000 == 9999999) {
+                    out << "scanned " << i + 1 << " rows\n";
+                    // lets the other commands of the workers run, throws once cancelled
+                    co_await asio::post(asio::use_awaitable);
+                }
+            }
+            out << "scanned " << rows << " rows, checksum " << sum << "\n";
+        },
+        "Scan a table of the given number of rows on a worker, Ctrl-C to stop", {"rows"});
+    insert_async(
+        "countdown", [](std::ostream& out, int seconds) -> asio::awaitable<void> {
+            asio::steady_timer timer(co_await asio::this_coro::executor);
+            for (int i = seconds; i > 0; --i) {
+                out << i << "\n";
+                timer.expires_after(std::chrono::seconds(1));
+                co_await timer.async_wait(asio::use_awaitable);
+            }
+            out << "done\n";
+        },
+        "Count the seconds down, a line each, Ctrl-C to stop", {"seconds"});
+}
+
+Repl::~Repl() {
+    if (workers) {
+        workers->stop();
+        workers->join();
+    }
+}
+
+void Repl::run_async_(CliSession& session, const std::string& cmd, AsyncTask task) {
+    if (!session.CanSuspend()) {
+        // a file session, before daemonize() maybe: runs here on its own io_context, no worker started
+        // before fork(); its output goes straight to the session
+        AsyncRun run(std::move(task), [&session](std::string chunk) { session.OutStream() << chunk; });
+        asio::io_context here;
+        auto done = asio::co_spawn(here, run.task(run.out), asio::use_future);
+        here.run();
+        try {
+            done.get();
+        } catch (...) {
+            run.out.flush();
+            throw;
+        }
+        run.out.flush();
+        return;
+    }
+
+    // on the io thread, so once daemonized: threads do not survive fork()
+    if (!workers) {
+        workers = make_unique<asio::thread_pool>(worker_threads);
+    }
+    // one strand per run: its cancellation signal is emitted where it runs
+    auto strand = asio::make_strand(*workers);
+
+    auto cancel = std::make_shared<asio::cancellation_signal>();
+    auto pending = session.Suspend([cancel, strand] {
+        asio::post(strand, [cancel] { cancel->emit(asio::cancellation_type::terminal); });
+    });
+    // the session is written on the io thread only, as long as it is open
+    auto io = scheduler.AsioContext().get_executor();
+    auto run = std::make_shared<AsyncRun>(std::move(task), [io, pending](std::string chunk) {
+        asio::post(io, [pending, chunk = std::move(chunk)] {
+            if (std::ostream* out = pending->OutStream()) {
+                *out << chunk << std::flush;
+            }
         });
+    });
+    asio::co_spawn(strand, run->task(run->out),
+                   asio::bind_cancellation_slot(cancel->slot(), [run, cancel, io, pending, cmd](std::exception_ptr e) {
+                       print_outcome(run->out, cmd, e);
+                       run->out.flush();
+                       // after the output posted so far
+                       asio::post(io, [pending] { pending->Complete(); });
+                   }));
+}
+
+void Repl::show_tasks(const PeriodicScheduler& periodic) {
+    menu->Insert(
+        "tasks",
+        [&periodic](std::ostream& out) {
+            Table tasks;
+            tasks.add_row(Row_t{"task", "every", "phase", "jitter", "on", "runs", "skipped", "overruns", "last", "p50",
+                                "p99", "max"});
+            for (const TaskStats& s : periodic.stats()) {
+                const TaskOptions& o = s.options;
+                tasks.add_row(Row_t{s.name + (s.running ? " *" : ""), format_duration(o.interval),
+                                    format_duration(o.phase), format_duration(o.jitter), o.offload ? "worker" : "io",
+                                    std::to_string(s.runs), std::to_string(s.skipped), std::to_string(s.overruns),
+                                    format_duration(s.last), "<" + format_duration(s.percentile(0.5)),
+                                    "<" + format_duration(s.percentile(0.99)), format_duration(s.max)});
+            }
+            for (size_t i = 5; i < 12; ++i) {
+                tasks.column(i).format().font_align(FontAlign::right);
+            }
+            out << tasks << "\n(* running now; p50 and p99 are histogram bucket bounds)\n";
+        },
+        "List the periodic tasks with their runtime percentiles");
 }
 
 void Repl::start_local_terminal_session() {
@@ -224,6 +461,25 @@ void Repl::start_telnet_session(int port) {
     telnet_session->ExitAction([](auto& out) { out << "Terminating this session...\n"; });
 }
 
+void Repl::start_telnet_session(const ReplOptions& options, TimerWheel& timers) {
+    start_telnet_session(options.port);
+    telnet_session->MaxSessions(options.max_sessions);
+    if (options.idle_timeout_s > 0) {
+        // one wheel timer per session, rescheduled by the expiry itself rather than on every keystroke
+        telnet_session->IdleTimeout(std::chrono::seconds(options.idle_timeout_s),
+                                    [&timers](auto delay, auto f) { timers.schedule(delay, std::move(f)); });
+    }
+    menu->Insert(
+        "telnet",
+        [this, options](std::ostream& out) {
+            out << "sessions: " << telnet_session->Sessions() << " / " << options.max_sessions
+                << ", refused: " << telnet_session->Refused() << ", closed idle: " << telnet_session->Reaped()
+                << " (after " << (options.idle_timeout_s > 0 ? std::to_string(options.idle_timeout_s) + " s" : "never")
+                << ")\n";
+        },
+        "Show the telnet sessions, and how many were refused or closed idle");
+}
+
 void Repl::start_file_session(std::istream& in, std::ostream& out) {
     file_session = make_unique<CliFileSession>(*cli, in, out);
     file_session->Start();
@@ -1,10 +1,22 @@
 #pragma once
 
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "asio.hpp"
 #include "cli/cli.h"
 #include "cli/clifilesession.h"
 #include "cli/clilocalsession.h"
 #include "cli/standaloneasioremotecli.h"
 #include "cli/standaloneasioscheduler.h"
+#include "options.hpp"
 #include "tabulate/table.hpp"
 
 using namespace tabulate;
@@ -25,6 +37,9 @@ using CliTelnetServer = StandaloneAsioCliTelnetServer;
 }  // namespace cli
 
 namespace lynx {
+class PeriodicScheduler;
+class TimerWheel;
+
 // a custom struct to be used as a user-defined parameter type
 struct Bar {
     string to_string() const { return std::to_string(value); }
@@ -32,10 +47,53 @@ struct Bar {
     int value;
 };
 
+class Repl;
+
+// an async command bound to its arguments, writing on out
+using AsyncTask = std::function<asio::awaitable<void>(std::ostream& out)>;
+
+// Command whose handler is a coroutine, see Repl::insert_async.
+template <typename F, typename... Args>
+class AsyncCommand : public Command {
+  public:
+    AsyncCommand(Repl& repl, const std::string& name, F f, std::string help, std::vector<std::string> par_desc)
+        : Command(name), repl_(repl), func_(std::move(f)), help_(std::move(help)), par_desc_(std::move(par_desc)) {}
+
+    bool Exec(const std::vector<std::string>& cmd_line, CliSession& session) override;
+
+    void Help(std::ostream& out) const override {
+        if (!IsEnabled()) {
+            return;
+        }
+        out << " - " << Name();
+        if (par_desc_.empty()) {
+            PrintDesc<Args...>::Dump(out);
+        }
+        for (const auto& s : par_desc_) {
+            out << " <" << s << '>';
+        }
+        out << "\n\t" << help_ << "\n";
+    }
+
+  private:
+    template <size_t... I>
+    static auto parse_(const std::vector<std::string>& cmd_line, std::index_sequence<I...>) {
+        // braced: parsed left to right, std::bad_cast on a wrong one
+        return std::tuple<std::decay_t<Args>...>{detail::from_string<std::decay_t<Args>>(cmd_line[I + 1])...};
+    }
+
+    Repl& repl_;
+    const F func_;
+    const std::string help_;
+    const std::vector<std::string> par_desc_;
+};
+
 class Repl {
   public:
-    explicit Repl(IoContext& iocontext);
-    ~Repl() = default;
+    // threads: the workers of the async commands, started by the first of them
+    explicit Repl(IoContext& iocontext, size_t threads = 2);
+    // stops the async commands still running
+    ~Repl();
 
     // 禁止拷贝构造和赋值操作
     Repl(const Repl&) = delete;
@@ -47,12 +105,42 @@ class Repl {
 
     void start_local_terminal_session();
     void start_telnet_session(int port = 5000);
+    // on options.port, capped at options.max_sessions, the idle sessions reaped on timers; adds "telnet":
+    // the sessions and how many were refused or reaped
+    void start_telnet_session(const ReplOptions& options, TimerWheel& timers);
     void start_file_session(std::istream& in = std::cin, std::ostream& out = std::cout);
     void stop() { scheduler.Stop(); }
+    // adds "tasks": the tasks of periodic and their runtimes
+    void show_tasks(const PeriodicScheduler& periodic);
+
+    // Adds a command whose handler is a coroutine, asio::awaitable<void>(std::ostream& out, Args...), run on
+    // the workers: the io thread keeps serving meanwhile. Its output reaches the session a line at a time as
+    // it goes and the prompt comes back once it returns. Ctrl-C, or the session closing, cancels it through
+    // its cancellation slot: its next co_await throws asio::error::operation_aborted. A file session runs it
+    // in place, on the calling thread, before the next command.
+    template <typename F>
+    CmdHandler insert_async(const std::string& name, F f, const std::string& help = "",
+                            const std::vector<std::string>& par_desc = {}) {
+        return insert_async_(name, std::move(f), help, par_desc, &F::operator());
+    }
 
   private:
+    template <typename F, typename... Args>
+    friend class AsyncCommand;
+
+    template <typename F, typename... Args>
+    CmdHandler insert_async_(const std::string& name, F f, const std::string& help,
+                             const std::vector<std::string>& par_desc,
+                             asio::awaitable<void> (F::*)(std::ostream&, Args...) const) {
+        return menu->Insert(make_unique<AsyncCommand<F, Args...>>(*this, name, std::move(f), help, par_desc));
+    }
+    void run_async_(CliSession& session, const std::string& cmd, AsyncTask task);
+
     StandaloneAsioScheduler scheduler;
+    size_t worker_threads;
+    unique_ptr<asio::thread_pool> workers;  // null until the first async command
     unique_ptr<Cli> cli;
+    Menu* menu{nullptr};  // the root menu, owned by cli
     CmdHandler colorCmd;
     CmdHandler nocolorCmd;
 
@@ -61,4 +149,26 @@ class Repl {
     unique_ptr<CliTelnetServer> telnet_session;
     unique_ptr<CliFileSession> file_session;
 };
-}  // namespace lynx
\ No newline at end of file
+
+template <typename F, typename... Args>
+bool AsyncCommand<F, Args...>::Exec(const std::vector<std::string>& cmd_line, CliSession& session) {
+    if (!IsEnabled() || cmd_line.size() != sizeof...(Args) + 1 || Name() != cmd_line[0]) {
+        return false;
+    }
+    std::tuple<std::decay_t<Args>...> args;
+    try {
+        args = parse_(cmd_line, std::index_sequence_for<Args...>{});
+    } catch (std::bad_cast&) {
+        return false;
+    }
+    std::string cmd = cmd_line[0];
+    for (size_t i = 1; i < cmd_line.size(); ++i) {
+        cmd += ' ' + cmd_line[i];
+    }
+    // the coroutine refers to the handler and the arguments held here until it completes
+    repl_.run_async_(session, cmd, [func = func_, args = std::move(args)](std::ostream& out) {
+        return std::apply([&](const auto&... a) { return func(out, a...); }, args);
+    });
+    return true;
+}
+}  // namespace lynx
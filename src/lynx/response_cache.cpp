@@ -0,0 +1,172 @@
+#include "response_cache.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+#include <utility>
+
+#include "cinatra.hpp"
+#include "compression.hpp"
+
+namespace lynx {
+RouteCache::Lookup RouteCache::find(cinatra::coro_http_request& req, Entry& entry, std::string_view& key) {
+    // one buffer per io thread: a hit builds its key without allocating
+    thread_local std::string buffer;
+    std::lock_guard<std::mutex> lock(mutex_);
+    buffer.assign(req.get_method()).append(" ").append(req.full_url());
+    for (const auto& header : vary_) {
+        buffer.append("\n").append(req.get_header_value(header));
+    }
+    key = buffer;
+
+    if (auto it = index_.find(key); it != index_.end()) {
+        if (it->second->entry->expires > std::chrono::steady_clock::now()) {
+            lru_.splice(lru_.begin(), lru_, it->second);
+            entry = it->second->entry;
+            ++stats_.hits;
+            return Lookup::hit;
+        }
+        erase_(it->second);
+    }
+    if (pending_.find(key) != pending_.end()) {
+        return Lookup::wait;
+    }
+    pending_.emplace(std::string(key), std::vector<Waiter*>{});
+    ++stats_.misses;
+    return Lookup::leader;
+}
+
+void RouteCache::fill(std::string_view key, Entry entry) {
+    std::vector<std::pair<async_simple::Executor*, std::coroutine_handle<>>> resume;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (entry && enabled() && index_.find(key) == index_.end()) {
+            size_t cost = entry->head.size() + entry->body.size();
+            if (cost <= budget_) {
+                while (stats_.bytes + cost > budget_) {
+                    erase_(std::prev(lru_.end()));
+                    ++stats_.evictions;
+                }
+                lru_.push_front({std::string(key), entry, cost});
+                index_.emplace(lru_.front().key, lru_.begin());
+                stats_.bytes += cost;
+                stats_.entries = index_.size();
+            }
+        }
+        if (auto it = pending_.find(key); it != pending_.end()) {
+            for (auto waiter : it->second) {
+                waiter->entry_ = entry;
+                resume.emplace_back(waiter->executor_, waiter->handle_);
+            }
+            pending_.erase(it);
+        }
+    }
+    // a waiter may be gone as soon as it is scheduled: only the copies are touched
+    for (auto [executor, handle] : resume) {
+        executor->schedule([handle] { handle.resume(); });
+    }
+}
+
+bool RouteCache::Waiter::await_suspend(std::coroutine_handle<> handle) {
+    std::lock_guard<std::mutex> lock(cache_.mutex_);
+    auto it = cache_.pending_.find(key_);
+    if (it == cache_.pending_.end() || executor_ == nullptr) {
+        // the leader is done already: its response if it made one
+        if (auto hit = cache_.index_.find(key_); hit != cache_.index_.end()) {
+            entry_ = hit->second->entry;
+            ++cache_.stats_.hits;
+        }
+        return false;
+    }
+    handle_ = handle;
+    it->second.push_back(this);
+    ++cache_.stats_.coalesced;
+    return true;
+}
+
+RouteCache::Entry RouteCache::make_entry(cinatra::coro_http_response& res) const {
+    if (res.status() != cinatra::status_type::ok) {
+        return nullptr;
+    }
+    auto entry = std::make_shared<CachedResponse>();
+    if (!res.build_prepared_head(entry->head)) {
+        return nullptr;
+    }
+    entry->body = res.body_view();
+    entry->status = static_cast<int>(res.status());
+    entry->hash = Compressor::content_hash(entry->head, entry->body);
+    std::lock_guard<std::mutex> lock(mutex_);
+    entry->expires = std::chrono::steady_clock::now() + ttl_;
+    return entry;
+}
+
+void RouteCache::configure(const CacheRouteOptions& options) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (options.vary != vary_) {
+        clear_();
+    }
+    while (stats_.bytes > options.max_size) {
+        erase_(std::prev(lru_.end()));
+        ++stats_.evictions;
+    }
+    ttl_ = std::chrono::milliseconds(options.ttl_ms);
+    budget_ = options.max_size;
+    vary_ = options.vary;
+    enabled_.store(true, std::memory_order_release);
+}
+
+void RouteCache::disable() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    enabled_.store(false, std::memory_order_release);
+    clear_();
+}
+
+RouteCache::Stats RouteCache::stats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+}
+
+void RouteCache::erase_(Lru::iterator it) {
+    stats_.bytes -= it->cost;
+    index_.erase(it->key);
+    lru_.erase(it);
+    stats_.entries = index_.size();
+}
+
+void RouteCache::clear_() {
+    index_.clear();
+    lru_.clear();
+    stats_.bytes = 0;
+    stats_.entries = 0;
+}
+
+ResponseCache::ResponseCache(size_t routes) {
+    routes_.reserve(routes);
+    for (size_t i = 0; i < routes; ++i) {
+        routes_.push_back(std::make_unique<RouteCache>());
+    }
+}
+
+void ResponseCache::configure(const CacheOptions& options, const std::function<size_t(std::string_view)>& index_of) {
+    std::vector<const CacheRouteOptions*> by_index(routes_.size());
+    for (const auto& route : options.routes) {
+        size_t index = index_of(route.route);
+        if (index >= routes_.size()) {
+            throw std::invalid_argument("cache: no such route: " + route.route);
+        }
+        if (!route.route.starts_with("GET ")) {
+            throw std::invalid_argument("cache: only GET routes can be cached: " + route.route);
+        }
+        if (by_index[index]) {
+            throw std::invalid_argument("cache: route listed twice: " + route.route);
+        }
+        by_index[index] = &route;
+    }
+    for (size_t i = 0; i < routes_.size(); ++i) {
+        if (by_index[i]) {
+            routes_[i]->configure(*by_index[i]);
+        } else if (routes_[i]->enabled()) {
+            routes_[i]->disable();
+        }
+    }
+}
+}  // namespace lynx
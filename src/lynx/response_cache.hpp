@@ -0,0 +1,157 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "async_simple/Executor.h"
+#include "compression.hpp"
+#include "options.hpp"
+
+namespace cinatra {
+class coro_http_request;
+class coro_http_response;
+}  // namespace cinatra
+
+namespace lynx {
+// A response as sent, built once by the handler and replayed on every hit:
+// head is the status line and headers without Date and Connection, see
+// cinatra::coro_http_response::build_prepared_head(). Immutable, shared by
+// the cache and the responses still writing it.
+struct CachedResponse {
+    std::string head;
+    std::string body;
+    int status{200};
+    ContentHash hash;  // Compressor::content_hash() of head and body
+    std::chrono::steady_clock::time_point expires;
+};
+
+// The responses of one route, keyed by method, url (query included) and the
+// vary headers. An LRU bounded by the bytes it holds, shared by the io
+// threads. Concurrent misses on the same key are coalesced: the first one
+// (the leader) runs the handler, the others wait for its response.
+class RouteCache {
+  public:
+    using Entry = std::shared_ptr<const CachedResponse>;
+
+    struct Stats {
+        uint64_t hits{0};
+        uint64_t misses{0};
+        uint64_t coalesced{0};  // misses that waited for a leader instead of running the handler
+        uint64_t evictions{0};
+        size_t entries{0};
+        size_t bytes{0};
+    };
+
+    enum class Lookup {
+        hit,     // entry is set
+        leader,  // not cached: run the handler, then fill() the key
+        wait,    // another request is computing it: co_await wait() on the key
+    };
+
+    // Looks the request up. key is set to its cache key, viewing a thread
+    // local buffer valid until the next lookup on the thread: copy it before
+    // suspending.
+    Lookup find(cinatra::coro_http_request& req, Entry& entry, std::string_view& key);
+
+    // Ends the computation find() made the caller the leader of. A null
+    // entry, e.g. the handler failed or the response can not be cached,
+    // wakes the waiters without a response: they run the handler themselves.
+    void fill(std::string_view key, Entry entry);
+
+    // Waits for the leader of key; resumes on the executor of the waiting
+    // coroutine. Null if the leader did not produce a response.
+    class Waiter {
+      public:
+        Waiter(RouteCache& cache, std::string key) : cache_(cache), key_(std::move(key)) {}
+
+        auto coAwait(async_simple::Executor* executor) {
+            executor_ = executor;
+            return std::move(*this);
+        }
+        bool await_ready() const noexcept { return false; }
+        bool await_suspend(std::coroutine_handle<> handle);
+        Entry await_resume() { return std::move(entry_); }
+
+      private:
+        friend class RouteCache;
+        RouteCache& cache_;
+        std::string key_;
+        async_simple::Executor* executor_{nullptr};
+        std::coroutine_handle<> handle_;
+        Entry entry_;
+    };
+    Waiter wait(std::string_view key) { return Waiter(*this, std::string(key)); }
+
+    // builds the entry of a response the handler filled in, null if it can not be cached
+    Entry make_entry(cinatra::coro_http_response& res) const;
+
+    // Applies new options: a new vary list drops the cached responses, a
+    // smaller budget evicts down to it. Pending leaders finish normally.
+    void configure(const CacheRouteOptions& options);
+    void disable();
+    bool enabled() const { return enabled_.load(std::memory_order_acquire); }
+
+    Stats stats() const;
+
+  private:
+    struct Slot {
+        std::string key;
+        Entry entry;
+        size_t cost;
+    };
+    struct KeyHash {
+        using is_transparent = void;
+        size_t operator()(std::string_view key) const { return std::hash<std::string_view>{}(key); }
+    };
+    using Lru = std::list<Slot>;
+    // the keys being computed, with the requests waiting for them
+    using Pending = std::unordered_map<std::string, std::vector<Waiter*>, KeyHash, std::equal_to<>>;
+
+    void erase_(Lru::iterator it);
+    void clear_();
+
+    std::atomic<bool> enabled_{false};
+    mutable std::mutex mutex_;
+    std::chrono::milliseconds ttl_{0};
+    size_t budget_{0};
+    std::vector<std::string> vary_;
+    Lru lru_;  // most recently used first
+    std::unordered_map<std::string, Lru::iterator, KeyHash, std::equal_to<>> index_;
+    Pending pending_;
+    Stats stats_;
+};
+
+// A RouteCache per route of a route table, by route index (see
+// RouteTable::find()). Only GET routes may be cached: the others are not
+// idempotent.
+class ResponseCache {
+  public:
+    explicit ResponseCache(size_t routes);
+
+    // nullptr if the route is not cached
+    RouteCache* route(size_t index) {
+        auto& cache = *routes_[index];
+        return cache.enabled() ? &cache : nullptr;
+    }
+
+    // index_of maps CacheRouteOptions::route to a route index, npos if there
+    // is no such route. Throws std::invalid_argument for an unknown or non GET
+    // route, leaving the caches as they were. Routes no longer listed stop
+    // being cached.
+    void configure(const CacheOptions& options, const std::function<size_t(std::string_view)>& index_of);
+
+  private:
+    std::vector<std::unique_ptr<RouteCache>> routes_;
+};
+}  // namespace lynx
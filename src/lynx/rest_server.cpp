@@ -1,25 +1,334 @@
 #include "rest_server.hpp"
 
+#include <algorithm>
+#include <any>
+#include <system_error>
+
+#include "route_table.hpp"
+#include "spdlog/spdlog.h"
+
 namespace lynx {
+namespace {
+using Handler = void (*)(const RouteParams&, cinatra::coro_http_request&, cinatra::coro_http_response&);
+
+void health(const RouteParams&, cinatra::coro_http_request&, cinatra::coro_http_response& res) {
+    res.set_status_and_content(cinatra::status_type::ok, "ok");
+}
+
+// REST API 示例1：数字参数
+void numbers(const RouteParams& params, cinatra::coro_http_request&, cinatra::coro_http_response& res) {
+    spdlog::debug("numbers: a is {}, b is {}", params[0], params[1]);
+    res.set_status_and_content(cinatra::status_type::ok, "hello world");
+}
+
+// REST API 示例2：字符串参数
+void string_test(const RouteParams& params, cinatra::coro_http_request&, cinatra::coro_http_response& res) {
+    std::string_view id = params.get("id");
+    std::string_view name = params.get("name");
+    spdlog::debug("string_test: id is {}, name is {}", id, name);
+    res.set_status_and_content(cinatra::status_type::ok, std::string(name));
+}
+
+// The whole API surface, built at compile time: exact paths are looked up in a
+// perfect hash map, the others matched segment by segment, never with a regex.
+constexpr std::pair<frozen::string, Handler> kExactRoutes[] = {
+    {"GET /health", health},
+};
+constexpr RouteTable<Handler, std::size(kExactRoutes), 4> kRoutes(
+    kExactRoutes, {{
+                      {"GET", "/numbers/{a:int}/test/{b:int}", numbers},
+                      {"POST", "/numbers/{a:int}/test/{b:int}", numbers},
+                      {"GET", "/string/{id}/test/{name}", string_test},
+                      {"POST", "/string/{id}/test/{name}", string_test},
+                  }});
+
+// Routes that read their body as a stream (upload.hpp): their handler is a
+// coroutine and always runs on the coroutine router.
+using StreamHandler = async_simple::coro::Lazy<void> (*)(const RouteParams&, BodyStream&, cinatra::coro_http_request&,
+                                                         cinatra::coro_http_response&);
+
+// 流式上传示例：逐块统计字节数和行数，内存只占一个窗口
+async_simple::coro::Lazy<void> ingest(const RouteParams&, BodyStream& body, cinatra::coro_http_request&,
+                                      cinatra::coro_http_response& res) {
+    size_t lines = 0;
+    for (;;) {
+        auto part = co_await body.next();
+        if (part.empty()) {
+            break;
+        }
+        lines += std::count(part.begin(), part.end(), '\n');
+    }
+    res.set_status_and_content(cinatra::status_type::ok,
+                               "bytes " + std::to_string(body.received()) + " lines " + std::to_string(lines));
+}
+
+// 落盘示例：请求体写入临时文件后 mmap 读取
+async_simple::coro::Lazy<void> ingest_file(const RouteParams&, BodyStream& body, cinatra::coro_http_request&,
+                                           cinatra::coro_http_response& res) {
+    SpilledBody file = co_await body.spill();
+    auto view = file.view();
+    size_t lines = std::count(view.begin(), view.end(), '\n');
+    res.set_status_and_content(cinatra::status_type::ok,
+                               "bytes " + std::to_string(file.size()) + " lines " + std::to_string(lines));
+}
+
+constexpr std::pair<frozen::string, StreamHandler> kExactStreamRoutes[] = {
+    {"POST /ingest", ingest},
+    {"POST /ingest/file", ingest_file},
+};
+constexpr RouteTable<StreamHandler, std::size(kExactStreamRoutes), 0> kStreamRoutes(kExactStreamRoutes, {});
+
+using cinatra::coro_http_router;
+
+// 压缩: the variant of a cached response the client accepts, the response as cached otherwise
+void replay(Compressor* compressor, const RouteCache::Entry& entry, cinatra::coro_http_request& req,
+            cinatra::coro_http_response& res) {
+    auto status = static_cast<cinatra::status_type>(entry->status);
+    if (compressor && compressor->eligible_head(entry->head, entry->body.size())) {
+        if (auto encoding = compressor->negotiate(req.get_accept_encoding()); encoding != Encoding::identity) {
+            if (auto variant = compressor->cached(entry, entry->head, entry->body, entry->hash, encoding)) {
+                res.set_prepared(status, variant->head, variant->body, variant);
+                return;
+            }
+        }
+    }
+    res.set_prepared(status, entry->head, entry->body, entry);
+}
+
+bool compressible(Compressor* compressor, cinatra::coro_http_response& res) {
+    return compressor && res.status() == cinatra::status_type::ok &&
+           compressor->eligible(res.header_value("Content-Type"), res.body_view().size()) &&
+           res.header_value("Content-Encoding").empty();
+}
+
+void apply(Compressor::Variant variant, cinatra::coro_http_response& res) {
+    if (variant) {
+        res.add_header("Content-Encoding", std::string(to_string(variant->encoding)));
+        res.set_content(variant->body);
+    }
+}
+
+// Compresses the response a handler made if its body is small enough for
+// the io thread. True if it is not: the coroutine router compresses it on the
+// workers (compress_offloaded()).
+bool compress_handled(Compressor* compressor, cinatra::coro_http_request& req, cinatra::coro_http_response& res) {
+    if (!compressible(compressor, res)) {
+        return false;
+    }
+    if (res.header_value("Vary").empty()) {
+        res.add_header("Vary", "Accept-Encoding");
+    }
+    auto encoding = compressor->negotiate(req.get_accept_encoding());
+    if (encoding == Encoding::identity) {
+        return false;
+    }
+    auto body = res.body_view();
+    if (body.size() >= compressor->options().offload_min) {
+        return true;
+    }
+    apply(compressor->compress({}, body, encoding), res);
+    return false;
+}
+
+async_simple::coro::Lazy<void> compress_offloaded(Compressor* compressor, cinatra::coro_http_request& req,
+                                                  cinatra::coro_http_response& res) {
+    auto encoding = compressor->negotiate(req.get_accept_encoding());
+    apply(co_await compressor->offload({}, res.body_view(), encoding), res);
+}
+
+async_simple::coro::Lazy<void> compress_any(Compressor* compressor, cinatra::coro_http_request& req,
+                                            cinatra::coro_http_response& res) {
+    if (compress_handled(compressor, req, res)) {
+        co_await compress_offloaded(compressor, req, res);
+    }
+}
+
+// Why the static router suspended a request whose handler it ran already,
+// kept in the request's user data for serve_suspended(): the response may
+// have any body, an empty one included.
+enum class Suspended { compress };
+
+bool suspended_to_compress(cinatra::coro_http_request& req) {
+    auto data = req.get_user_data();
+    auto* why = std::any_cast<Suspended>(&data);
+    return why != nullptr && *why == Suspended::compress;
+}
+
+// Runs the handler for a key nobody else is computing and hands its response
+// to the requests waiting for it, even if the handler throws.
+void lead(RouteCache& cache, Compressor* compressor, std::string key, Handler handler, const RouteParams& params,
+          cinatra::coro_http_request& req, cinatra::coro_http_response& res) {
+    struct Leader {
+        RouteCache& cache;
+        std::string key;
+        RouteCache::Entry entry;
+        ~Leader() { cache.fill(key, std::move(entry)); }
+    } leader{cache, std::move(key), nullptr};
+    handler(params, req, res);
+    if (compressible(compressor, res) && res.header_value("Vary").empty()) {
+        // cached as sent to the clients that do not compress
+        res.add_header("Vary", "Accept-Encoding");
+    }
+    leader.entry = cache.make_entry(res);
+    if (leader.entry && compressor) {
+        replay(compressor, leader.entry, req, res);
+    }
+}
+
+// The requests the static router suspended: to a streaming route, with a
+// large body to compress, or because their key is being computed by another
+// request, then wait for its response.
+async_simple::coro::Lazy<void> serve_suspended(ResponseCache& caches, Compressor* compressor,
+                                               const UploadOptions& uploads, std::string_view key,
+                                               cinatra::coro_http_request& req, cinatra::coro_http_response& res) {
+    if (suspended_to_compress(req)) {
+        // the static router ran the handler already, only the body is left to compress
+        co_await compress_offloaded(compressor, req, res);
+        co_return;
+    }
+    RouteParams params;
+    if (StreamHandler handler = kStreamRoutes.find(key, params); handler != nullptr) {
+        BodyStream body(req, uploads);
+        co_await handler(params, body, req, res);
+        co_await compress_any(compressor, req, res);
+        co_return;
+    }
+    size_t index;
+    Handler handler = kRoutes.find(key, params, index);
+    if (handler == nullptr) {
+        res.set_status(cinatra::status_type::not_found);
+        co_return;
+    }
+    RouteCache* cache = caches.route(index);
+    if (cache == nullptr) {
+        // no longer cached
+        handler(params, req, res);
+        co_await compress_any(compressor, req, res);
+        co_return;
+    }
+    RouteCache::Entry entry;
+    std::string_view cache_key;
+    switch (cache->find(req, entry, cache_key)) {
+        case RouteCache::Lookup::hit:
+            break;
+        case RouteCache::Lookup::leader:
+            lead(*cache, compressor, std::string(cache_key), handler, params, req, res);
+            co_return;
+        case RouteCache::Lookup::wait:
+            entry = co_await cache->wait(cache_key);
+            if (entry == nullptr) {
+                // the leader's response could not be cached
+                handler(params, req, res);
+                co_await compress_any(compressor, req, res);
+                co_return;
+            }
+            break;
+    }
+    replay(compressor, entry, req, res);
+}
+}  // namespace
+
+RestServer::RestServer(IoContextPool& pool, unsigned short port, std::string address)
+    : cache_(std::make_unique<ResponseCache>(kRoutes.size())) {
+    servers_.reserve(pool.size());
+    for (size_t i = 0; i < pool.size(); ++i) {
+        auto server = std::make_unique<cinatra::coro_http_server>(pool.context(i), port, address);
+        server->set_reuse_port(true);
+        servers_.push_back(std::move(server));
+    }
+}
+
 void RestServer::setup_routes() {
-    // REST API 示例1：数字参数
-    server_.set_http_handler<cinatra::GET, cinatra::POST>(
-        R"(/numbers/(\d+)/test/(\d+))",
-        [](cinatra::request& req, cinatra::response& res) {
-            std::cout << "matches[1] is : " << req.matches_[1]
-                      << " matches[2] is: " << req.matches_[2] << std::endl;
-            res.set_status_and_content(cinatra::status_type::ok, "hello world");
-        });
-
-    // REST API 示例2：字符串参数
-    server_.set_http_handler<cinatra::GET, cinatra::POST>(
-        "/string/:id/test/:name",
-        [](cinatra::request& req, cinatra::response& res) {
-            std::string id = req.params_["id"];
-            std::string name = req.params_["name"];
-            std::cout << "id value is: " << id << std::endl;
-            std::cout << "name value is: " << name << std::endl;
-            res.set_status_and_content(cinatra::status_type::ok, name);
-        });
-}
-}  // namespace lynx
\ No newline at end of file
+    for (auto& server : servers_) {
+        server->set_static_router(
+            [this](std::string_view key, cinatra::coro_http_request& req, cinatra::coro_http_response& res) {
+                RouteParams params;
+                size_t index;
+                Handler handler = kRoutes.find(key, params, index);
+                if (handler == nullptr) {
+                    return kStreamRoutes.find(key, params) != nullptr ? coro_http_router::static_route::suspend
+                                                                       : coro_http_router::static_route::not_found;
+                }
+                if (req.get_conn()->body_left() > 0) {
+                    // a body of stream_min bytes or more, only the streaming routes read it
+                    res.set_status_and_content(cinatra::status_type::request_entity_too_large, "body too large");
+                    return coro_http_router::static_route::served;
+                }
+                RouteCache* route = cache_->route(index);
+                if (route == nullptr) {
+                    handler(params, req, res);
+                    if (!compress_handled(compressor_, req, res)) {
+                        return coro_http_router::static_route::served;
+                    }
+                    req.set_user_data(Suspended::compress);
+                    return coro_http_router::static_route::suspend;
+                }
+                // 缓存命中: 不调用 handler, 直接写出缓存的 head 和 body
+                RouteCache::Entry entry;
+                std::string_view cache_key;
+                switch (route->find(req, entry, cache_key)) {
+                    case RouteCache::Lookup::hit:
+                        replay(compressor_, entry, req, res);
+                        break;
+                    case RouteCache::Lookup::leader:
+                        lead(*route, compressor_, std::string(cache_key), handler, params, req, res);
+                        break;
+                    case RouteCache::Lookup::wait:
+                        return coro_http_router::static_route::suspend;
+                }
+                return coro_http_router::static_route::served;
+            },
+            [this](std::string_view key, cinatra::coro_http_request& req, cinatra::coro_http_response& res) {
+                return serve_suspended(*cache_, compressor_, uploads_, key, req, res);
+            });
+    }
+}
+
+void RestServer::configure_uploads(const UploadOptions& options) {
+    uploads_ = options;
+    for (auto& server : servers_) {
+        server->set_stream_body_min(options.stream_min);
+        server->set_max_http_body_size(static_cast<int64_t>(options.max_size));
+    }
+}
+
+void RestServer::configure_cache(const CacheOptions& options) {
+    cache_->configure(options, [](std::string_view route) { return kRoutes.index_of(route); });
+}
+
+void RestServer::serve_static(StaticFiles& files) {
+    for (auto& server : servers_) {
+        server->set_default_handler(
+            [&files](cinatra::coro_http_request& req, cinatra::coro_http_response& res) -> async_simple::coro::Lazy<void> {
+                co_await files.serve(req, res);
+            });
+    }
+}
+
+void RestServer::serve_pubsub(PubSubHub& hub) {
+    for (auto& server : servers_) {
+        server->set_http_handler<cinatra::GET>(
+            hub.options().path,
+            [&hub](cinatra::coro_http_request& req, cinatra::coro_http_response& res) -> async_simple::coro::Lazy<void> {
+                co_await hub.serve(req, res);
+            });
+    }
+}
+
+void RestServer::async_start() {
+    for (auto& server : servers_) {
+        // the future is only ready right away when listen() failed
+        auto future = server->async_start();
+        if (future.hasResult() && future.value()) {
+            throw std::system_error(future.value(), "REST server failed to listen on port " +
+                                                        std::to_string(server->port()));
+        }
+    }
+}
+
+void RestServer::stop() {
+    for (auto& server : servers_) {
+        server->stop();
+    }
+}
+}  // namespace lynx
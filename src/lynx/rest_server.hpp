@@ -2,21 +2,60 @@
 #include <asio.hpp>
 #include <functional>
 #include <iostream>
+#include <memory>
 #include <string>
+#include <vector>
 
 #include "cinatra.hpp"
+#include "compression.hpp"
+#include "io_pool.hpp"
+#include "pubsub.hpp"
+#include "response_cache.hpp"
+#include "static_files.hpp"
+#include "upload.hpp"
 
 namespace lynx {
+// One coro_http_server per io_context of the pool, all listening on the same
+// port with SO_REUSEPORT: the kernel spreads the connections between the
+// acceptors, each served by the thread that accepted it.
 class RestServer {
   public:
-    RestServer(asio::io_context& io_ctx, unsigned short port, std::string address)
-        : server_(io_ctx, port, address) {}
+    RestServer(IoContextPool& pool, unsigned short port, std::string address);
 
+    // installs the compile time route table (route_table.hpp) on every server
     void setup_routes();
+    // Caches the responses of the routes listed, replaces the previous
+    // options; callable while serving. Throws std::invalid_argument for an
+    // unknown or non GET route, keeping the previous options.
+    void configure_cache(const CacheOptions& options);
+    // Bodies of at least options.stream_min bytes are left in the socket for
+    // the streaming routes to read (upload.hpp), the other routes answer them
+    // with a 413; bodies over options.max_size are refused. Call it before
+    // async_start().
+    void configure_uploads(const UploadOptions& options);
+    // Compresses the responses the clients accept compressed: the variants
+    // of the cached responses are kept by compressor, the other responses
+    // are compressed on each request. compressor must outlive the servers;
+    // call it before async_start().
+    void compress_with(Compressor& compressor) { compressor_ = &compressor; }
+    // Requests no route matched go to files: those under its prefix are
+    // served, the others get a 404. files must outlive the servers.
+    void serve_static(StaticFiles& files);
+    // The websocket clients of hub connect to its options().path, see
+    // PubSubHub::serve(). hub must outlive the servers; call it before async_start().
+    void serve_pubsub(PubSubHub& hub);
+    // listens on every context, throws std::system_error if one of them fails
+    void async_start();
+    void stop();
 
-    cinatra::coro_http_server& server() { return server_; }
+    size_t size() const { return servers_.size(); }
+    cinatra::coro_http_server& server(size_t i = 0) { return *servers_[i]; }
+    ResponseCache& cache() { return *cache_; }
 
   private:
-    cinatra::coro_http_server server_;
+    std::vector<std::unique_ptr<cinatra::coro_http_server>> servers_;
+    std::unique_ptr<ResponseCache> cache_;
+    UploadOptions uploads_;
+    Compressor* compressor_{nullptr};
 };
-}  // namespace lynx
\ No newline at end of file
+}  // namespace lynx
@@ -0,0 +1,222 @@
+#pragma once
+
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+
+#include "frozen/string.h"
+#include "frozen/unordered_map.h"
+
+namespace lynx {
+// Values captured by a pattern route, viewing the request path. Slots past
+// size() are left uninitialized: one lives on the stack of every lookup.
+class RouteParams {
+  public:
+    static constexpr size_t kMaxParams = 8;
+
+    constexpr RouteParams() {}
+
+    constexpr size_t size() const { return count_; }
+    constexpr std::string_view operator[](size_t i) const { return slots_[i].value(); }
+    // empty if the pattern has no such parameter
+    constexpr std::string_view get(std::string_view name) const {
+        for (size_t i = 0; i < count_; ++i) {
+            if (slots_[i].name() == name) {
+                return slots_[i].value();
+            }
+        }
+        return {};
+    }
+
+    constexpr void clear() { count_ = 0; }
+    constexpr bool add(std::string_view name, std::string_view value) {
+        if (count_ == kMaxParams) {
+            return false;
+        }
+        slots_[count_++] = {name.data(), name.size(), value.data(), value.size()};
+        return true;
+    }
+
+  private:
+    struct Slot {
+        const char* name_data;
+        size_t name_size;
+        const char* value_data;
+        size_t value_size;
+
+        constexpr std::string_view name() const { return {name_data, name_size}; }
+        constexpr std::string_view value() const { return {value_data, value_size}; }
+    };
+
+    Slot slots_[kMaxParams];
+    size_t count_{0};
+};
+
+// Matches a path against a pattern made of literal segments, "{name}" (any
+// non empty segment) and "{name:int}" (digits only), e.g.
+// "/numbers/{a:int}/test/{b:int}". One pass over both strings, no regex and
+// no allocation. On a miss params holds what matched before the mismatch.
+constexpr bool match_route(std::string_view pattern, std::string_view path, RouteParams& params) {
+    params.clear();
+    size_t i = 0;
+    size_t j = 0;
+    while (i < pattern.size()) {
+        if (pattern[i] != '{') {
+            if (j == path.size() || pattern[i] != path[j]) {
+                return false;
+            }
+            ++i;
+            ++j;
+            continue;
+        }
+        size_t close = pattern.find('}', i);
+        std::string_view spec = pattern.substr(i + 1, close - i - 1);
+        std::string_view name = spec;
+        bool digits = false;
+        if (size_t colon = spec.find(':'); colon != std::string_view::npos) {
+            name = spec.substr(0, colon);
+            digits = spec.substr(colon + 1) == "int";
+        }
+        size_t end = j;
+        while (end < path.size() && path[end] != '/') {
+            if (digits && (path[end] < '0' || path[end] > '9')) {
+                return false;
+            }
+            ++end;
+        }
+        if (end == j || !params.add(name, path.substr(j, end - j))) {
+            return false;
+        }
+        i = close + 1;
+        j = end;
+    }
+    return j == path.size();
+}
+
+// Seeded hash for the perfect hash tables of RouteTable. frozen's default
+// hashes one byte per multiply; route keys are hashed eight bytes at a time.
+struct RouteHash {
+    constexpr size_t operator()(frozen::string key, size_t seed) const {
+        const char* p = key.data();
+        size_t n = key.size();
+        uint64_t h = (seed ^ n) * kMul;
+        if (n < 8) {
+            for (size_t k = 0; k < n; ++k) {
+                h = mix(h ^ static_cast<unsigned char>(p[k]));
+            }
+        } else {
+            // whole words, then the last eight bytes (overlapping the previous word)
+            for (size_t i = 0; i + 8 < n; i += 8) {
+                h = mix(h ^ load(p + i));
+            }
+            h = mix(h ^ load(p + n - 8));
+        }
+        return static_cast<size_t>(h ^ (h >> 32));
+    }
+
+  private:
+    static constexpr uint64_t kMul = 0x9e3779b97f4a7c15ULL;
+    static constexpr uint64_t mix(uint64_t h) { return (h ^ (h >> 29)) * kMul; }
+    // little endian, same value at compile time and at run time
+    static constexpr uint64_t load(const char* p) {
+        static_assert(std::endian::native == std::endian::little);
+        uint64_t w = 0;
+        if (std::is_constant_evaluated()) {
+            for (size_t k = 0; k < 8; ++k) {
+                w |= uint64_t(static_cast<unsigned char>(p[k])) << (8 * k);
+            }
+        } else {
+            std::memcpy(&w, p, sizeof(w));
+        }
+        return w;
+    }
+};
+
+struct RouteKeyEqual {
+    constexpr bool operator()(frozen::string a, frozen::string b) const {
+        return std::string_view(a.data(), a.size()) == std::string_view(b.data(), b.size());
+    }
+};
+
+// A route table fixed at compile time. Exact "METHOD /path" keys resolve
+// through a frozen::unordered_map (perfect hashing built by the compiler),
+// the routes with parameters are then tried in order with match_route().
+template <typename Handler, size_t Exact, size_t Patterns>
+class RouteTable {
+  public:
+    struct Pattern {
+        std::string_view method;
+        std::string_view path;
+        Handler handler;
+    };
+
+    constexpr RouteTable(const std::pair<frozen::string, Handler> (&exact)[Exact],
+                         const std::array<Pattern, Patterns>& patterns)
+        : exact_(frozen::make_unordered_map(exact, RouteHash{}, RouteKeyEqual{})), patterns_(patterns) {}
+
+    static constexpr size_t npos = static_cast<size_t>(-1);
+
+    // number of routes; a route's index is below it
+    static constexpr size_t size() { return Exact + Patterns; }
+
+    // key is "METHOD /path" without the query, as cinatra routes it.
+    // Returns a null handler when nothing matches.
+    constexpr Handler find(std::string_view key, RouteParams& params) const {
+        size_t index;
+        return find(key, params, index);
+    }
+
+    // Also tells which route matched: exact routes first, in table order,
+    // then the patterns. index is npos on a miss.
+    constexpr Handler find(std::string_view key, RouteParams& params, size_t& index) const {
+        params.clear();
+        if (auto it = exact_.find(frozen::string(key.data(), key.size())); it != exact_.end()) {
+            index = static_cast<size_t>(it - exact_.begin());
+            return it->second;
+        }
+        index = npos;
+        size_t space = key.find(' ');
+        if (space == std::string_view::npos) {
+            return nullptr;
+        }
+        std::string_view method = key.substr(0, space);
+        std::string_view path = key.substr(space + 1);
+        for (size_t i = 0; i < Patterns; ++i) {
+            const auto& p = patterns_[i];
+            if (p.method == method && match_route(p.path, path, params)) {
+                index = Exact + i;
+                return p.handler;
+            }
+        }
+        params.clear();
+        return nullptr;
+    }
+
+    // Index of a route as declared, e.g. "GET /numbers/{a:int}/test/{b:int}"
+    // (the pattern itself, not a path it matches), npos if there is none.
+    constexpr size_t index_of(std::string_view route) const {
+        if (auto it = exact_.find(frozen::string(route.data(), route.size())); it != exact_.end()) {
+            return static_cast<size_t>(it - exact_.begin());
+        }
+        size_t space = route.find(' ');
+        if (space == std::string_view::npos) {
+            return npos;
+        }
+        for (size_t i = 0; i < Patterns; ++i) {
+            if (patterns_[i].method == route.substr(0, space) && patterns_[i].path == route.substr(space + 1)) {
+                return Exact + i;
+            }
+        }
+        return npos;
+    }
+
+  private:
+    frozen::unordered_map<frozen::string, Handler, Exact, RouteHash, RouteKeyEqual> exact_;
+    std::array<Pattern, Patterns> patterns_;
+};
+}  // namespace lynx
@@ -0,0 +1,176 @@
+#include "scheduler.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <exception>
+#include <stdexcept>
+#include <utility>
+
+#include "spdlog/spdlog.h"
+
+namespace lynx {
+namespace {
+using clock_type = TimerWheel::clock;
+
+size_t bucket_of(std::chrono::nanoseconds runtime) {
+    const auto us = static_cast<uint64_t>(std::max<int64_t>(runtime.count() / 1000, 0));
+    return us < 2 ? 0 : std::min<size_t>(std::bit_width(us) - 1, TaskStats::kBuckets - 1);
+}
+}  // namespace
+
+std::chrono::microseconds TaskStats::percentile(double q) const {
+    uint64_t count = 0;
+    for (uint64_t n : histogram) {
+        count += n;
+    }
+    if (count == 0) {
+        return std::chrono::microseconds(0);
+    }
+    const auto rank = std::max<uint64_t>(1, static_cast<uint64_t>(q * static_cast<double>(count) + 0.5));
+    uint64_t seen = 0;
+    for (size_t b = 0; b < histogram.size(); ++b) {
+        seen += histogram[b];
+        if (seen >= rank) {
+            return std::chrono::microseconds(int64_t(1) << (b + 1));
+        }
+    }
+    return std::chrono::microseconds(int64_t(1) << histogram.size());
+}
+
+PeriodicScheduler::PeriodicScheduler(TimerWheel& wheel, const SchedulerOptions& options)
+    : wheel_(wheel), workers_(std::max<size_t>(options.threads, 1)), random_(std::random_device{}()) {}
+
+PeriodicScheduler::~PeriodicScheduler() {
+    for (auto& [id, state] : tasks_) {
+        state->removed = true;
+        wheel_.cancel(state->timer);
+    }
+    workers_.join();
+}
+
+PeriodicScheduler::Id PeriodicScheduler::add(std::string name, const TaskOptions& options, Task task) {
+    if (options.interval.count() <= 0) {
+        throw std::invalid_argument("periodic task interval must be positive: " + name);
+    }
+    if (options.jitter.count() < 0 || options.jitter >= options.interval) {
+        throw std::invalid_argument("periodic task jitter must be at least 0 and less than its interval: " + name);
+    }
+    auto state = std::make_shared<State>();
+    state->id = next_id_++;
+    state->options = options;
+    state->task = std::move(task);
+    state->start = clock_type::now() + std::max(options.phase, std::chrono::milliseconds(0));
+    state->stats.name = std::move(name);
+    state->stats.options = options;
+    tasks_.emplace(state->id, state);
+    arm_(state);
+    return state->id;
+}
+
+bool PeriodicScheduler::remove(Id id) {
+    auto it = tasks_.find(id);
+    if (it == tasks_.end()) {
+        return false;
+    }
+    it->second->removed = true;
+    wheel_.cancel(it->second->timer);
+    tasks_.erase(it);
+    return true;
+}
+
+void PeriodicScheduler::arm_(const std::shared_ptr<State>& state) {
+    clock_type::time_point due = state->start + state->options.interval * static_cast<int64_t>(state->next);
+    if (state->options.jitter.count() > 0) {
+        std::uniform_int_distribution<int64_t> jitter(0, state->options.jitter.count() - 1);
+        due += std::chrono::milliseconds(jitter(random_));
+    }
+    state->timer = wheel_.schedule(due - clock_type::now(), [this, state] { due_(state); });
+}
+
+void PeriodicScheduler::due_(const std::shared_ptr<State>& state) {
+    // the next run follows the schedule, not this one: the runs whose time
+    // went by already are skipped
+    const auto now = clock_type::now();
+    const auto interval = state->options.interval;
+    uint64_t next = state->next + 1;
+    if (now >= state->start + interval * static_cast<int64_t>(next)) {
+        const auto caught_up = static_cast<uint64_t>((now - state->start) / interval) + 1;
+        std::lock_guard lock(state->mutex);
+        state->stats.skipped += caught_up - next;
+        next = caught_up;
+    }
+    state->next = next;
+    arm_(state);
+
+    if (state->running) {
+        std::lock_guard lock(state->mutex);
+        ++state->stats.skipped;
+        return;
+    }
+    due_list_.push_back(state);
+    if (due_list_.size() == 1) {
+        // after the wheel's batch: one dispatch for every task of the tick
+        asio::post(wheel_.executor(), [this] { dispatch_(); });
+    }
+}
+
+void PeriodicScheduler::dispatch_() {
+    std::vector<std::shared_ptr<State>> batch;
+    batch.swap(due_list_);
+    for (auto& state : batch) {
+        if (state->removed || state->running) {
+            continue;
+        }
+        // the tasks before it in the batch ran past its next run: that one
+        // takes its place
+        if (clock_type::now() >= state->start + state->options.interval * static_cast<int64_t>(state->next)) {
+            std::lock_guard lock(state->mutex);
+            ++state->stats.skipped;
+            continue;
+        }
+        state->running = true;
+        if (state->options.offload) {
+            asio::post(workers_, [state] { run_(*state); });
+        } else {
+            run_(*state);
+        }
+    }
+}
+
+void PeriodicScheduler::run_(State& state) {
+    const auto start = clock_type::now();
+    try {
+        state.task();
+    } catch (const std::exception& e) {
+        spdlog::warn("periodic task failed", {{"task", state.stats.name}, {"error", e.what()}});
+    } catch (...) {
+        spdlog::warn("periodic task failed", {{"task", state.stats.name}, {"error", "unknown exception"}});
+    }
+    const auto runtime = std::chrono::duration_cast<std::chrono::nanoseconds>(clock_type::now() - start);
+    {
+        std::lock_guard lock(state.mutex);
+        TaskStats& s = state.stats;
+        ++s.runs;
+        if (runtime > state.options.interval) {
+            ++s.overruns;
+        }
+        s.last = runtime;
+        s.max = std::max(s.max, runtime);
+        s.total += runtime;
+        ++s.histogram[bucket_of(runtime)];
+    }
+    state.running = false;
+}
+
+std::vector<TaskStats> PeriodicScheduler::stats() const {
+    std::vector<TaskStats> all;
+    all.reserve(tasks_.size());
+    for (const auto& [id, state] : tasks_) {
+        std::lock_guard lock(state->mutex);
+        all.push_back(state->stats);
+        all.back().running = state->running;
+    }
+    std::sort(all.begin(), all.end(), [](const TaskStats& a, const TaskStats& b) { return a.name < b.name; });
+    return all;
+}
+}  // namespace lynx
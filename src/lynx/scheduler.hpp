@@ -0,0 +1,103 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "asio.hpp"
+#include "options.hpp"
+#include "timer_wheel.hpp"
+
+namespace lynx {
+struct TaskOptions {
+    std::chrono::milliseconds interval{1000};
+    std::chrono::milliseconds phase{0};   // first run this long after add(), then every interval
+    std::chrono::milliseconds jitter{0};  // each run up to this late, at random: the cadence stays put
+    bool offload{false};                  // on the workers: a slow task never holds the io thread
+};
+
+// Runtime histogram and counters of a task.
+struct TaskStats {
+    static constexpr size_t kBuckets = 24;  // bucket b: runs of [2^b, 2^(b+1)) us, the first and last open
+
+    std::string name;
+    TaskOptions options;
+    uint64_t runs{0};
+    uint64_t overruns{0};  // runs longer than the interval
+    uint64_t skipped{0};   // due while still running, or while the io thread was late
+    bool running{false};
+    std::chrono::nanoseconds last{0};
+    std::chrono::nanoseconds max{0};
+    std::chrono::nanoseconds total{0};
+    std::array<uint64_t, kBuckets> histogram{};
+
+    // upper bound of the bucket holding quantile q of the runs, 0 before the first
+    std::chrono::microseconds percentile(double q) const;
+};
+
+// Periodic jobs of the control plane, on a TimerWheel: each task has a
+// timer of the wheel, re-armed from its own schedule (the n-th run is due at
+// phase + n * interval, plus jitter) before it runs, so a slow run does not
+// drift the cadence of the task or of the others; the runs it overlaps are
+// skipped and counted. The tasks due in the same tick are dispatched
+// together, the offloaded ones to a pool of workers.
+//
+// Its methods are for the io_context thread, the offloaded runs update their
+// stats under the task's lock. Destroy it once the io_context stopped running.
+class PeriodicScheduler {
+  public:
+    using Task = std::function<void()>;
+    using Id = uint64_t;
+
+    // the wheel must outlive the scheduler
+    PeriodicScheduler(TimerWheel& wheel, const SchedulerOptions& options);
+    // waits for the offloaded runs in progress
+    ~PeriodicScheduler();
+
+    PeriodicScheduler(const PeriodicScheduler&) = delete;
+    PeriodicScheduler& operator=(const PeriodicScheduler&) = delete;
+
+    // throws std::invalid_argument unless interval > 0 and 0 <= jitter < interval
+    Id add(std::string name, const TaskOptions& options, Task task);
+    // a run in progress completes, false if there is no such task
+    bool remove(Id id);
+
+    // by name
+    std::vector<TaskStats> stats() const;
+
+  private:
+    struct State {
+        Id id;
+        TaskOptions options;
+        Task task;
+        TimerWheel::clock::time_point start;  // run n is due at start + n * interval
+        uint64_t next{0};                     // run the timer is armed for
+        TimerWheel::Id timer{0};
+        std::atomic<bool> running{false};
+        std::atomic<bool> removed{false};
+        mutable std::mutex mutex;  // the stats, written by the workers too
+        TaskStats stats;
+    };
+
+    void arm_(const std::shared_ptr<State>& state);
+    void due_(const std::shared_ptr<State>& state);
+    void dispatch_();
+    static void run_(State& state);
+
+    TimerWheel& wheel_;
+    asio::thread_pool workers_;
+    std::minstd_rand random_;
+    Id next_id_{1};
+    std::unordered_map<Id, std::shared_ptr<State>> tasks_;
+    std::vector<std::shared_ptr<State>> due_list_;  // fired in the current tick, dispatched by one post
+};
+}  // namespace lynx
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <utility>
+#include <vector>
+
+namespace lynx {
+// A value read from any thread without locking and replaced copy on write
+// (RCU style): publish() makes a new version current, the versions readers
+// still hold live on until they let go. std::atomic<std::shared_ptr> would
+// not do, libstdc++ hides a spin lock in it.
+//
+// A reader counts itself in the slot it loaded, then checks the slot is still
+// the current one; publish() replaces the current slot, then recycles only
+// slots without readers. All four accesses are seq_cst, so of a reader and a
+// publisher racing on a slot one sees the other: either the reader finds the
+// slot replaced and backs off, or the publisher finds it read and leaves it
+// alone. The release on leaving orders the reads of the value before the
+// publisher's reuse of the slot.
+//
+// Readers never block. Publishers must be serialized by the caller, current()
+// is for them too. Slots are never freed before the cell: a publisher reuses
+// the first one that is not current and has no reader, else adds one.
+template <typename T>
+class SnapshotCell {
+    struct Slot {
+        T value{};
+        std::atomic<size_t> readers{0};
+    };
+
+  public:
+    // the value current when read() was called, counted as read until it goes
+    class Reader {
+      public:
+        explicit Reader(const std::atomic<Slot*>& current) {
+            for (;;) {
+                slot_ = current.load(std::memory_order_seq_cst);
+                slot_->readers.fetch_add(1, std::memory_order_seq_cst);
+                if (current.load(std::memory_order_seq_cst) == slot_) {
+                    return;
+                }
+                // replaced meanwhile, maybe being recycled: not read
+                slot_->readers.fetch_sub(1, std::memory_order_relaxed);
+            }
+        }
+        ~Reader() { slot_->readers.fetch_sub(1, std::memory_order_release); }
+
+        Reader(const Reader&) = delete;
+        Reader& operator=(const Reader&) = delete;
+
+        const T& operator*() const { return slot_->value; }
+        const T* operator->() const { return &slot_->value; }
+
+      private:
+        Slot* slot_;
+    };
+
+    SnapshotCell() : SnapshotCell(T{}) {}
+    explicit SnapshotCell(T value) { publish(std::move(value)); }
+
+    SnapshotCell(const SnapshotCell&) = delete;
+    SnapshotCell& operator=(const SnapshotCell&) = delete;
+
+    Reader read() const { return Reader(current_); }
+
+    // the current value, for the publishers only
+    const T& current() const { return current_.load(std::memory_order_relaxed)->value; }
+
+    void publish(T value) {
+        Slot* old = current_.load(std::memory_order_relaxed);
+        Slot* next = nullptr;
+        for (const auto& slot : slots_) {
+            if (slot.get() != old && slot->readers.load(std::memory_order_seq_cst) == 0) {
+                // no reader in it and none gets in anymore: drops what it still holds
+                slot->value = T{};
+                if (!next) {
+                    next = slot.get();
+                }
+            }
+        }
+        if (!next) {
+            slots_.push_back(std::make_unique<Slot>());
+            next = slots_.back().get();
+        }
+        next->value = std::move(value);
+        current_.store(next, std::memory_order_seq_cst);
+    }
+
+  private:
+    std::atomic<Slot*> current_{nullptr};
+    // every slot made, the current one and those to recycle, under the publishers' lock
+    std::vector<std::unique_ptr<Slot>> slots_;
+};
+}  // namespace lynx
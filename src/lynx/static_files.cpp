@@ -0,0 +1,646 @@
+#include "static_files.hpp"
+
+#include <fcntl.h>
+#include <sys/inotify.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <charconv>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <filesystem>
+#include <optional>
+#include <stdexcept>
+#include <utility>
+
+#include "cinatra.hpp"
+#include "compression.hpp"
+#include "spdlog/spdlog.h"
+
+namespace lynx {
+namespace {
+constexpr uint32_t kWatchMask = IN_CLOSE_WRITE | IN_MODIFY | IN_ATTRIB | IN_CREATE | IN_DELETE | IN_MOVED_FROM |
+                                IN_MOVED_TO | IN_DELETE_SELF | IN_MOVE_SELF | IN_ONLYDIR;
+
+class Fd {
+  public:
+    explicit Fd(int fd) : fd_(fd) {}
+    ~Fd() {
+        if (fd_ >= 0) {
+            ::close(fd_);
+        }
+    }
+    Fd(const Fd&) = delete;
+    Fd& operator=(const Fd&) = delete;
+    int get() const { return fd_; }
+    int release() { return std::exchange(fd_, -1); }
+
+  private:
+    int fd_;
+};
+
+// a read only mapping of a whole file, for a large file sent over TLS where sendfile() cannot be used
+class Mapping {
+  public:
+    Mapping(int fd, size_t size)
+        : data_(size > 0 ? ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED), size_(size) {}
+    ~Mapping() {
+        if (data_ != MAP_FAILED) {
+            ::munmap(data_, size_);
+        }
+    }
+    Mapping(const Mapping&) = delete;
+    Mapping& operator=(const Mapping&) = delete;
+    bool ok() const { return data_ != MAP_FAILED; }
+    const char* data() const { return static_cast<const char*>(data_); }
+
+  private:
+    void* data_;
+    size_t size_;
+};
+
+// nginx style: mtime and size in hex
+std::string make_etag(const struct stat& st) {
+    char buf[64];
+    int n = std::snprintf(buf, sizeof(buf), "\"%llx%09lx-%llx\"", static_cast<unsigned long long>(st.st_mtim.tv_sec),
+                          static_cast<unsigned long>(st.st_mtim.tv_nsec), static_cast<unsigned long long>(st.st_size));
+    return std::string(buf, static_cast<size_t>(n));
+}
+
+bool read_all(int fd, char* data, size_t size) {
+    size_t done = 0;
+    while (done < size) {
+        ssize_t n = ::pread(fd, data + done, size - done, static_cast<off_t>(done));
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        done += static_cast<size_t>(n);
+    }
+    return true;
+}
+
+bool etag_matches(std::string_view if_none_match, std::string_view etag) {
+    return if_none_match == "*" || if_none_match.find(etag) != std::string_view::npos;
+}
+
+struct ByteRange {
+    size_t first;
+    size_t last;  // inclusive
+};
+
+// "bytes=first-last", "bytes=first-" or "bytes=-suffix". Several ranges or a
+// malformed header: std::nullopt, the whole file is sent. unsatisfiable is set
+// when the range lies past the end of the file.
+std::optional<ByteRange> parse_range(std::string_view header, size_t size, bool& unsatisfiable) {
+    unsatisfiable = false;
+    constexpr std::string_view unit = "bytes=";
+    if (header.substr(0, unit.size()) != unit || header.find(',') != std::string_view::npos) {
+        return std::nullopt;
+    }
+    std::string_view spec = header.substr(unit.size());
+    size_t dash = spec.find('-');
+    if (dash == std::string_view::npos) {
+        return std::nullopt;
+    }
+    auto number = [](std::string_view s, size_t& v) {
+        auto [p, ec] = std::from_chars(s.data(), s.data() + s.size(), v);
+        return !s.empty() && ec == std::errc() && p == s.data() + s.size();
+    };
+    std::string_view first_str = spec.substr(0, dash);
+    std::string_view last_str = spec.substr(dash + 1);
+    size_t first = 0;
+    size_t last = 0;
+    if (first_str.empty()) {
+        if (!number(last_str, last) || last == 0) {
+            return std::nullopt;
+        }
+        if (size == 0) {
+            unsatisfiable = true;
+            return std::nullopt;
+        }
+        return ByteRange{size - std::min(last, size), size - 1};
+    }
+    if (!number(first_str, first) || (!last_str.empty() && (!number(last_str, last) || last < first))) {
+        return std::nullopt;
+    }
+    if (first >= size) {
+        unsatisfiable = true;
+        return std::nullopt;
+    }
+    last = last_str.empty() ? size - 1 : std::min(last, size - 1);
+    return ByteRange{first, last};
+}
+
+StaticOptions normalized(StaticOptions options) {
+    std::error_code ec;
+    if (options.root.empty() || !std::filesystem::is_directory(options.root, ec)) {
+        throw std::invalid_argument("static root is not a directory: " + options.root);
+    }
+    options.root = std::filesystem::canonical(options.root).string();
+    if (options.prefix.empty() || options.prefix.front() != '/') {
+        options.prefix.insert(options.prefix.begin(), '/');
+    }
+    while (!options.prefix.empty() && options.prefix.back() == '/') {
+        options.prefix.pop_back();
+    }
+    return options;
+}
+}  // namespace
+
+std::shared_ptr<const StaticFile> StaticFile::load(const std::string& path, const StaticOptions& options) {
+    Fd fd(::open(path.c_str(), O_RDONLY | O_CLOEXEC));
+    if (fd.get() < 0) {
+        return nullptr;
+    }
+    struct stat st;
+    if (::fstat(fd.get(), &st) != 0) {
+        return nullptr;
+    }
+    if (!S_ISREG(st.st_mode)) {
+        errno = S_ISDIR(st.st_mode) ? EISDIR : EINVAL;
+        return nullptr;
+    }
+
+    std::shared_ptr<StaticFile> file(new StaticFile);
+    file->path_ = path;
+    file->size_ = static_cast<size_t>(st.st_size);
+    file->dev_ = st.st_dev;
+    file->ino_ = st.st_ino;
+    file->mtime_ = st.st_mtim;
+    file->etag_ = make_etag(st);
+    file->mime_ = cinatra::get_mime_type(cinatra::get_extension(path));
+
+    if (file->size_ >= options.sendfile_min) {
+        file->storage_ = Storage::sendfile;
+    } else if (file->size_ >= options.mmap_min && file->size_ > 0) {
+        void* map = ::mmap(nullptr, file->size_, PROT_READ, MAP_PRIVATE, fd.get(), 0);
+        if (map != MAP_FAILED) {
+            ::madvise(map, file->size_, MADV_WILLNEED);
+            file->storage_ = Storage::mapped;
+            file->map_ = map;
+            file->data_ = static_cast<const char*>(map);
+            file->fd_ = fd.release();
+        }
+    }
+    if (file->storage_ == Storage::heap) {
+        file->heap_.resize(file->size_);
+        if (!read_all(fd.get(), file->heap_.data(), file->size_)) {
+            errno = EIO;
+            return nullptr;
+        }
+        file->data_ = file->heap_.data();
+    }
+
+    char date[32];
+    std::string_view last_modified = cinatra::get_gmt_time_str(date, st.st_mtim.tv_sec);
+    file->head_.reserve(192);
+    file->head_.append("HTTP/1.1 200 OK\r\nContent-Type: ")
+        .append(file->mime_)
+        .append("\r\nContent-Length: ")
+        .append(std::to_string(file->size_))
+        .append("\r\nETag: ")
+        .append(file->etag_)
+        .append("\r\nLast-Modified: ")
+        .append(last_modified)
+        .append("\r\nAccept-Ranges: bytes\r\n");
+    if (Compressor::compressible(file->mime_)) {
+        // the same url may be sent compressed
+        file->head_.append("Vary: Accept-Encoding\r\n");
+    }
+    if (file->storage_ != Storage::sendfile) {
+        file->hash_ = Compressor::content_hash(file->head_, std::string_view(file->data_, file->size_));
+    }
+    return file;
+}
+
+StaticFile::~StaticFile() {
+    if (map_ != nullptr) {
+        ::munmap(map_, size_);
+    }
+    if (fd_ >= 0) {
+        ::close(fd_);
+    }
+}
+
+bool StaticFile::current(const struct stat& st) const {
+    return st.st_dev == dev_ && st.st_ino == ino_ && static_cast<size_t>(st.st_size) == size_ &&
+           st.st_mtim.tv_sec == mtime_.tv_sec && st.st_mtim.tv_nsec == mtime_.tv_nsec;
+}
+
+bool StaticFile::intact() const {
+    if (storage_ != Storage::mapped) {
+        return true;
+    }
+    if (dropped_.load(std::memory_order_acquire)) {
+        return false;
+    }
+    struct stat st;
+    if (::fstat(fd_, &st) == 0 && static_cast<size_t>(st.st_size) >= size_) {
+        return true;
+    }
+    // anonymous pages over the same range: the writes still holding the file read zeros
+    if (!dropped_.exchange(true, std::memory_order_acq_rel)) {
+        ::mmap(map_, size_, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED, -1, 0);
+    }
+    return false;
+}
+
+std::shared_ptr<const StaticFile> StaticFileCache::get(std::string_view key) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = index_.find(key);
+    if (it == index_.end()) {
+        ++stats_.misses;
+        return nullptr;
+    }
+    ++stats_.hits;
+    lru_.splice(lru_.begin(), lru_, it->second);
+    return it->second->file;
+}
+
+void StaticFileCache::put(const std::string& key, std::shared_ptr<const StaticFile> file) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (auto it = index_.find(key); it != index_.end()) {
+        erase_(it->second);
+    }
+    if (file->cost() > budget_) {
+        return;
+    }
+    stats_.bytes += file->cost();
+    lru_.push_front(Entry{key, std::move(file)});
+    index_.emplace(key, lru_.begin());
+    while (stats_.bytes > budget_) {
+        erase_(std::prev(lru_.end()));
+        ++stats_.evictions;
+    }
+}
+
+std::shared_ptr<const StaticFile> StaticFileCache::invalidate(std::string_view key) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = index_.find(key);
+    if (it == index_.end()) {
+        return nullptr;
+    }
+    auto file = std::move(it->second->file);
+    erase_(it->second);
+    ++stats_.invalidations;
+    return file;
+}
+
+void StaticFileCache::invalidate_prefix(std::string_view prefix) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto it = lru_.begin(); it != lru_.end();) {
+        auto next = std::next(it);
+        if (std::string_view(it->key).substr(0, prefix.size()) == prefix) {
+            erase_(it);
+            ++stats_.invalidations;
+        }
+        it = next;
+    }
+}
+
+void StaticFileCache::clear() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stats_.invalidations += lru_.size();
+    index_.clear();
+    lru_.clear();
+    stats_.bytes = 0;
+}
+
+StaticFileCache::Stats StaticFileCache::stats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Stats s = stats_;
+    s.entries = lru_.size();
+    return s;
+}
+
+void StaticFileCache::erase_(Lru::iterator it) {
+    stats_.bytes -= it->file->cost();
+    index_.erase(it->key);
+    lru_.erase(it);
+}
+
+StaticFiles::StaticFiles(asio::io_context& control, StaticOptions options)
+    : options_(normalized(std::move(options))), cache_(options_.cache_size), inotify_(control) {
+    if (!options_.watch) {
+        return;
+    }
+    int fd = ::inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (fd < 0) {
+        spdlog::warn("inotify unavailable, static files are checked with stat()", {{"error", std::strerror(errno)}});
+        return;
+    }
+    inotify_.assign(fd);
+    watching_ = true;
+    watch_tree_("");
+    read_events_();
+}
+
+StaticFiles::~StaticFiles() { stop(); }
+
+void StaticFiles::stop() {
+    watching_ = false;
+    asio::error_code ec;
+    inotify_.close(ec);
+    watches_.clear();
+}
+
+void StaticFiles::watch_tree_(const std::string& dir) {
+    std::error_code ec;
+    std::filesystem::path base = std::filesystem::path(options_.root) / dir;
+    auto add = [this](const std::filesystem::path& path, std::string relative) {
+        int wd = ::inotify_add_watch(inotify_.native_handle(), path.c_str(), kWatchMask);
+        if (wd < 0) {
+            // ENOSPC: fs.inotify.max_user_watches is too low for the tree
+            spdlog::warn("inotify watch failed, static files are checked with stat()",
+                         {{"path", path.string()}, {"error", std::strerror(errno)}});
+            watching_ = false;
+            return false;
+        }
+        watches_[wd] = std::move(relative);
+        return true;
+    };
+    if (!add(base, dir)) {
+        return;
+    }
+    for (auto it = std::filesystem::recursive_directory_iterator(base, ec);
+         !ec && it != std::filesystem::recursive_directory_iterator(); it.increment(ec)) {
+        if (it->is_directory(ec) && !it->is_symlink(ec)) {
+            if (!add(it->path(), dir + std::filesystem::relative(it->path(), base).string() + "/")) {
+                return;
+            }
+        }
+    }
+}
+
+void StaticFiles::read_events_() {
+    inotify_.async_read_some(asio::buffer(events_), [this](const asio::error_code& ec, size_t n) {
+        if (ec) {
+            if (ec != asio::error::operation_aborted) {
+                spdlog::warn("inotify read failed, static files are checked with stat()", {{"error", ec.message()}});
+                watching_ = false;
+            }
+            return;
+        }
+        for (size_t off = 0; off + sizeof(inotify_event) <= n;) {
+            const auto* ev = reinterpret_cast<const inotify_event*>(events_.data() + off);
+            on_event_(*ev);
+            off += sizeof(inotify_event) + ev->len;
+        }
+        read_events_();
+    });
+}
+
+void StaticFiles::on_event_(const struct inotify_event& ev) {
+    if (ev.mask & IN_Q_OVERFLOW) {
+        // events were lost, nothing cached can be trusted
+        cache_.clear();
+        return;
+    }
+    auto it = watches_.find(ev.wd);
+    if (it == watches_.end()) {
+        return;
+    }
+    if (ev.mask & IN_IGNORED) {
+        watches_.erase(it);
+        return;
+    }
+    const std::string& dir = it->second;
+    if (ev.mask & (IN_DELETE_SELF | IN_MOVE_SELF)) {
+        cache_.invalidate_prefix(dir);
+        if (ev.mask & IN_MOVE_SELF) {
+            // still watched under its new name, which this watch does not know
+            ::inotify_rm_watch(inotify_.native_handle(), ev.wd);
+        }
+        return;
+    }
+    std::string name = dir + (ev.len > 0 ? ev.name : "");
+    if (ev.mask & IN_ISDIR) {
+        cache_.invalidate_prefix(name + "/");
+        if (ev.mask & (IN_CREATE | IN_MOVED_TO)) {
+            watch_tree_(name + "/");
+        }
+        return;
+    }
+    if (auto file = cache_.invalidate(name)) {
+        // responses may still be writing it: truncated in place, its mapping goes now
+        file->intact();
+    }
+}
+
+std::string StaticFiles::resolve_(std::string_view url) const {
+    std::string_view path = url;
+    if (path.substr(0, options_.prefix.size()) != options_.prefix) {
+        return {};
+    }
+    path.remove_prefix(options_.prefix.size());
+    if (!path.empty() && path.front() != '/') {
+        return {};
+    }
+    std::string decoded;
+    if (path.find('%') != std::string_view::npos) {
+        decoded = code_utils::url_decode(path);
+        path = decoded;
+    }
+
+    // never leaves root: ".." and NUL are refused, "." and empty segments dropped
+    std::string key;
+    key.reserve(path.size() + 10);
+    size_t i = 0;
+    while (i < path.size()) {
+        size_t end = std::min(path.find('/', i), path.size());
+        std::string_view segment = path.substr(i, end - i);
+        if (segment == ".." || segment.find('\0') != std::string_view::npos) {
+            return {};
+        }
+        if (!segment.empty() && segment != ".") {
+            key.append(segment);
+            if (end < path.size()) {
+                key.push_back('/');
+            }
+        }
+        i = end + 1;
+    }
+    if (key.empty() || key.back() == '/') {
+        key.append("index.html");
+    }
+    return key;
+}
+
+std::shared_ptr<const StaticFile> StaticFiles::find_(const std::string& key) {
+    auto file = cache_.get(key);
+    if (file && !watching_) {
+        struct stat st;
+        if (::stat(file->path().c_str(), &st) != 0 || !file->current(st)) {
+            cache_.invalidate(key);
+            file = nullptr;
+        }
+    }
+    if (!file) {
+        file = StaticFile::load(options_.root + "/" + key, options_);
+        if (file) {
+            cache_.put(key, file);
+        }
+    }
+    return file;
+}
+
+async_simple::coro::Lazy<void> StaticFiles::serve(cinatra::coro_http_request& req, cinatra::coro_http_response& res) {
+    std::string key = resolve_(req.get_url());
+    if (key.empty()) {
+        res.set_status(cinatra::status_type::not_found);
+        co_return;
+    }
+    std::string_view method = req.get_method();
+    bool head_only = method == "HEAD";
+    if (!head_only && method != "GET") {
+        res.set_status(cinatra::status_type::method_not_allowed);
+        co_return;
+    }
+
+    auto file = find_(key);
+    if (file && !file->intact()) {
+        cache_.invalidate(key);
+        file = find_(key);
+    }
+    // a large file is opened for sendfile(): make sure it is still the one the head describes
+    std::optional<Fd> fd;
+    if (file && file->storage() == StaticFile::Storage::sendfile && !head_only) {
+        fd.emplace(::open(file->path().c_str(), O_RDONLY | O_CLOEXEC));
+        struct stat st;
+        if (fd->get() >= 0 && ::fstat(fd->get(), &st) == 0 && !file->current(st)) {
+            cache_.invalidate(key);
+            file = find_(key);
+            fd.reset();
+            if (file && file->storage() == StaticFile::Storage::sendfile) {
+                fd.emplace(::open(file->path().c_str(), O_RDONLY | O_CLOEXEC));
+            }
+        }
+        if (fd && fd->get() < 0) {
+            file = nullptr;
+        }
+    }
+    if (!file) {
+        res.set_status(cinatra::status_type::not_found);
+        co_return;
+    }
+
+    auto* conn = req.get_conn();
+    res.set_delay(true);
+    std::string_view connection = cinatra::iequal0(req.get_header_value("Connection"), "close")
+                                      ? "Connection: close\r\n\r\n"
+                                      : "\r\n";
+    char gmt[32];
+    std::string_view now = cinatra::get_gmt_time_str(gmt, std::time(nullptr));
+    char date_buf[64];
+    int date_len = std::snprintf(date_buf, sizeof(date_buf), "Date: %.*s\r\n", static_cast<int>(now.size()), now.data());
+    std::string_view date(date_buf, static_cast<size_t>(date_len));
+
+    if (auto inm = req.get_header_value("If-None-Match"); !inm.empty() && etag_matches(inm, file->etag())) {
+        std::string head = "HTTP/1.1 304 Not Modified\r\nETag: ";
+        head.append(file->etag()).append("\r\n");
+        std::array<asio::const_buffer, 3> buffers{asio::buffer(head), asio::buffer(date), asio::buffer(connection)};
+        if (auto [ec, _] = co_await conn->async_write(buffers); ec) {
+            conn->close();
+        }
+        co_return;
+    }
+
+    // the cached head, or one built for a byte range
+    std::string_view head = file->head();
+    std::string partial;
+    size_t offset = 0;
+    size_t length = file->size();
+    auto range_header = req.get_header_value("Range");
+    if (compressor_ && range_header.empty() && file->storage() != StaticFile::Storage::sendfile &&
+        compressor_->eligible(file->mime(), file->size())) {
+        // a cached variant, or compressed now, or queued for the next requests
+        auto encoding = compressor_->negotiate(req.get_accept_encoding());
+        auto body = file->body();
+        if (auto variant = encoding == Encoding::identity
+                               ? nullptr
+                               : compressor_->cached(file, file->head(), std::string_view(body.data(), body.size()),
+                                                     file->content_hash(), encoding)) {
+            std::array<asio::const_buffer, 4> buffers{asio::buffer(variant->head), asio::buffer(date),
+                                                      asio::buffer(connection),
+                                                      asio::buffer(variant->body.data(), head_only ? 0 : variant->body.size())};
+            if (auto [ec, _] = co_await conn->async_write(buffers); ec) {
+                conn->close();
+            }
+            co_return;
+        }
+    }
+    if (!range_header.empty()) {
+        bool unsatisfiable = false;
+        auto range = parse_range(range_header, file->size(), unsatisfiable);
+        if (unsatisfiable) {
+            partial = "HTTP/1.1 416 Range Not Satisfiable\r\nContent-Length: 0\r\nContent-Range: bytes */";
+            partial.append(std::to_string(file->size())).append("\r\n");
+            std::array<asio::const_buffer, 3> buffers{asio::buffer(partial), asio::buffer(date),
+                                                      asio::buffer(connection)};
+            if (auto [ec, _] = co_await conn->async_write(buffers); ec) {
+                conn->close();
+            }
+            co_return;
+        }
+        if (range) {
+            offset = range->first;
+            length = range->last - range->first + 1;
+            partial.append("HTTP/1.1 206 Partial Content\r\nContent-Type: ")
+                .append(file->mime())
+                .append("\r\nContent-Length: ")
+                .append(std::to_string(length))
+                .append("\r\nContent-Range: bytes ")
+                .append(std::to_string(range->first))
+                .append("-")
+                .append(std::to_string(range->last))
+                .append("/")
+                .append(std::to_string(file->size()))
+                .append("\r\nETag: ")
+                .append(file->etag())
+                .append("\r\nAccept-Ranges: bytes\r\n");
+            head = partial;
+        }
+    }
+
+    std::span<const char> body = file->body();
+    if (head_only) {
+        length = 0;
+    } else if (!body.empty()) {
+        body = body.subspan(offset, length);
+    }
+    std::array<asio::const_buffer, 4> buffers{asio::buffer(head.data(), head.size()), asio::buffer(date),
+                                              asio::buffer(connection),
+                                              asio::buffer(body.data(), head_only ? 0 : body.size())};
+    auto [ec, _] = co_await conn->async_write(buffers);
+    if (ec) {
+        conn->close();
+        co_return;
+    }
+    if (file->storage() != StaticFile::Storage::sendfile || length == 0) {
+        co_return;
+    }
+
+    std::error_code body_ec;
+    if (!conn->is_ssl()) {
+        // the kernel moves the bytes from the page cache to the socket
+        auto [send_ec, sent] = co_await conn->async_sendfile(fd->get(), static_cast<off_t>(offset), length);
+        body_ec = send_ec;
+    } else {
+        Mapping map(fd->get(), file->size());
+        if (!map.ok()) {
+            conn->close();
+            co_return;
+        }
+        auto [write_ec, written] = co_await conn->async_write(asio::buffer(map.data() + offset, length));
+        body_ec = write_ec;
+    }
+    if (body_ec) {
+        conn->close();
+    }
+}
+}  // namespace lynx
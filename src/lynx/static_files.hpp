@@ -0,0 +1,181 @@
+#pragma once
+
+#include <sys/inotify.h>
+#include <sys/stat.h>
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+#include "asio.hpp"
+#include "async_simple/coro/Lazy.h"
+#include "compression.hpp"
+#include "options.hpp"
+
+namespace cinatra {
+class coro_http_request;
+class coro_http_response;
+}  // namespace cinatra
+
+namespace lynx {
+// A file as served: immutable once loaded, shared by the cache and the
+// responses still writing it, so eviction never pulls memory from under a
+// write. The response head (Content-Type, Content-Length, ETag,
+// Last-Modified) is built once per load, not per request.
+class StaticFile {
+  public:
+    enum class Storage {
+        heap,      // small file, copied into memory
+        mapped,    // medium file, mmap()ed
+        sendfile,  // large file, only the head is kept, the body goes from the page cache to the socket
+    };
+
+    // nullptr with errno set if path is not a regular file that can be read
+    static std::shared_ptr<const StaticFile> load(const std::string& path, const StaticOptions& options);
+    ~StaticFile();
+
+    StaticFile(const StaticFile&) = delete;
+    StaticFile& operator=(const StaticFile&) = delete;
+
+    const std::string& path() const { return path_; }
+    Storage storage() const { return storage_; }
+    size_t size() const { return size_; }
+    std::string_view etag() const { return etag_; }
+    std::string_view mime() const { return mime_; }
+    // "HTTP/1.1 200 OK\r\n" and the headers of the whole file, without the closing blank line
+    std::string_view head() const { return head_; }
+    // empty for Storage::sendfile
+    std::span<const char> body() const { return {data_, storage_ == Storage::sendfile ? 0 : size_}; }
+    // Compressor::content_hash() of head and body, empty for Storage::sendfile
+    const ContentHash& content_hash() const { return hash_; }
+    // bytes charged against StaticOptions::cache_size
+    size_t cost() const { return head_.size() + body().size(); }
+    // same file on disk as when it was loaded
+    bool current(const struct stat& st) const;
+    // Storage::mapped: false once the file got shorter than its mapping, whose
+    // pages are then swapped for zeros, as reading past the end of the file
+    // would raise SIGBUS. Checked before serving and on inotify events; a
+    // truncation racing a write only sends zeros.
+    bool intact() const;
+
+  private:
+    StaticFile() = default;
+
+    std::string path_;
+    Storage storage_{Storage::heap};
+    size_t size_{0};
+    dev_t dev_{0};
+    ino_t ino_{0};
+    struct timespec mtime_ {};
+    std::string etag_;
+    std::string_view mime_;
+    std::string head_;
+    ContentHash hash_;
+    std::string heap_;
+    const char* data_{nullptr};
+    void* map_{nullptr};
+    int fd_{-1};  // Storage::mapped: kept open to see the file shrink under the mapping
+    mutable std::atomic<bool> dropped_{false};
+};
+
+// LRU of StaticFile keyed by path relative to the root, bounded by the bytes
+// the entries hold rather than their count. Shared by the io threads.
+class StaticFileCache {
+  public:
+    struct Stats {
+        uint64_t hits{0};
+        uint64_t misses{0};
+        uint64_t evictions{0};
+        uint64_t invalidations{0};
+        size_t entries{0};
+        size_t bytes{0};
+    };
+
+    explicit StaticFileCache(size_t budget) : budget_(budget) {}
+
+    std::shared_ptr<const StaticFile> get(std::string_view key);
+    // evicts the least recently used files to make room, a file over the whole budget is not kept
+    void put(const std::string& key, std::shared_ptr<const StaticFile> file);
+    // the file dropped, if it was cached
+    std::shared_ptr<const StaticFile> invalidate(std::string_view key);
+    // every key under a directory, prefix ends with '/'
+    void invalidate_prefix(std::string_view prefix);
+    void clear();
+
+    size_t budget() const { return budget_; }
+    Stats stats() const;
+
+  private:
+    struct Entry {
+        std::string key;
+        std::shared_ptr<const StaticFile> file;
+    };
+    struct KeyHash {
+        using is_transparent = void;
+        size_t operator()(std::string_view key) const { return std::hash<std::string_view>{}(key); }
+    };
+    using Lru = std::list<Entry>;
+
+    void erase_(Lru::iterator it);
+
+    const size_t budget_;
+    mutable std::mutex mutex_;
+    Lru lru_;  // most recently used first
+    std::unordered_map<std::string, Lru::iterator, KeyHash, std::equal_to<>> index_;
+    Stats stats_;
+};
+
+// Serves StaticOptions::root under StaticOptions::prefix on the REST servers
+// (GET and HEAD, ETag / If-None-Match, single byte ranges). Files are cached
+// by StaticFileCache; an inotify watch running on the control io_context
+// drops the entries of files changed on disk.
+class StaticFiles {
+  public:
+    // throws std::invalid_argument if root is not a directory
+    StaticFiles(asio::io_context& control, StaticOptions options);
+    ~StaticFiles();
+
+    StaticFiles(const StaticFiles&) = delete;
+    StaticFiles& operator=(const StaticFiles&) = delete;
+
+    const StaticOptions& options() const { return options_; }
+    StaticFileCache& cache() { return cache_; }
+    // Sends the gzip or br variant of the files that compress to the clients
+    // accepting it, never for a range or a file sent with sendfile().
+    // compressor must outlive this.
+    void compress_with(Compressor& compressor) { compressor_ = &compressor; }
+    // false when inotify is unavailable: every cache hit is checked with stat()
+    bool watching() const { return watching_; }
+
+    // Answers the request if its path is under the prefix, 404 otherwise.
+    // Runs on the io thread of the connection.
+    async_simple::coro::Lazy<void> serve(cinatra::coro_http_request& req, cinatra::coro_http_response& res);
+    // stops watching, the cache stays usable
+    void stop();
+
+  private:
+    // path relative to root, "" if the url is outside of the prefix or escapes root
+    std::string resolve_(std::string_view url) const;
+    std::shared_ptr<const StaticFile> find_(const std::string& key);
+
+    void watch_tree_(const std::string& dir);
+    void read_events_();
+    void on_event_(const struct inotify_event& ev);
+
+    const StaticOptions options_;
+    StaticFileCache cache_;
+    asio::posix::stream_descriptor inotify_;
+    std::unordered_map<int, std::string> watches_;  // watch descriptor => directory relative to root, "" or "dir/"
+    alignas(inotify_event) std::array<char, 16384> events_;
+    std::atomic<bool> watching_{false};
+    Compressor* compressor_{nullptr};
+};
+}  // namespace lynx
@@ -0,0 +1,282 @@
+#include "tcp.hpp"
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <stdexcept>
+#include <system_error>
+
+namespace lynx {
+namespace {
+std::system_error errno_error(const char* what) { return std::system_error(errno, std::generic_category(), what); }
+}  // namespace
+
+Framing framing_from_string(const std::string& name) {
+    if (name == "line") {
+        return Framing::line;
+    }
+    if (name == "length") {
+        return Framing::length;
+    }
+    throw std::invalid_argument("unknown framing: " + name);
+}
+
+const char* to_string(Framing framing) { return framing == Framing::line ? "line" : "length"; }
+
+RingBuffer::RingBuffer(size_t capacity) {
+    const auto page = static_cast<size_t>(::sysconf(_SC_PAGESIZE));
+    capacity_ = (std::max<size_t>(capacity, 1) + page - 1) / page * page;
+
+    int fd = ::memfd_create("lynx-ring", MFD_CLOEXEC);
+    if (fd < 0) {
+        throw errno_error("memfd_create");
+    }
+    if (::ftruncate(fd, static_cast<off_t>(capacity_)) != 0) {
+        auto error = errno_error("ftruncate");
+        ::close(fd);
+        throw error;
+    }
+    // reserve both halves first, then map the same pages over each
+    void* base = ::mmap(nullptr, 2 * capacity_, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (base == MAP_FAILED) {
+        auto error = errno_error("mmap");
+        ::close(fd);
+        throw error;
+    }
+    base_ = static_cast<char*>(base);
+    for (char* half : {base_, base_ + capacity_}) {
+        if (::mmap(half, capacity_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED) {
+            auto error = errno_error("mmap");
+            ::munmap(base_, 2 * capacity_);
+            ::close(fd);
+            throw error;
+        }
+    }
+    // the mappings hold the pages
+    ::close(fd);
+}
+
+RingBuffer::~RingBuffer() { ::munmap(base_, 2 * capacity_); }
+
+FrameDecoder::FrameDecoder(const TcpOptions& options)
+    : framing_(options.framing),
+      max_frame_(options.max_frame),
+      // a partial frame and its length always leave room to read into
+      ring_(std::max(options.buffer_size, 2 * (options.max_frame + 4))) {}
+
+void append_frame(std::string& out, Framing framing, std::string_view payload) {
+    if (framing == Framing::line) {
+        out.append(payload);
+        out.push_back('\n');
+        return;
+    }
+    const auto len = static_cast<uint32_t>(payload.size());
+    const char header[4] = {static_cast<char>(len >> 24), static_cast<char>(len >> 16), static_cast<char>(len >> 8),
+                            static_cast<char>(len)};
+    out.append(header, sizeof(header));
+    out.append(payload);
+}
+
+TcpConnection::TcpConnection(TcpFrameServer& server, asio::ip::tcp::socket socket)
+    : server_(&server), socket_(std::move(socket)), decoder_(server.options()) {
+    asio::error_code ec;
+    remote_ = socket_.remote_endpoint(ec);
+}
+
+void TcpConnection::send(std::string_view bytes) {
+    if (closed_) {
+        return;
+    }
+    out_.append(bytes);
+    if (out_.size() + writing_.size() > server_->options_.max_output) {
+        ++server_->stats_.overflowed;
+        close_();
+    }
+}
+
+void TcpConnection::send_frame(std::string_view payload) {
+    if (closed_) {
+        return;
+    }
+    append_frame(out_, server_->options_.framing, payload);
+    if (out_.size() + writing_.size() > server_->options_.max_output) {
+        ++server_->stats_.overflowed;
+        close_();
+    }
+}
+
+void TcpConnection::close() {
+    closing_ = true;
+    if (writing_.empty() && out_.empty()) {
+        close_();
+    }
+}
+
+void TcpConnection::read_() {
+    std::span<char> buffer = decoder_.buffer();
+    socket_.async_read_some(asio::buffer(buffer.data(), buffer.size()),
+                            [self = shared_from_this()](const asio::error_code& ec, size_t n) {
+                                if (self->closed_) {
+                                    return;
+                                }
+                                if (ec) {
+                                    self->close_();
+                                    return;
+                                }
+                                TcpFrameServer& server = *self->server_;
+                                if (self->idle_ != 0) {
+                                    server.timers_->reschedule(self->idle_, server.options_.idle_timeout);
+                                }
+                                ++server.stats_.reads;
+                                server.stats_.bytes_in += n;
+                                bool ok = self->decoder_.commit(n, [&](std::string_view frame) {
+                                    if (self->closing_) {
+                                        return;
+                                    }
+                                    ++server.stats_.frames;
+                                    server.handler_(*self, frame);
+                                });
+                                if (self->closed_) {
+                                    return;
+                                }
+                                if (!ok) {
+                                    ++server.stats_.oversized;
+                                    self->close_();
+                                    return;
+                                }
+                                self->flush_();
+                                if (self->closing_) {
+                                    if (self->writing_.empty()) {
+                                        self->close_();
+                                    }
+                                    return;
+                                }
+                                self->read_();
+                            });
+}
+
+void TcpConnection::flush_() {
+    if (closed_ || !writing_.empty() || out_.empty()) {
+        return;
+    }
+    writing_.swap(out_);
+    asio::async_write(socket_, asio::buffer(writing_),
+                      [self = shared_from_this()](const asio::error_code& ec, size_t n) {
+                          if (self->closed_) {
+                              return;
+                          }
+                          if (ec) {
+                              self->close_();
+                              return;
+                          }
+                          ++self->server_->stats_.writes;
+                          self->server_->stats_.bytes_out += n;
+                          self->writing_.clear();
+                          self->flush_();
+                          if (self->closing_ && self->writing_.empty()) {
+                              self->close_();
+                          }
+                      });
+}
+
+void TcpConnection::close_() {
+    if (closed_) {
+        return;
+    }
+    closed_ = closing_ = true;
+    asio::error_code ec;
+    socket_.shutdown(asio::ip::tcp::socket::shutdown_both, ec);
+    socket_.close(ec);
+    TcpFrameServer& server = *server_;
+    if (idle_ != 0) {
+        server.timers_->cancel(idle_);
+        idle_ = 0;
+    }
+    ++server.stats_.closed;
+    if (server.on_close_) {
+        server.on_close_(*this);
+    }
+    // the pending handlers hold the last references
+    server.connections_.erase(shared_from_this());
+}
+
+TcpFrameServer::TcpFrameServer(asio::io_context& ctx, const TcpOptions& options, TimerWheel* timers)
+    : acceptor_(ctx), backoff_(ctx), options_(options), timers_(timers) {
+    if (options_.idle_timeout.count() > 0 && timers_ == nullptr) {
+        throw std::invalid_argument("an idle_timeout needs a TimerWheel");
+    }
+}
+
+void TcpFrameServer::listen(const endpoint& local) {
+    acceptor_.open(local.protocol());
+    acceptor_.set_option(asio::socket_base::reuse_address(true));
+    int one = 1;
+    if (::setsockopt(acceptor_.native_handle(), SOL_SOCKET, SO_REUSEPORT, &one, sizeof(one)) != 0) {
+        throw errno_error("setsockopt SO_REUSEPORT");
+    }
+    acceptor_.bind(local);
+    acceptor_.listen();
+}
+
+void TcpFrameServer::start(Handler handler, ConnectionHandler on_close) {
+    handler_ = std::move(handler);
+    on_close_ = std::move(on_close);
+    running_ = true;
+    accept_();
+}
+
+void TcpFrameServer::stop() {
+    running_ = false;
+    asio::error_code ec;
+    acceptor_.close(ec);
+    backoff_.cancel();
+    // close_() erases from the set
+    while (!connections_.empty()) {
+        auto conn = *connections_.begin();
+        conn->close_();
+    }
+}
+
+void TcpFrameServer::accept_() {
+    acceptor_.async_accept([this](const asio::error_code& ec, asio::ip::tcp::socket socket) {
+        if (!running_ || ec == asio::error::operation_aborted) {
+            return;
+        }
+        if (ec) {
+            // EMFILE and the like: retrying right away would spin
+            backoff_.expires_after(std::chrono::milliseconds(100));
+            backoff_.async_wait([this](const asio::error_code& timer_ec) {
+                if (!timer_ec && running_) {
+                    accept_();
+                }
+            });
+            return;
+        }
+        asio::error_code ignored;
+        socket.set_option(asio::ip::tcp::no_delay(options_.no_delay), ignored);
+        std::shared_ptr<TcpConnection> conn;
+        try {
+            conn = std::make_shared<TcpConnection>(*this, std::move(socket));
+        } catch (const std::system_error&) {
+            // no ring for it: out of memory or of mappings (vm.max_map_count)
+            accept_();
+            return;
+        }
+        ++stats_.accepted;
+        connections_.insert(conn);
+        if (options_.idle_timeout.count() > 0) {
+            // the connection outlives its timer: close_() cancels it
+            conn->idle_ = timers_->schedule(options_.idle_timeout, [this, c = conn.get()] {
+                c->idle_ = 0;
+                ++stats_.idled;
+                c->close_();
+            });
+        }
+        conn->read_();
+        accept_();
+    });
+}
+}  // namespace lynx
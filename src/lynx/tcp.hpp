@@ -0,0 +1,240 @@
+#pragma once
+
+#include <any>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_set>
+
+#include "asio.hpp"
+#include "timer_wheel.hpp"
+
+namespace lynx {
+// How a byte stream is cut into frames.
+enum class Framing {
+    line,    // a frame ends with '\n', a '\r' before it is dropped too
+    length,  // a frame follows its length, 4 bytes big endian
+};
+
+// "line" or "length", throws std::invalid_argument otherwise.
+Framing framing_from_string(const std::string& name);
+const char* to_string(Framing framing);
+
+struct TcpOptions {
+    Framing framing{Framing::line};
+    size_t max_frame{64 << 10};                 // a longer frame closes the connection, its stream is lost
+    size_t buffer_size{64 << 10};               // receive ring per connection, at least twice max_frame, in pages
+    size_t max_output{4 << 20};                 // bytes waiting to be written per connection, more closes it
+    bool no_delay{true};                        // TCP_NODELAY: the replies of a batch go out in one write anyway
+    std::chrono::milliseconds idle_timeout{0};  // nothing read for that long closes the connection, 0: never
+};
+
+struct TcpStats {
+    uint64_t accepted{0};
+    uint64_t closed{0};
+    uint64_t frames{0};  // handed to the handler
+    uint64_t reads{0};   // read completions, each delivering all the frames it completed
+    uint64_t writes{0};  // write completions, each carrying all the replies queued meanwhile
+    uint64_t bytes_in{0};
+    uint64_t bytes_out{0};
+    uint64_t oversized{0};   // connections closed over a frame longer than max_frame
+    uint64_t overflowed{0};  // connections closed with more than max_output bytes waiting
+    uint64_t idled{0};       // connections closed after idle_timeout
+};
+
+// Circular byte buffer whose pages are mapped twice, back to back: the bytes
+// past the end are those of the start, so the data, and the free space, are
+// always contiguous. A frame wrapping around the end is still one
+// string_view, read() gets one buffer, nothing is ever moved.
+class RingBuffer {
+  public:
+    // capacity is rounded up to the page size, throws std::system_error
+    explicit RingBuffer(size_t capacity);
+    ~RingBuffer();
+
+    RingBuffer(const RingBuffer&) = delete;
+    RingBuffer& operator=(const RingBuffer&) = delete;
+
+    size_t capacity() const { return capacity_; }
+    size_t size() const { return static_cast<size_t>(tail_ - head_); }
+
+    std::string_view data() const { return {base_ + head_ % capacity_, size()}; }
+    // the free space, to read into, then commit() what was
+    std::span<char> prepare() { return {base_ + tail_ % capacity_, capacity_ - size()}; }
+    void commit(size_t n) { tail_ += n; }
+    void consume(size_t n) { head_ += n; }
+
+  private:
+    char* base_{nullptr};
+    size_t capacity_{0};
+    uint64_t head_{0};  // both count every byte ever, the offsets are modulo capacity_
+    uint64_t tail_{0};
+};
+
+// Cuts the bytes read from a stream into frames: read into buffer(), then
+// commit() calls f(frame) for every frame the read completed, in order, the
+// frame a view of the ring. A partial frame stays in the ring for the next
+// read, and is not scanned again: the delimiter search goes on from where it
+// stopped, with memchr (SIMD in glibc) rather than byte by byte.
+class FrameDecoder {
+  public:
+    explicit FrameDecoder(const TcpOptions& options);
+
+    std::span<char> buffer() { return ring_.prepare(); }
+
+    // false when a frame is longer than max_frame: the stream is lost.
+    // The frames are valid until f returns.
+    template <typename F>
+    bool commit(size_t n, F&& f) {
+        ring_.commit(n);
+        std::string_view data = ring_.data();
+        size_t pos = 0;
+        bool ok = true;
+        if (framing_ == Framing::line) {
+            size_t from = scanned_;
+            while (const void* found = std::memchr(data.data() + from, '\n', data.size() - from)) {
+                size_t end = static_cast<size_t>(static_cast<const char*>(found) - data.data());
+                size_t len = end - pos;
+                if (len > 0 && data[end - 1] == '\r') {
+                    --len;
+                }
+                f(data.substr(pos, len));
+                from = pos = end + 1;
+            }
+            scanned_ = data.size() - pos;
+            ok = scanned_ <= max_frame_;
+        } else {
+            while (data.size() - pos >= 4) {
+                auto* p = reinterpret_cast<const unsigned char*>(data.data() + pos);
+                size_t len = (size_t(p[0]) << 24) | (size_t(p[1]) << 16) | (size_t(p[2]) << 8) | size_t(p[3]);
+                if (len > max_frame_) {
+                    ok = false;
+                    break;
+                }
+                if (data.size() - pos - 4 < len) {
+                    break;
+                }
+                f(data.substr(pos + 4, len));
+                pos += 4 + len;
+            }
+        }
+        ring_.consume(pos);
+        return ok;
+    }
+
+    size_t buffered() const { return ring_.size(); }
+
+  private:
+    const Framing framing_;
+    const size_t max_frame_;
+    RingBuffer ring_;
+    size_t scanned_{0};  // bytes of the partial line searched already
+};
+
+// Appends payload to out framed as framing wants it: followed by '\n', or
+// behind its length.
+void append_frame(std::string& out, Framing framing, std::string_view payload);
+
+class TcpFrameServer;
+
+// A client of a TcpFrameServer, owned by the server until it is closed.
+class TcpConnection : public std::enable_shared_from_this<TcpConnection> {
+  public:
+    using endpoint = asio::ip::tcp::endpoint;
+
+    TcpConnection(TcpFrameServer& server, asio::ip::tcp::socket socket);
+
+    // Queue bytes as they are, or framed. The output is written once the
+    // handler has seen all the frames of the read, in one write.
+    void send(std::string_view bytes);
+    void send_frame(std::string_view payload);
+    // Reads no more, closes once the output is written. The frames left in
+    // the batch are not handed to the handler.
+    void close();
+    bool closing() const { return closing_; }
+
+    const endpoint& remote() const { return remote_; }
+    // the protocol's per connection state, set by its handler
+    std::any& state() { return state_; }
+
+  private:
+    friend class TcpFrameServer;
+
+    void read_();
+    void flush_();
+    void close_();
+
+    TcpFrameServer* server_;
+    asio::ip::tcp::socket socket_;
+    endpoint remote_;
+    FrameDecoder decoder_;
+    std::string out_;      // queued by the handlers
+    std::string writing_;  // being written, swapped with out_: both keep their capacity
+    bool closing_{false};
+    bool closed_{false};
+    TimerWheel::Id idle_{0};
+    std::any state_;
+};
+
+// Framed TCP server on an asio io_context: the base of lynx's own TCP
+// protocols. Each connection reads into its RingBuffer, and every read hands
+// all the frames it completed to the handler as views of the ring, no copy
+// and no allocation; the replies the handler sends are then written together.
+//
+// For more cores run one server per io_context of an IoContextPool, all
+// listening on the same port: SO_REUSEPORT lets the kernel spread the
+// connections. Everything runs on the io_context thread, the server is not
+// thread safe. stop() it and let the context run before destroying it.
+//
+// The idle timeout of every connection is a timer of the TimerWheel of the
+// io_context, pushed back in O(1) by each read.
+class TcpFrameServer {
+  public:
+    using endpoint = asio::ip::tcp::endpoint;
+    // frame views the connection's ring: valid until the handler returns
+    using Handler = std::function<void(TcpConnection& conn, std::string_view frame)>;
+    using ConnectionHandler = std::function<void(TcpConnection& conn)>;
+
+    // timers, on the same io_context, is needed for an idle_timeout:
+    // throws std::invalid_argument otherwise
+    explicit TcpFrameServer(asio::io_context& ctx, const TcpOptions& options = {}, TimerWheel* timers = nullptr);
+
+    TcpFrameServer(const TcpFrameServer&) = delete;
+    TcpFrameServer& operator=(const TcpFrameServer&) = delete;
+
+    // with SO_REUSEPORT, throws std::system_error
+    void listen(const endpoint& local);
+    endpoint local_endpoint() const { return acceptor_.local_endpoint(); }
+
+    // Accepts connections and calls handler for each of their frames until
+    // stop(); on_close, if any, when a connection is gone.
+    void start(Handler handler, ConnectionHandler on_close = {});
+    // closes the listening socket and every connection
+    void stop();
+
+    const TcpOptions& options() const { return options_; }
+    size_t connections() const { return connections_.size(); }
+    const TcpStats& stats() const { return stats_; }
+
+  private:
+    friend class TcpConnection;
+
+    void accept_();
+
+    asio::ip::tcp::acceptor acceptor_;
+    asio::steady_timer backoff_;  // out of file descriptors: accept again later
+    const TcpOptions options_;
+    TimerWheel* timers_;
+    Handler handler_;
+    ConnectionHandler on_close_;
+    bool running_{false};
+    std::unordered_set<std::shared_ptr<TcpConnection>> connections_;
+    TcpStats stats_;
+};
+}  // namespace lynx
@@ -0,0 +1,248 @@
+#include "timer_wheel.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <stdexcept>
+#include <utility>
+
+namespace lynx {
+namespace {
+size_t slot_bits(const TimerWheelOptions& options) {
+    if (options.resolution.count() <= 0) {
+        throw std::invalid_argument("timer wheel resolution must be positive");
+    }
+    if (options.slots < 2 || !std::has_single_bit(options.slots)) {
+        throw std::invalid_argument("timer wheel slots must be a power of two");
+    }
+    const auto bits = static_cast<size_t>(std::countr_zero(options.slots));
+    if (options.levels == 0 || bits * options.levels > 63) {
+        throw std::invalid_argument("timer wheel levels must span 1 to 63 bits of ticks");
+    }
+    return bits;
+}
+}  // namespace
+
+TimerWheel::TimerWheel(asio::io_context& ctx, const TimerWheelOptions& options)
+    : tick_(ctx),
+      resolution_(options.resolution),
+      origin_(clock::now()),
+      bits_(slot_bits(options)),
+      levels_(options.levels),
+      mask_(options.slots - 1),
+      max_ticks_(uint64_t(1) << (bits_ * levels_)),
+      firing_(static_cast<uint32_t>(levels_ * options.slots)),
+      heads_(levels_ * options.slots + 1, kNil) {}
+
+TimerWheel::~TimerWheel() { tick_.cancel(); }
+
+TimerWheel::Node* TimerWheel::find_(Id id) {
+    const auto i = static_cast<uint32_t>(id);
+    if (i >= nodes_.size()) {
+        return nullptr;
+    }
+    Node& n = nodes_[i];
+    return n.list != kNil && n.generation == static_cast<uint32_t>(id >> 32) ? &n : nullptr;
+}
+
+uint64_t TimerWheel::tick_of_(clock::time_point t) const {
+    return t <= origin_ ? 0 : static_cast<uint64_t>((t - origin_) / resolution_);
+}
+
+uint64_t TimerWheel::deadline_(clock::duration delay) const {
+    // in whole ticks first: a delay of duration::max() does not overflow
+    const clock::duration since = clock::now() - origin_;
+    delay = std::max(delay, clock::duration::zero());
+    const auto rest = (since % resolution_ + delay % resolution_ + resolution_ - clock::duration(1)) / resolution_;
+    const auto tick = static_cast<uint64_t>(since / resolution_) + static_cast<uint64_t>(delay / resolution_) +
+                      static_cast<uint64_t>(rest);
+    // a timer due while the wheel lags behind fires with the next tick run
+    return std::max(tick, base_);
+}
+
+TimerWheel::Id TimerWheel::schedule(clock::duration delay, Callback callback) {
+    if (stats_.armed == 0) {
+        // nothing in the slots: skip the ticks nobody waited for
+        base_ = std::max(base_, tick_of_(clock::now()));
+    }
+    const uint64_t expires = deadline_(delay);
+    uint32_t i = free_;
+    if (i == kNil) {
+        i = static_cast<uint32_t>(nodes_.size());
+        nodes_.emplace_back();
+    } else {
+        free_ = nodes_[i].next;
+    }
+    Node& n = nodes_[i];
+    n.callback = std::move(callback);
+    n.expires = expires;
+    insert_(i);
+    ++stats_.scheduled;
+    ++stats_.armed;
+    arm_();
+    return (uint64_t(n.generation) << 32) | i;
+}
+
+bool TimerWheel::cancel(Id id) {
+    Node* n = find_(id);
+    if (n == nullptr) {
+        return false;
+    }
+    const auto i = static_cast<uint32_t>(id);
+    unlink_(i);
+    release_(i);
+    ++stats_.cancelled;
+    --stats_.armed;
+    return true;
+}
+
+bool TimerWheel::reschedule(Id id, clock::duration delay) {
+    Node* n = find_(id);
+    if (n == nullptr) {
+        return false;
+    }
+    const auto i = static_cast<uint32_t>(id);
+    unlink_(i);
+    n->expires = deadline_(delay);
+    insert_(i);
+    return true;
+}
+
+void TimerWheel::insert_(uint32_t i) {
+    const uint64_t expires = nodes_[i].expires;
+    // due already (the lagging case): the slot about to run
+    uint64_t delta = expires > base_ ? expires - base_ : 0;
+    uint64_t at = base_ + delta;
+    if (delta >= max_ticks_) {
+        // parked as far as the wheel reaches, moved down again from there
+        delta = max_ticks_ - 1;
+        at = base_ + delta;
+    }
+    const size_t level = delta == 0 ? 0 : (std::bit_width(delta) - 1) / bits_;
+    const size_t slot = static_cast<size_t>((at >> (bits_ * level)) & mask_);
+    link_(i, static_cast<uint32_t>((level << bits_) + slot));
+}
+
+void TimerWheel::link_(uint32_t i, uint32_t list) {
+    Node& n = nodes_[i];
+    n.list = list;
+    n.prev = kNil;
+    n.next = heads_[list];
+    if (n.next != kNil) {
+        nodes_[n.next].prev = i;
+    }
+    heads_[list] = i;
+}
+
+void TimerWheel::unlink_(uint32_t i) {
+    Node& n = nodes_[i];
+    if (n.prev != kNil) {
+        nodes_[n.prev].next = n.next;
+    } else {
+        heads_[n.list] = n.next;
+    }
+    if (n.next != kNil) {
+        nodes_[n.next].prev = n.prev;
+    }
+}
+
+void TimerWheel::release_(uint32_t i) {
+    Node& n = nodes_[i];
+    n.callback = nullptr;
+    n.list = kNil;
+    ++n.generation;
+    if (n.generation == 0) {
+        n.generation = 1;
+    }
+    n.next = free_;
+    free_ = i;
+}
+
+void TimerWheel::cascade_(size_t level, size_t slot) {
+    const auto list = static_cast<uint32_t>((level << bits_) + slot);
+    uint32_t i = heads_[list];
+    heads_[list] = kNil;
+    while (i != kNil) {
+        uint32_t next = nodes_[i].next;
+        insert_(i);
+        ++stats_.cascaded;
+        i = next;
+    }
+}
+
+size_t TimerWheel::run_tick_() {
+    const auto index = static_cast<size_t>(base_ & mask_);
+    if (index == 0) {
+        // level 0 wrapped: bring the next stretch of each level down, as far
+        // up as the levels wrapped too
+        for (size_t level = 1; level < levels_; ++level) {
+            const auto slot = static_cast<size_t>((base_ >> (bits_ * level)) & mask_);
+            cascade_(level, slot);
+            if (slot != 0) {
+                break;
+            }
+        }
+    }
+    // the slot becomes the firing list: what its timers schedule goes to
+    // the ticks after this one
+    uint32_t i = heads_[index];
+    heads_[index] = kNil;
+    heads_[firing_] = i;
+    for (; i != kNil; i = nodes_[i].next) {
+        nodes_[i].list = firing_;
+    }
+    ++base_;
+    ++stats_.ticks;
+    return fire_();
+}
+
+size_t TimerWheel::fire_() {
+    size_t fired = 0;
+    while (heads_[firing_] != kNil) {
+        const uint32_t i = heads_[firing_];
+        unlink_(i);
+        if (nodes_[i].expires >= base_) {
+            // parked beyond the wheel's reach, not due yet
+            insert_(i);
+            continue;
+        }
+        Callback callback = std::move(nodes_[i].callback);
+        release_(i);
+        --stats_.armed;
+        ++stats_.expired;
+        ++fired;
+        // may schedule, reschedule or cancel, the firing list included
+        callback();
+    }
+    return fired;
+}
+
+size_t TimerWheel::advance(clock::time_point now) {
+    // what a throwing callback left of its batch goes first
+    size_t fired = fire_();
+    const uint64_t target = tick_of_(now);
+    while (base_ <= target) {
+        if (stats_.armed == 0) {
+            base_ = target + 1;
+            break;
+        }
+        fired += run_tick_();
+    }
+    return fired;
+}
+
+void TimerWheel::arm_() {
+    if (armed_ || stats_.armed == 0) {
+        return;
+    }
+    armed_ = true;
+    tick_.expires_at(origin_ + resolution_ * static_cast<clock::rep>(base_));
+    tick_.async_wait([this](const asio::error_code& ec) {
+        if (ec) {
+            return;
+        }
+        armed_ = false;
+        advance(clock::now());
+        arm_();
+    });
+}
+}  // namespace lynx
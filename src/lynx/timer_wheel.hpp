@@ -0,0 +1,113 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include "asio.hpp"
+
+namespace lynx {
+struct TimerWheelOptions {
+    std::chrono::milliseconds resolution{10};  // a tick: timers fire up to this late, never early
+    size_t slots{256};                         // per level, a power of two
+    size_t levels{4};                          // level l spans slots^(l+1) ticks, farther timers wait at the top
+};
+
+// Hashed hierarchical timing wheel for the timers of one io_context: the
+// idle, keep-alive and retry timers of many connections. Level 0 has a slot
+// per tick, each level above a slot per slots ticks of the one below, and a
+// slot is a doubly linked list of timers, so scheduling, cancelling and
+// rescheduling are O(1) whatever the number of timers. When level 0 wraps,
+// the due slot of the level above is cascaded down.
+//
+// A single asio::steady_timer ticks every resolution while timers are armed
+// and expires the due slot as one batch: the reactor's timer queue holds one
+// entry instead of one per connection. Everything runs on the io_context
+// thread, the wheel is not thread safe; callbacks may schedule and cancel.
+class TimerWheel {
+  public:
+    using clock = std::chrono::steady_clock;
+    // generation and slot of a timer, 0 is never one: a stale id is refused
+    using Id = uint64_t;
+    using Callback = std::function<void()>;
+
+    struct Stats {
+        uint64_t scheduled{0};
+        uint64_t cancelled{0};
+        uint64_t expired{0};
+        uint64_t ticks{0};     // slots of level 0 run
+        uint64_t cascaded{0};  // timers moved down a level
+        size_t armed{0};
+    };
+
+    // throws std::invalid_argument unless resolution > 0, slots a power of two
+    // and levels within 64 bits of ticks
+    explicit TimerWheel(asio::io_context& ctx, const TimerWheelOptions& options = {});
+    ~TimerWheel();
+
+    TimerWheel(const TimerWheel&) = delete;
+    TimerWheel& operator=(const TimerWheel&) = delete;
+
+    // callback runs once, on the io_context, delay rounded up to the tick
+    Id schedule(clock::duration delay, Callback callback);
+    // false if it fired or was cancelled already
+    bool cancel(Id id);
+    // Moves it delay from now, keeping its callback: an idle timer pushed
+    // back on every read. false if it fired or was cancelled already.
+    bool reschedule(Id id, clock::duration delay);
+
+    // Runs the ticks up to now and their timers, returns how many fired. The
+    // asio tick calls it; a wheel whose io_context does not run (a bench) may
+    // be driven by hand.
+    size_t advance(clock::time_point now);
+
+    // of its io_context: the callbacks run there
+    asio::any_io_executor executor() { return tick_.get_executor(); }
+    size_t size() const { return stats_.armed; }
+    clock::duration resolution() const { return resolution_; }
+    const Stats& stats() const { return stats_; }
+
+  private:
+    static constexpr uint32_t kNil = UINT32_MAX;
+
+    struct Node {
+        Callback callback;
+        uint64_t expires{0};  // tick
+        uint32_t prev{kNil};
+        uint32_t next{kNil};
+        uint32_t list{kNil};  // index in heads_, kNil when free
+        uint32_t generation{1};
+    };
+
+    Node* find_(Id id);
+    uint64_t tick_of_(clock::time_point t) const;
+    // the first tick at or after now + delay
+    uint64_t deadline_(clock::duration delay) const;
+    void insert_(uint32_t i);
+    void link_(uint32_t i, uint32_t list);
+    void unlink_(uint32_t i);
+    void release_(uint32_t i);
+    void cascade_(size_t level, size_t slot);
+    // runs tick base_, returns the number of timers fired
+    size_t run_tick_();
+    size_t fire_();
+    void arm_();
+
+    asio::steady_timer tick_;
+    const clock::duration resolution_;
+    const clock::time_point origin_;  // tick 0
+    const size_t bits_;               // log2 of slots
+    const size_t levels_;
+    const uint64_t mask_;
+    const uint64_t max_ticks_;  // farthest placement, later timers are moved down again from there
+    const uint32_t firing_;     // list of the slot being run, in heads_ after the wheel's slots
+    std::vector<uint32_t> heads_;
+    std::vector<Node> nodes_;
+    uint32_t free_{kNil};  // free nodes, chained by next
+    uint64_t base_{0};     // next tick to run
+    bool armed_{false};
+    Stats stats_;
+};
+}  // namespace lynx
@@ -0,0 +1,304 @@
+#include "udp.hpp"
+
+#include <netinet/in.h>
+#include <netinet/udp.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <system_error>
+
+namespace lynx {
+namespace {
+constexpr size_t kMaxBatch = 1024;        // UIO_MAXIOV, sendmmsg/recvmmsg vlen limit
+constexpr size_t kGroBufferSize = 65536;  // a GRO read returns up to 64 KiB
+constexpr size_t kMaxGsoSegments = 64;    // UDP_MAX_SEGMENTS of older kernels
+constexpr size_t kMaxGsoPayload = 65507;  // payload of one IPv4 datagram, headers excluded
+constexpr size_t kReadBudget = 16;        // recvmmsg calls before giving other handlers a turn
+
+size_t clamp_batch(size_t n) { return std::clamp<size_t>(n, 1, kMaxBatch); }
+}  // namespace
+
+UdpSlab::UdpSlab(size_t count, size_t buffer_size)
+    : count_(count), buffer_size_(buffer_size), memory_(std::make_unique<char[]>(count * buffer_size)) {}
+
+UdpEngine::UdpEngine(asio::io_context& ctx, const UdpOptions& options)
+    : socket_(ctx),
+      options_(options),
+      recv_slab_(clamp_batch(options.batch_size), options.gro ? kGroBufferSize : options.max_datagram),
+      recv_msgs_(recv_slab_.count()),
+      recv_iov_(recv_slab_.count()),
+      senders_(recv_slab_.count()),
+      recv_control_(recv_slab_.count() * CMSG_SPACE(sizeof(int))),
+      send_slab_(clamp_batch(options.batch_size), options.max_datagram),
+      queue_(send_slab_.count()),
+      send_msgs_(send_slab_.count()),
+      send_iov_(send_slab_.count()),
+      msg_datagrams_(send_slab_.count()),
+      send_control_(send_slab_.count() * CMSG_SPACE(sizeof(uint16_t))) {
+    for (size_t i = 0; i < recv_msgs_.size(); ++i) {
+        recv_iov_[i] = {recv_slab_.buffer(i), recv_slab_.buffer_size()};
+        msghdr& h = recv_msgs_[i].msg_hdr;
+        h = {};
+        h.msg_name = senders_[i].data();
+        h.msg_iov = &recv_iov_[i];
+        h.msg_iovlen = 1;
+    }
+}
+
+void UdpEngine::bind(const endpoint& local) {
+    open_(local.protocol());
+    socket_.bind(local);
+}
+
+void UdpEngine::connect(const endpoint& remote) {
+    open_(remote.protocol());
+    socket_.connect(remote);
+}
+
+void UdpEngine::open_(const asio::ip::udp& protocol) {
+    if (socket_.is_open()) {
+        return;
+    }
+    socket_.open(protocol);
+    socket_.non_blocking(true);
+    if (options_.socket_buffer > 0) {
+        socket_.set_option(asio::socket_base::receive_buffer_size(options_.socket_buffer));
+        socket_.set_option(asio::socket_base::send_buffer_size(options_.socket_buffer));
+    }
+
+    // both are best effort: a kernel without them still gets plain batches
+    int fd = socket_.native_handle();
+    int one = 1;
+    gro_ = options_.gro && ::setsockopt(fd, SOL_UDP, UDP_GRO, &one, sizeof(one)) == 0;
+    int no_segment = 0;
+    gso_ = options_.gso && ::setsockopt(fd, SOL_UDP, UDP_SEGMENT, &no_segment, sizeof(no_segment)) == 0;
+}
+
+void UdpEngine::start(Handler handler) {
+    handler_ = std::move(handler);
+    running_ = true;
+    wait_read_();
+}
+
+void UdpEngine::stop() {
+    running_ = false;
+    write_waiting_ = false;
+    asio::error_code ec;
+    socket_.cancel(ec);
+}
+
+void UdpEngine::wait_read_() {
+    socket_.async_wait(asio::socket_base::wait_read, [this](const asio::error_code& ec) {
+        if (ec == asio::error::operation_aborted || !running_) {
+            return;
+        }
+        read_();
+    });
+}
+
+void UdpEngine::read_() {
+    const int fd = socket_.native_handle();
+    const auto batch = static_cast<unsigned int>(recv_msgs_.size());
+    for (size_t calls = 0; calls < kReadBudget && running_; ++calls) {
+        // the kernel overwrote the lengths of the previous batch
+        for (size_t i = 0; i < recv_msgs_.size(); ++i) {
+            msghdr& h = recv_msgs_[i].msg_hdr;
+            h.msg_namelen = static_cast<socklen_t>(senders_[i].capacity());
+            if (gro_) {
+                h.msg_control = recv_control_.data() + i * CMSG_SPACE(sizeof(int));
+                h.msg_controllen = CMSG_SPACE(sizeof(int));
+            }
+        }
+        int n = ::recvmmsg(fd, recv_msgs_.data(), batch, MSG_DONTWAIT, nullptr);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            // EAGAIN: drained. Anything else (an ICMP error on a connected
+            // socket) is about one datagram, keep on reading later.
+            break;
+        }
+        ++stats_.recv_calls;
+        for (int i = 0; i < n && running_; ++i) {
+            deliver_(static_cast<size_t>(i));
+        }
+        flush();
+        if (static_cast<unsigned int>(n) < batch) {
+            break;
+        }
+    }
+    if (running_) {
+        wait_read_();
+    }
+}
+
+void UdpEngine::deliver_(size_t i) {
+    const mmsghdr& m = recv_msgs_[i];
+    if (m.msg_hdr.msg_flags & MSG_TRUNC) {
+        ++stats_.truncated;
+        return;
+    }
+    senders_[i].resize(m.msg_hdr.msg_namelen);
+    const char* data = recv_slab_.buffer(i);
+    size_t len = m.msg_len;
+
+    size_t segment = len;
+    if (gro_) {
+        auto* h = const_cast<msghdr*>(&m.msg_hdr);
+        for (cmsghdr* c = CMSG_FIRSTHDR(h); c != nullptr; c = CMSG_NXTHDR(h, c)) {
+            if (c->cmsg_level == SOL_UDP && c->cmsg_type == UDP_GRO) {
+                int size;
+                std::memcpy(&size, CMSG_DATA(c), sizeof(size));
+                segment = size > 0 ? static_cast<size_t>(size) : len;
+            }
+        }
+    }
+    if (len == 0) {
+        ++stats_.received;
+        handler_(std::span<const char>(data, 0), senders_[i]);
+        return;
+    }
+    // coalesced by GRO: same sender, every datagram segment bytes but the last
+    for (size_t off = 0; off < len && running_; off += segment) {
+        ++stats_.received;
+        handler_(std::span<const char>(data + off, std::min(segment, len - off)), senders_[i]);
+    }
+}
+
+bool UdpEngine::send(std::span<const char> payload, const endpoint& to) {
+    if (payload.size() > send_slab_.buffer_size()) {
+        ++stats_.send_dropped;
+        return false;
+    }
+    if (queued_ == queue_.size()) {
+        flush();
+        if (queued_ == queue_.size()) {
+            ++stats_.send_dropped;
+            return false;
+        }
+    }
+    std::memcpy(send_slab_.buffer(queued_), payload.data(), payload.size());
+    queue_[queued_] = Queued{payload.size(), to, false};
+    ++queued_;
+    return true;
+}
+
+bool UdpEngine::send(std::span<const char> payload) {
+    static const endpoint none;
+    if (!send(payload, none)) {
+        return false;
+    }
+    queue_[queued_ - 1].connected = true;
+    return true;
+}
+
+size_t UdpEngine::build_send_batch_(size_t first) {
+    size_t messages = 0;
+    size_t j = first;
+    while (j < queued_) {
+        const Queued& head = queue_[j];
+        send_iov_[j] = {send_slab_.buffer(j), head.size};
+        msghdr& h = send_msgs_[messages].msg_hdr;
+        h = {};
+        if (!head.connected) {
+            h.msg_name = const_cast<sockaddr*>(head.to.data());
+            h.msg_namelen = static_cast<socklen_t>(head.to.size());
+        }
+        h.msg_iov = &send_iov_[j];
+
+        // GSO: a run of datagrams to the same peer, all head.size bytes but
+        // the last, leaves as one message the kernel segments again
+        size_t count = 1;
+        size_t bytes = head.size;
+        if (gso_ && head.size > 0) {
+            while (j + count < queued_ && count < kMaxGsoSegments) {
+                const Queued& next = queue_[j + count];
+                if (next.connected != head.connected || (!head.connected && !(next.to == head.to)) ||
+                    next.size == 0 || next.size > head.size || bytes + next.size > kMaxGsoPayload) {
+                    break;
+                }
+                send_iov_[j + count] = {send_slab_.buffer(j + count), next.size};
+                bytes += next.size;
+                ++count;
+                if (next.size < head.size) {
+                    break;
+                }
+            }
+        }
+        h.msg_iovlen = count;
+        if (count > 1) {
+            h.msg_control = send_control_.data() + messages * CMSG_SPACE(sizeof(uint16_t));
+            h.msg_controllen = CMSG_SPACE(sizeof(uint16_t));
+            cmsghdr* c = CMSG_FIRSTHDR(&h);
+            c->cmsg_level = SOL_UDP;
+            c->cmsg_type = UDP_SEGMENT;
+            c->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+            auto segment = static_cast<uint16_t>(head.size);
+            std::memcpy(CMSG_DATA(c), &segment, sizeof(segment));
+        }
+        msg_datagrams_[messages++] = count;
+        j += count;
+    }
+    return messages;
+}
+
+size_t UdpEngine::flush() {
+    if (queued_ == 0 || !socket_.is_open()) {
+        return 0;
+    }
+    const int fd = socket_.native_handle();
+    size_t first = 0;
+    size_t sent = 0;
+    bool blocked = false;
+    while (first < queued_) {
+        size_t messages = build_send_batch_(first);
+        int n = ::sendmmsg(fd, send_msgs_.data(), static_cast<unsigned int>(messages), MSG_DONTWAIT);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno == EAGAIN || errno == EWOULDBLOCK || errno == ENOBUFS) {
+                blocked = true;
+                break;
+            }
+            // refused peer, message too large...: only the first message is lost
+            stats_.send_dropped += msg_datagrams_[0];
+            first += msg_datagrams_[0];
+            continue;
+        }
+        ++stats_.send_calls;
+        for (int k = 0; k < n; ++k) {
+            first += msg_datagrams_[k];
+            sent += msg_datagrams_[k];
+        }
+    }
+    stats_.sent += sent;
+
+    // keep what the socket did not take at the front of the queue
+    size_t left = queued_ - first;
+    for (size_t k = 0; k < left; ++k) {
+        std::memcpy(send_slab_.buffer(k), send_slab_.buffer(first + k), queue_[first + k].size);
+        queue_[k] = queue_[first + k];
+    }
+    queued_ = left;
+    if (blocked) {
+        wait_write_();
+    }
+    return sent;
+}
+
+void UdpEngine::wait_write_() {
+    if (write_waiting_) {
+        return;
+    }
+    write_waiting_ = true;
+    socket_.async_wait(asio::socket_base::wait_write, [this](const asio::error_code& ec) {
+        if (ec == asio::error::operation_aborted) {
+            return;
+        }
+        write_waiting_ = false;
+        flush();
+    });
+}
+}  // namespace lynx
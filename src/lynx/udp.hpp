@@ -0,0 +1,134 @@
+#pragma once
+
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <span>
+#include <vector>
+
+#include "asio.hpp"
+
+namespace lynx {
+struct UdpOptions {
+    size_t batch_size{32};       // datagrams per recvmmsg/sendmmsg
+    size_t max_datagram{2048};   // largest datagram sent, or received without GRO
+    bool gro{false};             // let the kernel coalesce received datagrams, split again for the handler
+    bool gso{false};             // send runs of same sized datagrams to one peer as one segmented write
+    int socket_buffer{4 << 20};  // SO_RCVBUF and SO_SNDBUF, 0 keeps the system default
+};
+
+struct UdpStats {
+    uint64_t received{0};      // datagrams handed to the handler
+    uint64_t recv_calls{0};    // recvmmsg calls that returned datagrams
+    uint64_t truncated{0};     // datagrams larger than the receive buffer, dropped
+    uint64_t sent{0};          // datagrams accepted by the kernel
+    uint64_t send_calls{0};    // sendmmsg calls
+    uint64_t send_dropped{0};  // send queue full or send error
+};
+
+// Fixed size buffers carved out of one allocation, made once and reused for
+// every batch, so that receiving or queuing a datagram never allocates.
+class UdpSlab {
+  public:
+    UdpSlab(size_t count, size_t buffer_size);
+
+    size_t count() const { return count_; }
+    size_t buffer_size() const { return buffer_size_; }
+    char* buffer(size_t i) { return memory_.get() + i * buffer_size_; }
+
+  private:
+    size_t count_;
+    size_t buffer_size_;
+    std::unique_ptr<char[]> memory_;
+};
+
+// Datagram socket on an asio io_context moving up to batch_size datagrams per
+// system call with recvmmsg/sendmmsg. The socket is non blocking: asio only
+// tells when it is readable (or writable again), the engine then drains it.
+//
+// Server: bind() then start(handler). Client: connect() or not, send() then
+// flush(), and start(handler) to get the answers. Everything runs on the
+// io_context thread, the engine is not thread safe.
+class UdpEngine {
+  public:
+    using endpoint = asio::ip::udp::endpoint;
+    // payload views the receive slab: valid until the handler returns
+    using Handler = std::function<void(std::span<const char> payload, const endpoint& from)>;
+
+    explicit UdpEngine(asio::io_context& ctx, const UdpOptions& options = {});
+
+    UdpEngine(const UdpEngine&) = delete;
+    UdpEngine& operator=(const UdpEngine&) = delete;
+
+    // throw std::system_error
+    void bind(const endpoint& local);
+    void connect(const endpoint& remote);
+    endpoint local_endpoint() const { return socket_.local_endpoint(); }
+
+    // Calls handler for every datagram received until stop(). The send queue
+    // is flushed after each batch, so replies sent from the handler go out
+    // together.
+    void start(Handler handler);
+    void stop();
+
+    // Copies payload into the send queue, flushed when full. False when the
+    // datagram is too large or the queue is full and the socket would block.
+    bool send(std::span<const char> payload, const endpoint& to);
+    // to the connected peer
+    bool send(std::span<const char> payload);
+    // sendmmsg what is queued, what the socket does not take now goes when it
+    // is writable again. Returns the number of datagrams sent.
+    size_t flush();
+    size_t queued() const { return queued_; }
+
+    // false when the kernel refused them, see UdpOptions
+    bool gro() const { return gro_; }
+    bool gso() const { return gso_; }
+    const UdpStats& stats() const { return stats_; }
+
+  private:
+    struct Queued {
+        size_t size;
+        endpoint to;
+        bool connected;
+    };
+
+    void open_(const asio::ip::udp& protocol);
+    void wait_read_();
+    void read_();
+    void deliver_(size_t i);
+    void wait_write_();
+    // fills send_msgs_ with queue_[first, queued_), returns the message count
+    size_t build_send_batch_(size_t first);
+
+    asio::ip::udp::socket socket_;
+    UdpOptions options_;
+    Handler handler_;
+    bool gro_{false};
+    bool gso_{false};
+    bool running_{false};
+    bool write_waiting_{false};
+
+    // receive side: one slab buffer, sender address and control block per message
+    UdpSlab recv_slab_;
+    std::vector<mmsghdr> recv_msgs_;
+    std::vector<iovec> recv_iov_;
+    std::vector<endpoint> senders_;
+    std::vector<char> recv_control_;
+
+    // send side: queued datagrams, one slab buffer each
+    UdpSlab send_slab_;
+    std::vector<Queued> queue_;
+    size_t queued_{0};
+    std::vector<mmsghdr> send_msgs_;
+    std::vector<iovec> send_iov_;
+    std::vector<size_t> msg_datagrams_;  // datagrams carried by each message
+    std::vector<char> send_control_;
+
+    UdpStats stats_;
+};
+}  // namespace lynx
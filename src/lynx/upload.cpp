@@ -0,0 +1,135 @@
+#include "upload.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdlib>
+#include <system_error>
+#include <utility>
+
+#include "cinatra.hpp"
+
+namespace lynx {
+namespace {
+// O_TMPFILE where the file system has it, mkstemp() and unlink() elsewhere
+int open_unlinked(const std::string& dir) {
+    int fd = ::open(dir.c_str(), O_TMPFILE | O_RDWR | O_CLOEXEC, 0600);
+    if (fd >= 0 || (errno != EOPNOTSUPP && errno != EISDIR && errno != EINVAL)) {
+        return fd;
+    }
+    std::string path = dir + "/lynx-upload-XXXXXX";
+    fd = ::mkostemp(path.data(), O_CLOEXEC);
+    if (fd >= 0) {
+        ::unlink(path.c_str());
+    }
+    return fd;
+}
+
+void write_all(int fd, std::span<const char> data) {
+    while (!data.empty()) {
+        ssize_t n = ::write(fd, data.data(), data.size());
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n < 0) {
+            throw std::system_error(errno, std::generic_category(), "upload spill write");
+        }
+        data = data.subspan(static_cast<size_t>(n));
+    }
+}
+}  // namespace
+
+SpilledBody::~SpilledBody() { reset_(); }
+
+SpilledBody::SpilledBody(SpilledBody&& other) noexcept
+    : fd_(std::exchange(other.fd_, -1)), size_(std::exchange(other.size_, 0)), map_(std::exchange(other.map_, nullptr)) {}
+
+SpilledBody& SpilledBody::operator=(SpilledBody&& other) noexcept {
+    if (this != &other) {
+        reset_();
+        fd_ = std::exchange(other.fd_, -1);
+        size_ = std::exchange(other.size_, 0);
+        map_ = std::exchange(other.map_, nullptr);
+    }
+    return *this;
+}
+
+std::span<const char> SpilledBody::view() {
+    if (size_ == 0) {
+        return {};
+    }
+    if (map_ == nullptr) {
+        void* map = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd_, 0);
+        if (map == MAP_FAILED) {
+            throw std::system_error(errno, std::generic_category(), "upload spill mmap");
+        }
+        map_ = map;
+    }
+    return {static_cast<const char*>(map_), size_};
+}
+
+void SpilledBody::reset_() {
+    if (map_) {
+        ::munmap(map_, size_);
+        map_ = nullptr;
+    }
+    if (fd_ >= 0) {
+        ::close(fd_);
+        fd_ = -1;
+    }
+}
+
+BodyStream::BodyStream(cinatra::coro_http_request& req, const UploadOptions& options)
+    : conn_(req.get_conn()), window_size_(options.window), spill_dir_(options.spill_dir) {
+    if (conn_->body_left() > 0) {
+        size_ = conn_->body_left();
+    } else {
+        buffered_ = req.get_body();
+        size_ = buffered_.size();
+    }
+}
+
+async_simple::coro::Lazy<std::span<const char>> BodyStream::next() {
+    if (!buffered_.empty()) {
+        std::span<const char> all(buffered_.data(), buffered_.size());
+        buffered_ = {};
+        received_ = size_;
+        co_return all;
+    }
+    if (received_ == size_) {
+        co_return std::span<const char>{};
+    }
+    if (!window_) {
+        window_ = std::make_unique_for_overwrite<char[]>(window_size_);
+    }
+    auto [ec, n] = co_await conn_->read_body_some(window_.get(), window_size_);
+    if (ec) {
+        throw std::system_error(ec, "upload read");
+    }
+    if (n == 0) {
+        throw std::system_error(std::make_error_code(std::errc::connection_aborted), "upload read");
+    }
+    received_ += n;
+    co_return std::span<const char>(window_.get(), n);
+}
+
+async_simple::coro::Lazy<SpilledBody> BodyStream::spill() {
+    int fd = open_unlinked(spill_dir_);
+    if (fd < 0) {
+        throw std::system_error(errno, std::generic_category(), "upload spill open in " + spill_dir_);
+    }
+    SpilledBody file(fd, 0);
+    size_t start = received_;
+    for (;;) {
+        auto part = co_await next();
+        if (part.empty()) {
+            break;
+        }
+        write_all(fd, part);
+    }
+    file.size_ = received_ - start;
+    co_return std::move(file);
+}
+}  // namespace lynx
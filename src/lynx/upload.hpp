@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
+
+#include "async_simple/coro/Lazy.h"
+#include "options.hpp"
+
+namespace cinatra {
+class coro_http_connection;
+class coro_http_request;
+}  // namespace cinatra
+
+namespace lynx {
+// A request body spilled to an unlinked temporary file: nothing is left on
+// disk once the object is gone. Move only.
+class SpilledBody {
+  public:
+    SpilledBody() = default;
+    SpilledBody(int fd, size_t size) : fd_(fd), size_(size) {}
+    ~SpilledBody();
+    SpilledBody(SpilledBody&& other) noexcept;
+    SpilledBody& operator=(SpilledBody&& other) noexcept;
+
+    int fd() const { return fd_; }
+    size_t size() const { return size_; }
+    // the whole body, mapped read only on the first call; throws std::system_error
+    std::span<const char> view();
+
+  private:
+    friend class BodyStream;
+    void reset_();
+
+    int fd_{-1};
+    size_t size_{0};
+    void* map_{nullptr};
+};
+
+// The body of a request to a streaming route, read on demand. A body of at
+// least UploadOptions::stream_min bytes is still in the socket when the
+// handler starts: next() reads at most a window of it at a time, and reads
+// nothing until it is called, so a slow consumer slows the client down (TCP
+// flow control) instead of growing a buffer. A smaller body was read before
+// the handler ran and comes as a single part.
+class BodyStream {
+  public:
+    BodyStream(cinatra::coro_http_request& req, const UploadOptions& options);
+
+    // Content-Length
+    size_t size() const { return size_; }
+    size_t received() const { return received_; }
+
+    // The next part of the body, valid until the next call; empty once all
+    // of it was read. Throws std::system_error if the connection fails.
+    async_simple::coro::Lazy<std::span<const char>> next();
+
+    // Reads the rest of the body into an unlinked file in spill_dir, the
+    // window being the only memory used. The writes go to the page cache on
+    // the io thread. Throws std::system_error.
+    async_simple::coro::Lazy<SpilledBody> spill();
+
+  private:
+    cinatra::coro_http_connection* conn_;
+    std::string_view buffered_;  // the body if it was read before the handler ran
+    std::unique_ptr<char[]> window_;
+    size_t window_size_;
+    size_t size_;
+    size_t received_{0};
+    const std::string& spill_dir_;
+};
+}  // namespace lynx